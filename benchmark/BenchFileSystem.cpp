@@ -0,0 +1,525 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#include <Langulus/IO.hpp>
+#include <Langulus/Testing.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include "FileSystem.hpp"
+#include "PackFormat.hpp"
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+constexpr size_t SmallCount = 4096;
+constexpr size_t SmallSize = 4 * 1024;
+constexpr size_t LargeSize = 64 * 1024 * 1024;
+constexpr size_t ChunkSize = 64 * 1024;
+constexpr size_t WriteSize = 64;
+
+
+/// Name of a small fixture file                                              
+///   @param index - the index of the file                                    
+///   @return the name, relative to the fixture folder                        
+static std::string SmallName(size_t index) {
+   auto number = std::to_string(index);
+   return "small/" + std::string(4 - std::min<size_t>(4, number.size()), '0')
+      + number + ".bin";
+}
+
+/// Pack a set of contents, the same way the packer tool does, but without    
+/// compression. Fixtures are generated, so there's nothing to walk           
+///   @param target - the .lpk file to create                                 
+///   @param files - names and contents, folders have no contents             
+static void WritePack(
+   const fs::path& target,
+   std::vector<std::pair<std::string, const std::vector<char>*>> files
+) {
+   using namespace PackFormat;
+   std::ranges::sort(files, {}, &decltype(files)::value_type::first);
+
+   std::vector<PackEntry> entries(files.size());
+   std::string names;
+   for (size_t i = 0; i < files.size(); ++i) {
+      auto& entry = entries[i];
+      entry = {};
+      entry.mNameOffset = static_cast<uint32_t>(names.size());
+      entry.mNameSize = static_cast<uint32_t>(files[i].first.size());
+      entry.mFlags = files[i].second ? 0u : uint32_t {Directory};
+      entry.mModTime = -1;
+      names += files[i].first;
+   }
+
+   PackHeader header {};
+   std::memcpy(header.mMagic, Magic, sizeof(Magic));
+   header.mVersion = Version;
+   header.mAlignment = DefaultAlignment;
+   header.mEntryCount = static_cast<uint32_t>(entries.size());
+   header.mEntriesOffset = sizeof(PackHeader);
+   header.mNamesOffset = header.mEntriesOffset
+      + entries.size() * sizeof(PackEntry);
+   header.mNamesSize = names.size();
+   header.mCompression = None;
+
+   // Data offsets are known in advance, because nothing is compressed  
+   auto at = Align(header.mNamesOffset + names.size(), DefaultAlignment);
+   for (size_t i = 0; i < files.size(); ++i) {
+      if (not files[i].second)
+         continue;
+
+      entries[i].mOffset = at;
+      entries[i].mSize = entries[i].mStoredSize = files[i].second->size();
+      at = Align(at + entries[i].mSize, DefaultAlignment);
+   }
+
+   std::ofstream output {target, std::ios::binary | std::ios::trunc};
+   output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+   output.write(reinterpret_cast<const char*>(entries.data()),
+      entries.size() * sizeof(PackEntry));
+   output.write(names.data(), names.size());
+
+   for (size_t i = 0; i < files.size(); ++i) {
+      if (not files[i].second)
+         continue;
+
+      const std::vector<char> zeroes(
+         entries[i].mOffset - static_cast<uint64_t>(output.tellp()));
+      output.write(zeroes.data(), zeroes.size());
+      output.write(files[i].second->data(), files[i].second->size());
+   }
+}
+
+/// Writes bits in the order deflate expects them                             
+struct BitWriter {
+   std::vector<char>& mOutput;
+   uint32_t mBits = 0;
+   int mCount = 0;
+
+   /// Write the lowest bits of a value, least significant first              
+   void Put(uint32_t value, int count) {
+      mBits |= value << mCount;
+      mCount += count;
+      while (mCount >= 8) {
+         mOutput.push_back(static_cast<char>(mBits & 0xFF));
+         mBits >>= 8;
+         mCount -= 8;
+      }
+   }
+
+   /// Write a Huffman code, most significant bit first                       
+   void PutCode(uint32_t code, int count) {
+      uint32_t reversed = 0;
+      for (int i = 0; i < count; ++i)
+         reversed |= ((code >> i) & 1) << (count - 1 - i);
+      Put(reversed, count);
+   }
+
+   void Finish() {
+      if (mCount)
+         mOutput.push_back(static_cast<char>(mBits & 0xFF));
+      mBits = 0;
+      mCount = 0;
+   }
+};
+
+/// Compress contents with deflate, using the fixed Huffman codes, and a      
+/// simple hash chain of length one to find repeated strings. Far from what   
+/// zlib achieves, but the archive has to be decompressed all the same        
+///   @param input - the contents to compress                                 
+///   @return the raw deflate stream                                          
+static std::vector<char> Deflate(const std::vector<char>& input) {
+   static constexpr uint16_t LengthBase[29] {
+      3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+      35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+   };
+   static constexpr uint8_t LengthExtra[29] {
+      0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+      3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+   };
+   static constexpr uint16_t DistanceBase[30] {
+      1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+      257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+      8193, 12289, 16385, 24577
+   };
+   static constexpr uint8_t DistanceExtra[30] {
+      0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+      7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+   };
+
+   std::vector<char> output;
+   output.reserve(input.size() + input.size() / 8 + 16);
+   BitWriter bits {output};
+
+   const auto symbol = [&](uint32_t value) {
+      if (value < 144)
+         bits.PutCode(0x30 + value, 8);
+      else if (value < 256)
+         bits.PutCode(0x190 + value - 144, 9);
+      else if (value < 280)
+         bits.PutCode(value - 256, 7);
+      else
+         bits.PutCode(0xC0 + value - 280, 8);
+   };
+
+   // A single final block, compressed with the fixed codes             
+   bits.Put(1, 1);
+   bits.Put(1, 2);
+
+   const auto data = reinterpret_cast<const uint8_t*>(input.data());
+   const size_t size = input.size();
+   std::vector<int64_t> head(1 << 15, -1);
+   size_t at = 0;
+   while (at < size) {
+      size_t length = 0;
+      size_t distance = 0;
+      if (at + 3 <= size) {
+         const auto hash = ((data[at] << 10) ^ (data[at + 1] << 5)
+            ^ data[at + 2]) & 0x7FFF;
+         const auto candidate = head[hash];
+         head[hash] = static_cast<int64_t>(at);
+
+         const auto from = static_cast<size_t>(candidate);
+         if (candidate >= 0 and at - from <= 32768) {
+            const auto limit = std::min<size_t>(258, size - at);
+            while (length < limit and data[from + length] == data[at + length])
+               ++length;
+            distance = at - from;
+         }
+      }
+
+      if (length < 3) {
+         symbol(data[at++]);
+         continue;
+      }
+
+      size_t code = 28;
+      while (LengthBase[code] > length)
+         --code;
+      symbol(257 + static_cast<uint32_t>(code));
+      bits.Put(static_cast<uint32_t>(length - LengthBase[code]),
+         LengthExtra[code]);
+
+      code = 29;
+      while (DistanceBase[code] > distance)
+         --code;
+      bits.PutCode(static_cast<uint32_t>(code), 5);
+      bits.Put(static_cast<uint32_t>(distance - DistanceBase[code]),
+         DistanceExtra[code]);
+      at += length;
+   }
+
+   symbol(256);
+   bits.Finish();
+   return output;
+}
+
+/// Compute the CRC-32 of contents, as stored in zip archives                 
+///   @param input - the contents                                             
+///   @return the checksum                                                    
+static uint32_t Crc32(const std::vector<char>& input) {
+   static const auto table = [] {
+      std::array<uint32_t, 256> result {};
+      for (uint32_t i = 0; i < 256; ++i) {
+         uint32_t c = i;
+         for (int k = 0; k < 8; ++k)
+            c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+         result[i] = c;
+      }
+      return result;
+   }();
+
+   uint32_t crc = 0xFFFFFFFFu;
+   for (auto c : input)
+      crc = table[(crc ^ static_cast<uint8_t>(c)) & 0xFF] ^ (crc >> 8);
+   return crc ^ 0xFFFFFFFFu;
+}
+
+/// Write a zip archive, with every file compressed by Deflate                
+///   @param target - the .zip file to create                                 
+///   @param files - names and contents                                       
+static void WriteZip(
+   const fs::path& target,
+   const std::vector<std::pair<std::string, const std::vector<char>*>>& files
+) {
+   std::ofstream output {target, std::ios::binary | std::ios::trunc};
+   std::string directory;
+   const auto put = [](std::string& into, uint32_t value, int bytes) {
+      for (int i = 0; i < bytes; ++i)
+         into += static_cast<char>((value >> (8 * i)) & 0xFF);
+   };
+
+   uint32_t offset = 0;
+   for (auto& [name, contents] : files) {
+      const auto packed = Deflate(*contents);
+      const auto crc = Crc32(*contents);
+      const auto size = static_cast<uint32_t>(contents->size());
+      const auto stored = static_cast<uint32_t>(packed.size());
+      const auto nameSize = static_cast<uint32_t>(name.size());
+
+      // Local header, followed by the compressed contents              
+      std::string local;
+      put(local, 0x04034B50, 4);
+      put(local, 20, 2);         // Version needed to extract           
+      put(local, 0, 2);          // Flags                               
+      put(local, 8, 2);          // Deflate                             
+      put(local, 0, 2);          // Time                                
+      put(local, 0x21, 2);       // Date - 1980-01-01                   
+      put(local, crc, 4);
+      put(local, stored, 4);
+      put(local, size, 4);
+      put(local, nameSize, 2);
+      put(local, 0, 2);          // Extra field size                    
+      local += name;
+      output.write(local.data(), local.size());
+      output.write(packed.data(), packed.size());
+
+      // Central directory entry, written after all contents            
+      put(directory, 0x02014B50, 4);
+      put(directory, 20, 2);     // Version made by                     
+      put(directory, 20, 2);     // Version needed to extract           
+      put(directory, 0, 2);
+      put(directory, 8, 2);
+      put(directory, 0, 2);
+      put(directory, 0x21, 2);
+      put(directory, crc, 4);
+      put(directory, stored, 4);
+      put(directory, size, 4);
+      put(directory, nameSize, 2);
+      put(directory, 0, 2);      // Extra field size                    
+      put(directory, 0, 2);      // Comment size                        
+      put(directory, 0, 2);      // Disk number                         
+      put(directory, 0, 2);      // Internal attributes                 
+      put(directory, 0, 4);      // External attributes                 
+      put(directory, offset, 4);
+      directory += name;
+
+      offset += static_cast<uint32_t>(local.size()) + stored;
+   }
+
+   std::string end;
+   put(end, 0x06054B50, 4);
+   put(end, 0, 2);
+   put(end, 0, 2);
+   put(end, static_cast<uint32_t>(files.size()), 2);
+   put(end, static_cast<uint32_t>(files.size()), 2);
+   put(end, static_cast<uint32_t>(directory.size()), 4);
+   put(end, offset, 4);
+   put(end, 0, 2);
+   output.write(directory.data(), directory.size());
+   output.write(end.data(), end.size());
+}
+
+/// Generate all fixtures inside the data folder, unless already generated    
+/// The same contents are available natively, in data/bench, inside           
+/// data/bench.lpk, whose entries are in bench-pack, and compressed inside    
+/// data/bench.zip, which is mounted at bench-zip                             
+///   @param data - the data folder                                           
+static void GenerateFixtures(const fs::path& data) {
+   const auto marker = data / "bench" / ".generated";
+   if (fs::exists(marker) and fs::exists(data / "bench.zip"))
+      return;
+
+   fs::create_directories(data / "bench" / "small");
+   std::mt19937 random {42};
+   std::uniform_int_distribution<int> byte {0, 255};
+
+   std::vector<char> large(LargeSize);
+   for (auto& c : large)
+      c = static_cast<char>(byte(random));
+
+   std::vector<std::vector<char>> small(SmallCount);
+   for (auto& contents : small) {
+      contents.resize(SmallSize);
+      for (auto& c : contents)
+         c = static_cast<char>(byte(random));
+   }
+
+   std::vector<std::pair<std::string, const std::vector<char>*>> packed {
+      {"bench-pack", nullptr},
+      {"bench-pack/small", nullptr},
+      {"bench-pack/large.bin", &large}
+   };
+   std::vector<std::pair<std::string, const std::vector<char>*>> zipped {
+      {"large.bin", &large}
+   };
+
+   std::ofstream {data / "bench" / "large.bin", std::ios::binary}
+      .write(large.data(), large.size());
+   for (size_t i = 0; i < SmallCount; ++i) {
+      const auto name = SmallName(i);
+      std::ofstream {data / "bench" / name, std::ios::binary}
+         .write(small[i].data(), small[i].size());
+      packed.emplace_back("bench-pack/" + name, &small[i]);
+      zipped.emplace_back(name, &small[i]);
+   }
+
+   WritePack(data / "bench.lpk", std::move(packed));
+   WriteZip(data / "bench.zip", zipped);
+   std::ofstream {marker} << "fixtures for the file system benchmarks\n";
+}
+
+
+SCENARIO("File system benchmarks", "[benchmark]") {
+   auto root = Thing::Root<false>("FileSystem");
+   const auto runtime = root.GetRuntime();
+   const auto data = fs::path {
+      std::string {AsToken(runtime->GetWorkingPath())}} / "data";
+   GenerateFixtures(data);
+
+   // The abstract interface can't mount, so go through the module      
+   auto anchor = runtime->GetFile("bench/large.bin");
+   const auto module = static_cast<::File*>(anchor.Get())->GetProducer();
+   const auto mount = [&](const fs::path& native, Token point, int order) {
+      const auto path = fs::absolute(native).string();
+      return module->Mount(Path {Token {path}}, Path {point}, order);
+   };
+
+   // Archives go below loose files, like packs usually do              
+   REQUIRE(mount(data / "bench.lpk", {}, -1));
+   REQUIRE(mount(data / "bench.zip", "bench-zip", -1));
+   REQUIRE(runtime->GetFolder("bench-pack")->Exists());
+   REQUIRE(runtime->GetFolder("bench-zip")->Exists());
+
+   GIVEN("Path lookups") {
+      BENCHMARK("Lookup of an already interfaced file") {
+         return runtime->GetFile("bench/large.bin");
+      };
+
+      BENCHMARK("Lookup of an already interfaced folder") {
+         return runtime->GetFolder("bench/small");
+      };
+
+      size_t fresh = 0;
+      BENCHMARK("Lookup of a missing file") {
+         return runtime->GetFile(Path {Token {
+            "bench/missing-" + std::to_string(fresh++) + ".bin"}});
+      };
+
+      BENCHMARK_ADVANCED("Interfacing 4096 files for the first time")(
+         Catch::Benchmark::Chronometer meter
+      ) {
+         // Paths differ between runs, so nothing is interfaced already 
+         static size_t run = 0;
+         std::vector<Path> paths;
+         paths.reserve(SmallCount * meter.runs());
+         for (int r = 0; r < meter.runs(); ++r, ++run) {
+            for (size_t i = 0; i < SmallCount; ++i) {
+               paths.emplace_back(Token {"bench/fresh-" + std::to_string(run)
+                  + '/' + std::to_string(i) + ".bin"});
+            }
+         }
+
+         meter.measure([&](int r) {
+            size_t found = 0;
+            for (size_t i = 0; i < SmallCount; ++i)
+               found += runtime->GetFile(paths[r * SmallCount + i])->Exists();
+            return found;
+         });
+      };
+   }
+
+   GIVEN("Sequential reads of a 64MiB file, in 64KiB chunks") {
+      const auto read = [&](const Path& path) {
+         TMany<Byte> chunk;
+         chunk.New(ChunkSize);
+
+         auto reader = runtime->GetFile(path)->NewReader();
+         size_t total = 0;
+         while (const auto r = reader->Read(chunk)) {
+            total += r;
+            if (r < ChunkSize)
+               break;
+         }
+         return total;
+      };
+
+      BENCHMARK("From a native directory") {
+         return read("bench/large.bin");
+      };
+
+      BENCHMARK("From a pack") {
+         return read("bench-pack/large.bin");
+      };
+
+      BENCHMARK("From a compressed zip") {
+         return read("bench-zip/large.bin");
+      };
+   }
+
+   GIVEN("Random reads of whole 4KiB files") {
+      // The abstract reader can't seek, so random access is done over  
+      // many small files instead                                       
+      std::mt19937 random {7};
+      std::uniform_int_distribution<size_t> pick {0, SmallCount - 1};
+
+      BENCHMARK("From a native directory") {
+         const Path path {Token {"bench/" + SmallName(pick(random))}};
+         return runtime->GetFile(path)->ReadAs(nullptr).GetBytesize();
+      };
+
+      BENCHMARK("From a pack") {
+         const Path path {Token {"bench-pack/" + SmallName(pick(random))}};
+         return runtime->GetFile(path)->ReadAs(nullptr).GetBytesize();
+      };
+
+      BENCHMARK("From a compressed zip") {
+         const Path path {Token {"bench-zip/" + SmallName(pick(random))}};
+         return runtime->GetFile(path)->ReadAs(nullptr).GetBytesize();
+      };
+   }
+
+   GIVEN("Small writes") {
+      TMany<Byte> data;
+      data.New(WriteSize);
+
+      BENCHMARK("1024 writes of 64 bytes each") {
+         auto writer = runtime->GetFile("bench/written.bin")->NewWriter(false);
+         size_t total = 0;
+         for (int i = 0; i < 1024; ++i)
+            total += writer->Write(data);
+         return total;
+      };
+
+      BENCHMARK("1024 buffered writes of 64 bytes each") {
+         auto file = runtime->GetFile("bench/written.bin");
+         auto writer = static_cast<::File*>(file.Get())
+            ->NewWriter(false, ::File::Buffering {});
+         size_t total = 0;
+         for (int i = 0; i < 1024; ++i)
+            total += writer->Write(data);
+         return total;
+      };
+   }
+
+   GIVEN("Directory enumeration") {
+      auto native = root.CreateUnit<A::Folder>("bench");
+      auto packed = root.CreateUnit<A::Folder>("bench-pack");
+      auto zipped = root.CreateUnit<A::Folder>("bench-zip");
+
+      BENCHMARK("Of a native directory") {
+         Verbs::Select select {Text {"**"}};
+         Flow::DispatchFlat(native, select);
+         return select.GetOutput().GetCount();
+      };
+
+      BENCHMARK("Of a pack") {
+         Verbs::Select select {Text {"**"}};
+         Flow::DispatchFlat(packed, select);
+         return select.GetOutput().GetCount();
+      };
+
+      BENCHMARK("Of a compressed zip") {
+         Verbs::Select select {Text {"**"}};
+         Flow::DispatchFlat(zipped, select);
+         return select.GetOutput().GetCount();
+      };
+   }
+}
@@ -0,0 +1,10 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#include <Langulus/MetaOf.hpp>
+
+LANGULUS_RTTI_BOUNDARY(RTTI::MainBoundary)
\ No newline at end of file
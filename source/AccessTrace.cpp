@@ -0,0 +1,123 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#include "AccessTrace.hpp"
+#include <charconv>
+
+
+/// First line of every manifest                                              
+constexpr std::string_view ManifestHeader = "# langulus access trace v1";
+
+/// Start recording, forgetting about anything recorded before                
+void AccessTrace::Start() {
+   std::scoped_lock lock {mMutex};
+   mAccesses.clear();
+   mLast.clear();
+   mRecording = true;
+}
+
+/// Stop recording, keeping what was recorded                                 
+void AccessTrace::Stop() {
+   mRecording = false;
+}
+
+/// Record an access to a file                                                
+///   @param path - virtual path of the file                                  
+///   @param offset - where the read started                                  
+///   @param size - number of bytes read, zero if file was only opened        
+void AccessTrace::Record(std::string_view path, Offset offset, Offset size) {
+   if (not IsRecording())
+      return;
+
+   std::scoped_lock lock {mMutex};
+   const auto found = mLast.find(std::string {path});
+   if (found != mLast.end()) {
+      // Opening a file again adds nothing new                          
+      if (not size)
+         return;
+
+      auto& last = mAccesses[found->second];
+      if (not last.mSize)
+         last.mOffset = offset;
+      if (last.mOffset + last.mSize == offset) {
+         last.mSize += size;
+         return;
+      }
+
+      found->second = mAccesses.size();
+   }
+   else mLast.emplace(path, mAccesses.size());
+
+   mAccesses.push_back({std::string {path}, offset, size});
+}
+
+/// Get a copy of everything recorded so far                                  
+///   @return the accesses, in the order they happened                        
+auto AccessTrace::GetAccesses() -> std::vector<Access> {
+   std::scoped_lock lock {mMutex};
+   return mAccesses;
+}
+
+/// Write accesses as a manifest - a line per access, with the offset, size   
+/// and path, separated by spaces                                             
+///   @param accesses - the accesses to write                                 
+///   @return the manifest text                                               
+std::string AccessTrace::Serialize(const std::vector<Access>& accesses) {
+   std::string result {ManifestHeader};
+   result += '\n';
+   for (auto& access : accesses) {
+      result += std::to_string(access.mOffset);
+      result += ' ';
+      result += std::to_string(access.mSize);
+      result += ' ';
+      result += access.mPath;
+      result += '\n';
+   }
+   return result;
+}
+
+/// Read accesses from a manifest                                             
+///   @param manifest - the manifest text                                     
+///   @param accesses - [out] the accesses are appended here                  
+///   @return false if manifest is malformed                                  
+bool AccessTrace::Parse(
+   std::string_view manifest, std::vector<Access>& accesses
+) {
+   if (not manifest.starts_with(ManifestHeader))
+      return false;
+
+   while (not manifest.empty()) {
+      const auto end = manifest.find('\n');
+      auto line = manifest.substr(0, end);
+      manifest.remove_prefix(end == std::string_view::npos
+         ? manifest.size() : end + 1);
+      if (not line.empty() and line.back() == '\r')
+         line.remove_suffix(1);
+      if (line.empty() or line.front() == '#')
+         continue;
+
+      const auto number = [&line](Offset& value) {
+         const auto [next, ec] = std::from_chars(
+            line.data(), line.data() + line.size(), value);
+         if (ec != std::errc {} or next == line.data() + line.size()
+         or *next != ' ')
+            return false;
+         line.remove_prefix(next - line.data() + 1);
+         return true;
+      };
+
+      Access access;
+      if (not number(access.mOffset) or not number(access.mSize)
+      or line.empty())
+         return false;
+
+      access.mPath = line;
+      accesses.emplace_back(std::move(access));
+   }
+
+   return true;
+}
@@ -0,0 +1,56 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#pragma once
+#include "Common.hpp"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+
+///                                                                           
+///   File access trace                                                       
+///                                                                           
+///   Records which files were opened, and which byte ranges were read from   
+/// them, in the order it happened. Consecutive reads that continue where     
+/// the previous read of the same file ended are merged into one access.      
+///   Saved traces are manifests for the Prefetcher, which replays them on    
+/// the next launch, so that files are already cached when they're needed     
+///                                                                           
+struct AccessTrace {
+   struct Access {
+      // Virtual path of the file                                       
+      std::string mPath;
+      Offset mOffset;
+      // Zero if file was only opened                                   
+      Offset mSize;
+   };
+
+private:
+   std::vector<Access> mAccesses;
+   // Index of the last access of each file, to merge continuous reads  
+   std::unordered_map<std::string, size_t> mLast;
+   std::mutex mMutex;
+   // Checked on every read, so it's kept outside the mutex             
+   std::atomic_bool mRecording = false;
+
+public:
+   void Start();
+   void Stop();
+   bool IsRecording() const noexcept {
+      return mRecording.load(std::memory_order_relaxed);
+   }
+
+   void Record(std::string_view path, Offset offset, Offset size);
+   auto GetAccesses() -> std::vector<Access>;
+
+   static std::string Serialize(const std::vector<Access>&);
+   static bool Parse(std::string_view, std::vector<Access>&);
+};
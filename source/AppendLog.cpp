@@ -0,0 +1,286 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#include "AppendLog.hpp"
+#include "Native.hpp"
+#include <algorithm>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+
+/// Describe the last PhysFS error of this thread                             
+///   @param what - the operation that failed                                 
+///   @return the description                                                 
+static std::string Describe(std::string_view what) {
+   const auto error = PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode());
+   return std::string {what} + ": "
+      + (error ? error : "<undefined PhysFS error code>");
+}
+
+/// Append log constructor                                                    
+///   @param path - virtual path of the log file                              
+///   @param pool - where the log file handle is leased from                  
+///   @param stats - module-wide statistics, where batches are counted        
+///   @param counters - counters of the log file, if any                      
+///   @param onWritten - invoked from the drain thread after each batch       
+AppendLog::AppendLog(
+   std::string_view path, HandlePool& pool, IOStats& stats,
+   IOStats::Counters* counters, Callback&& onWritten
+) : mPath {path}
+  , mPool {pool}
+  , mStats {stats}
+  , mCounters {counters}
+  , mOnWritten {std::move(onWritten)} {}
+
+/// Write everything appended so far, and stop the drain thread               
+AppendLog::~AppendLog() {
+   Stop();
+}
+
+/// Open the log file for appending, and start the drain thread               
+///   @return true if log is running, PhysFS error is set otherwise           
+bool AppendLog::Start() {
+   std::scoped_lock lock {mMutex};
+   if (mDrain.joinable())
+      return true;
+
+   mHandle = mPool.Open(mPath, HandlePool::Append);
+   if (not mHandle)
+      return false;
+
+   PHYSFS_sint64 length;
+   {
+      const HandlePool::Pin handle {mHandle};
+      length = PHYSFS_fileLength(handle);
+   }
+
+   const auto start = length > 0 ? static_cast<Offset>(length) : 0;
+   mReserved.store(start);
+   mWritten.store(start);
+   mSegmentStart.store(0);
+   mStopping = false;
+   mFailed = false;
+   mDrain = std::thread {&AppendLog::Drain, this};
+   mRunning.store(true, std::memory_order_release);
+   return true;
+}
+
+/// Write everything appended so far, and stop the drain thread               
+/// Nothing should be appended while stopping                                 
+void AppendLog::Stop() {
+   std::scoped_lock lock {mMutex};
+   if (not mDrain.joinable())
+      return;
+
+   mStopping = true;
+   mSignal.fetch_add(1);
+   mSignal.notify_one();
+   mDrain.join();
+   mRunning.store(false, std::memory_order_release);
+}
+
+/// Append a record to the log, without waiting for it to be written          
+/// Thread-safe and lock-free, but the record is copied                       
+///   @attention the log must be started, otherwise nothing would ever write  
+///              the record, and Flush would wait for it forever              
+///   @param data - the record                                                
+///   @param size - size of the record in bytes                               
+///   @return the logical offset of the record, or nothing if the log has     
+///           failed, and no longer accepts records                           
+auto AppendLog::Append(const Byte* data, Offset size)
+-> std::optional<Offset> {
+   LANGULUS_ASSERT(mRunning.load(std::memory_order_acquire), FileSystem,
+      "Can't append to `", mPath.c_str(), "` before its log is started");
+   if (mFailed.load(std::memory_order_acquire))
+      return {};
+
+   // Nothing can fail after the offset is reserved, otherwise the      
+   // drain thread would wait for the missing record forever            
+   const auto record = new Record {nullptr, 0, {data, data + size}};
+   const auto offset = mReserved.fetch_add(size, std::memory_order_relaxed);
+   record->mOffset = offset;
+
+   record->mNext = mPushed.load(std::memory_order_relaxed);
+   while (not mPushed.compare_exchange_weak(record->mNext, record));
+
+   Wake();
+   return offset;
+}
+
+/// Wait until everything appended so far is written                          
+/// Records are dropped after a failure, not retried, and nothing can be      
+/// appended before the log is started, so this always returns                
+///   @return false if any write failed                                       
+bool AppendLog::Flush() {
+   const auto target = mReserved.load();
+   auto written = mWritten.load();
+   while (written < target) {
+      mWritten.wait(written);
+      written = mWritten.load();
+   }
+   return not mFailed;
+}
+
+/// Enable or disable size-based rotation                                     
+///   @param size - the size a log file can reach, zero disables rotation     
+///   @param keep - number of rotated files to keep, zero keeps none          
+void AppendLog::SetRotation(Offset size, Count keep) noexcept {
+   mRotateKeep.store(keep, std::memory_order_relaxed);
+   mRotateSize.store(size, std::memory_order_relaxed);
+}
+
+/// Get the description of the first failure                                  
+///   @return the error, only valid if HasFailed() is true                    
+auto AppendLog::GetError() const noexcept -> std::string_view {
+   return mFailed ? std::string_view {mError} : std::string_view {};
+}
+
+/// Wake the drain thread up, if it is sleeping                               
+void AppendLog::Wake() noexcept {
+   if (mSleeping.exchange(false)) {
+      mSignal.fetch_add(1);
+      mSignal.notify_one();
+   }
+}
+
+/// The drain thread                                                          
+/// Records are taken from the stack, put in a heap by offset, and every      
+/// contiguous run of them, starting where the last write ended, is written   
+/// in batches of up to BatchSize bytes                                       
+void AppendLog::Drain() {
+   const auto later = [](const Record* lhs, const Record* rhs) {
+      return lhs->mOffset > rhs->mOffset;
+   };
+
+   std::vector<Record*> waiting;
+   std::vector<Byte> batch;
+   batch.reserve(BatchSize);
+   auto next = mWritten.load();
+   auto segment = next;
+
+   const auto fail = [&](std::string error) {
+      if (not mFailed) {
+         mError = std::move(error);
+         mFailed.store(true);
+      }
+   };
+
+   const auto write = [&] {
+      if (batch.empty())
+         return;
+
+      // Nothing is written after a failure, because the file no longer 
+      // ends where the next record is supposed to begin                
+      if (mHandle and not mFailed) {
+         IOStats::Timer timer {mStats, mCounters, IOStats::Write};
+         PHYSFS_sint64 result = -1;
+         try {
+            // Pinning reopens the handle, if it was closed by the pool 
+            const HandlePool::Pin handle {mHandle};
+            result = PHYSFS_writeBytes(
+               handle, batch.data(), PHYSFS_uint64(batch.size()));
+         }
+         catch (...) {}
+
+         if (result != PHYSFS_sint64(batch.size()))
+            fail(Describe("Error in PHYSFS_writeBytes"));
+         else
+            timer.SetBytes(batch.size());
+      }
+
+      // Whatever was cached about the file is stale before anyone is   
+      // told the batch is written                                      
+      if (mOnWritten)
+         mOnWritten();
+
+      // Failed records are dropped, so that Flush never hangs, and     
+      // offsets only move on, because reserved ones can't be taken back
+      batch.clear();
+      mWritten.store(next);
+      mWritten.notify_all();
+   };
+
+   for (;;) {
+      // Take everything pushed so far                                  
+      auto record = mPushed.exchange(nullptr, std::memory_order_acquire);
+      while (record) {
+         waiting.push_back(record);
+         std::ranges::push_heap(waiting, later);
+         record = record->mNext;
+      }
+
+      // Write the contiguous run, that continues where writing ended   
+      while (not waiting.empty() and waiting.front()->mOffset == next) {
+         std::ranges::pop_heap(waiting, later);
+         const auto ready = waiting.back();
+         waiting.pop_back();
+
+         batch.insert(batch.end(), ready->mData.begin(), ready->mData.end());
+         next += ready->mData.size();
+         segment += ready->mData.size();
+         delete ready;
+
+         const auto limit = mRotateSize.load(std::memory_order_relaxed);
+         if (limit and segment >= limit) {
+            write();
+            if (mHandle and not mFailed and not Rotate())
+               fail(Describe("Can't rotate"));
+            segment = 0;
+            mSegmentStart.store(next);
+         }
+         else if (batch.size() >= BatchSize)
+            write();
+      }
+
+      write();
+      if (mStopping and waiting.empty() and not mPushed.load())
+         break;
+
+      // Sleep until something is pushed. The signal is read before the 
+      // stack is checked, so that a push in between isn't missed       
+      const auto signal = mSignal.load();
+      mSleeping.store(true);
+      if (mPushed.load() or mStopping) {
+         mSleeping.store(false);
+         continue;
+      }
+
+      mSignal.wait(signal);
+      mSleeping.store(false);
+   }
+
+   if (not mHandle.Close())
+      fail(Describe("Error in PHYSFS_close"));
+}
+
+/// Rotate the log file                                                       
+/// The handle is closed, so that the file can be renamed on any platform,    
+/// and a new empty file is opened in its place                               
+///   @return true on success, the handle is released otherwise               
+bool AppendLog::Rotate() {
+   mHandle.Close();
+
+   const auto native = Native::ResolveWritePath(mPath.c_str());
+   const auto keep = mRotateKeep.load(std::memory_order_relaxed);
+   if (not native.empty() and keep) {
+      const auto rotated = [&](Count index) {
+         return native + '.' + std::to_string(index);
+      };
+
+      // Missing files are skipped, so errors are ignored here          
+      std::error_code ec;
+      fs::remove(rotated(keep), ec);
+      for (Count index = keep; index > 1; --index)
+         fs::rename(rotated(index - 1), rotated(index), ec);
+      fs::rename(native, rotated(1), ec);
+   }
+
+   // Opening for writing truncates whatever wasn't rotated away        
+   mHandle = mPool.Open(mPath, HandlePool::Write);
+   return static_cast<bool>(mHandle);
+}
@@ -0,0 +1,113 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#pragma once
+#include "IOStats.hpp"
+#include "HandlePool.hpp"
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+
+///                                                                           
+///   Multi-producer append log                                               
+///                                                                           
+///   Any number of threads can append records to the same file at once,      
+/// without ever waiting for each other. Each record reserves its place in    
+/// the log with a single atomic addition, so its offset is known right       
+/// away, and is then pushed to a lock-free stack. A single drain thread      
+/// takes everything pushed so far, puts the records back in offset order,    
+/// and writes every contiguous run of them in big sequential batches.        
+///   Offsets are logical - they start at the size of the file when the log   
+/// is opened, and keep growing when the log is rotated, so they are offsets  
+/// inside the file only until the first rotation. After that, subtract the   
+/// logical offset the current file starts at, see GetSegmentStart. When      
+/// rotation is enabled, a file that grows past the limit is renamed to       
+/// "<name>.1", any older "<name>.N" is shifted to "<name>.N+1", and the      
+/// oldest is deleted.                                                        
+///   A failed write stops the log for good. Records that were reserved       
+/// after the failed ones are dropped, and new records are rejected, because  
+/// they would otherwise end up in the file at other offsets than reported.   
+///   The log file handle is leased from the handle pool, so it might be      
+/// closed between batches, when too many handles are open                    
+///                                                                           
+struct AppendLog {
+   /// Size of the batches written at once                                    
+   static constexpr Offset BatchSize = 1024 * 1024;
+
+   /// Invoked from the drain thread after each written batch                 
+   using Callback = std::function<void()>;
+
+private:
+   struct Record {
+      Record* mNext;
+      Offset mOffset;
+      std::vector<Byte> mData;
+   };
+
+   // Null-terminated virtual path of the log file                      
+   std::string mPath;
+   // The log file handle, used only by the drain thread after start    
+   HandlePool& mPool;
+   HandlePool::Lease mHandle;
+   // Where writes are counted                                          
+   IOStats& mStats;
+   IOStats::Counters* mCounters;
+   Callback mOnWritten;
+
+   // Records pushed by producers, the most recent on top               
+   std::atomic<Record*> mPushed {};
+   // Offset, at which the next appended record will go                 
+   std::atomic<Offset> mReserved = 0;
+   // Everything before this offset has been written                    
+   std::atomic<Offset> mWritten = 0;
+   // Logical offset, at which the current log file begins              
+   std::atomic<Offset> mSegmentStart = 0;
+   // Wakes the drain thread up, when it's sleeping                     
+   std::atomic<uint32_t> mSignal = 0;
+   std::atomic_bool mSleeping = false;
+   std::atomic_bool mRunning = false;
+   std::atomic_bool mStopping = false;
+   std::atomic_bool mFailed = false;
+   // First failure, written by the drain thread before mFailed is set  
+   std::string mError;
+
+   // Rotation limits, zero size disables rotation                      
+   std::atomic<Offset> mRotateSize = 0;
+   std::atomic<Count> mRotateKeep = 4;
+
+   // Serializes Start and Stop                                         
+   std::mutex mMutex;
+   std::thread mDrain;
+
+   void Drain();
+   void Wake() noexcept;
+   bool Rotate();
+
+public:
+   AppendLog(std::string_view path, HandlePool&, IOStats&,
+      IOStats::Counters*, Callback&& onWritten = {});
+   AppendLog(const AppendLog&) = delete;
+  ~AppendLog();
+
+   bool Start();
+   void Stop();
+
+   auto Append(const Byte*, Offset) -> std::optional<Offset>;
+   bool Flush();
+   void SetRotation(Offset size, Count keep = 4) noexcept;
+
+   bool IsRunning() const noexcept { return mRunning; }
+   bool HasFailed() const noexcept { return mFailed; }
+   auto GetSegmentStart() const noexcept -> Offset { return mSegmentStart; }
+   auto GetError() const noexcept -> std::string_view;
+};
@@ -0,0 +1,270 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#include "AsyncIO.hpp"
+#include "FileSystem.hpp"
+#include <algorithm>
+
+
+/// Stop all workers on destruction                                           
+AsyncIO::~AsyncIO() {
+   Shutdown();
+}
+
+/// Spawn the worker threads                                                  
+///   @param workers - number of workers, zero to pick automatically          
+void AsyncIO::Start(Count workers) {
+   if (not mWorkers.empty())
+      return;
+
+   if (not workers) {
+      // I/O bound work doesn't need a thread per core, but a couple of 
+      // requests in flight are necessary to keep the device busy       
+      const Count cores = std::thread::hardware_concurrency();
+      workers = std::clamp<Count>(cores / 2, 2, 8);
+   }
+
+   mStopping = false;
+   mWorkers.reserve(workers);
+   for (Count i = 0; i < workers; ++i)
+      mWorkers.emplace_back(&AsyncIO::Work, this);
+}
+
+/// Stop and join all workers                                                 
+/// Requests that were never started are discarded, along with the            
+/// completed ones whose callbacks were never dispatched                      
+void AsyncIO::Shutdown() {
+   {
+      std::scoped_lock lock {mMutex};
+      mStopping = true;
+   }
+
+   mWake.notify_all();
+   for (auto& worker : mWorkers)
+      worker.join();
+   mWorkers.clear();
+
+   // Release requests on the calling thread, because they hold         
+   // references to files and data, that aren't thread-safe             
+   std::scoped_lock lock {mMutex};
+   mTasks.clear();
+   mPending.clear();
+   mCompleted.clear();
+   mInFlight = 0;
+}
+
+/// Submit a request for asynchronous execution                               
+///   @param request - the request to submit                                  
+void AsyncIO::Submit(Request&& request) {
+   LANGULUS_ASSERT(request.mFile, FileSystem,
+      "Asynchronous request without a file");
+   LANGULUS_ASSERT(not mWorkers.empty(), FileSystem,
+      "Asynchronous I/O engine isn't running");
+
+   auto owned = std::make_unique<Request>(std::move(request));
+   const auto path = owned->mFile->GetFilePath().Terminate();
+   owned->mPath = path.GetRaw();
+   owned->mResult = 0;
+   owned->mError.clear();
+
+   {
+      std::scoped_lock lock {mMutex};
+      mPending.emplace_back(std::move(owned));
+      ++mInFlight;
+   }
+   mWake.notify_one();
+}
+
+/// Run a task on one of the workers, as soon as one is free                  
+/// Tasks have no callback, and might be discarded on shutdown, so whoever    
+/// submits them can't rely on them ever running                              
+///   @param task - the task to run                                           
+///   @return false if the engine isn't running, and task was discarded       
+bool AsyncIO::Run(Task&& task) {
+   {
+      std::scoped_lock lock {mMutex};
+      if (mWorkers.empty() or mStopping)
+         return false;
+      mTasks.emplace_back(std::move(task));
+   }
+   mWake.notify_one();
+   return true;
+}
+
+/// Invoke the callbacks of all completed requests                            
+/// Called from FileSystem::Update, on the thread that owns the module. If a  
+/// callback throws, the requests after it are queued back, to be dispatched  
+/// on the next call, and the exception is propagated                         
+///   @return the number of dispatched requests                               
+Count AsyncIO::Dispatch() {
+   std::deque<std::unique_ptr<Request>> completed;
+   {
+      std::scoped_lock lock {mMutex};
+      if (mCompleted.empty())
+         return 0;
+      completed.swap(mCompleted);
+      mInFlight -= completed.size();
+   }
+
+   Count dispatched = 0;
+   std::unique_ptr<Request> request;
+   try {
+      while (not completed.empty()) {
+         request = std::move(completed.front());
+         completed.pop_front();
+         ++dispatched;
+         if (request->mOnComplete)
+            request->mOnComplete(*request);
+         Release(*request);
+      }
+   }
+   catch (...) {
+      Release(*request);
+
+      // Keep them in front of whatever completed meanwhile             
+      std::scoped_lock lock {mMutex};
+      mInFlight += completed.size();
+      mCompleted.insert(mCompleted.begin(),
+         std::make_move_iterator(completed.begin()),
+         std::make_move_iterator(completed.end()));
+      throw;
+   }
+   return dispatched;
+}
+
+/// Dereference the file of a dispatched request                              
+/// Readers of the same file might be made on other threads meanwhile, so     
+/// this happens under the lock from FileSystem::LockReferences               
+///   @param request - the request to release                                 
+void AsyncIO::Release(Request& request) {
+   if (not request.mFile)
+      return;
+
+   const auto file = request.mFile.As<::File>();
+   const auto lock = file->GetProducer()->LockReferences();
+   request.mFile.Reset();
+}
+
+/// Get the number of requests, whose callbacks haven't been invoked yet      
+///   @return the number of requests in flight                                
+Count AsyncIO::GetInFlight() const {
+   std::scoped_lock lock {mMutex};
+   return mInFlight;
+}
+
+/// Worker thread routine                                                     
+void AsyncIO::Work() {
+   while (true) {
+      std::unique_ptr<Request> request;
+      Task task;
+      {
+         std::unique_lock lock {mMutex};
+         mWake.wait(lock, [this] {
+            return mStopping or not mTasks.empty() or not mPending.empty();
+         });
+
+         if (mStopping)
+            return;
+
+         if (not mTasks.empty()) {
+            task = std::move(mTasks.front());
+            mTasks.pop_front();
+         }
+         else {
+            request = std::move(mPending.front());
+            mPending.pop_front();
+         }
+      }
+
+      if (task) {
+         task();
+         continue;
+      }
+
+      request->Execute();
+
+      std::scoped_lock lock {mMutex};
+      mCompleted.emplace_back(std::move(request));
+   }
+}
+
+/// Execute a request on the current thread                                   
+/// Only the file's thread-safe interface is used here, through a raw         
+/// pointer, so that it is safe to call from any worker                       
+void AsyncIO::Request::Execute() {
+   const auto file = mFile.As<::File>();
+   const auto producer = file->GetProducer();
+   const auto size = mData.GetBytesize();
+   if (mKind == Read) {
+      // Positional reads on the shared descriptor, or through the      
+      // block cache for archived files - see File::ReadRange           
+      if (not size)
+         return;
+
+      try {
+         mResult = file->ReadRange(mOffset, size, mData);
+      }
+      catch (...) {
+         mError = "Can't read `" + mPath + "`: ";
+         mError += GetLastError();
+      }
+      return;
+   }
+
+   const auto record = [this](IOStats::Operation op, uint64_t start) {
+      if (mStats)
+         mStats->Record(op, IOStats::Now() - start, mResult, mCounters);
+   };
+
+   auto start = IOStats::Now();
+   if (mKind == Write) {
+      // Written to a temporary, that is renamed over the target, so    
+      // that readers and views never see partially written contents    
+      const auto target = Native::ResolveWritePath(mPath.c_str());
+      if (target.empty())
+         mError = "Can't rewrite `" + mPath + "` without a write directory";
+      else if (not producer->GetCommitQueue().Write(mPath, target,
+         mData.GetRaw(), size))
+         mError = "Can't rewrite `" + mPath + '`';
+      else
+         mResult = size;
+
+      record(IOStats::Write, start);
+      return;
+   }
+
+   // Appends lease their handle, so they count towards the limit       
+   auto handle = producer->GetHandlePool().Open(mPath, HandlePool::Append);
+   record(IOStats::Open, start);
+   if (not handle) {
+      mError = "Can't open `" + mPath + "`: ";
+      mError += GetLastError();
+      return;
+   }
+
+   start = IOStats::Now();
+   try {
+      const HandlePool::Pin pin {handle};
+      const auto result = PHYSFS_writeBytes(
+         pin, mData.GetRaw(), PHYSFS_uint64(size));
+      if (result > 0)
+         mResult = static_cast<Offset>(result);
+      if (PHYSFS_uint64(result) != size) {
+         mError = "Error in PHYSFS_writeBytes: ";
+         mError += GetLastError();
+      }
+   }
+   catch (...) {
+      mError = "Can't reopen `" + mPath + "` for appending";
+   }
+
+   record(IOStats::Write, start);
+   if (not handle.Close() and mError.empty()) {
+      mError = "Error in PHYSFS_close: ";
+      mError += GetLastError();
+   }
+}
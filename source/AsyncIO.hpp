@@ -0,0 +1,111 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#pragma once
+#include "Common.hpp"
+#include "IOStats.hpp"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+///                                                                           
+///   Asynchronous I/O engine                                                 
+///                                                                           
+///   Requests are executed on a small pool of worker threads. Reads go       
+/// through the file's shared descriptor or the block cache, rewrites are     
+/// atomic, and appends lease their handle from the handle pool, so requests  
+/// count towards the same handle limit as everything else. Completed         
+/// requests are queued, and their callbacks are invoked from                 
+/// FileSystem::Update, so that consumers never have to synchronize with the  
+/// workers themselves.                                                       
+///   The workers also run plain tasks, that synchronize on their own, e.g.   
+/// to help with a parallel read. Tasks go before pending requests            
+///                                                                           
+struct AsyncIO {
+   ///                                                                        
+   ///   A single read/write request                                          
+   ///                                                                        
+   struct Request {
+      enum Kind {
+         Read,          // Read bytes at an offset into mData
+         Write,         // Rewrite the file atomically with mData
+         Append         // Append the bytes in mData to the file
+      };
+
+      using Callback = std::function<void(Request&)>;
+
+      Kind mKind = Read;
+      // The file this request is about - kept alive until completion,  
+      // and released under FileSystem::LockReferences                  
+      Ref<A::File> mFile;
+      // Where to read from, ignored when writing/appending             
+      Offset mOffset = 0;
+      // Preallocated destination when reading, source when writing     
+      Many mData;
+      // Invoked from FileSystem::Update, after request is done         
+      Callback mOnComplete;
+      // Where writes are counted, if anywhere - the counters belong to 
+      // mFile, so they live until completion. Reads count themselves   
+      IOStats* mStats = nullptr;
+      IOStats::Counters* mCounters = nullptr;
+
+      // Number of bytes actually transferred                           
+      Offset mResult = 0;
+      // Failure description, empty on success                          
+      std::string mError;
+
+   private:
+      friend struct AsyncIO;
+      // Null-terminated virtual path, so workers don't touch mFile's   
+      // path, nor its reference count                                  
+      std::string mPath;
+
+      void Execute();
+   };
+
+   /// A task, that must not throw, nor touch anything thread-unsafe          
+   using Task = std::function<void()>;
+
+private:
+   // Worker threads                                                    
+   std::vector<std::thread> mWorkers;
+   // Tasks waiting to be picked by a worker                            
+   std::deque<Task> mTasks;
+   // Requests waiting to be picked by a worker                         
+   std::deque<std::unique_ptr<Request>> mPending;
+   // Requests done, waiting for their callbacks to be invoked          
+   std::deque<std::unique_ptr<Request>> mCompleted;
+   // Protects mTasks, mPending, mCompleted and the counters            
+   mutable std::mutex mMutex;
+   // Wakes workers up when work arrives, or on shutdown                
+   std::condition_variable mWake;
+   // Number of submitted requests, whose callbacks haven't been invoked
+   Count mInFlight = 0;
+   bool mStopping = false;
+
+   void Work();
+   static void Release(Request&);
+
+public:
+   AsyncIO() = default;
+   AsyncIO(const AsyncIO&) = delete;
+  ~AsyncIO();
+
+   void Start(Count workers = 0);
+   void Shutdown();
+
+   void Submit(Request&&);
+   bool Run(Task&&);
+   Count Dispatch();
+   Count GetInFlight() const;
+};
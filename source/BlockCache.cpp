@@ -0,0 +1,135 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#include "BlockCache.hpp"
+
+
+/// Hash a block key                                                          
+///   @param key - the key to hash                                            
+///   @return the hash                                                        
+size_t BlockCache::KeyHash::operator () (const Key& key) const noexcept {
+   const std::hash<std::string> hasher;
+   auto result = hasher(key.mArchive);
+   result ^= hasher(key.mEntry) + 0x9e3779b97f4a7c15ull
+      + (result << 6) + (result >> 2);
+   result ^= std::hash<Offset> {}(key.mIndex) + 0x9e3779b97f4a7c15ull
+      + (result << 6) + (result >> 2);
+   return result;
+}
+
+/// Find a block, and mark it as recently used                                
+///   @param archive - native path of the archive                             
+///   @param entry - virtual path of the file inside the archive              
+///   @param index - index of the block inside the file                       
+///   @return the block, or nullptr if not cached                             
+auto BlockCache::Find(
+   std::string_view archive, std::string_view entry, Offset index
+) -> Block {
+   const Key key {std::string {archive}, std::string {entry}, index};
+   std::scoped_lock lock {mMutex};
+   const auto found = mNodes.find(key);
+   if (found == mNodes.end()) {
+      ++mMisses;
+      return {};
+   }
+
+   ++mHits;
+   mOrder.splice(mOrder.begin(), mOrder, found->second);
+   return found->second->mBlock;
+}
+
+/// Cache a block, that was just decompressed                                 
+/// If another thread inserted the same block in the meantime, that one is    
+/// kept, and returned instead                                                
+///   @param archive - native path of the archive                             
+///   @param entry - virtual path of the file inside the archive              
+///   @param index - index of the block inside the file                       
+///   @param bytes - the decompressed bytes                                   
+///   @return the cached block                                                
+auto BlockCache::Insert(
+   std::string_view archive, std::string_view entry, Offset index,
+   std::vector<Byte>&& bytes
+) -> Block {
+   Key key {std::string {archive}, std::string {entry}, index};
+   auto block = std::make_shared<const std::vector<Byte>>(std::move(bytes));
+
+   std::scoped_lock lock {mMutex};
+   const auto found = mNodes.find(key);
+   if (found != mNodes.end()) {
+      mOrder.splice(mOrder.begin(), mOrder, found->second);
+      return found->second->mBlock;
+   }
+
+   // Blocks that don't fit at all aren't cached                        
+   if (block->size() > mBudget)
+      return block;
+
+   mUsage += block->size();
+   mOrder.push_front({key, block});
+   mNodes.emplace(std::move(key), mOrder.begin());
+   Evict();
+   return block;
+}
+
+/// Drop the least recently used blocks, until usage fits the budget          
+///   @attention assumes mMutex is locked                                     
+void BlockCache::Evict() {
+   while (mUsage > mBudget and not mOrder.empty()) {
+      auto& last = mOrder.back();
+      mUsage -= last.mBlock->size();
+      mNodes.erase(last.mKey);
+      mOrder.pop_back();
+   }
+}
+
+/// Forget about all blocks of an archive, or of a single entry inside it     
+///   @param archive - native path of the archive                             
+///   @param entry - virtual path of the entry, or empty for all entries      
+void BlockCache::Invalidate(std::string_view archive, std::string_view entry) {
+   std::scoped_lock lock {mMutex};
+   for (auto node = mOrder.begin(); node != mOrder.end();) {
+      if (node->mKey.mArchive != archive
+      or (not entry.empty() and node->mKey.mEntry != entry)) {
+         ++node;
+         continue;
+      }
+
+      mUsage -= node->mBlock->size();
+      mNodes.erase(node->mKey);
+      node = mOrder.erase(node);
+   }
+}
+
+/// Forget about everything - used when mounts change                         
+void BlockCache::Clear() {
+   std::scoped_lock lock {mMutex};
+   mNodes.clear();
+   mOrder.clear();
+   mUsage = 0;
+}
+
+/// Change the memory budget, evicting blocks if necessary                    
+///   @param budget - the new budget in bytes, zero disables caching          
+void BlockCache::SetBudget(Offset budget) {
+   std::scoped_lock lock {mMutex};
+   mBudget = budget;
+   Evict();
+}
+
+/// Get the memory budget                                                     
+///   @return the budget in bytes                                             
+Offset BlockCache::GetBudget() const {
+   std::scoped_lock lock {mMutex};
+   return mBudget;
+}
+
+/// Get the number of bytes currently cached                                  
+///   @return the usage in bytes                                              
+Offset BlockCache::GetUsage() const {
+   std::scoped_lock lock {mMutex};
+   return mUsage;
+}
@@ -0,0 +1,88 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#pragma once
+#include "Common.hpp"
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+
+///                                                                           
+///   Decompressed block cache                                                
+///                                                                           
+///   Files inside compressed archives can't be read at an offset without     
+/// decompressing everything before it, and every reader or re-open pays      
+/// that price again. Decompressed contents are kept here instead, in blocks  
+/// of fixed size, keyed by archive, entry and block index, and shared by all 
+/// readers. The least recently used blocks are dropped, when the memory      
+/// budget is exceeded                                                        
+///                                                                           
+struct BlockCache {
+   /// Bytes per block, except the last block of an entry                     
+   static constexpr Offset BlockSize = 64 * 1024;
+   /// Default memory budget                                                  
+   static constexpr Offset DefaultBudget = 32 * 1024 * 1024;
+
+   /// Blocks are immutable and reference-counted, so that they can be        
+   /// evicted while still being copied from                                  
+   using Block = std::shared_ptr<const std::vector<Byte>>;
+
+private:
+   struct Key {
+      // Native path of the archive                                     
+      std::string mArchive;
+      // Virtual path of the entry                                      
+      std::string mEntry;
+      Offset mIndex;
+
+      bool operator == (const Key&) const = default;
+   };
+
+   struct KeyHash {
+      size_t operator () (const Key&) const noexcept;
+   };
+
+   struct Node {
+      Key mKey;
+      Block mBlock;
+   };
+
+   // Most recently used blocks are in front                            
+   std::list<Node> mOrder;
+   std::unordered_map<Key, std::list<Node>::iterator, KeyHash> mNodes;
+   // Lookups reorder the list, so they're exclusive too                
+   mutable std::mutex mMutex;
+   // Memory budget, and bytes currently used by blocks                 
+   Offset mBudget = DefaultBudget;
+   Offset mUsage = 0;
+   // Statistics                                                        
+   std::atomic<Count> mHits = 0;
+   std::atomic<Count> mMisses = 0;
+
+   void Evict();
+
+public:
+   Block Find(std::string_view archive, std::string_view entry, Offset);
+   Block Insert(
+      std::string_view archive, std::string_view entry, Offset,
+      std::vector<Byte>&&
+   );
+   void Invalidate(std::string_view archive, std::string_view entry = {});
+   void Clear();
+
+   void SetBudget(Offset);
+   Offset GetBudget() const;
+   Offset GetUsage() const;
+   Count GetHits() const noexcept { return mHits; }
+   Count GetMisses() const noexcept { return mMisses; }
+};
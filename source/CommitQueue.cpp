@@ -0,0 +1,218 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#include "CommitQueue.hpp"
+#include "Native.hpp"
+#include <algorithm>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+
+/// Write contents to a new temporary file                                    
+///   @param file - [out] the temporary file, left open on success            
+///   @param temporary - native path of the temporary file                    
+///   @param data - the contents                                              
+///   @param size - size of the contents in bytes                             
+///   @return true on success, the temporary file is removed on failure       
+static bool WriteTemporary(
+   Native::Descriptor& file, const std::string& temporary,
+   const Byte* data, Offset size
+) {
+   if (not file.Create(temporary))
+      return false;
+
+   Native::Slice slice {const_cast<Byte*>(data), size};
+   if (size and file.WriteAtV(&slice, 1, 0) != static_cast<int64_t>(size)) {
+      file.Close();
+      std::error_code ec;
+      fs::remove(temporary, ec);
+      return false;
+   }
+   return true;
+}
+
+/// Get the directory a native path resides in                                
+///   @param path - the native path                                           
+///   @return the directory, "." for relative paths without one               
+static std::string DirectoryOf(const std::string& path) {
+   const auto parent = fs::path {path}.parent_path();
+   return parent.empty() ? std::string {"."} : parent.string();
+}
+
+/// Remove all temporaries that were never committed                          
+CommitQueue::~CommitQueue() {
+   for (auto& pending : mPending) {
+      pending.mFile->Close();
+      std::error_code ec;
+      fs::remove(pending.mTemporary, ec);
+   }
+}
+
+/// Rewrite a file atomically                                                 
+/// In group commit mode the contents are only written to a temporary file,   
+/// and the target is replaced on the next Commit. Otherwise the target is    
+/// replaced right away, and the replacement is durable when this returns     
+///   @param path - virtual path of the file, reported back by Commit         
+///   @param target - native path of the file                                 
+///   @param data - the new contents                                          
+///   @param size - size of the new contents in bytes                         
+///   @return true on success                                                 
+bool CommitQueue::Write(
+   std::string_view path, const std::string& target,
+   const Byte* data, Offset size
+) {
+   const auto temporary = target + ".tmp-" + std::to_string(
+      mSequence.fetch_add(1, std::memory_order_relaxed));
+
+   if (mGroupCommit.load(std::memory_order_relaxed)) {
+      // The temporary stays open, and is synced when committed         
+      auto file = std::make_unique<Native::Descriptor>();
+      if (not WriteTemporary(*file, temporary, data, size))
+         return false;
+
+      // A newer write of the same file replaces the pending one        
+      std::scoped_lock lock {mMutex};
+      Supersede(target);
+      mPending.push_back({
+         std::string {path}, temporary, target, std::move(file)});
+      return true;
+   }
+
+   Native::Descriptor file;
+   if (not WriteTemporary(file, temporary, data, size))
+      return false;
+
+   const bool durable = file.Sync();
+   file.Close();
+   std::error_code ec;
+   if (not durable) {
+      fs::remove(temporary, ec);
+      return false;
+   }
+
+   {
+      // Renaming under the lock orders this write with any commit, so  
+      // that an older grouped write never replaces it afterwards       
+      std::scoped_lock lock {mMutex};
+      Supersede(target);
+      if (mCommitting)
+         mOvertaken.push_back(target);
+
+      fs::rename(temporary, target, ec);
+      if (ec) {
+         fs::remove(temporary, ec);
+         return false;
+      }
+   }
+
+   const std::string directory[] {DirectoryOf(target)};
+   return Native::SyncAll(directory);
+}
+
+/// Drop the pending write of a file, if any                                  
+///   @attention assumes mMutex is locked                                     
+///   @param target - native path of the file                                 
+///   @return true if there was a pending write                               
+bool CommitQueue::Supersede(const std::string& target) {
+   const auto found = std::ranges::find(mPending, target, &Pending::mTarget);
+   if (found == mPending.end())
+      return false;
+
+   found->mFile->Close();
+   std::error_code ec;
+   fs::remove(found->mTemporary, ec);
+   mPending.erase(found);
+   return true;
+}
+
+/// Commit all pending writes                                                 
+/// All temporaries are synced through their own descriptors before any       
+/// target is replaced, so that a crash midway never replaces a target with   
+/// a file that isn't completely on disk yet. Each directory that had a       
+/// rename is then synced once. Pending writes whose target got rewritten     
+/// directly in the meantime are dropped, because they're older               
+///   @param onCommit - invoked for each write, in the order they were made,  
+///                     along with whether its target was replaced            
+///   @return false if any write failed, or isn't durable                     
+bool CommitQueue::Commit(const Callback& onCommit) {
+   std::vector<Pending> pending;
+   {
+      std::scoped_lock lock {mMutex};
+      if (mPending.empty())
+         return true;
+      pending.swap(mPending);
+      ++mCommitting;
+   }
+
+   // Syncing takes the longest, so it's done without locking           
+   std::vector<bool> durable(pending.size(), false);
+   for (size_t i = 0; i < pending.size(); ++i) {
+      durable[i] = pending[i].mFile->Sync();
+      pending[i].mFile->Close();
+   }
+
+   // Replace the targets, and remember where the renames happened      
+   std::vector<bool> committed(pending.size(), false);
+   std::vector<bool> overtaken(pending.size(), false);
+   std::vector<std::string> directories;
+   {
+      std::scoped_lock lock {mMutex};
+      for (size_t i = 0; i < pending.size(); ++i) {
+         std::error_code ec;
+         overtaken[i] = std::ranges::find(mOvertaken, pending[i].mTarget)
+            != mOvertaken.end();
+         if (durable[i] and not overtaken[i])
+            fs::rename(pending[i].mTemporary, pending[i].mTarget, ec);
+         if (not durable[i] or overtaken[i] or ec) {
+            fs::remove(pending[i].mTemporary, ec);
+            continue;
+         }
+
+         committed[i] = true;
+         auto directory = DirectoryOf(pending[i].mTarget);
+         if (std::ranges::find(directories, directory) == directories.end())
+            directories.push_back(std::move(directory));
+      }
+
+      if (0 == --mCommitting)
+         mOvertaken.clear();
+   }
+
+   const bool renamed = directories.empty()
+      or Native::SyncAll(directories);
+   bool success = renamed;
+   for (size_t i = 0; i < pending.size(); ++i) {
+      // Overtaken writes are reported like superseded ones - not at all
+      if (overtaken[i])
+         continue;
+      if (onCommit)
+         onCommit(pending[i].mPath, committed[i]);
+      success = success and committed[i];
+   }
+   return success;
+}
+
+/// Enable or disable group commit                                            
+/// Writes that are already pending remain so, until the next Commit          
+///   @param enabled - true to defer writes until Commit                      
+void CommitQueue::SetGroupCommit(bool enabled) noexcept {
+   mGroupCommit.store(enabled, std::memory_order_relaxed);
+}
+
+/// Check if writes are deferred until Commit                                 
+///   @return true if group commit is enabled                                 
+bool CommitQueue::IsGroupCommit() const noexcept {
+   return mGroupCommit.load(std::memory_order_relaxed);
+}
+
+/// Check if there are writes waiting for Commit                              
+///   @return true if nothing is pending                                      
+bool CommitQueue::IsEmpty() {
+   std::scoped_lock lock {mMutex};
+   return mPending.empty();
+}
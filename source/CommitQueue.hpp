@@ -0,0 +1,77 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#pragma once
+#include "Common.hpp"
+#include "Native.hpp"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+///                                                                           
+///   Atomic file rewrites                                                    
+///                                                                           
+///   Files are never rewritten in place. The new contents go to a temporary  
+/// file next to the target, which is synced to disk, and then renamed over   
+/// the target, so that a crash leaves either the old or the new contents,    
+/// never a mix of both. Temporaries left by a crash are named after their    
+/// target, followed by ".tmp-" and a number.                                 
+///   In group commit mode, temporaries are not synced one by one. They       
+/// pile up until Commit, which syncs all of them at once, renames them, and  
+/// then syncs each of their directories once. Each grouped write keeps its   
+/// temporary open until then, so that its own writeback errors are reported. 
+/// Contents of grouped writes become visible only after they're committed.   
+///   Renames are serialized, so that a target is always left with the        
+/// contents of its newest write, even if it is written while committing      
+///                                                                           
+struct CommitQueue {
+   /// Invoked for each committed write, along with whether it replaced the   
+   /// target file                                                            
+   using Callback = std::function<void(std::string_view path, bool)>;
+
+private:
+   struct Pending {
+      // Virtual path of the file, as given to Write                    
+      std::string mPath;
+      // Native path of the temporary file, and of the target           
+      std::string mTemporary;
+      std::string mTarget;
+      // The temporary file, still open, so it can be synced            
+      std::unique_ptr<Native::Descriptor> mFile;
+   };
+
+   // Grouped writes, waiting to be committed, in the order written     
+   std::vector<Pending> mPending;
+   // Targets replaced by ungrouped writes, while a commit was syncing  
+   // the temporaries - their older grouped writes are dropped          
+   std::vector<std::string> mOvertaken;
+   // Number of commits in progress                                     
+   Count mCommitting = 0;
+   // Protects all of the above, and is held while renaming             
+   std::mutex mMutex;
+   // Makes temporary names unique                                      
+   std::atomic<uint64_t> mSequence = 0;
+   std::atomic_bool mGroupCommit = false;
+
+   bool Supersede(const std::string& target);
+
+public:
+  ~CommitQueue();
+
+   bool Write(std::string_view path, const std::string& target,
+      const Byte*, Offset);
+   bool Commit(const Callback&);
+
+   void SetGroupCommit(bool) noexcept;
+   bool IsGroupCommit() const noexcept;
+   bool IsEmpty();
+};
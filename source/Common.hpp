@@ -7,6 +7,9 @@
 ///                                                                           
 #pragma once
 #include <Langulus/IO.hpp>
+#include <initializer_list>
+#include <string>
+#include <string_view>
 
 using namespace Langulus;
 
@@ -35,4 +38,120 @@ Token GetLastError() noexcept {
    if (not readableError)
       return "<undefined PhysFS error code>";
    return readableError;
+}
+
+/// Get a view over the letters of a text container, without copying          
+///   @param text - the text to view                                          
+///   @return the view                                                        
+LANGULUS(INLINED)
+Token AsToken(const Text& text) noexcept {
+   return Token {text.GetRaw(), text.GetCount()};
+}
+
+/// Walk the normalized form of a virtual path, that is given in segments     
+/// Segments are joined with separators, backslashes become separators, and   
+/// duplicate, leading and trailing separators are skipped. Each segment      
+/// ends at its first null terminator, if any                                 
+///   @param parts - the path segments, joined in order                       
+///   @param lowercase - whether to lowercase all letters                     
+///   @param call - invoked for each normalized character, returns false to   
+///                 stop walking early                                        
+template<class F>
+void NormalizePath(
+   std::initializer_list<std::string_view> parts, bool lowercase, F&& call
+) {
+   bool emitted = false;
+   bool separator = false;
+   for (auto part : parts) {
+      // Segments are always separated                                  
+      separator = emitted;
+      for (auto c : part) {
+         if (c == '\0')
+            break;
+
+         if (c == '/' or c == '\\') {
+            separator = emitted;
+            continue;
+         }
+
+         if (separator) {
+            if (not call('/'))
+               return;
+            separator = false;
+         }
+
+         if (lowercase and c >= 'A' and c <= 'Z')
+            c += 'a' - 'A';
+         if (not call(c))
+            return;
+         emitted = true;
+      }
+   }
+}
+
+/// Normalize a virtual path, so that equivalent paths compare equal          
+///   @param path - the path to normalize                                     
+///   @param lowercase - whether to lowercase all letters, like interfaced    
+///                      paths are                                            
+///   @return the normalized path                                             
+LANGULUS(INLINED)
+std::string NormalizePath(std::string_view path, bool lowercase) {
+   std::string result;
+   result.reserve(path.size());
+   NormalizePath({path}, lowercase, [&](char c) {
+      result += c;
+      return true;
+   });
+   return result;
+}
+
+/// Closes a PhysFS handle when going out of scope                            
+struct ScopedHandle {
+   PHYSFS_File* mHandle;
+
+   ScopedHandle(PHYSFS_File* handle) noexcept
+      : mHandle {handle} {}
+   ScopedHandle(const ScopedHandle&) = delete;
+  ~ScopedHandle() {
+      if (mHandle)
+         PHYSFS_close(mHandle);
+   }
+
+   operator PHYSFS_File* () const noexcept { return mHandle; }
+};
+
+/// Wrap a memory region inside a constant block of bytes, without copying    
+///   @attention the block doesn't own the memory, so the region must outlive 
+///              the block and all of its copies                              
+///   @param data - start of the region                                       
+///   @param size - size of the region in bytes                               
+///   @return the block                                                       
+LANGULUS(INLINED)
+Many WrapBytes(const Byte* data, Offset size) {
+   return Block::From(data, size);
+}
+
+/// Wrap a memory region inside a constant block of some type, without        
+/// copying                                                                   
+///   @attention the block doesn't own the memory, so the region must outlive 
+///              the block and all of its copies                              
+///   @attention the region must be aligned for the type                      
+///   @param type - the type of the elements                                  
+///   @param data - start of the region                                       
+///   @param count - number of elements in the region                         
+///   @return the block                                                       
+LANGULUS(INLINED)
+Many WrapTyped(DMeta type, const Byte* data, Count count) {
+   return Block {DataState::Constant, type, count, data};
+}
+
+/// Allocate an owned container of uninitialized elements                     
+///   @tparam T - the container type, bytes by default                        
+///   @param count - number of elements to allocate                           
+///   @return the container                                                   
+template<class T = TMany<Byte>>
+T Allocate(Offset count) {
+   T result;
+   result.New(count);
+   return result;
 }
\ No newline at end of file
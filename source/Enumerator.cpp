@@ -0,0 +1,414 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#include "Enumerator.hpp"
+#include "Native.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+namespace
+{
+
+   /// Found entries are handed over to the calling thread in batches of      
+   /// this size, so that huge directories still stream out                   
+   constexpr size_t BatchSize = 1024;
+
+   /// Split the first segment from a relative path                           
+   ///   @param path - the path to split, will contain the remainder          
+   ///   @return the first segment                                            
+   std::string_view PopSegment(std::string_view& path) {
+      const auto slash = path.find('/');
+      const auto head = path.substr(0, slash);
+      path = slash == std::string_view::npos
+         ? std::string_view {} : path.substr(slash + 1);
+      return head;
+   }
+
+   /// Match a single segment against a glob with '*' and '?' wildcards       
+   ///   @param glob - the glob segment                                       
+   ///   @param name - the segment to match                                   
+   ///   @return true if name matches                                         
+   bool MatchSegment(std::string_view glob, std::string_view name) {
+      size_t g = 0, n = 0;
+      size_t star = std::string_view::npos, retry = 0;
+      while (n < name.size()) {
+         if (g < glob.size() and (glob[g] == '?' or glob[g] == name[n])) {
+            ++g;
+            ++n;
+         }
+         else if (g < glob.size() and glob[g] == '*') {
+            // Remember the star, and try matching it to nothing first  
+            star = g++;
+            retry = n;
+         }
+         else if (star != std::string_view::npos) {
+            // Let the last star consume one more character             
+            g = star + 1;
+            n = ++retry;
+         }
+         else return false;
+      }
+
+      while (g < glob.size() and glob[g] == '*')
+         ++g;
+      return g == glob.size();
+   }
+
+   using SegmentIt = std::vector<std::string>::const_iterator;
+
+   /// Match a relative path against a segmented glob                         
+   ///   @param it, end - the glob segments                                   
+   ///   @param path - the relative path to match                             
+   ///   @return true if the whole path matches                               
+   bool MatchPath(SegmentIt it, SegmentIt end, std::string_view path) {
+      if (it == end)
+         return path.empty();
+
+      if (*it == "**") {
+         // Consume as many segments as necessary                       
+         while (true) {
+            if (MatchPath(it + 1, end, path))
+               return true;
+            if (path.empty())
+               return false;
+            PopSegment(path);
+         }
+      }
+
+      if (path.empty())
+         return false;
+      const auto head = PopSegment(path);
+      return MatchSegment(*it, head) and MatchPath(it + 1, end, path);
+   }
+
+   /// Check if anything inside a directory can match a segmented glob        
+   ///   @param it, end - the glob segments                                   
+   ///   @param dir - the relative directory path                             
+   ///   @return true if directory has to be entered                          
+   bool MatchPrefix(SegmentIt it, SegmentIt end, std::string_view dir) {
+      if (dir.empty())
+         return it != end;
+      if (it == end)
+         return false;
+      if (*it == "**")
+         return true;
+
+      const auto head = PopSegment(dir);
+      return MatchSegment(*it, head) and MatchPrefix(it + 1, end, dir);
+   }
+
+   /// Concatenate a relative directory path and an entry name                
+   std::string Join(std::string_view dir, std::string_view name) {
+      std::string result;
+      result.reserve(dir.size() + name.size() + 1);
+      result += dir;
+      if (not dir.empty())
+         result += '/';
+      result += name;
+      return result;
+   }
+
+   /// Releases lists returned by PhysFS                                      
+   struct ListDeleter {
+      void operator () (char** list) const noexcept {
+         PHYSFS_freeList(list);
+      }
+   };
+
+} // namespace
+
+
+/// Prepare an enumerator                                                     
+///   @param patterns - glob patterns to match, all immediate children are    
+///                     reported if there are none                            
+///   @param workers - maximum number of threads for native walks, zero to    
+///                    pick automatically                                     
+Enumerator::Enumerator(
+   const std::vector<std::string>& patterns, Count workers
+) {
+   for (auto pattern : patterns) {
+      std::ranges::replace(pattern, '\\', '/');
+
+      Pattern compiled;
+      while (not pattern.empty() and pattern.back() == '/') {
+         compiled.mFoldersOnly = true;
+         pattern.pop_back();
+      }
+
+      // Empty and '.' segments don't change what pattern matches       
+      std::string_view remainder {pattern};
+      while (not remainder.empty()) {
+         const auto segment = PopSegment(remainder);
+         if (not segment.empty() and segment != ".")
+            compiled.mSegments.emplace_back(segment);
+      }
+
+      if (not compiled.mSegments.empty())
+         mPatterns.emplace_back(std::move(compiled));
+   }
+
+   if (mPatterns.empty())
+      mPatterns.push_back({{"*"}, false});
+
+   if (not workers) {
+      // Walking is mostly waiting on metadata, so there's no point in  
+      // more threads than cores, and devices rarely scale beyond eight 
+      const Count cores = std::thread::hardware_concurrency();
+      workers = std::clamp<Count>(cores, 1, 8);
+   }
+   mWorkers = workers;
+}
+
+/// Check if an entry should be reported                                      
+///   @param path - path relative to the walked directory                     
+///   @param folder - whether the entry is a folder                           
+///   @return true if any of the patterns matches                             
+bool Enumerator::Matches(std::string_view path, bool folder) const {
+   for (auto& pattern : mPatterns) {
+      if (pattern.mFoldersOnly and not folder)
+         continue;
+      if (MatchPath(pattern.mSegments.begin(), pattern.mSegments.end(), path))
+         return true;
+   }
+   return false;
+}
+
+/// Check if a subdirectory should be entered                                 
+///   @param path - subdirectory path relative to the walked directory        
+///   @return true if anything inside can match any of the patterns           
+bool Enumerator::CanDescend(std::string_view path) const {
+   for (auto& pattern : mPatterns) {
+      const auto& s = pattern.mSegments;
+      if (MatchPrefix(s.begin(), s.end(), path))
+         return true;
+   }
+   return false;
+}
+
+/// Walk a virtual directory                                                  
+///   @param path - the virtual directory path                                
+///   @param callback - invoked for each match, on the calling thread         
+///   @return the number of reported entries                                  
+Count Enumerator::Walk(std::string_view path, const Callback& callback) const {
+   std::string root {path};
+   std::ranges::replace(root, '\\', '/');
+   while (not root.empty() and root.back() == '/')
+      root.pop_back();
+
+   const auto native = Native::ResolveSoleDirectory(root.c_str());
+   if (not native.empty())
+      return WalkNative(native, callback);
+   return WalkVirtual(root, callback);
+}
+
+/// Walk a directory through PhysFS, one directory at a time                  
+///   @param root - the virtual directory path                                
+///   @param callback - invoked for each match                                
+///   @return the number of reported entries                                  
+Count Enumerator::WalkVirtual(
+   const std::string& root, const Callback& callback
+) const {
+   Count found = 0;
+   std::vector<std::string> pending {std::string {}};
+   while (not pending.empty()) {
+      const auto dir = std::move(pending.back());
+      pending.pop_back();
+
+      const auto full = root.empty() ? dir : Join(root, dir);
+      const std::unique_ptr<char*[], ListDeleter> list {
+         PHYSFS_enumerateFiles(full.c_str())
+      };
+      if (not list)
+         continue;
+
+      for (auto name = list.get(); *name; ++name) {
+         const auto relative = Join(dir, *name);
+         const auto child = root.empty() ? relative : Join(root, relative);
+
+         PHYSFS_Stat info {};
+         if (not PHYSFS_stat(child.c_str(), &info))
+            continue;
+
+         const bool folder = info.filetype == PHYSFS_FILETYPE_DIRECTORY;
+         if (Matches(relative, folder)) {
+            callback(relative, folder);
+            ++found;
+         }
+
+         if (folder and CanDescend(relative))
+            pending.emplace_back(relative);
+      }
+   }
+
+   return found;
+}
+
+/// Walk a native directory, using multiple threads                           
+/// Worker threads take directories from a shared queue, and push found       
+/// subdirectories back to it, so that the whole tree is walked in parallel.  
+/// Matches are collected in batches, and handed to the calling thread,       
+/// which reports them while the walk is still going                          
+///   @param root - the native directory path                                 
+///   @param callback - invoked for each match, on the calling thread         
+///   @return the number of reported entries                                  
+Count Enumerator::WalkNative(
+   const std::string& root, const Callback& callback
+) const {
+   using Found = std::vector<std::pair<std::string, bool>>;
+
+   struct Shared {
+      std::mutex mMutex;
+      // Notifies workers about new directories, or about the end       
+      std::condition_variable mWake;
+      // Notifies the calling thread about new matches, or the end      
+      std::condition_variable mReady;
+      // Directories waiting to be walked, relative to root             
+      std::vector<std::string> mPending {std::string {}};
+      // Matches waiting to be reported                                 
+      Found mFound;
+      // Number of directories currently being walked                   
+      Count mBusy = 0;
+      // Set if calling thread stopped early                            
+      bool mAbort = false;
+      // Worker threads - spawned on demand                             
+      std::vector<std::thread> mThreads;
+
+      bool IsDone() const noexcept {
+         return mAbort or (mPending.empty() and mBusy == 0);
+      }
+   } shared;
+
+   const bool followLinks = PHYSFS_symbolicLinksPermitted();
+   const std::filesystem::path base {root};
+   std::function<void()> work;
+
+   // Spawn another worker, if there are more directories than idle     
+   // workers to walk them. Must be called while holding the mutex      
+   const auto spawn = [&] {
+      const auto idle = shared.mThreads.size() - shared.mBusy;
+      if (shared.mPending.size() <= idle
+      or  shared.mThreads.size() >= mWorkers)
+         return;
+
+      try { shared.mThreads.emplace_back(work); }
+      catch (const std::system_error&) {
+         // Out of threads - existing workers will pick up the slack    
+         if (shared.mThreads.empty())
+            throw;
+      }
+   };
+
+   work = [&] {
+      std::unique_lock lock {shared.mMutex};
+      while (true) {
+         shared.mWake.wait(lock, [&] {
+            return shared.IsDone() or not shared.mPending.empty();
+         });
+         if (shared.IsDone())
+            break;
+
+         const auto dir = std::move(shared.mPending.back());
+         shared.mPending.pop_back();
+         ++shared.mBusy;
+         lock.unlock();
+
+         Found found;
+         std::vector<std::string> subdirs;
+         std::error_code ec;
+         constexpr auto options =
+            std::filesystem::directory_options::skip_permission_denied;
+         std::filesystem::directory_iterator it {base / dir, options, ec};
+
+         for (; not ec and it != std::filesystem::directory_iterator {};
+                it.increment(ec)) {
+            // PhysFS hides symbolic links, unless they're permitted    
+            std::error_code entryError;
+            const bool link = it->is_symlink(entryError);
+            if (link and not followLinks)
+               continue;
+
+            auto relative = Join(dir, it->path().filename().string());
+            const bool folder = it->is_directory(entryError);
+
+            // Never enter linked directories, to avoid cycles          
+            if (folder and not link and CanDescend(relative))
+               subdirs.emplace_back(relative);
+            if (Matches(relative, folder))
+               found.emplace_back(std::move(relative), folder);
+
+            if (found.size() >= BatchSize) {
+               std::scoped_lock flush {shared.mMutex};
+               if (shared.mAbort)
+                  break;
+               std::ranges::move(found, std::back_inserter(shared.mFound));
+               found.clear();
+               shared.mReady.notify_one();
+            }
+         }
+
+         lock.lock();
+         --shared.mBusy;
+         std::ranges::move(found, std::back_inserter(shared.mFound));
+         std::ranges::move(subdirs, std::back_inserter(shared.mPending));
+         if (not shared.mAbort and not subdirs.empty()) {
+            spawn();
+            shared.mWake.notify_all();
+         }
+         else if (shared.IsDone())
+            shared.mWake.notify_all();
+         shared.mReady.notify_one();
+      }
+   };
+
+   // Make sure all workers finish, even if callback throws             
+   struct Joiner {
+      Shared& mShared;
+      ~Joiner() {
+         {
+            std::scoped_lock lock {mShared.mMutex};
+            mShared.mAbort = true;
+         }
+         mShared.mWake.notify_all();
+         for (auto& thread : mShared.mThreads)
+            thread.join();
+      }
+   } joiner {shared};
+
+   {
+      std::scoped_lock lock {shared.mMutex};
+      spawn();
+   }
+
+   // Report matches as they arrive                                     
+   Count reported = 0;
+   Found batch;
+   std::unique_lock lock {shared.mMutex};
+   while (true) {
+      shared.mReady.wait(lock, [&] {
+         return shared.IsDone() or not shared.mFound.empty();
+      });
+      if (shared.mFound.empty())
+         break;
+
+      batch.swap(shared.mFound);
+      lock.unlock();
+      for (auto& [path, folder] : batch)
+         callback(path, folder);
+      reported += batch.size();
+      batch.clear();
+      lock.lock();
+   }
+
+   return reported;
+}
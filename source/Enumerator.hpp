@@ -0,0 +1,58 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#pragma once
+#include "Common.hpp"
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+///                                                                           
+///   Directory enumerator                                                    
+///                                                                           
+///   Walks a virtual directory and reports all entries that match a set of   
+/// glob patterns. Patterns are matched against paths relative to the walked  
+/// directory, segment by segment:                                            
+///      *     matches any number of characters inside a single segment       
+///      ?     matches exactly one character inside a single segment          
+///      **    matches any number of segments, enabling full recursion        
+///   A trailing slash restricts a pattern to folders. Subdirectories are     
+/// entered only if some pattern can match something inside them, so          
+/// "*.png" lists a single directory, "textures/*.png" enters only one        
+/// subdirectory, and "**/*.png" walks the whole tree                         
+///   When the directory comes from a single native mount, subtrees are       
+/// walked in parallel by a number of threads. Otherwise the walk goes        
+/// through PhysFS, which serializes enumeration internally. Either way,      
+/// results are reported on the calling thread, as soon as they're found      
+///                                                                           
+struct Enumerator {
+   // Receives a path relative to the walked directory, and whether     
+   // it's a folder                                                     
+   using Callback = std::function<void(std::string_view, bool)>;
+
+private:
+   struct Pattern {
+      std::vector<std::string> mSegments;
+      bool mFoldersOnly = false;
+   };
+
+   std::vector<Pattern> mPatterns;
+   Count mWorkers;
+
+   bool Matches(std::string_view, bool folder) const;
+   bool CanDescend(std::string_view) const;
+
+   Count WalkNative(const std::string&, const Callback&) const;
+   Count WalkVirtual(const std::string&, const Callback&) const;
+
+public:
+   Enumerator(const std::vector<std::string>& patterns, Count workers = 0);
+
+   Count Walk(std::string_view, const Callback&) const;
+};
@@ -7,6 +7,43 @@
 ///                                                                           
 #include "File.hpp"
 #include "FileSystem.hpp"
+#include "Pack.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <thread>
+#include <vector>
+
+
+/// Size of the chunks used when reading whole files                          
+/// Big enough to bypass PhysFS' internal buffering and amortize syscalls     
+constexpr Offset ReadChunkSize = 1024 * 1024;
+
+/// Minimum range size per thread, when reading in parallel                   
+/// Smaller ranges don't benefit from more threads, even on NVMe drives       
+constexpr Offset ParallelRangeSize = 32 * ReadChunkSize;
+
+/// Read the requested number of bytes in large chunks                        
+///   @param handle - the handle to read from                                 
+///   @param output - [out] where to read bytes into                          
+///   @param count - number of bytes to read                                  
+///   @return the number of bytes read, less than count only on end of file   
+static Offset ReadChunked(PHYSFS_File* handle, Byte* output, Offset count) {
+   Offset done = 0;
+   while (done < count) {
+      const auto chunk = std::min(ReadChunkSize, count - done);
+      const auto result = PHYSFS_readBytes(
+         handle, output + done, PHYSFS_uint64(chunk));
+      LANGULUS_ASSERT(result >= 0, FileSystem,
+         "Complete failure in PHYSFS_readBytes: ", GetLastError());
+
+      if (result == 0)
+         break;
+      done += static_cast<Offset>(result);
+   }
+   return done;
+}
 
 
 /// File constructor                                                          
@@ -29,7 +66,14 @@ File::File(FileSystem* producer, const Many& descriptor)
    mFileExtension = mFilePath.GetExtension();
 
    // Check if file exists, and retrieve its info                       
-   if (0 != PHYSFS_stat(mFilePath.GetRaw(), &mFileInfo)) {
+   mMountGeneration = producer->GetGeneration();
+   bool found;
+   {
+      const auto timer = Measure(IOStats::Stat);
+      found = producer->GetStatCache().Stat(mFilePath.GetRaw(), mFileInfo);
+   }
+
+   if (found) {
       LANGULUS_ASSERT(
          mFileInfo.filetype == PHYSFS_FILETYPE_REGULAR, FileSystem,
          "Path `", mFilePath, "` doesn't point to a regular file"
@@ -74,17 +118,100 @@ File::File(FileSystem* producer, const Many& descriptor)
    VERBOSE_VFS("Initialized");
 }
 
-/// File destructor                                                           
-File::~File() {
-   if (mHandle) {
-      LANGULUS_ASSERT(PHYSFS_close(mHandle), FileSystem,
-         "Error in PHYSFS_close: ", GetLastError());
-      mHandle.Reset();
+/// React on environmental change                                             
+/// Refreshes the file info, and drops the native resources and cached        
+/// blocks, so that they're reacquired for the new contents. Invoked by the   
+/// watcher, from within FileSystem::Update, when the file changes on disk    
+/// Reads in progress on other threads finish using the retired resources.    
+/// The file is watched again the next time its contents are used, in case    
+/// it was moved or recreated                                                 
+void File::Refresh() {
+   mMountGeneration.store(GetProducer()->GetGeneration(),
+      std::memory_order_release);
+
+   auto& cache = GetProducer()->GetStatCache();
+   cache.Invalidate(mFilePath.GetRaw());
+
+   PHYSFS_Stat info {};
+   bool found;
+   {
+      const auto timer = Measure(IOStats::Stat);
+      found = cache.Stat(mFilePath.GetRaw(), info);
+   }
+
+   if (found and info.filetype == PHYSFS_FILETYPE_REGULAR) {
+      mFileInfo = info;
+      mExists = true;
+      mByteCount = static_cast<Offset>(info.filesize);
+      mIsReadOnly = info.readonly;
+   }
+   else {
+      mFileInfo = {};
+      mExists = false;
+      mByteCount = 0;
+      mIsReadOnly = false;
+   }
+
+   VERBOSE_VFS("Refreshed: ", mFilePath);
+
+   // Idle handles might still point to the old contents                
+   GetProducer()->GetHandlePool().Forget(
+      {mFilePath.GetRaw(), mFilePath.GetCount()});
+
+   {
+      std::scoped_lock lock {mNativeMutex};
+      if (mSource and mSource->IsArchived()) {
+         GetProducer()->GetBlockCache().Invalidate(mSource->mArchive,
+            {mFilePath.GetRaw(), mFilePath.GetCount()});
+      }
+
+      // Reads in progress hold their own reference to the source, so   
+      // its descriptor is closed only after the last one is done       
+      mSource.reset();
+      mWatched = false;
+
+      RetireMapping();
    }
 }
 
+/// Refresh the file, if sources were mounted or unmounted since it was last  
+/// refreshed. Any path might change its meaning when mounts change, so files 
+/// are checked on their next use, instead of refreshing all of them on each  
+/// mount. Only one thread refreshes, the others keep using the old info      
+void File::Validate() const {
+   const auto current = GetProducer()->GetGeneration();
+   auto refreshed = mMountGeneration.load(std::memory_order_acquire);
+   if (refreshed == current
+   or not mMountGeneration.compare_exchange_strong(refreshed, current))
+      return;
+
+   const_cast<File*>(this)->Refresh();
+}
+
+/// Register the file for change notifications, the first time its contents   
+/// are used - until then, nothing is cached that could go stale, other than  
+/// the file info, so interfacing many files never touches the watcher        
+///   @attention assumes mNativeMutex is locked                               
+///   @param native - where the file is on disk, if it's in a native directory
+void File::Watch(const std::string& native) const {
+   if (mWatched)
+      return;
+
+   // Registering doesn't change the file, it only makes Poll refresh it
+   mWatched = true;
+   GetProducer()->GetWatcher().Watch(const_cast<File*>(this),
+      native.empty() ? Native::ResolveWritePath(mFilePath.GetRaw()) : native);
+}
+
 /// First stage destruction                                                   
 void File::Teardown() {
+   GetProducer()->GetWatcher().Unwatch(this);
+   {
+      // Write out pending records, while the path is still valid       
+      std::scoped_lock lock {mAppendMutex};
+      mAppendLogPublished.store(nullptr, std::memory_order_release);
+      mAppendLog.reset();
+   }
    mFilePath.Reset();
    mParentDirectory = {};
    mFileName = {};
@@ -92,69 +219,780 @@ void File::Teardown() {
 }
 
 /// Read a file and deserialize it as the required type                       
-Many File::ReadAs(DMeta) const {
-   TODO();
-   return {};
+/// The file is read with a single allocation, sized from the file info,      
+/// directly into the container that is then handed to the deserializer       
+///   @param type - the type to deserialize as, or nullptr for raw contents   
+///   @return the deserialized data                                           
+Many File::ReadAs(DMeta type) const {
+   Validate();
+   LANGULUS_ASSERT(mExists, FileSystem,
+      "Can't read non-existing file `", mFilePath, '`');
+
+   // Text-based formats are read straight into a text container, the   
+   // rest are read as raw bytes                                        
+   const bool isText = mFormat and mFormat->template CastsTo<Text>();
+   Many contents;
+   if (isText)
+      contents = Allocate<Text>(mByteCount);
+   else
+      contents = Allocate(mByteCount);
+   ReadInto(contents);
+
+   if (not type
+   or (isText and type->template CastsTo<Text>())
+   or (not isText and type->template IsExact<Byte>()))
+      return contents;
+
+   // Deserialize straight from the read contents                       
+   Verbs::Interpret interpreter {type};
+   Flow::DispatchFlat(contents, interpreter);
+   LANGULUS_ASSERT(interpreter.IsDone(), FileSystem,
+      "Can't interpret `", mFilePath, "` as ", type);
+   return interpreter.GetOutput();
 }
 
-/// Create a new file reader                                                  
+/// Get a read-only view over the entire file contents                        
+/// If the file resides in a native directory, it is memory-mapped and no     
+/// bytes are copied. Otherwise (i.e. file is inside an archive) the contents 
+/// are read into a new block instead                                         
+///   @return the view, with empty contents if file is empty/missing          
+auto File::NewMappedView() const -> View {
+   Validate();
+   View view;
+   if (not mExists or not mByteCount)
+      return view;
+
+   Trace(0, mByteCount);
+   view.mMapping = MapContents();
+   if (view.mMapping) {
+      view.mData = WrapBytes(
+         reinterpret_cast<const Byte*>(view.mMapping->GetRaw()),
+         view.mMapping->GetSize());
+   }
+   else {
+      // Fallback to copying, if file isn't backed by a native file     
+      view.mData = ReadBytes();
+   }
+   return view;
+}
+
+/// Map the entire file contents in memory, the first time it's needed        
+///   @return the mapping, or nullptr if file can't be mapped                 
+auto File::MapContents() const -> std::shared_ptr<const Native::Mapping> {
+   std::scoped_lock lock {mNativeMutex};
+   if (mMapping)
+      return mMapping;
+
+   const auto& source = ResolveSource();
+   if (not source.IsNative())
+      return {};
+
+   auto mapping = std::make_shared<Native::Mapping>();
+   if (not mapping->Open(source.mNativePath, source.mNativeOffset,
+      source.mNativeIsPack ? source.mSize : 0))
+      return {};
+
+   VERBOSE_VFS("Mapped ", Size {mapping->GetSize()},
+      " from `", mFilePath, '`');
+   mMapping = std::move(mapping);
+   return mMapping;
+}
+
+/// Drop the mapping, so that the next view maps the contents anew            
+/// Views over the mapping keep it alive, and it is unmapped after the last   
+/// of them is released                                                       
+///   @attention assumes mNativeMutex is locked                               
+void File::RetireMapping() const {
+   std::erase_if(mRetiredMappings, [](auto& mapping) {
+      return mapping.expired();
+   });
+
+   if (mMapping) {
+      if (mMapping.use_count() > 1)
+         mRetiredMappings.emplace_back(mMapping);
+      mMapping.reset();
+   }
+}
+
+/// Make sure that truncating the file doesn't pull the contents from under   
+/// views, which would crash whoever reads them. If there are any views, the  
+/// file is deleted first, so that they keep the old contents, and the file   
+/// is created anew, instead of being truncated                               
+void File::DetachViews() const {
+   std::scoped_lock lock {mNativeMutex};
+   RetireMapping();
+   if (not mRetiredMappings.empty()) {
+      VERBOSE_VFS("Deletes `", mFilePath, "` before rewriting, "
+         "because it is still viewed");
+      PHYSFS_delete(mFilePath.GetRaw());
+   }
+}
+
+/// Get a typed view over the entire file contents, i.e. for flat arrays of   
+/// vertices, indices or floats. If the file is memory-mapped, and the        
+/// mapping is aligned for the type, the elements are viewed right where      
+/// they are, without deserializing or copying anything. Otherwise the        
+/// contents are copied into a new container of the type                      
+///   @param type - the element type, must be POD                             
+///   @return the view, with no elements if file is empty/missing             
+auto File::ViewAs(DMeta type) const -> View {
+   Validate();
+   LANGULUS_ASSERT(type and type->mIsPOD and type->mSize, FileSystem,
+      "Can't view `", mFilePath, "` as ", type, " - type isn't POD");
+
+   View view;
+   if (not mExists or not mByteCount) {
+      view.mData = Many::FromMeta(type);
+      return view;
+   }
+
+   auto mapping = MapContents();
+   const auto mapped = mapping
+      ? reinterpret_cast<const Byte*>(mapping->GetRaw()) : nullptr;
+   const auto size = mapping ? mapping->GetSize() : mByteCount;
+   LANGULUS_ASSERT(size % type->mSize == 0, FileSystem,
+      "Can't view `", mFilePath, "` as ", type, " - ", Size {size},
+      " isn't a multiple of ", Size {type->mSize});
+   const auto count = size / type->mSize;
+
+   const auto address = reinterpret_cast<uintptr_t>(mapped);
+   if (mapped and address % type->mAlignment == 0) {
+      Trace(0, size);
+      VERBOSE_VFS("Views ", count, " ", type, " in `", mFilePath, '`');
+      view.mData = WrapTyped(type, mapped, count);
+      view.mMapping = std::move(mapping);
+      return view;
+   }
+
+   // Containers are always aligned for their type, so copy into one    
+   view.mData = Many::FromMeta(type);
+   view.mData.New(count);
+   if (mapped) {
+      Trace(0, size);
+      std::memcpy(view.mData.GetRaw(), mapped, size);
+   }
+   else ReadInto(view.mData);
+   return view;
+}
+
+/// Read a range of bytes, without moving any reader's cursor                 
+/// Safe to call from multiple threads at once. Files in native directories   
+/// are read with positional reads on a shared descriptor, archived files     
+/// through the shared block cache                                            
+///   @param offset - byte offset to start reading from                       
+///   @param size - number of bytes to read                                   
+///   @param output - [out] where bytes go - allocated if empty, otherwise it 
+///                   must have room for at least 'size' bytes                
+///   @return the number of bytes read, less than size only at end of file    
+Offset File::ReadRange(Offset offset, Offset size, Many& output) const {
+   if (output.IsEmpty())
+      output = Allocate(size);
+   else {
+      LANGULUS_ASSERT(output.GetBytesize() >= size, FileSystem,
+         "Output block is too small for reading range from `", mFilePath, '`');
+   }
+
+   if (not size)
+      return 0;
+
+   Trace(offset, size);
+   auto timer = Measure(IOStats::Read);
+   const auto source = GetSource();
+
+   Offset done;
+   if (source->IsNative()) {
+      // Positional reads on the shared native descriptor               
+      const HandlePool::Pin pin {source->mDescriptor};
+      const auto result = source->ReadNative(
+         pin, offset, size, output.GetRaw());
+      LANGULUS_ASSERT(result >= 0, FileSystem,
+         "Error in positional read from `", mFilePath, '`');
+      done = static_cast<Offset>(result);
+   }
+   else if (source->IsArchived()) {
+      // Archived files are decompressed only once, through the cache   
+      done = ReadCached(*source, offset, size, output.GetRaw());
+   }
+   else {
+      // Fallback for archives - a temporary handle per call            
+      ScopedHandle handle = OpenRead();
+      LANGULUS_ASSERT(PHYSFS_seek(handle, PHYSFS_uint64(offset)), FileSystem,
+         "Can't seek `", mFilePath, "` to ", offset, ": ", GetLastError());
+      done = ReadChunked(handle, output.GetRaw(), size);
+   }
+
+   timer.SetBytes(done);
+   return done;
+}
+
+/// Read the entire file using multiple threads                               
+/// The file is split into large ranges, that are read in parallel directly   
+/// into their place in a single preallocated block. Ranges are read by the   
+/// calling thread, helped by the asynchronous I/O workers, so no threads are 
+/// created. Files that don't support positional reads (i.e. ones inside      
+/// archives) are read sequentially                                           
+///   @param output - [out] where bytes go - allocated if empty, otherwise it 
+///                   must have room for the entire file                      
+///   @param threads - maximum number of threads, zero to pick automatically  
+///   @return the number of bytes read                                        
+Offset File::ReadParallel(Many& output, Count threads) const {
+   Validate();
+   LANGULUS_ASSERT(mExists, FileSystem,
+      "Can't read non-existing file `", mFilePath, '`');
+
+   const auto size = mByteCount;
+   if (output.IsEmpty())
+      output = Allocate(size);
+   else {
+      LANGULUS_ASSERT(output.GetBytesize() >= size, FileSystem,
+         "Output block is too small for reading `", mFilePath, '`');
+   }
+
+   if (not size)
+      return 0;
+
+   Trace(0, size);
+   auto timer = Measure(IOStats::Read);
+   const auto source = GetSource();
+
+   if (not source->IsNative()) {
+      Offset done;
+      if (source->IsArchived()
+      and size <= GetProducer()->GetBlockCache().GetBudget() / 4)
+         done = ReadCached(*source, 0, size, output.GetRaw());
+      else {
+         // Sequential reads, when the backend can't seek cheaply       
+         ScopedHandle handle = OpenRead();
+         done = ReadChunked(handle, output.GetRaw(), size);
+      }
+
+      timer.SetBytes(done);
+      return done;
+   }
+
+   // Pick a number of threads, so that each gets a sizable range       
+   if (not threads)
+      threads = std::max(std::thread::hardware_concurrency(), 1u);
+   const auto ranges = (size + ParallelRangeSize - 1) / ParallelRangeSize;
+   threads = std::min<Count>(threads, ranges);
+
+   // Ranges are aligned to read chunks, the last one takes the rest    
+   auto perThread = (size + threads - 1) / threads + ReadChunkSize - 1;
+   perThread -= perThread % ReadChunkSize;
+
+   // Ranges are claimed one by one, by the calling thread and by the   
+   // workers. The caller waits only for ranges that were claimed, so   
+   // workers that get to it late find nothing left, and touch only the 
+   // state they share ownership of, never anything on this stack       
+   struct Parallel {
+      const Source* mSource;
+      const HandlePool::Pin* mPin;
+      Byte* mOutput;
+      Offset mSize;
+      Offset mRange;
+      Count mRanges;
+      std::atomic<Count> mNext = 0;
+      std::atomic<Count> mDone = 0;
+      std::atomic<int64_t> mTotal = 0;
+      std::atomic_bool mFailed = false;
+
+      void Work() noexcept {
+         while (true) {
+            const auto index = mNext.fetch_add(1);
+            if (index >= mRanges)
+               return;
+
+            const auto from = index * mRange;
+            const auto done = mSource->ReadNative(
+               *mPin, from, std::min(mRange, mSize - from), mOutput + from);
+            if (done < 0)
+               mFailed = true;
+            else
+               mTotal += done;
+
+            if (mDone.fetch_add(1) + 1 == mRanges)
+               mDone.notify_all();
+         }
+      }
+   };
+
+   // The descriptor is pinned once, and shared by all threads          
+   const HandlePool::Pin pin {source->mDescriptor};
+   const auto state = std::make_shared<Parallel>();
+   state->mSource = source.get();
+   state->mPin = &pin;
+   state->mOutput = output.GetRaw();
+   state->mSize = size;
+   state->mRange = perThread;
+   state->mRanges = (size + perThread - 1) / perThread;
+
+   // Failing to hand out a range is fine, the caller reads it instead  
+   auto& pool = GetProducer()->GetAsyncIO();
+   try {
+      for (Count helper = 1; helper < state->mRanges; ++helper) {
+         if (not pool.Run([state] { state->Work(); }))
+            break;
+      }
+   }
+   catch (...) {}
+
+   state->Work();
+   for (auto done = state->mDone.load(); done < state->mRanges;
+        done = state->mDone.load())
+      state->mDone.wait(done);
+
+   LANGULUS_ASSERT(not state->mFailed, FileSystem,
+      "Error in parallel read from `", mFilePath, '`');
+   const auto total = static_cast<Offset>(state->mTotal.load());
+   timer.SetBytes(total);
+   return total;
+}
+
+/// Positional read from the native descriptor, until all bytes are read      
+/// Doesn't throw, so that it can be used from any thread                     
+///   @param pin - the pinned mDescriptor                                     
+///   @param offset - byte offset to start reading from                       
+///   @param size - number of bytes to read                                   
+///   @param output - [out] where bytes go                                    
+///   @return the number of read bytes, or -1 on error                        
+int64_t File::Source::ReadNative(
+   const Pin& pin, Offset offset, Offset size, Byte* output
+) const noexcept {
+   if (mNativeIsPack) {
+      if (offset >= mSize)
+         return 0;
+      size = std::min(size, mSize - offset);
+   }
+
+   const auto& descriptor = pin.GetDescriptor();
+   Offset done = 0;
+   while (done < size) {
+      const auto result = descriptor.ReadAt(
+         output + done, size - done, mNativeOffset + offset + done);
+      if (result < 0)
+         return -1;
+      if (result == 0)
+         break;
+      done += static_cast<Offset>(result);
+   }
+   return static_cast<int64_t>(done);
+}
+
+/// Vectored positional read from the native descriptor                       
+/// Doesn't throw, so that it can be used from any thread                     
+///   @param pin - the pinned mDescriptor                                     
+///   @param offset - byte offset to start reading from                       
+///   @param slices - [in/out] where bytes go, trimmed as they're filled      
+///   @return the number of read bytes, or -1 on error                        
+int64_t File::Source::ReadNativeV(
+   const Pin& pin, Offset offset, std::span<Native::Slice> slices
+) const noexcept {
+   if (mNativeIsPack) {
+      // The pack continues after the file, so don't read past its end  
+      auto left = offset < mSize ? mSize - offset : 0;
+      for (auto& slice : slices) {
+         slice.mSize = std::min<size_t>(slice.mSize, left);
+         left -= slice.mSize;
+      }
+   }
+
+   return pin.GetDescriptor().ReadAtV(
+      slices.data(), slices.size(), mNativeOffset + offset);
+}
+
+/// Look up where the file contents are, the first time it's needed           
+/// Native files get a pooled descriptor for positional reads, that isn't     
+/// opened until the first such read                                          
+///   @attention assumes mNativeMutex is locked                               
+///   @return the source                                                      
+auto File::ResolveSource() const -> const Source& {
+   if (mSource)
+      return *mSource;
+
+   // The stat cache knows where the file is on disk, without asking    
+   // PhysFS or the OS again                                            
+   auto source = std::make_shared<Source>();
+   source->mSize = mByteCount;
+   PHYSFS_Stat info;
+   GetProducer()->GetStatCache().Stat(
+      mFilePath.GetRaw(), info, &source->mNativePath);
+   Watch(source->mNativePath);
+
+   if (source->mNativePath.empty()) {
+      uint64_t offset;
+      if (Pack::Locate(mFilePath.GetRaw(), source->mNativePath, offset)) {
+         source->mNativeOffset = static_cast<Offset>(offset);
+         source->mNativeIsPack = true;
+      }
+   }
+
+   if (not source->mNativePath.empty()) {
+      source->mDescriptor = GetProducer()->GetHandlePool().Reserve(
+         source->mNativePath, HandlePool::NativeRead);
+   }
+   else if (const auto archive = PHYSFS_getRealDir(mFilePath.GetRaw()))
+      source->mArchive = archive;
+
+   mSource = std::move(source);
+   return *mSource;
+}
+
+/// Get where the file contents are read from                                 
+/// The source remains usable after the file is refreshed, so hold on to it   
+/// for the duration of a read, instead of looking it up again                
+///   @return the source, never nullptr                                       
+auto File::GetSource() const -> SourceRef {
+   Validate();
+   std::scoped_lock lock {mNativeMutex};
+   ResolveSource();
+   return mSource;
+}
+
+/// Read a range of bytes through the shared block cache                      
+/// Missing blocks are decompressed using a temporary handle, and cached      
+///   @attention assumes source.IsArchived() returned true                    
+///   @param source - the archive the file is in                              
+///   @param offset - byte offset to start reading from                       
+///   @param size - number of bytes to read                                   
+///   @param output - [out] where bytes go                                    
+///   @return the number of bytes read, less than size only at end of file    
+Offset File::ReadCached(
+   const Source& source, Offset offset, Offset size, Byte* output
+) const {
+   const auto fileSize = source.mSize;
+   if (offset >= fileSize)
+      return 0;
+   size = std::min(size, fileSize - offset);
+
+   auto& cache = GetProducer()->GetBlockCache();
+   const std::string_view entry {mFilePath.GetRaw(), mFilePath.GetCount()};
+   std::optional<ScopedHandle> handle;
+
+   Offset done = 0;
+   while (done < size) {
+      const auto index = (offset + done) / BlockCache::BlockSize;
+      const auto start = index * BlockCache::BlockSize;
+      auto block = cache.Find(source.mArchive, entry, index);
+      if (not block) {
+         if (not handle)
+            handle.emplace(OpenRead());
+
+         // Consecutive missing blocks don't need a seek, which is      
+         // important, because seeking back in archives decompresses    
+         // everything from the start again                             
+         if (PHYSFS_tell(*handle) != PHYSFS_sint64(start)) {
+            LANGULUS_ASSERT(PHYSFS_seek(*handle, PHYSFS_uint64(start)),
+               FileSystem, "Can't seek `", mFilePath, "` to ", start,
+               ": ", GetLastError());
+         }
+
+         std::vector<Byte> bytes(
+            std::min(BlockCache::BlockSize, fileSize - start));
+         const auto read = ReadChunked(*handle, bytes.data(), bytes.size());
+         LANGULUS_ASSERT(read == bytes.size(), FileSystem,
+            "File `", mFilePath, "` changed while being read");
+         block = cache.Insert(
+            source.mArchive, entry, index, std::move(bytes));
+      }
+
+      const auto from = offset + done - start;
+      const auto count = std::min(size - done, block->size() - from);
+      std::memcpy(output + done, block->data() + from, count);
+      done += count;
+   }
+
+   return done;
+}
+
+/// Prefetch a range of bytes ahead of time, in the background                
+/// Native files are only hinted to the OS, falling back to reading the range 
+/// into a scratch buffer, where hints aren't supported. Archived files are   
+/// decompressed into the block cache, if they fit comfortably in it          
+///   @param offset - byte offset to start prefetching from                   
+///   @param size - number of bytes to prefetch, zero for the whole file      
+void File::Prefetch(Offset offset, Offset size) const {
+   Validate();
+   if (not mExists or offset >= mByteCount)
+      return;
+   if (not size or size > mByteCount - offset)
+      size = mByteCount - offset;
+
+   const auto source = GetSource();
+   if (source->IsNative()) {
+      const HandlePool::Pin pin {source->mDescriptor};
+      if (pin.GetDescriptor().WillNeed(source->mNativeOffset + offset, size))
+         return;
+
+      std::vector<Byte> scratch(std::min(size, ReadChunkSize));
+      for (Offset done = 0; done < size;) {
+         const auto result = source->ReadNative(pin, offset + done,
+            std::min<Offset>(scratch.size(), size - done), scratch.data());
+         if (result <= 0)
+            break;
+         done += static_cast<Offset>(result);
+      }
+   }
+   else if (source->IsArchived()
+   and size <= GetProducer()->GetBlockCache().GetBudget() / 4) {
+      std::vector<Byte> scratch(size);
+      ReadCached(*source, offset, size, scratch.data());
+   }
+}
+
+/// Check if file accesses are being recorded                                 
+///   @return true if Trace should be called                                  
+bool File::IsTraced() const noexcept {
+   return GetProducer()->GetAccessTrace().IsRecording();
+}
+
+/// Record an access to the file, if accesses are being recorded              
+///   @param offset - where the read started                                  
+///   @param size - number of bytes read, zero if file was only opened        
+void File::Trace(Offset offset, Offset size) const {
+   auto& trace = GetProducer()->GetAccessTrace();
+   if (trace.IsRecording()) {
+      trace.Record({mFilePath.GetRaw(), mFilePath.GetCount()},
+         offset, size);
+   }
+}
+
+/// Start measuring an operation on the file                                  
+///   @param operation - the operation                                        
+///   @return the timer, that records the operation when destroyed            
+auto File::Measure(IOStats::Operation operation) const noexcept
+-> IOStats::Timer {
+   return {GetProducer()->GetIOStats(), &mIOCounters, operation};
+}
+
+/// Open a temporary handle for reading, measuring how long it takes          
+///   @return the handle, never nullptr                                       
+PHYSFS_File* File::OpenRead() const {
+   PHYSFS_File* handle;
+   {
+      const auto timer = Measure(IOStats::Open);
+      handle = PHYSFS_openRead(mFilePath.GetRaw());
+   }
+
+   LANGULUS_ASSERT(handle, FileSystem,
+      "Can't open `", mFilePath, "` for reading");
+   return handle;
+}
+
+/// Get the totals of all operations made on this file so far                 
+/// Module-wide totals and latency histograms are in FileSystem::GetIOStats   
+///   @return the totals, indexed by IOStats::Operation                       
+auto File::GetIOStats() const noexcept
+-> std::array<IOStats::Totals, IOStats::OperationCount> {
+   return mIOCounters.GetTotals();
+}
+
+/// Read the entire file contents in a new block of bytes                     
+///   @return the read bytes                                                  
+Many File::ReadBytes() const {
+   Many result = Allocate(mByteCount);
+   ReadInto(result);
+   return result;
+}
+
+/// Fill a preallocated block with the file contents, starting from the       
+/// beginning of the file                                                     
+/// Uses a temporary handle, so it doesn't interfere with readers/writers.    
+/// Archived files, that fit comfortably in the block cache, go through it    
+///   @param output - [out] the block to fill, must be exactly file-sized     
+void File::ReadInto(Many& output) const {
+   const auto count = output.GetBytesize();
+   Trace(0, count);
+   auto timer = Measure(IOStats::Read);
+   const auto source = GetSource();
+   if (source->IsArchived()
+   and count <= GetProducer()->GetBlockCache().GetBudget() / 4) {
+      const auto read = ReadCached(*source, 0, count, output.GetRaw());
+      timer.SetBytes(read);
+      LANGULUS_ASSERT(read == count, FileSystem,
+         "File `", mFilePath, "` changed while being read");
+      return;
+   }
+
+   ScopedHandle handle = OpenRead();
+   const auto read = ReadChunked(handle, output.GetRaw(), count);
+   timer.SetBytes(read);
+
+   VERBOSE_VFS("Reads ", Size {read}, " from `", mFilePath, '`');
+   LANGULUS_ASSERT(read == count, FileSystem,
+      "File `", mFilePath, "` changed while being read");
+}
+
+/// Create a new file reader with default buffering                           
 ///   @return a pointer to the file reader                                    
 auto File::NewReader() const -> Ref<A::File::Reader> {
-   LANGULUS_ASSERT(not mHandle, FileSystem,
-      "File `", mFilePath, "` is already opened");
+   return NewReader(Buffering {});
+}
+
+/// Create a new file reader                                                  
+/// Any number of readers can exist simultaneously, each with its own cursor  
+///   @param buffering - read-ahead buffering options                         
+///   @return a pointer to the file reader                                    
+auto File::NewReader(const Buffering& buffering) const
+-> Ref<A::File::Reader> {
+   Trace(0, 0);
 
-   // Open file for reading                                             
-   mHandle = PHYSFS_openRead(GetFilePath().GetRaw());
-   LANGULUS_ASSERT(mHandle, FileSystem,
-      "Can't open `", GetFilePath(), "` for reading");
+   // Archived files are read through the block cache, and uncached     
+   // native files through their own descriptor, both without a handle  
+   HandlePool::Lease handle;
+   const auto source = GetSource();
+   const bool direct = buffering.mDirect and source->IsNative();
+   if (not direct and not source->IsArchived()) {
+      {
+         const auto timer = Measure(IOStats::Open);
+         handle = GetProducer()->GetHandlePool().Open(
+            {mFilePath.GetRaw(), mFilePath.GetCount()}, HandlePool::Read);
+      }
+      LANGULUS_ASSERT(handle, FileSystem,
+         "Can't open `", GetFilePath(), "` for reading");
+   }
 
    Ref<::File::Reader> instance;
-   instance.New(const_cast<File*>(this));
+   instance.New(const_cast<File*>(this), std::move(handle), source,
+      buffering);
    return instance.As<A::File::Reader>();
 }
 
-/// Create a new file writer                                                  
+/// Create a new unbuffered file writer                                       
+/// Every write goes straight to the handle, like it always did - pass        
+/// Buffering explicitly to coalesce writes in memory instead                 
+///   @param append - false if you want to delete and create the file anew    
 ///   @return a pointer to the file writer                                    
 auto File::NewWriter(bool append) const -> Ref<A::File::Writer> {
+   Buffering unbuffered;
+   unbuffered.mSize = 0;
+   return NewWriter(append, unbuffered);
+}
+
+/// Create a new file writer                                                  
+/// Written bytes are coalesced in memory, until buffer is full, or until     
+/// the writer is flushed/destroyed                                           
+///   @param append - false if you want to delete and create the file anew    
+///   @param buffering - write-behind buffering options                       
+///   @return a pointer to the file writer                                    
+auto File::NewWriter(bool append, const Buffering& buffering) const
+-> Ref<A::File::Writer> {
+   Validate();
+
    // Check if file is read-only                                        
    LANGULUS_ASSERT(
       not Exists() or not IsReadOnly(), FileSystem,
       "Can't open read-only `", GetFilePath(), "` for writing/appending"
    );
 
-   LANGULUS_ASSERT(not mHandle, FileSystem,
-      "File `", mFilePath, "` is already opened");
+   // Idle read handles won't see what is written                       
+   auto& pool = GetProducer()->GetHandlePool();
+   const std::string_view path {mFilePath.GetRaw(), mFilePath.GetCount()};
+   pool.Forget(path);
+   if (not append)
+      DetachViews();
 
-   if (append) {
-      // Open file for appending                                        
-      mHandle = PHYSFS_openAppend(GetFilePath().GetRaw());
-      LANGULUS_ASSERT(mHandle, FileSystem,
-         "Can't open `", GetFilePath(), "` for appending");
-   }
-   else {
-      // Open file anew for writing                                     
-      mHandle = PHYSFS_openWrite(GetFilePath().GetRaw());
-      LANGULUS_ASSERT(mHandle, FileSystem,
-         "Can't open `", GetFilePath(), "` for writing");
+   // Uncached writers use their own descriptor, and need no handle,    
+   // but only if the write directory is native                         
+   HandlePool::Lease handle;
+   const bool direct = buffering.mDirect
+      and not Native::ResolveWritePath(mFilePath.GetRaw()).empty();
+   if (not direct) {
+      {
+         const auto timer = Measure(IOStats::Open);
+         handle = pool.Open(path,
+            append ? HandlePool::Append : HandlePool::Write);
+      }
+
+      // Open file for appending, or anew for writing                   
+      LANGULUS_ASSERT(handle, FileSystem, "Can't open `", GetFilePath(),
+         append ? "` for appending" : "` for writing");
    }
 
+   // File was created or truncated                                     
+   GetProducer()->GetStatCache().Invalidate(mFilePath.GetRaw());
+
    Ref<::File::Writer> instance;
-   instance.New(const_cast<File*>(this), append);
+   instance.New(const_cast<File*>(this), std::move(handle), append,
+      buffering);
    return instance.As<A::File::Writer>();
 }
 
+/// Read bytes asynchronously                                                 
+/// Completion callback is invoked from FileSystem::Update                    
+///   @param offset - where to start reading from                             
+///   @param output - preallocated block where bytes will be read into - it   
+///                   shouldn't be resized/reallocated until completion       
+///   @param onComplete - invoked when done, check the request for errors     
+void File::ReadAsync(
+   Offset offset, const Many& output,
+   AsyncIO::Request::Callback&& onComplete
+) const {
+   AsyncIO::Request request;
+   request.mKind = AsyncIO::Request::Read;
+   {
+      const auto lock = GetProducer()->LockReferences();
+      request.mFile = const_cast<File*>(this);
+   }
+   request.mOffset = offset;
+   request.mData = output;
+   request.mOnComplete = std::move(onComplete);
+   GetProducer()->GetAsyncIO().Submit(std::move(request));
+}
+
+/// Write bytes asynchronously                                                
+/// Rewrites are atomic, like WriteAtomic, so views and readers keep the old  
+/// contents. Completion callback is invoked from FileSystem::Update, after   
+/// the file is refreshed                                                     
+///   @param input - the bytes to write - must remain unchanged until done    
+///   @param append - false if you want to delete and create the file anew    
+///   @param onComplete - invoked when done, check the request for errors     
+void File::WriteAsync(
+   const Many& input, bool append,
+   AsyncIO::Request::Callback&& onComplete
+) const {
+   Validate();
+   LANGULUS_ASSERT(
+      not Exists() or not IsReadOnly(), FileSystem,
+      "Can't open read-only `", GetFilePath(), "` for writing/appending"
+   );
+
+   AsyncIO::Request request;
+   request.mKind = append
+      ? AsyncIO::Request::Append
+      : AsyncIO::Request::Write;
+   {
+      const auto lock = GetProducer()->LockReferences();
+      request.mFile = const_cast<File*>(this);
+   }
+   request.mData = input;
+   request.mStats = &GetProducer()->GetIOStats();
+   request.mCounters = &mIOCounters;
+   request.mOnComplete = [this, callback = std::move(onComplete)]
+   (AsyncIO::Request& done) {
+      // Cached info, idle handles, blocks and the mapping are now stale
+      const_cast<File*>(this)->Refresh();
+      if (callback)
+         callback(done);
+   };
+   GetProducer()->GetAsyncIO().Submit(std::move(request));
+}
+
 /// Get a file interface with filename, relative to this file                 
 ///   @param filename - path relative to this file's path                     
 ///   @return the file interface                                              
 auto File::RelativeFile(const Path& filename) const -> Ref<A::File> {
-   return GetProducer()->GetFile(Path {mParentDirectory} / filename);
+   const auto producer = GetProducer();
+   return producer->GetFile(
+      producer->Intern(mParentDirectory, AsToken(filename)));
 }
 
 /// Get a subfolder interface with filename, relative to this file            
 ///   @param dirname - path relative to this file's path                      
 ///   @return the folder interface                                            
 auto File::RelativeFolder(const Path& dirname) const -> Ref<A::Folder> {
-   return GetProducer()->GetFolder(Path {mParentDirectory} / dirname);
+   const auto producer = GetProducer();
+   return producer->GetFolder(
+      producer->Intern(mParentDirectory, AsToken(dirname)));
 }
 
 /// Rewrite the file, by serializing the verb's arguments                     
@@ -163,32 +1001,186 @@ void File::Associate(Verb& verb) {
    if (verb.GetMass() <= 0)
       return;
 
-   TODO();
+   WriteAtomic(Serialize(verb.GetArgument()));
+   verb << mFilePath;
+}
+
+/// Turn data into the bytes, that the file should contain                    
+/// Bytes and text are written as they are, anything else is interpreted in   
+/// the file's format - as text for text formats, or as raw bytes             
+///   @param data - the data to serialize                                     
+///   @return a block of bytes or letters                                     
+Many File::Serialize(const Many& data) const {
+   if (data.template IsExact<Byte>())
+      return data;
+   if (data.template IsExact<Text>() and data.GetCount() == 1) {
+      Many letters = data.template As<Text>();
+      return letters;
+   }
+
+   const bool isText = mFormat and mFormat->template CastsTo<Text>();
+   Verbs::Interpret interpreter {
+      isText ? MetaDataOf<Text>() : MetaDataOf<Byte>()};
+   auto input = data;
+   Flow::DispatchFlat(input, interpreter);
+   LANGULUS_ASSERT(interpreter.IsDone(), FileSystem,
+      "Can't serialize ", data.GetType(), " for `", mFilePath, '`');
+
+   const auto& output = interpreter.GetOutput();
+   LANGULUS_ASSERT(output.template IsExact<Byte>()
+      or (output.template IsExact<Text>() and output.GetCount() == 1),
+      FileSystem, "Serializing ", data.GetType(), " for `", mFilePath,
+      "` produced ", output.GetType());
+   return Serialize(output);
+}
+
+/// Replace the file contents atomically - a crash never leaves a partially   
+/// written file behind. If group commit is enabled, the new contents become  
+/// visible only after the next FileSystem::Update, otherwise they're on      
+/// disk, when this returns                                                   
+///   @param contents - the new contents, a block of bytes or letters         
+void File::WriteAtomic(const Many& contents) {
+   Validate();
+   LANGULUS_ASSERT(
+      not Exists() or not IsReadOnly(), FileSystem,
+      "Can't rewrite read-only `", GetFilePath(), '`'
+   );
+
+   // Writes always go to the write directory, which is native          
+   const auto target = Native::ResolveWritePath(mFilePath.GetRaw());
+   LANGULUS_ASSERT(not target.empty(), FileSystem,
+      "Can't rewrite `", mFilePath, "` without a write directory");
+
+   auto& commits = GetProducer()->GetCommitQueue();
+   {
+      auto timer = Measure(IOStats::Write);
+      LANGULUS_ASSERT(commits.Write(
+         {mFilePath.GetRaw(), mFilePath.GetCount()}, target,
+         contents.GetRaw(), contents.GetBytesize()), FileSystem,
+         "Can't rewrite `", mFilePath, '`');
+      timer.SetBytes(contents.GetBytesize());
+   }
+
+   VERBOSE_VFS("Rewrites ", Size {contents.GetBytesize()}, " to `",
+      mFilePath, '`');
+   if (not commits.IsGroupCommit())
+      Refresh();
 }
 
 /// Append to the file, by serializing the verb's arguments                   
+/// Appends from any number of threads don't wait for each other, nor for     
+/// the disk - the offset of each record is produced right away, and the      
+/// record is written later, along with others, by the file's append log      
 ///   @param verb - the catenate verb                                         
 void File::Catenate(Verb& verb) {
    if (verb.GetMass() <= 0)
       return;
 
-   TODO();
+   verb << Append(Serialize(verb.GetArgument()));
+}
+
+/// Append a record to the file, through its append log                       
+///   @param record - a block of bytes or letters                             
+///   @return the logical offset of the record - the offset inside the file,  
+///           unless the log was rotated, see AppendLog::GetSegmentStart      
+Offset File::Append(const Many& record) const {
+   auto& log = GetAppendLog();
+   const auto offset = log.Append(
+      static_cast<const Byte*>(record.GetRaw()), record.GetBytesize());
+
+   const auto error = log.GetError();
+   LANGULUS_ASSERT(offset, FileSystem,
+      "Can't append to `", mFilePath, "`: ",
+      Token {error.data(), error.size()});
+   return *offset;
+}
+
+/// Get the append log of the file, starting it if not running yet            
+/// Use it to enable rotation, or to wait until appended records are written  
+///   @return the append log                                                  
+AppendLog& File::GetAppendLog() const {
+   // Once started, the log is reached without locking                  
+   if (const auto log = mAppendLogPublished.load(std::memory_order_acquire))
+      return *log;
+
+   std::scoped_lock lock {mAppendMutex};
+   if (mAppendLog)
+      return *mAppendLog;
+
+   LANGULUS_ASSERT(
+      not Exists() or not IsReadOnly(), FileSystem,
+      "Can't open read-only `", GetFilePath(), "` for appending"
+   );
+
+   // Idle read handles won't see what is appended, and the cached      
+   // size goes stale with each written batch                           
+   const auto producer = GetProducer();
+   const std::string_view path {mFilePath.GetRaw(), mFilePath.GetCount()};
+   producer->GetHandlePool().Forget(path);
+
+   auto log = std::make_unique<AppendLog>(
+      path, producer->GetHandlePool(), producer->GetIOStats(), &mIOCounters,
+      [producer, path = std::string {path}] {
+         producer->GetStatCache().Invalidate(path);
+      }
+   );
+
+   bool started;
+   {
+      const auto timer = Measure(IOStats::Open);
+      started = log->Start();
+   }
+
+   LANGULUS_ASSERT(started, FileSystem,
+      "Can't open `", mFilePath, "` for appending: ", GetLastError());
+   VERBOSE_VFS("Started append log for `", mFilePath, '`');
+   mAppendLog = std::move(log);
+   mAppendLogPublished.store(mAppendLog.get(), std::memory_order_release);
+   return *mAppendLog;
 }
 
 /// Seek a position inside the file, like the front/back/specific offset      
+/// Files have no shared cursor, so this produces a new reader, positioned    
+/// at the selected offset. An empty argument selects the front, IndexBack    
+/// or IndexLast select the back, where the file currently ends, and any      
+/// other argument is converted to a byte offset                              
 ///   @param verb - the select verb                                           
 void File::Select(Verb& verb) {
    if (verb.GetMass() <= 0)
       return;
 
-   TODO();
+   Offset offset = 0;
+   const auto& argument = verb.GetArgument();
+   if (argument.template Is<Index>()) {
+      const auto index = argument.template As<Index>();
+      if (index == IndexBack or index == IndexLast)
+         offset = mByteCount;
+      else
+         offset = argument.template AsCast<Offset>();
+   }
+   else if (argument)
+      offset = argument.template AsCast<Offset>();
+
+   auto reader = NewReader();
+   reader.template As<Reader>()->Seek(offset);
+   verb << reader;
 }
 
-/// Attempt to interpret the file contents at the current position as some    
-/// data type                                                                 
-///   @param verb - the interpret verb                                        
-void File::Interpret(Verb&) {
-   TODO();
+/// Interpret the file contents as some data types                            
+/// POD types are viewed without copying where possible - see ViewAs - and    
+/// are output as a File::View, which keeps the mapping alive for as long as  
+/// the output is. Any other type is deserialized - see ReadAs                
+///   @param verb - the interpret verb, with the types as argument            
+void File::Interpret(Verb& verb) {
+   if (verb.GetMass() <= 0)
+      return;
+
+   verb.GetArgument().ForEachDeep([&](DMeta type) {
+      if (type->mIsPOD and type->mSize)
+         verb << ViewAs(type);
+      else
+         verb << ReadAs(type);
+   });
 }
 
 
@@ -198,19 +1190,70 @@ void File::Interpret(Verb&) {
 ///                                                                           
 
 /// File reader constructor                                                   
+/// Readers can be made on any thread, so the file is referenced while the    
+/// lock from FileSystem::LockReferences is held - the lock is a temporary,   
+/// that lives until the base is constructed                                  
 ///   @param file - the file interface                                        
-File::Reader::Reader(File* file)
-   : A::File::Reader {file} {}
+///   @param handle - the handle to read from, or an empty lease to read      
+///                   through the block cache                                 
+///   @param source - where the file contents are                             
+///   @param buffering - read-ahead buffering options                         
+File::Reader::Reader(
+   File* file, HandlePool::Lease&& handle, SourceRef source,
+   const Buffering& buffering
+) : A::File::Reader {(file->GetProducer()->LockReferences(), file)}
+  , mHandle {std::move(handle)}
+  , mSource {std::move(source)}
+  , mBuffering {buffering} {
+   if (not mHandle and mBuffering.mDirect and mSource->IsNative())
+      OpenDirect();
+   else
+      SetBuffer(mBuffering.mSize);
+}
+
+/// File reader destructor, returns the handle to the pool                    
+File::Reader::~Reader() {
+   if (not mHandle.Close())
+      Logger::Error(Self(), "Error in PHYSFS_close: ", GetLastError());
+
+   // Dereference the file under the same lock it was referenced with   
+   const auto lock = mFile.As<::File>()->GetProducer()->LockReferences();
+   mFile.Reset();
+}
 
 /// Read bytes into a preallocated block                                      
 ///   @attention output might not be entirely filled, check return value      
 ///   @param output - [out] the read bytes go here                            
 ///   @return the true number of read bytes                                   
 Offset File::Reader::Read(Many& output) {
+   return Read(output.GetRaw(), output.GetBytesize());
+}
+
+/// Read bytes into a raw memory region                                       
+///   @attention region might not be entirely filled, check return value      
+///   @param output - [out] the read bytes go here                            
+///   @param size - size of the region in bytes                               
+///   @return the true number of read bytes                                   
+Offset File::Reader::Read(Byte* output, Offset size) {
    const auto file = mFile.As<::File>();
-   const auto count = PHYSFS_uint64(output.GetBytesize());
-   const auto result = PHYSFS_readBytes(file->mHandle, output.GetRaw(), count);
+   auto timer = file->Measure(IOStats::Read);
+   if (not mHandle) {
+      const auto r = mDirect
+         ? ReadDirect(mPosition, size, output)
+         : file->ReadCached(*mSource, mPosition, size, output);
+      timer.SetBytes(r);
+      file->Trace(mPosition, r);
+      mPosition += r;
+      mProgress += r;
+      return r;
+   }
+
+   const auto position = mPosition;
+   const auto count = PHYSFS_uint64(size);
+   const HandlePool::Pin handle {mHandle};
+   const auto result = PHYSFS_readBytes(handle, output, count);
    const auto r = static_cast<Offset>(result);
+   timer.SetBytes(result > 0 ? r : 0);
    VERBOSE_VFS("Reads ", Size {r}, " from `", mFile->GetFilePath(), '`');
 
    LANGULUS_ASSERT(-1 != result, FileSystem,
@@ -218,10 +1261,190 @@ Offset File::Reader::Read(Many& output) {
    //LANGULUS_ASSERT(r == count, FileSystem,
    //   "Error in PHYSFS_readBytes: ", GetLastError());
 
+   Adapt(position, r);
+   mPosition = position + r;
+   file->Trace(position, r);
    mProgress += r;
    return r;
 }
 
+/// Read bytes into multiple preallocated blocks, in order, as if they were   
+/// a single contiguous block, i.e. a header followed by several arrays       
+/// Native files are read with a single vectored read, the rest fall back to  
+/// a read per block                                                          
+///   @attention blocks might not be entirely filled, check return value      
+///   @param outputs - [out] the read bytes go here                           
+///   @return the total number of read bytes                                  
+Offset File::Reader::ReadV(std::span<Many> outputs) {
+   const auto file = mFile.As<::File>();
+   if (not mHandle or not mSource->IsNative()) {
+      Offset done = 0;
+      for (auto& output : outputs) {
+         const auto size = output.GetBytesize();
+         const auto r = Read(output);
+         done += r;
+         if (r < size)
+            break;
+      }
+      return done;
+   }
+
+   std::vector<Native::Slice> slices;
+   slices.reserve(outputs.size());
+   for (auto& output : outputs)
+      slices.push_back({output.GetRaw(), output.GetBytesize()});
+
+   // The handle's read-ahead is bypassed, so read from its logical     
+   // position, and move it past the read bytes afterwards              
+   auto timer = file->Measure(IOStats::Read);
+   const auto position = GetPosition();
+   const auto result = mSource->ReadNativeV(
+      HandlePool::Pin {mSource->mDescriptor}, position, slices);
+   LANGULUS_ASSERT(result >= 0, FileSystem,
+      "Error in vectored read from `", file->GetFilePath(), '`');
+
+   const auto r = static_cast<Offset>(result);
+   timer.SetBytes(r);
+   VERBOSE_VFS("Reads ", Size {r}, " from `", file->GetFilePath(), '`');
+   const HandlePool::Pin handle {mHandle};
+   LANGULUS_ASSERT(PHYSFS_seek(handle, PHYSFS_uint64(position + r)),
+      FileSystem, "Can't seek `", file->GetFilePath(), "` to ",
+      position + r, ": ", GetLastError());
+
+   Adapt(position, r);
+   mPosition = position + r;
+   file->Trace(position, r);
+   mProgress += r;
+   return r;
+}
+
+/// Open the native file for reading around the page cache                    
+/// Falls back to dropping what was read from the cache, where the file       
+/// system doesn't support direct I/O                                         
+void File::Reader::OpenDirect() {
+   const auto file = mFile.As<::File>();
+   mDirectBegin = mSource->mNativeOffset;
+   mDirectEnd = mSource->mNativeIsPack
+      ? mSource->mNativeOffset + mSource->mSize
+      : std::numeric_limits<Offset>::max();
+
+   {
+      const auto timer = file->Measure(IOStats::Open);
+      mDirect = file->GetProducer()->GetHandlePool().Open(
+         mSource->mNativePath, HandlePool::DirectRead);
+   }
+
+   LANGULUS_ASSERT(mDirect, FileSystem,
+      "Can't open `", file->GetFilePath(), "` for uncached reading");
+   mDirectBuffer.Allocate(std::max<Offset>(
+      mBuffering.mSize, Native::DirectAlignment));
+   VERBOSE_VFS("Reads `", file->GetFilePath(), "` uncached");
+}
+
+/// Read through the aligned buffer, bypassing the page cache                 
+///   @param offset - where to start reading from, relative to file start     
+///   @param size - number of bytes to read                                   
+///   @param output - [out] where to read bytes into                          
+///   @return the number of read bytes, less than size only on end of file    
+Offset File::Reader::ReadDirect(Offset offset, Offset size, Byte* output) {
+   const auto buffer = reinterpret_cast<Byte*>(mDirectBuffer.GetRaw());
+   const HandlePool::Pin pin {mDirect};
+   const auto& direct = pin.GetDescriptor();
+   const Offset align = direct.IsDirect() ? Native::DirectAlignment : 1;
+
+   Offset done = 0;
+   while (done < size) {
+      const auto at = mDirectBegin + offset + done;
+      if (at >= mDirectEnd)
+         break;
+
+      if (at < mDirectStart or at >= mDirectStart + mDirectFill) {
+         // What was read through the cache isn't needed anymore        
+         if (not direct.IsDirect() and mDirectFill)
+            direct.DontNeed(mDirectStart, mDirectFill);
+
+         mDirectStart = at / align * align;
+         mDirectFill = 0;
+         const auto r = direct.ReadAt(
+            buffer, mDirectBuffer.GetSize(), mDirectStart);
+         LANGULUS_ASSERT(r >= 0, FileSystem,
+            "Error in uncached read from `", mFile->GetFilePath(), '`');
+         mDirectFill = static_cast<Offset>(r);
+         if (at >= mDirectStart + mDirectFill)
+            break;
+      }
+
+      const auto count = std::min({size - done,
+         mDirectStart + mDirectFill - at, mDirectEnd - at});
+      std::memcpy(output + done, buffer + (at - mDirectStart), count);
+      done += count;
+   }
+   return done;
+}
+
+/// Change the read-ahead buffer size                                         
+///   @param size - the new buffer size in bytes, zero disables buffering     
+void File::Reader::SetBuffer(Offset size) {
+   if (size == mBufferSize or not mHandle)
+      return;
+
+   mHandle.SetBuffer(size);
+   mBufferSize = size;
+}
+
+/// Adapt the read-ahead to the way the file is being read, in adaptive mode  
+/// The buffer doubles each time twice its size is read sequentially, up to   
+/// the maximum size, and drops back to the initial size on random access,    
+/// which doesn't benefit from a big read-ahead                               
+///   @param offset - where the read started                                  
+///   @param size - number of bytes read                                      
+void File::Reader::Adapt(Offset offset, Offset size) {
+   if (not mBuffering.mAdaptive or not mBufferSize)
+      return;
+
+   if (offset != mNextRead) {
+      mSequentialBytes = 0;
+      SetBuffer(mBuffering.mSize);
+   }
+   else if (mBufferSize < mBuffering.mMaxSize) {
+      mSequentialBytes += size;
+      if (mSequentialBytes >= mBufferSize * 2) {
+         SetBuffer(std::min(mBufferSize * 2, mBuffering.mMaxSize));
+         mSequentialBytes = 0;
+      }
+   }
+
+   mNextRead = offset + size;
+}
+
+/// Move the reader's cursor                                                  
+/// The read-ahead adapts on the next read, so seeking to where the reader    
+/// already is doesn't count as random access                                 
+///   @param offset - the new position, in bytes from the start of the file   
+void File::Reader::Seek(Offset offset) {
+   if (mHandle) {
+      const HandlePool::Pin handle {mHandle};
+      LANGULUS_ASSERT(PHYSFS_seek(handle, PHYSFS_uint64(offset)), FileSystem,
+         "Can't seek `", mFile->GetFilePath(), "` to ", offset,
+         ": ", GetLastError());
+   }
+
+   mPosition = offset;
+}
+
+/// Get the reader's cursor                                                   
+///   @return the position, in bytes from the start of the file               
+Offset File::Reader::GetPosition() const {
+   if (not mHandle)
+      return mPosition;
+
+   const HandlePool::Pin handle {mHandle};
+   const auto position = PHYSFS_tell(handle);
+   LANGULUS_ASSERT(position >= 0, FileSystem,
+      "Error in PHYSFS_tell: ", GetLastError());
+   return static_cast<Offset>(position);
+}
+
 Text File::Reader::Self() const {
    return mFile ? mFile->Self() : "<invalid file reader>";
 }
@@ -233,19 +1456,81 @@ Text File::Reader::Self() const {
 ///                                                                           
 
 /// File writer constructor                                                   
+/// Writers reference the file under a lock, just like readers                
 ///   @param file - the file interface                                        
+///   @param handle - the handle to write to                                  
 ///   @param append - false if you want to delete and create the file anew    
-File::Writer::Writer(File* file, bool append)
-   : A::File::Writer {file, append} {}
+///   @param buffering - write-behind buffering options                       
+File::Writer::Writer(
+   File* file, HandlePool::Lease&& handle, bool append,
+   const Buffering& buffering
+) : A::File::Writer {(file->GetProducer()->LockReferences(), file), append}
+  , mHandle {std::move(handle)} {
+   if (not mHandle and buffering.mDirect)
+      OpenDirect(append, buffering);
+   else if (buffering.mSize) {
+      mHandle.SetBuffer(buffering.mSize);
+      mBufferSize = buffering.mSize;
+   }
+}
+
+/// File writer destructor, flushes and closes the handle                     
+File::Writer::~Writer() {
+   // Flushing pins the descriptor, which throws if it was closed by    
+   // the pool, and can't be reopened                                   
+   try {
+      if (mDirect and not FlushDirect())
+         Logger::Error(Self(), "Error in uncached write");
+   }
+   catch (...) {
+      Logger::Error(Self(), "Can't reopen for uncached write");
+   }
+
+   if (not mHandle.Close())
+      Logger::Error(Self(), "Error in PHYSFS_close: ", GetLastError());
+
+   // Cached info about the written file is now stale                   
+   const auto file = mFile.As<::File>();
+   file->GetProducer()->GetStatCache().Invalidate(file->GetFilePath().GetRaw());
+
+   const auto lock = file->GetProducer()->LockReferences();
+   mFile.Reset();
+}
 
 /// Write bytes to a preallocated block                                       
 ///   @param input - the written bytes come from here                         
 ///   @return the number of written bytes                                     
 Offset File::Writer::Write(const Many& input) {
-   const auto file = mFile.As<::File>();
+   auto timer = mFile.As<::File>()->Measure(IOStats::Write);
+   if (mDirect) {
+      // Coalesce in the aligned buffer, writing it whenever it's full  
+      const auto buffer = reinterpret_cast<Byte*>(mDirectBuffer.GetRaw());
+      const auto data = input.GetRaw();
+      const auto size = input.GetBytesize();
+      Offset done = 0;
+      while (done < size) {
+         const auto count = std::min(
+            size - done, mDirectBuffer.GetSize() - mDirectFill);
+         std::memcpy(buffer + mDirectFill, data + done, count);
+         mDirectFill += count;
+         done += count;
+
+         LANGULUS_ASSERT(mDirectFill < mDirectBuffer.GetSize()
+            or FlushDirect(), FileSystem,
+            "Error in uncached write to `", mFile->GetFilePath(), '`');
+      }
+
+      timer.SetBytes(size);
+      VERBOSE_VFS("Writes ", size, " to `", mFile->GetFilePath(), '`');
+      mProgress += size;
+      return size;
+   }
+
    const auto count = PHYSFS_uint64(input.GetBytesize());
+   const HandlePool::Pin handle {mHandle};
    const auto result = static_cast<Offset>(
-      PHYSFS_writeBytes(file->mHandle, input.GetRaw(), count));
+      PHYSFS_writeBytes(handle, input.GetRaw(), count));
+   timer.SetBytes(PHYSFS_uint64(result) == count ? result : 0);
 
    VERBOSE_VFS("Writes ", result, " to `", mFile->GetFilePath(), '`');
    LANGULUS_ASSERT(PHYSFS_uint64(result) == count, FileSystem,
@@ -256,6 +1541,163 @@ Offset File::Writer::Write(const Many& input) {
    return r;
 }
 
+/// Write multiple blocks, in order, as if they were a single contiguous      
+/// block, i.e. a header followed by several arrays                           
+/// Batches that fit in the write buffer are simply coalesced there. Bigger   
+/// ones are written to native files with a single vectored write, and one    
+/// block at a time otherwise                                                 
+///   @param inputs - the written bytes come from here                        
+///   @return the total number of written bytes                               
+Offset File::Writer::WriteV(std::span<const Many> inputs) {
+   Offset total = 0;
+   for (auto& input : inputs)
+      total += input.GetBytesize();
+
+   if (mDirect or total <= mBufferSize or not ResolveNative()) {
+      for (auto& input : inputs)
+         Write(input);
+      return total;
+   }
+
+   std::vector<Native::Slice> slices;
+   slices.reserve(inputs.size());
+   for (auto& input : inputs) {
+      // Slices are shared with reads, but writes never modify the data 
+      slices.push_back({
+         const_cast<Byte*>(input.GetRaw()), input.GetBytesize()});
+   }
+
+   // Write whatever is buffered first, so that bytes remain in order,  
+   // and write after it, moving the handle's cursor past the bytes     
+   auto timer = mFile.As<::File>()->Measure(IOStats::Write);
+   Flush();
+   const HandlePool::Pin handle {mHandle};
+   const HandlePool::Pin descriptor {mDescriptor};
+   const auto position = PHYSFS_tell(handle);
+   LANGULUS_ASSERT(position >= 0, FileSystem,
+      "Error in PHYSFS_tell: ", GetLastError());
+
+   const auto result = descriptor.GetDescriptor().WriteAtV(
+      slices.data(), slices.size(), PHYSFS_uint64(position));
+   VERBOSE_VFS("Writes ", total, " to `", mFile->GetFilePath(), '`');
+   timer.SetBytes(result > 0 ? static_cast<Offset>(result) : 0);
+   LANGULUS_ASSERT(result == static_cast<int64_t>(total), FileSystem,
+      "Error in vectored write to `", mFile->GetFilePath(), '`');
+   LANGULUS_ASSERT(PHYSFS_seek(handle, PHYSFS_uint64(position) + total),
+      FileSystem, "Can't seek `", mFile->GetFilePath(), "` to ",
+      PHYSFS_uint64(position) + total, ": ", GetLastError());
+
+   mProgress += total;
+   return total;
+}
+
+/// Open a native descriptor for vectored writes, the first time it's needed  
+/// Writes always go to the write directory, so that's where the file is      
+///   @return true if the native descriptor is available                      
+bool File::Writer::ResolveNative() {
+   if (not mNativeResolved) {
+      mNativeResolved = true;
+      const auto file = mFile.As<::File>();
+      const auto native = Native::ResolveWritePath(
+         file->GetFilePath().GetRaw());
+      if (not native.empty()) {
+         mDescriptor = file->GetProducer()->GetHandlePool().Open(
+            native, HandlePool::NativeWrite);
+      }
+   }
+
+   return static_cast<bool>(mDescriptor);
+}
+
+/// Open the native file for writing around the page cache                    
+/// Falls back to dropping what was written from the cache, where the file    
+/// system doesn't support direct I/O                                         
+///   @param append - false if you want to delete and create the file anew    
+///   @param buffering - the buffer size                                      
+void File::Writer::OpenDirect(bool append, const Buffering& buffering) {
+   const auto file = mFile.As<::File>();
+   const auto path = Native::ResolveWritePath(file->GetFilePath().GetRaw());
+   {
+      const auto timer = file->Measure(IOStats::Open);
+      mDirect = file->GetProducer()->GetHandlePool().Open(path,
+         append ? HandlePool::DirectUpdate : HandlePool::DirectWrite);
+   }
+
+   LANGULUS_ASSERT(mDirect, FileSystem,
+      "Can't open `", file->GetFilePath(), "` for uncached writing");
+   mDirectBuffer.Allocate(std::max<Offset>(
+      buffering.mSize, Native::DirectAlignment));
+   if (not append)
+      return;
+
+   const HandlePool::Pin pin {mDirect};
+   const auto& direct = pin.GetDescriptor();
+   const auto size = direct.GetSize();
+   LANGULUS_ASSERT(size >= 0, FileSystem,
+      "Can't get size of `", file->GetFilePath(), '`');
+
+   // Direct writes can't begin midway through a block, so the partial  
+   // block at the end is read, and written again along with new bytes  
+   const Offset end = static_cast<Offset>(size);
+   const Offset align = direct.IsDirect() ? Native::DirectAlignment : 1;
+   mDirectStart = end / align * align;
+   if (end > mDirectStart) {
+      const auto r = direct.ReadAt(
+         mDirectBuffer.GetRaw(), Native::DirectAlignment, mDirectStart);
+      LANGULUS_ASSERT(r == static_cast<int64_t>(end - mDirectStart),
+         FileSystem, "Can't read the end of `", file->GetFilePath(), '`');
+      mDirectFill = mDirectFlushed = end - mDirectStart;
+   }
+}
+
+/// Write the aligned buffer, that wasn't written yet                         
+/// A full buffer is emptied afterwards. A partial one is kept, because its   
+/// last block will be written again, when more bytes are appended. Direct    
+/// writes are padded to the alignment, and the file is truncated back        
+///   @return true on success                                                 
+bool File::Writer::FlushDirect() {
+   if (mDirectFlushed == mDirectFill)
+      return true;
+
+   const auto buffer = mDirectBuffer.GetRaw();
+   const HandlePool::Pin pin {mDirect};
+   const auto& direct = pin.GetDescriptor();
+   const Offset align = direct.IsDirect() ? Native::DirectAlignment : 1;
+   const auto from = mDirectFlushed / align * align;
+   const auto to = (mDirectFill + align - 1) / align * align;
+   std::memset(buffer + mDirectFill, 0, to - mDirectFill);
+
+   Native::Slice slice {buffer + from, to - from};
+   if (direct.WriteAtV(&slice, 1, mDirectStart + from)
+      != static_cast<int64_t>(to - from))
+      return false;
+   if (to != mDirectFill and not direct.Truncate(mDirectStart + mDirectFill))
+      return false;
+   mDirectFlushed = mDirectFill;
+
+   if (mDirectFill == mDirectBuffer.GetSize()) {
+      // What was written through the cache isn't needed anymore        
+      if (not direct.IsDirect())
+         direct.DontNeed(mDirectStart, mDirectFill);
+      mDirectStart += mDirectFill;
+      mDirectFill = mDirectFlushed = 0;
+   }
+   return true;
+}
+
+/// Write all coalesced bytes to the file                                     
+void File::Writer::Flush() {
+   if (mDirect) {
+      LANGULUS_ASSERT(FlushDirect(), FileSystem,
+         "Error in uncached write to `", mFile->GetFilePath(), '`');
+      return;
+   }
+
+   const HandlePool::Pin handle {mHandle};
+   LANGULUS_ASSERT(PHYSFS_flush(handle), FileSystem,
+      "Error in PHYSFS_flush: ", GetLastError());
+}
+
 Text File::Writer::Self() const {
    return mFile ? mFile->Self() : "<invalid file writer>";
 }
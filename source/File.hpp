@@ -7,12 +7,23 @@
 ///                                                                           
 #pragma once
 #include "Common.hpp"
+#include "Native.hpp"
+#include "AsyncIO.hpp"
+#include "HandlePool.hpp"
+#include "IOStats.hpp"
+#include "AppendLog.hpp"
 #include <Langulus/Flow/Producible.hpp>
 #include <Langulus/Verbs/Associate.hpp>
 #include <Langulus/Verbs/Catenate.hpp>
 #include <Langulus/Verbs/Select.hpp>
 #include <Langulus/Verbs/Interpret.hpp>
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <span>
+#include <string>
+#include <vector>
 
 
 ///                                                                           
@@ -30,16 +41,134 @@ struct File final : A::File, Flow::ProducedFrom<FileSystem> {
    );
 
 
+   ///                                                                        
+   /// Buffering options for file readers and writers                         
+   /// Readers are buffered by default, writers only when given options       
+   struct Buffering {
+      // Initial buffer size in bytes, zero disables buffering          
+      Offset mSize = 64 * 1024;
+      // Readers grow their buffer when reading sequentially            
+      bool mAdaptive = true;
+      // The maximum size an adaptive buffer can grow to                
+      Offset mMaxSize = 1024 * 1024;
+      // Bypass the page cache, for streams too big to be worth caching 
+      // Only native files are affected. The buffer is then managed by  
+      // the stream itself, with its size rounded up to the alignment   
+      bool mDirect = false;
+   };
+
+
+   ///                                                                        
+   /// Read-only view over the file contents, that keeps them alive           
+   /// Mapped contents are shared by all views, and unmapped only after the   
+   /// last of them is released, even if the file changes meanwhile           
+   struct View {
+   private:
+      friend struct File;
+      // The mapping, or nullptr if contents were copied instead        
+      std::shared_ptr<const Native::Mapping> mMapping;
+      // The contents - doesn't own mapped memory, so don't let it, or  
+      // any copy of it, outlive the view. Pass the view itself around  
+      // instead, i.e. as the output of Verbs::Interpret                
+      Many mData;
+
+   public:
+      auto GetData() const noexcept -> const Many& { return mData; }
+      bool IsMapped() const noexcept { return mMapping != nullptr; }
+   };
+
+   struct Reader;
+   struct Writer;
+
+protected:
+   friend struct Reader;
+   friend struct Writer;
+
+   ///                                                                        
+   /// Where the file contents are read from, looked up on first use          
+   /// Reads on any thread hold a reference to it, so refreshing the file     
+   /// only retires it - its descriptor is released after the last such read  
+   struct Source {
+      // Path on disk, if file resides in a native directory, or is     
+      // stored without compression inside a pack                       
+      std::string mNativePath;
+      // Where contents begin inside the native file - nonzero for packs
+      Offset mNativeOffset = 0;
+      // Packs continue after the file, so reads have to stop at its end
+      bool mNativeIsPack = false;
+      // Pooled descriptor for positional reads, if file is native      
+      // It is opened the first time it is pinned, and can be pinned by 
+      // multiple threads at once                                       
+      mutable HandlePool::Lease mDescriptor;
+      // Native path of the archive, if the file has to be decompressed 
+      std::string mArchive;
+      // Size of the file when it was looked up                         
+      Offset mSize = 0;
+
+      bool IsNative() const noexcept { return not mNativePath.empty(); }
+      bool IsArchived() const noexcept { return not mArchive.empty(); }
+
+      using Pin = HandlePool::Pin;
+      int64_t ReadNative(const Pin&, Offset, Offset, Byte*) const noexcept;
+      int64_t ReadNativeV(const Pin&, Offset, std::span<Native::Slice>)
+         const noexcept;
+   };
+
+   using SourceRef = std::shared_ptr<const Source>;
+
+public:
    ///                                                                        
    /// File reader stream                                                     
    struct Reader final : A::File::Reader {
    private:
+      // Each reader has its own handle, and thus its own cursor        
+      // Readers of archived files have no handle, and read through the 
+      // block cache instead. Handles are pooled, and might be closed   
+      // and reopened between calls                                     
+      mutable HandlePool::Lease mHandle;
+      // Where the file was when the reader was created - the reader    
+      // keeps reading from there, even if the file is refreshed        
+      SourceRef mSource;
+      // Cursor, also kept when there's a handle, to tell sequential    
+      // reads from random ones                                         
+      Offset mPosition = 0;
+      // Buffering options the reader was created with                  
+      Buffering mBuffering;
+      // Current size of the read-ahead buffer                          
+      Offset mBufferSize = 0;
+      // Where the previous read ended - a read starting anywhere else  
+      // is random access                                               
+      Offset mNextRead = 0;
+      // Bytes read sequentially since the buffer last changed size     
+      Offset mSequentialBytes = 0;
+
+      // Descriptor and aligned buffer, when reading without caching    
+      HandlePool::Lease mDirect;
+      Native::AlignedBuffer mDirectBuffer;
+      // Where the buffered bytes start inside the native file          
+      Offset mDirectStart = 0;
+      // Number of valid bytes in the buffer                            
+      Offset mDirectFill = 0;
+      // Where the file begins and ends inside the native file          
+      Offset mDirectBegin = 0;
+      Offset mDirectEnd = 0;
+
       Text Self() const;
+      void SetBuffer(Offset);
+      void Adapt(Offset, Offset);
+      void OpenDirect();
+      Offset ReadDirect(Offset, Offset, Byte*);
 
    public:
-      Reader(File*);
+      Reader(File*, HandlePool::Lease&&, SourceRef, const Buffering&);
+     ~Reader();
 
       Offset Read(Many&);
+      Offset Read(Byte*, Offset);
+      Offset ReadV(std::span<Many>);
+      void Seek(Offset);
+      Offset GetPosition() const;
+      Offset GetBufferSize() const noexcept { return mBufferSize; }
    };
 
 
@@ -47,28 +176,84 @@ struct File final : A::File, Flow::ProducedFrom<FileSystem> {
    /// File writer stream                                                     
    struct Writer final : A::File::Writer {
    private:
+      // Pooled file handle                                             
+      HandlePool::Lease mHandle;
+      // Size of the handle's write buffer                              
+      Offset mBufferSize = 0;
+      // Native descriptor for vectored writes, if file is native       
+      HandlePool::Lease mDescriptor;
+      bool mNativeResolved = false;
+
+      // Descriptor and aligned buffer, when writing without caching    
+      HandlePool::Lease mDirect;
+      Native::AlignedBuffer mDirectBuffer;
+      // Where the buffered bytes go inside the native file             
+      Offset mDirectStart = 0;
+      // Number of valid bytes in the buffer                            
+      Offset mDirectFill = 0;
+      // Number of bytes in the buffer, that are already written        
+      Offset mDirectFlushed = 0;
+
       Text Self() const;
+      bool ResolveNative();
+      void OpenDirect(bool append, const Buffering&);
+      bool FlushDirect();
 
    public:
-      Writer(File*, bool append);
+      Writer(File*, HandlePool::Lease&&, bool append, const Buffering&);
+     ~Writer();
 
       Offset Write(const Many&);
+      Offset WriteV(std::span<const Many>);
+      void Flush();
    };
 
 protected:
-   friend struct Reader;
-   friend struct Writer;
-
    // Information about the file, if file exists                        
    PHYSFS_Stat mFileInfo {};
-   // Opened file handle                                                
-   mutable Own<PHYSFS_File*> mHandle;
+   // Guards the lazy initialization of the native resources below      
+   mutable std::mutex mNativeMutex;
+   // Where contents are read from, null until first needed             
+   mutable SourceRef mSource;
+   // Whether the file is registered for change notifications           
+   mutable bool mWatched = false;
+   // Mount generation the info was last refreshed for                  
+   mutable std::atomic<uint64_t> mMountGeneration = 0;
+   // Memory mapping, if file resides in a native directory - shared    
+   // with all views over it                                            
+   mutable std::shared_ptr<const Native::Mapping> mMapping;
+   // Mappings replaced since, that might still be viewed               
+   mutable std::vector<std::weak_ptr<const Native::Mapping>>
+      mRetiredMappings;
+   // Operations made on this file, counted along with module-wide ones 
+   mutable IOStats::Counters mIOCounters;
+   // Multi-producer append log, started on first Catenate              
+   mutable std::mutex mAppendMutex;
+   mutable std::unique_ptr<AppendLog> mAppendLog;
+   // The log, published once started, so appends don't have to lock    
+   mutable std::atomic<AppendLog*> mAppendLogPublished {};
+
+   auto ResolveSource() const -> const Source&;
+   auto GetSource() const -> SourceRef;
+   void Watch(const std::string& native) const;
+   Offset ReadCached(const Source&, Offset, Offset, Byte*) const;
+   bool IsTraced() const noexcept;
+   void Trace(Offset, Offset) const;
+   auto Measure(IOStats::Operation) const noexcept -> IOStats::Timer;
+   PHYSFS_File* OpenRead() const;
+
+   Many ReadBytes() const;
+   auto MapContents() const -> std::shared_ptr<const Native::Mapping>;
+   void RetireMapping() const;
+   void DetachViews() const;
+   void ReadInto(Many&) const;
+   Many Serialize(const Many&) const;
 
 public:
    File(FileSystem*, const Many&);
-  ~File();
 
-   void Refresh() {}
+   void Refresh();
+   void Validate() const;
    void Teardown();
 
    void Associate(Verb&);
@@ -77,9 +262,25 @@ public:
    void Interpret(Verb&);
 
    Many ReadAs(DMeta) const;
+   View NewMappedView() const;
+   View ViewAs(DMeta) const;
+   Offset ReadRange(Offset, Offset, Many&) const;
+   Offset ReadParallel(Many&, Count threads = 0) const;
+   void WriteAtomic(const Many&);
+   Offset Append(const Many&) const;
+   AppendLog& GetAppendLog() const;
+   void Prefetch(Offset, Offset) const;
+   auto GetIOStats() const noexcept
+      -> std::array<IOStats::Totals, IOStats::OperationCount>;
 
    auto NewReader()                 const -> Ref<A::File::Reader>;
+   auto NewReader(const Buffering&) const -> Ref<A::File::Reader>;
    auto NewWriter(bool append)      const -> Ref<A::File::Writer>;
+   auto NewWriter(bool append, const Buffering&) const
+      -> Ref<A::File::Writer>;
+
+   void ReadAsync(Offset, const Many&, AsyncIO::Request::Callback&&) const;
+   void WriteAsync(const Many&, bool, AsyncIO::Request::Callback&&) const;
 
    auto RelativeFile(const Path&)   const -> Ref<A::File>;
    auto RelativeFolder(const Path&) const -> Ref<A::Folder>;
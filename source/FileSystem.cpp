@@ -6,6 +6,8 @@
 /// SPDX-License-Identifier: GPL-3.0-or-later                                 
 ///                                                                           
 #include "FileSystem.hpp"
+#include "Pack.hpp"
+#include <algorithm>
 
 LANGULUS_DEFINE_MODULE(
    FileSystem, 9, "FileSystem",
@@ -19,7 +21,8 @@ LANGULUS_DEFINE_MODULE(
 ///   @param descriptor - instructions for configuring the module             
 FileSystem::FileSystem(Runtime* runtime, const Many&)
    : Resolvable {this}
-   , Module     {runtime} {
+   , Module     {runtime}
+   , mStatCache {mMounts} {
    VERBOSE_VFS("Initializing...");
 
    // Initialize the virtual file system                                
@@ -29,6 +32,13 @@ FileSystem::FileSystem(Runtime* runtime, const Many&)
    }
    VERBOSE_VFS("PhysFS initialized");
 
+   // Make .lpk packs mountable, in addition to the built-in archives   
+   if (not Pack::Register()) {
+      Logger::Warning(Self(),
+         "Can't register .lpk pack support due to PhysFS error: ",
+         GetLastError());
+   }
+
    // Get the working and data directories                              
    // This is the only place where full paths are used                  
    //TODO erase working path after mounting, if LANGULUS(PARANOID)
@@ -38,7 +48,7 @@ FileSystem::FileSystem(Runtime* runtime, const Many&)
 
    // Mount main read/write path                                        
    const auto dataio = (mWorkingPath / mMainDataPath).Terminate();
-   if (0 == PHYSFS_mount(dataio.GetRaw(), nullptr, 0)) {
+   if (not mMounts.Mount(AsToken(dataio), {}, 0)) {
       Logger::Error(Self(),
          "Can't mount main data directory `", dataio,
          "` due to PHYSFS_mount error: ", GetLastError());
@@ -71,12 +81,24 @@ FileSystem::FileSystem(Runtime* runtime, const Many&)
       );
       ++supported;
    }
+
+   // Start the asynchronous I/O workers                                
+   mAsyncIO.Start();
+
+   // Start watching for changes on disk                                
+   if (not mWatcher.Start())
+      VERBOSE_VFS("Watching for file changes is not supported");
    VERBOSE_VFS("Initialized");
 }
 
 /// Shutdown file system                                                      
 FileSystem::~FileSystem() {
    VERBOSE_VFS("Destroying...");
+   CommitWrites();
+   // Workers use PhysFS handles, so they must stop before deinit       
+   mAsyncIO.Shutdown();
+   mHandles.DropIdle();
+
    // Shut PhysFS down                                                  
    if (0 == PHYSFS_deinit()) {
       Logger::Error(Self(),
@@ -91,8 +113,15 @@ FileSystem::~FileSystem() {
 /// Create/Destroy file and folder interfaces                                 
 ///   @param verb - the creation/destruction verb                             
 void FileSystem::Teardown() {
-   mFolderMap.Reset();
-   mFileMap.Reset();
+   // Pending requests reference files, so drop them first              
+   mPrefetcher.Stop();
+   mAsyncIO.Shutdown();
+   CommitWrites();
+   mWatcher.Stop();
+   mStatCache.Clear();
+
+   std::scoped_lock lock {mFactoryMutex};
+   mPaths.Reset();
    mWorkingPath.Reset();
    mMainDataPath.Reset();
    mFiles.Teardown();
@@ -102,17 +131,27 @@ void FileSystem::Teardown() {
    // stored in files will become unclosable                            
    mFolders.Reset();
    mFiles.Reset();
+   mHandles.DropIdle();
 }
 
 /// Module update routine                                                     
+/// Invokes the callbacks of all completed asynchronous requests, commits     
+/// grouped atomic rewrites, and refreshes the files and folders that         
+/// changed on disk. Reads in progress, including prefetches, keep reading    
+/// from where the file was before it got refreshed                           
 ///   @param dt - time from last update                                       
 bool FileSystem::Update(Time) {
+   mAsyncIO.Dispatch();
+   if (not mCommits.IsEmpty())
+      CommitWrites();
+   mWatcher.Poll();
    return true;
 }
 
 /// Create/Destroy file and folder interfaces                                 
 ///   @param verb - the creation/destruction verb                             
 void FileSystem::Create(Verb& verb) {
+   std::scoped_lock lock {mFactoryMutex};
    mFiles.Create(this, verb);
    mFolders.Create(this, verb);
 }
@@ -120,60 +159,404 @@ void FileSystem::Create(Verb& verb) {
 /// Select file and folder interfaces                                         
 ///   @param verb - the selection verb                                        
 void FileSystem::Select(Verb& verb) {
+   std::scoped_lock lock {mFactoryMutex};
    mFiles.Select(verb);
    mFolders.Select(verb);
 }
 
 /// Interface a file                                                          
 /// This doesn't open the file, nor ensures the file exists - it only creates 
-/// an object, that can do those things                                       
+/// an object, that can do those things. Can be called from any thread        
 ///   @param path - the filename to interface                                 
 ///   @return the file interface or nullptr on failure                        
 auto FileSystem::GetFile(const Path& path) -> Ref<A::File> {
    if (not path)
       return {};
+   return GetFile(Intern(AsToken(path)));
+}
+
+/// Interface a file, using an interned path                                  
+/// Doesn't lock or allocate anything, if file is already interfaced. The     
+/// path index holds a reference to the interface until teardown, so the      
+/// returned one is disowned, and never touches the reference count, which    
+/// isn't atomic                                                              
+///   @param handle - the interned path handle                                
+///   @return the file interface or nullptr on failure                        
+auto FileSystem::GetFile(PathIndex::Handle handle) -> Ref<A::File> {
+   return Ref<A::File> {Disown(InterfaceFile(handle))};
+}
+
+/// Interface a file from any thread                                          
+///   @param path - the filename to interface                                 
+///   @return the file interface, valid until teardown, or nullptr on failure 
+auto FileSystem::InterfaceFile(const Path& path) -> A::File* {
+   if (not path)
+      return nullptr;
+   return InterfaceFile(Intern(AsToken(path)));
+}
+
+/// Interface a file, using an interned path                                  
+/// Thread-safe - if file is already interfaced, this doesn't lock or         
+/// allocate anything                                                         
+///   @param handle - the interned path handle                                
+///   @return the file interface, valid until teardown, or nullptr on failure 
+auto FileSystem::InterfaceFile(PathIndex::Handle handle) -> A::File* {
+   if (not handle)
+      return nullptr;
+   if (mAccessTrace.IsRecording())
+      mAccessTrace.Record(mPaths.Get(handle).mPath, 0, 0);
 
    // Check if file is already interfaced                               
-   const auto normalizedPath = path.Lowercase();
-   auto found = mFileMap.FindIt(normalizedPath);
-   if (found)
-      return found.GetValue();
+   auto& entry = mPaths.Get(handle);
+   if (const auto found = entry.mFile.load(std::memory_order_acquire)) {
+      static_cast<File*>(found)->Validate();
+      return found;
+   }
+
+   std::scoped_lock lock {mFactoryMutex};
+   if (const auto found = entry.mFile.load(std::memory_order_relaxed))
+      return found;
 
    // Produce a new file interface                                      
-   Verbs::Create creator {Construct::From<File>(normalizedPath)};
+   Verbs::Create creator {Construct::From<File>(Path {Token {entry.mPath}})};
    mFiles.Create(this, creator);
-   if (creator.IsDone()) {
-      auto filePtr = creator->template As<A::File*>();
-      mFileMap.Insert(normalizedPath, filePtr);
-      return filePtr;
-   }
+   if (not creator.IsDone())
+      return nullptr;
 
-   return {};
+   const auto filePtr = creator->template As<A::File*>();
+   entry.mFileRef = filePtr;
+   entry.mFile.store(filePtr, std::memory_order_release);
+   return filePtr;
 }
 
 /// Interface a folder                                                        
 /// This doesn't open the folder, nor ensures the file exists - it only       
-/// creates an object, that can do those things                               
+/// creates an object, that can do those things. Can be called from any       
+/// thread                                                                    
 ///   @param path - the directory path to interface                           
 ///   @return the file interface or nullptr on failure                        
 auto FileSystem::GetFolder(const Path& path) -> Ref<A::Folder> {
    if (not path)
       return {};
+   return GetFolder(Intern(AsToken(path)));
+}
+
+/// Interface a folder, using an interned path                                
+/// Doesn't lock or allocate anything, if folder is already interfaced. The   
+/// returned reference is disowned, like the one from GetFile                 
+///   @param handle - the interned path handle                                
+///   @return the folder interface or nullptr on failure                      
+auto FileSystem::GetFolder(PathIndex::Handle handle) -> Ref<A::Folder> {
+   return Ref<A::Folder> {Disown(InterfaceFolder(handle))};
+}
+
+/// Interface a folder from any thread                                        
+///   @param path - the directory path to interface                           
+///   @return the folder interface, valid until teardown, or nullptr          
+auto FileSystem::InterfaceFolder(const Path& path) -> A::Folder* {
+   if (not path)
+      return nullptr;
+   return InterfaceFolder(Intern(AsToken(path)));
+}
+
+/// Interface a folder, using an interned path                                
+/// Thread-safe - if folder is already interfaced, this doesn't lock or       
+/// allocate anything                                                         
+///   @param handle - the interned path handle                                
+///   @return the folder interface, valid until teardown, or nullptr          
+auto FileSystem::InterfaceFolder(PathIndex::Handle handle) -> A::Folder* {
+   if (not handle)
+      return nullptr;
 
    // Check if folder is already interfaced                             
-   const auto normalizedPath = path.Lowercase();
-   auto found = mFolderMap.FindIt(normalizedPath);
-   if (found)
-      return found.GetValue();
+   auto& entry = mPaths.Get(handle);
+   if (const auto found = entry.mFolder.load(std::memory_order_acquire)) {
+      static_cast<Folder*>(found)->Validate();
+      return found;
+   }
+
+   std::scoped_lock lock {mFactoryMutex};
+   if (const auto found = entry.mFolder.load(std::memory_order_relaxed))
+      return found;
 
    // Produce a new folder interface                                    
-   Verbs::Create creator {Construct::From<Folder>(normalizedPath)};
+   Verbs::Create creator {Construct::From<Folder>(Path {Token {entry.mPath}})};
    mFolders.Create(this, creator);
-   if (creator.IsDone()) {
-      auto folderPtr = creator->template As<A::Folder*>();
-      mFolderMap.Insert(normalizedPath, folderPtr);
-      return folderPtr;
+   if (not creator.IsDone())
+      return nullptr;
+
+   const auto folderPtr = creator->template As<A::Folder*>();
+   entry.mFolderRef = folderPtr;
+   entry.mFolder.store(folderPtr, std::memory_order_release);
+   return folderPtr;
+}
+
+/// Mount a directory or an archive in the virtual file system                
+/// Archives are indexed once, so that looking paths up doesn't depend on     
+/// the number of mounted archives. The main data directory is mounted with   
+/// zero priority, so packs with equal priority override it.                  
+///   Mounting anywhere but at either end of the search order temporarily     
+/// unmounts other sources, so all handles that aren't in use are closed      
+/// first - readers and writers reopen them where they left off. Reads and    
+/// writes in progress on other threads keep their handles open, and make     
+/// the mount fail, if they are inside a source that has to be unmounted      
+///   @param native - the native path to the directory or archive             
+///   @param mountPoint - where to mount it, root if empty                    
+///   @param priority - sources with higher priority are searched first,      
+///                     latest mount wins among sources with equal priority   
+///   @return true on success                                                 
+bool FileSystem::Mount(
+   const Path& native, const Path& mountPoint, int priority
+) {
+   mPrefetcher.Stop();
+   mHandles.Suspend();
+   const auto generation = mMounts.GetGeneration();
+   if (not mMounts.Mount(AsToken(native), AsToken(mountPoint), priority)) {
+      Logger::Error(Self(), "Can't mount `", native,
+         "` due to PHYSFS_mount error: ", GetLastError());
+
+      // Sources that couldn't be mounted back, after being detached    
+      // to make room for this one, are gone, as is this source, if it  
+      // was mounted before                                             
+      if (generation != mMounts.GetGeneration()) {
+         Logger::Error(Self(), "Mounted sources changed while failing "
+            "to mount `", native, '`');
+         InvalidateAll();
+      }
+      return false;
+   }
+
+   VERBOSE_VFS("Mounted `", native, "` at `/", mountPoint,
+      "` with priority ", priority);
+   InvalidateAll();
+   return true;
+}
+
+/// Unmount a directory or an archive from the virtual file system            
+/// Handles that aren't in use are closed first, like when mounting           
+///   @param native - the native path, as it was mounted                      
+///   @return true on success, fails if files inside are being read or        
+///           written on other threads                                        
+bool FileSystem::Unmount(const Path& native) {
+   mPrefetcher.Stop();
+
+   // Open handles inside the archive would prevent unmounting          
+   mHandles.Suspend();
+   if (not mMounts.Unmount(AsToken(native))) {
+      Logger::Error(Self(), "Can't unmount `", native,
+         "` due to PHYSFS_unmount error: ", GetLastError());
+      return false;
+   }
+
+   VERBOSE_VFS("Unmounted `", native, '`');
+   InvalidateAll();
+   return true;
+}
+
+/// Any path might change its meaning after mounts change, so drop all        
+/// cached info and contents. Interfaced files and folders see that the mount 
+/// generation changed, and refresh themselves on their next use              
+void FileSystem::InvalidateAll() {
+   mStatCache.Clear();
+   mBlockCache.Clear();
+   mHandles.DropIdle();
+   mGeneration.fetch_add(1, std::memory_order_release);
+}
+
+/// Get a number that changes whenever mounts change, after all cached info   
+/// is dropped, so that interfaces refresh only from the new mounts           
+///   @return the generation                                                  
+auto FileSystem::GetGeneration() const noexcept -> uint64_t {
+   return mGeneration.load(std::memory_order_acquire);
+}
+
+/// Commit all grouped atomic rewrites with a shared sync barrier, and        
+/// refresh the interfaced files, that were replaced                          
+void FileSystem::CommitWrites() {
+   mCommits.Commit([this](std::string_view path, bool committed) {
+      const Token token {path.data(), path.size()};
+      if (not committed) {
+         Logger::Error(Self(), "Can't commit rewrite of `", token, '`');
+         return;
+      }
+
+      VERBOSE_VFS("Committed rewrite of `", token, '`');
+      const auto handle = mPaths.Find({path});
+      const auto file = handle ? static_cast<File*>(
+         mPaths.Get(handle).mFile.load(std::memory_order_acquire)) : nullptr;
+      if (file)
+         file->Refresh();
+      else
+         mStatCache.Invalidate(path);
+   });
+}
+
+/// Start recording which files are opened and read, and in what order        
+/// Anything recorded before is forgotten                                     
+void FileSystem::StartTrace() {
+   mAccessTrace.Start();
+   VERBOSE_VFS("Started recording file accesses");
+}
+
+/// Stop recording file accesses, and save them as a manifest for Replay      
+///   @param manifest - virtual path of the manifest, inside the write dir    
+///   @return true on success                                                 
+bool FileSystem::SaveTrace(const Path& manifest) {
+   mAccessTrace.Stop();
+   const auto text = AccessTrace::Serialize(mAccessTrace.GetAccesses());
+   const auto path = manifest.Terminate();
+
+   ScopedHandle handle = PHYSFS_openWrite(path.GetRaw());
+   if (not handle) {
+      Logger::Error(Self(), "Can't save access trace to `", manifest,
+         "` due to PHYSFS_openWrite error: ", GetLastError());
+      return false;
+   }
+
+   const auto written = PHYSFS_writeBytes(
+      handle, text.data(), PHYSFS_uint64(text.size()));
+   mStatCache.Invalidate(AsToken(path));
+   if (written != PHYSFS_sint64(text.size())) {
+      Logger::Error(Self(), "Can't save access trace to `", manifest,
+         "` due to PHYSFS_writeBytes error: ", GetLastError());
+      return false;
+   }
+
+   VERBOSE_VFS("Saved access trace to `", manifest, '`');
+   return true;
+}
+
+/// Prefetch everything a saved manifest says, in the background and in the   
+/// same order, so that files are already cached by the time they're read     
+/// Files are interfaced right away, on the calling thread. Replaying again   
+/// cancels the previous replay                                               
+///   @param manifest - virtual path of the manifest                          
+///   @param workers - number of prefetch threads, zero to pick automatically 
+///   @return true if manifest was loaded, and prefetching started            
+bool FileSystem::Replay(const Path& manifest, Count workers) {
+   const auto path = manifest.Terminate();
+   std::string text;
+   {
+      ScopedHandle handle = PHYSFS_openRead(path.GetRaw());
+      if (not handle) {
+         Logger::Error(Self(), "Can't replay `", manifest,
+            "` due to PHYSFS_openRead error: ", GetLastError());
+         return false;
+      }
+
+      const auto size = PHYSFS_fileLength(handle);
+      text.resize(size > 0 ? static_cast<size_t>(size) : 0);
+      if (PHYSFS_readBytes(handle, text.data(), PHYSFS_uint64(text.size()))
+      != PHYSFS_sint64(text.size())) {
+         Logger::Error(Self(), "Can't replay `", manifest,
+            "` due to PHYSFS_readBytes error: ", GetLastError());
+         return false;
+      }
    }
 
-   return {};
+   std::vector<AccessTrace::Access> accesses;
+   if (not AccessTrace::Parse(text, accesses)) {
+      Logger::Error(Self(), "Can't replay malformed manifest `", manifest, '`');
+      return false;
+   }
+
+   // Files that were only opened are warmed up by interfacing them     
+   std::vector<Prefetcher::Job> jobs;
+   jobs.reserve(accesses.size());
+   for (auto& access : accesses) {
+      const Token name {access.mPath.data(), access.mPath.size()};
+      const auto file = static_cast<const File*>(InterfaceFile(Intern(name)));
+      if (file and file->Exists() and access.mSize)
+         jobs.push_back({file, access.mOffset, access.mSize});
+   }
+
+   VERBOSE_VFS("Replaying ", jobs.size(), " accesses from `", manifest, '`');
+   mPrefetcher.Start(std::move(jobs), workers);
+   return true;
+}
+
+/// Find the interfaced files, that spent the most time in I/O so far,        
+/// i.e. the ones most likely causing stalls                                  
+///   @param count - maximum number of files to return                        
+///   @return the files, starting with the slowest one                        
+auto FileSystem::GetSlowestFiles(Count count) -> TMany<const File*> {
+   std::vector<std::pair<uint64_t, const File*>> files;
+   mPaths.ForEach([&](const PathIndex::Entry& entry) {
+      const auto file = static_cast<const File*>(
+         entry.mFile.load(std::memory_order_acquire));
+      if (not file)
+         return;
+
+      uint64_t time = 0;
+      for (auto& totals : file->GetIOStats())
+         time += totals.mTime;
+      if (time)
+         files.emplace_back(time, file);
+   });
+
+   count = std::min<Count>(count, files.size());
+   std::partial_sort(files.begin(), files.begin() + count, files.end(),
+      [](auto& lhs, auto& rhs) { return lhs.first > rhs.first; });
+
+   TMany<const File*> result;
+   result.Reserve(count);
+   for (Count i = 0; i < count; ++i)
+      result << files[i].second;
+   return result;
+}
+
+/// Log the module-wide I/O statistics, followed by the files that spent the  
+/// most time in I/O. Available in all builds, unlike VERBOSE_VFS             
+///   @param files - number of slowest files to log                           
+void FileSystem::LogIOStats(Count files) {
+   static constexpr const char* Names[IOStats::OperationCount] {
+      "Stat", "Open", "Read", "Write"
+   };
+
+   const auto snapshot = mIOStats.GetSnapshot();
+   const auto tab = Logger::InfoTab(Self(), "I/O statistics:");
+   for (unsigned i = 0; i < IOStats::OperationCount; ++i) {
+      const auto& totals = snapshot.mTotals[i];
+      const auto& latency = snapshot.mLatency[i];
+      Logger::Line(Names[i], ": ", totals.mCount, " times, ",
+         Size {totals.mBytes}, ", ", totals.mTime / 1000, "us total, p50 < ",
+         latency.Percentile(0.5) / 1000, "us, p99 < ",
+         latency.Percentile(0.99) / 1000, "us, max ",
+         totals.mMaxTime / 1000, "us");
+   }
+
+   for (auto file : GetSlowestFiles(files)) {
+      const auto totals = file->GetIOStats();
+      uint64_t time = 0;
+      uint64_t max = 0;
+      for (auto& operation : totals) {
+         time += operation.mTime;
+         max = std::max(max, operation.mMaxTime);
+      }
+
+      Logger::Line(file->GetFilePath(), ": ", time / 1000, "us total, ",
+         max / 1000, "us max, ", totals[IOStats::Read].mCount, " reads of ",
+         Size {totals[IOStats::Read].mBytes}, ", ",
+         totals[IOStats::Write].mCount, " writes of ",
+         Size {totals[IOStats::Write].mBytes});
+   }
+}
+
+/// Normalize, hash and intern a path, so that it can be looked up quickly    
+/// Nothing is allocated, if path is already interned                         
+///   @param base - the base path, i.e. a directory                           
+///   @param relative - path relative to the base, if any                     
+///   @return the handle, invalid if path is empty                            
+auto FileSystem::Intern(Token base, Token relative) -> PathIndex::Handle {
+   return mPaths.Intern({base, relative});
+}
+
+/// Lock changes to reference counts of interfaces                            
+/// Counts aren't atomic, so readers, writers and asynchronous requests,      
+/// which can be made and released on any thread, reference their file only   
+/// while holding this lock. References from GetFile and GetFolder don't      
+/// need it, because they are disowned                                        
+///   @return the lock                                                        
+auto FileSystem::LockReferences() -> std::unique_lock<std::mutex> {
+   return std::unique_lock {mReferenceMutex};
 }
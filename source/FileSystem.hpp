@@ -8,8 +8,21 @@
 #pragma once
 #include "File.hpp"
 #include "Folder.hpp"
+#include "AsyncIO.hpp"
+#include "HandlePool.hpp"
+#include "Watcher.hpp"
+#include "MountTable.hpp"
+#include "StatCache.hpp"
+#include "BlockCache.hpp"
+#include "AccessTrace.hpp"
+#include "Prefetcher.hpp"
+#include "IOStats.hpp"
+#include "CommitQueue.hpp"
+#include "PathIndex.hpp"
 #include <Langulus/Flow/Factory.hpp>
 #include <Langulus/Verbs/Create.hpp>
+#include <atomic>
+#include <mutex>
 
 
 ///                                                                           
@@ -23,13 +36,44 @@ struct FileSystem final : A::FileSystem {
 private:
    // List of interfaced files                                          
    TFactoryUnique<File> mFiles;
-   // Files indexed by a lowercase relative path                        
-   TUnorderedMap<Path, Ref<A::File>> mFileMap;
-
    // List of interfaced folders                                        
    TFactoryUnique<Folder> mFolders;
-   // Folders indexed by a lowercase relative path                      
-   TUnorderedMap<Path, Ref<A::Folder>> mFolderMap;
+   // Interned normalized paths, along with their file/folder interfaces
+   // Lookups are lock-free, so that any thread can resolve paths       
+   PathIndex mPaths;
+   // Serializes the factories, when producing new interfaces           
+   std::recursive_mutex mFactoryMutex;
+   // Serializes reference count changes of interfaces, made by readers,
+   // writers and requests on any thread                                
+   std::mutex mReferenceMutex;
+
+   // Counters and latency histograms of all file operations            
+   IOStats mIOStats;
+   // Limits the number of handles open at once, shared by all readers  
+   // and writers                                                       
+   HandlePool mHandles;
+   // Asynchronous read/write engine                                    
+   AsyncIO mAsyncIO;
+   // Notifies interfaced files and folders about changes on disk       
+   Watcher mWatcher;
+   // Mounted directories and archives, along with an index of archives 
+   MountTable mMounts;
+   // Incremented after mounts change and caches are dropped, so that   
+   // interfaces can tell they're stale, and refresh on their next use  
+   std::atomic<uint64_t> mGeneration = 0;
+   // Cached file/folder info, shared by all interfaces                 
+   StatCache mStatCache;
+   // Decompressed contents of archived files, shared by all readers    
+   BlockCache mBlockCache;
+   // Records file accesses, to be replayed on the next launch          
+   AccessTrace mAccessTrace;
+   // Replays recorded accesses in the background                       
+   Prefetcher mPrefetcher;
+   // Atomic rewrites, waiting for a shared sync barrier                
+   CommitQueue mCommits;
+
+   void InvalidateAll();
+   void CommitWrites();
 
 public:
     FileSystem(Runtime*, const Many&);
@@ -42,5 +86,34 @@ public:
 
    auto GetFile  (const Path&) -> Ref<A::File>;
    auto GetFolder(const Path&) -> Ref<A::Folder>;
+   auto GetFile  (PathIndex::Handle) -> Ref<A::File>;
+   auto GetFolder(PathIndex::Handle) -> Ref<A::Folder>;
+   auto InterfaceFile  (const Path&) -> A::File*;
+   auto InterfaceFolder(const Path&) -> A::Folder*;
+   auto InterfaceFile  (PathIndex::Handle) -> A::File*;
+   auto InterfaceFolder(PathIndex::Handle) -> A::Folder*;
+
+   auto Intern(Token base, Token relative = {}) -> PathIndex::Handle;
+   auto GetGeneration() const noexcept -> uint64_t;
+   auto LockReferences() -> std::unique_lock<std::mutex>;
+
+   bool Mount(const Path&, const Path& mountPoint = {}, int priority = 0);
+   bool Unmount(const Path& native);
+
+   void StartTrace();
+   bool SaveTrace(const Path& manifest);
+   bool Replay(const Path& manifest, Count workers = 0);
+
+   auto GetSlowestFiles(Count) -> TMany<const File*>;
+   void LogIOStats(Count files = 10);
+
+   auto GetAsyncIO() noexcept -> AsyncIO& { return mAsyncIO; }
+   auto GetHandlePool() noexcept -> HandlePool& { return mHandles; }
+   auto GetWatcher() noexcept -> Watcher& { return mWatcher; }
+   auto GetStatCache() noexcept -> StatCache& { return mStatCache; }
+   auto GetBlockCache() noexcept -> BlockCache& { return mBlockCache; }
+   auto GetAccessTrace() noexcept -> AccessTrace& { return mAccessTrace; }
+   auto GetIOStats() noexcept -> IOStats& { return mIOStats; }
+   auto GetCommitQueue() noexcept -> CommitQueue& { return mCommits; }
 };
 
@@ -7,6 +7,176 @@
 ///                                                                           
 #include "Folder.hpp"
 #include "FileSystem.hpp"
+#include "Native.hpp"
+#include "Enumerator.hpp"
+#include <algorithm>
+#include <filesystem>
+
+
+/// Accumulates failures inside a batch, so that one bad entry doesn't        
+/// prevent the rest of the batch from being processed                        
+struct BatchErrors {
+   std::vector<std::string> mFailures;
+
+   void Add(const char* what, const std::string& path) {
+      Add(what, path, GetLastError());
+   }
+
+   void Add(const char* what, const std::string& path, Token reason) {
+      mFailures.emplace_back(
+         std::string {what} + " `" + path + "`: " + reason);
+   }
+};
+
+/// Order paths so that all descendants of a directory immediately follow     
+/// it - separators are compared as if they're the lowest character           
+static bool DepthFirstLess(const std::string& lhs, const std::string& rhs) {
+   return std::ranges::lexicographical_compare(lhs, rhs,
+      [](char a, char b) {
+         const auto ka = a == '/' ? '\0' : a;
+         const auto kb = b == '/' ? '\0' : b;
+         return static_cast<unsigned char>(ka) < static_cast<unsigned char>(kb);
+      });
+}
+
+/// Create a batch of files and folders                                       
+///   @param files - the files to create, existing ones are left intact       
+///   @param folders - the folders to create                                  
+///   @param done - [out] the paths that were requested and created           
+///   @param touched - [out] all paths that changed on disk                   
+///   @param errors - [out] the failures                                      
+static void CreateBatch(
+   const std::vector<std::string>& files,
+   const std::vector<std::string>& folders,
+   std::vector<std::string>& done,
+   std::vector<std::string>& touched,
+   BatchErrors& errors
+) {
+   // Gather all directories that have to exist - the requested ones    
+   // and the parents of all requested files                            
+   std::vector<std::string> dirs {folders};
+   for (auto& file : files) {
+      const auto separator = file.find_last_of('/');
+      if (separator != std::string::npos)
+         dirs.emplace_back(file.substr(0, separator));
+   }
+   std::ranges::sort(dirs, DepthFirstLess);
+   const auto duplicates = std::ranges::unique(dirs);
+   dirs.erase(duplicates.begin(), duplicates.end());
+
+   // Making the deepest directory makes all of its parents, so each    
+   // chain is created only once                                        
+   for (size_t i = 0; i < dirs.size(); ++i) {
+      const auto& dir = dirs[i];
+      if (i + 1 < dirs.size() and dirs[i + 1].starts_with(dir)
+      and dirs[i + 1][dir.size()] == '/')
+         continue;
+
+      if (not PHYSFS_mkdir(dir.c_str()))
+         errors.Add("Can't create directory", dir);
+   }
+   touched.insert(touched.end(), dirs.begin(), dirs.end());
+
+   for (auto& folder : folders) {
+      PHYSFS_Stat info {};
+      if (PHYSFS_stat(folder.c_str(), &info)
+      and info.filetype == PHYSFS_FILETYPE_DIRECTORY)
+         done.emplace_back(folder);
+   }
+
+   // Appending doesn't truncate files that already exist               
+   for (auto& file : files) {
+      ScopedHandle handle {PHYSFS_openAppend(file.c_str())};
+      if (not handle) {
+         errors.Add("Can't create file", file);
+         continue;
+      }
+
+      done.emplace_back(file);
+      touched.emplace_back(file);
+   }
+}
+
+/// Delete a batch of files and folders                                       
+/// Only entries inside the write directory are deleted. Folder contents are  
+/// gathered from the write directory alone, without following symlinks, so   
+/// nothing mounted from elsewhere is ever touched                            
+///   @param files - the files to delete                                      
+///   @param folders - the folders to delete, along with their contents       
+///   @param done - [out] the paths that were requested and deleted           
+///   @param touched - [out] all paths that changed on disk                   
+///   @param errors - [out] the failures                                      
+static void DeleteBatch(
+   const std::vector<std::string>& files,
+   const std::vector<std::string>& folders,
+   std::vector<std::string>& done,
+   std::vector<std::string>& touched,
+   BatchErrors& errors
+) {
+   // Where a path is in the write directory, if it's there at all      
+   // Entries that exist only in other mounts can't be deleted, and     
+   // missing entries are already deleted, so they're not an error      
+   const auto locate = [&](const std::string& path, std::string& native) {
+      native = Native::ResolveWritePath(path.c_str());
+      std::error_code ec;
+      if (not native.empty()
+      and std::filesystem::exists(std::filesystem::symlink_status(native, ec)))
+         return true;
+
+      if (PHYSFS_exists(path.c_str()))
+         errors.Add("Can't delete", path, "not in the write directory");
+      else
+         done.emplace_back(path);
+      return false;
+   };
+
+   const auto remove = [&](const std::string& path) {
+      if (PHYSFS_delete(path.c_str())) {
+         touched.emplace_back(path);
+         return true;
+      }
+      if (PHYSFS_getLastErrorCode() == PHYSFS_ERR_NOT_FOUND)
+         return true;
+
+      errors.Add("Can't delete", path);
+      return false;
+   };
+
+   std::string native;
+   for (auto& file : files) {
+      if (locate(file, native) and remove(file))
+         done.emplace_back(file);
+   }
+
+   // Folders have to be emptied first - gather all of their contents,  
+   // and delete them deepest first                                     
+   std::vector<std::string> existing, contents;
+   for (auto& folder : folders) {
+      if (not locate(folder, native))
+         continue;
+
+      existing.emplace_back(folder);
+      std::error_code ec;
+      for (std::filesystem::recursive_directory_iterator it {native, ec}, end;
+           not ec and it != end; it.increment(ec)) {
+         const auto relative = it->path().lexically_relative(native);
+         contents.emplace_back(folder + '/' + relative.generic_string());
+      }
+      if (ec)
+         errors.Add("Can't enumerate", folder, "directory walk failed");
+   }
+
+   std::ranges::sort(contents, DepthFirstLess);
+   const auto duplicates = std::ranges::unique(contents);
+   contents.erase(duplicates.begin(), duplicates.end());
+   for (auto path = contents.rbegin(); path != contents.rend(); ++path)
+      remove(*path);
+
+   for (auto& folder : existing) {
+      if (remove(folder))
+         done.emplace_back(folder);
+   }
+}
 
 
 /// Folder constructor                                                        
@@ -24,7 +194,16 @@ Folder::Folder(FileSystem* producer, const Many& descriptor)
       "Can't interface empty directory path");
 
    // Check if folder exists, and retrieve its info                     
-   if (0 != PHYSFS_stat(mFolderPath.Terminate().GetRaw(), &mFolderInfo)) {
+   mMountGeneration = producer->GetGeneration();
+   const auto path = mFolderPath.Terminate();
+   bool found;
+   {
+      const IOStats::Timer timer {
+         producer->GetIOStats(), nullptr, IOStats::Stat};
+      found = producer->GetStatCache().Stat(path.GetRaw(), mFolderInfo);
+   }
+
+   if (found) {
       LANGULUS_ASSERT(
          mFolderInfo.filetype == PHYSFS_FILETYPE_DIRECTORY, FileSystem,
          "Path `", mFolderPath, "` doesn't point to a regular directory"
@@ -43,33 +222,189 @@ Folder::Folder(FileSystem* producer, const Many& descriptor)
 }
 
 /// React on environmental change                                             
-void Folder::Refresh() {}
+/// Refreshes the folder info - invoked by the watcher, from within           
+/// FileSystem::Update, when the folder or its contents change on disk.       
+/// The folder is watched again the next time it is enumerated, in case it    
+/// was created since, and its contents weren't watched                       
+void Folder::Refresh() {
+   mMountGeneration.store(GetProducer()->GetGeneration(),
+      std::memory_order_release);
+
+   const auto path = mFolderPath.Terminate();
+   auto& cache = GetProducer()->GetStatCache();
+   cache.Invalidate(path.GetRaw());
+
+   PHYSFS_Stat info {};
+   if (cache.Stat(path.GetRaw(), info)
+   and info.filetype == PHYSFS_FILETYPE_DIRECTORY) {
+      mFolderInfo = info;
+      mExists = true;
+      mIsReadOnly = info.readonly;
+   }
+   else {
+      mFolderInfo = {};
+      mExists = false;
+      mIsReadOnly = false;
+   }
+
+   VERBOSE_VFS("Refreshed: ", mFolderPath);
+   mWatched = false;
+}
+
+/// Refresh the folder, if sources were mounted or unmounted since it was     
+/// last refreshed - folders are checked on their next use, just like files   
+void Folder::Validate() {
+   const auto current = GetProducer()->GetGeneration();
+   auto refreshed = mMountGeneration.load(std::memory_order_acquire);
+   if (refreshed == current
+   or not mMountGeneration.compare_exchange_strong(refreshed, current))
+      return;
+
+   Refresh();
+}
+
+/// Register the folder and its contents for change notifications, the first  
+/// time it is enumerated, so that interfacing many folders never touches     
+/// the watcher                                                               
+void Folder::Watch() {
+   if (mWatched.exchange(true))
+      return;
+
+   // The stat cache knows where the folder is on disk, without asking  
+   // PhysFS or the OS again                                            
+   const auto path = mFolderPath.Terminate();
+   PHYSFS_Stat info;
+   std::string native;
+   GetProducer()->GetStatCache().Stat(path.GetRaw(), info, &native);
+   if (native.empty())
+      native = Native::ResolveWritePath(path.GetRaw());
+   GetProducer()->GetWatcher().Watch(this, native, true);
+}
 
 /// First stage destruction                                                   
 void Folder::Teardown() {
+   GetProducer()->GetWatcher().Unwatch(this);
    mFolderPath.Reset();
 }
 
-/// Create or delete files and subfolders under this folder                   
-void Folder::Create(Verb&) {
-   TODO();
+/// Create or delete files and subfolders under this folder, as one batch     
+/// Text arguments are paths relative to this folder - a trailing slash       
+/// marks a subfolder, anything else is an empty file. Parent directories     
+/// are created only once per batch, and existing files are left intact.      
+/// Negative mass deletes the entries instead, including the contents of      
+/// deleted subfolders - only entries in the write directory can be deleted.  
+/// Metadata cache is updated once for the whole batch, and the paths of all  
+/// created/deleted entries are pushed to the output. Entries that fail are   
+/// logged one by one, without undoing the rest of the batch                  
+/// Interfaced files and folders are refreshed by the watcher, as usual       
+///   @attention throws only if the whole batch failed, so that nothing has   
+///              been pushed to the output yet                                
+///   @param verb - the creation/destruction verb                             
+void Folder::Create(Verb& verb) {
+   if (verb.GetMass() == 0)
+      return;
+
+   std::string prefix {AsToken(mFolderPath)};
+   std::ranges::replace(prefix, '\\', '/');
+   while (not prefix.empty() and prefix.back() == '/')
+      prefix.pop_back();
+   if (not prefix.empty())
+      prefix += '/';
+
+   std::vector<std::string> files, folders;
+   verb.GetArgument().ForEachDeep([&](const Text& text) {
+      std::string path {AsToken(text)};
+      std::ranges::replace(path, '\\', '/');
+
+      const bool folder = path.ends_with('/');
+      while (not path.empty() and path.back() == '/')
+         path.pop_back();
+      while (not path.empty() and path.front() == '/')
+         path.erase(0, 1);
+      if (path.empty())
+         return;
+
+      (folder ? folders : files).emplace_back(prefix + path);
+   });
+
+   for (auto list : {&files, &folders}) {
+      std::ranges::sort(*list);
+      const auto duplicates = std::ranges::unique(*list);
+      list->erase(duplicates.begin(), duplicates.end());
+   }
+
+   std::vector<std::string> done, touched;
+   BatchErrors errors;
+   if (verb.GetMass() > 0)
+      CreateBatch(files, folders, done, touched, errors);
+   else
+      DeleteBatch(files, folders, done, touched, errors);
+
+   GetProducer()->GetStatCache().InvalidateBatch(touched);
+   VERBOSE_VFS(verb.GetMass() > 0 ? "Created " : "Deleted ",
+      done.size(), " entries in: ", mFolderPath);
+
+   if (errors.mFailures.empty() or not done.empty()) {
+      for (auto& failure : errors.mFailures)
+         Logger::Error(Self(), failure.c_str());
+      for (auto& path : done)
+         verb << Path {Token {path}};
+      return;
+   }
+
+   LANGULUS_ASSERT(false, FileSystem,
+      errors.mFailures.size(), " entries in batch failed, first one - ",
+      errors.mFailures.front().c_str());
 }
 
 /// Select files and subfolders under this folder                             
-void Folder::Select(Verb&) {
-   TODO();
+/// Text arguments are glob patterns, relative to this folder - see           
+/// Enumerator for the syntax. Without patterns, all immediate children are   
+/// selected. Paths of matching entries are pushed to the verb output as      
+/// soon as they're found, while subtrees are still being walked              
+///   @param verb - the select verb                                           
+void Folder::Select(Verb& verb) {
+   if (verb.GetMass() <= 0)
+      return;
+
+   // Watch before bailing out, so that the folder is refreshed, when it
+   // gets created                                                      
+   Validate();
+   Watch();
+   if (not mExists)
+      return;
+
+   std::vector<std::string> patterns;
+   verb.GetArgument().ForEachDeep([&](const Text& pattern) {
+      patterns.emplace_back(AsToken(pattern));
+   });
+
+   const auto root = mFolderPath.Terminate();
+   std::string prefix {AsToken(mFolderPath)};
+   if (not prefix.empty() and prefix.back() != '/')
+      prefix += '/';
+
+   const Enumerator enumerator {patterns};
+   enumerator.Walk(root.GetRaw(), [&](std::string_view relative, bool) {
+      const auto full = prefix + std::string {relative};
+      verb << Path {Token {full}};
+   });
 }
 
 /// Get a file interface, from a path that resides in this folder             
 ///   @param filename - path relative to this folder                          
 ///   @return the file interface                                              
 auto Folder::RelativeFile(const Path& filename) const -> Ref<A::File> {
-   return GetProducer()->GetFile(mFolderPath / filename);
+   const auto producer = GetProducer();
+   return producer->GetFile(
+      producer->Intern(AsToken(mFolderPath), AsToken(filename)));
 }
 
 /// Get a subfolder interface, from a path that resides in this folder        
 ///   @param dirname - path relative to this folder                           
 ///   @return the folder interface                                            
 auto Folder::RelativeFolder(const Path& dirname) const -> Ref<A::Folder> {
-   return GetProducer()->GetFolder(mFolderPath / dirname);
+   const auto producer = GetProducer();
+   return producer->GetFolder(
+      producer->Intern(AsToken(mFolderPath), AsToken(dirname)));
 }
\ No newline at end of file
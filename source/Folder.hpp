@@ -10,6 +10,7 @@
 #include <Langulus/Flow/Producible.hpp>
 #include <Langulus/Verbs/Create.hpp>
 #include <Langulus/Verbs/Select.hpp>
+#include <atomic>
 
 
 ///                                                                           
@@ -24,6 +25,12 @@ struct Folder final : A::Folder, ProducedFrom<FileSystem> {
 private:
    // Information about the folder, if it exists                        
    PHYSFS_Stat mFolderInfo {};
+   // Whether the folder is registered for change notifications         
+   std::atomic_bool mWatched = false;
+   // Mount generation the info was last refreshed for                  
+   std::atomic<uint64_t> mMountGeneration = 0;
+
+   void Watch();
 
 public:
    Folder(FileSystem*, const Many&);
@@ -32,6 +39,7 @@ public:
    void Select(Verb&);
 
    void Refresh();
+   void Validate();
    void Teardown();
 
    auto RelativeFile  (const Path&) const -> Ref<A::File>;
@@ -0,0 +1,432 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#include "HandlePool.hpp"
+#include <algorithm>
+
+
+/// Close all idle handles on destruction                                     
+///   @attention all leases must be released before the pool is destroyed     
+HandlePool::~HandlePool() {
+   DropIdle();
+}
+
+/// Open a handle                                                             
+/// Reuses an idle handle when reading, if there's one for the same file,     
+/// otherwise makes room for a new handle, by closing least recently used     
+///   @param path - the virtual path of the file, or the native path in       
+///                 native modes                                              
+///   @param mode - how to open the file                                      
+///   @return the lease, invalid if file couldn't be opened (PhysFS error is  
+///           set in that case, unless mode is native)                        
+auto HandlePool::Open(std::string_view path, Mode mode) -> Lease {
+   std::string terminated {path};
+   Lease lease;
+   lease.mPool = this;
+
+   std::unique_lock lock {mMutex};
+   if (mode == Read) {
+      const auto found = mIdle.find(terminated);
+      if (found != mIdle.end()) {
+         const auto node = found->second.back();
+         Unidle(*node);
+
+         // Reused handles start from the beginning, unbuffered         
+         if (PHYSFS_seek(node->mHandle, 0)
+         and PHYSFS_setBuffer(node->mHandle, 0)) {
+            node->mBufferSize = 0;
+            Touch(*node);
+            lease.mNode = node;
+            return lease;
+         }
+
+         if (Close(*node))
+            delete node;
+      }
+   }
+
+   // Open outside the lock, because opening files in archives is slow  
+   Evict(1);
+   lock.unlock();
+
+   const auto node = new Node;
+   node->mPath = std::move(terminated);
+   node->mMode = mode;
+   switch (mode) {
+   case Read:
+      node->mHandle = PHYSFS_openRead(node->mPath.c_str());
+      break;
+   case Write:
+      node->mHandle = PHYSFS_openWrite(node->mPath.c_str());
+      break;
+   case Append:
+      node->mHandle = PHYSFS_openAppend(node->mPath.c_str());
+      break;
+   default:
+      OpenNative(*node);
+   }
+
+   if (not node->IsOpen()) {
+      delete node;
+      return {};
+   }
+
+   // Reopened writers must continue, instead of truncating again       
+   node->mMode = Reopened(mode);
+
+   lock.lock();
+   mOrder.push_front(node);
+   node->mOrder = mOrder.begin();
+   lease.mNode = node;
+   return lease;
+}
+
+/// Lease a handle, without opening it yet - it is opened the first time it   
+/// is pinned, so that reserving handles for files, that might never be read, 
+/// costs nothing. Truncating modes aren't truncated                          
+///   @param path - the virtual path of the file, or the native path in       
+///                 native modes                                              
+///   @param mode - how to open the file                                      
+///   @return the lease                                                       
+auto HandlePool::Reserve(std::string_view path, Mode mode) -> Lease {
+   const auto node = new Node;
+   node->mPath = path;
+   node->mMode = Reopened(mode);
+
+   Lease lease;
+   lease.mPool = this;
+   lease.mNode = node;
+   return lease;
+}
+
+/// Close idle handles for a file, so that a changed file isn't read through  
+/// an outdated handle                                                        
+///   @param path - the virtual path of the file                              
+void HandlePool::Forget(std::string_view path) {
+   std::scoped_lock lock {mMutex};
+   const auto found = mIdle.find(std::string {path});
+   if (found == mIdle.end())
+      return;
+
+   for (auto node : found->second) {
+      node->mIdle = false;
+      if (Close(*node))
+         delete node;
+   }
+   mIdle.erase(found);
+}
+
+/// Close all idle handles, i.e. before unmounting, which fails while there   
+/// are handles open inside the unmounted archive                             
+void HandlePool::DropIdle() {
+   std::scoped_lock lock {mMutex};
+   for (auto& [path, nodes] : mIdle) {
+      for (auto node : nodes) {
+         node->mIdle = false;
+         if (Close(*node))
+            delete node;
+      }
+   }
+   mIdle.clear();
+}
+
+/// Close all PhysFS handles that aren't pinned, including leased ones, i.e.  
+/// before changing the search path, which fails while there are handles      
+/// open inside the affected sources. Leased handles are reopened at the      
+/// same position, the next time their owners use them, like evicted ones.    
+/// Native descriptors are left open, because they don't involve PhysFS       
+///   @return the number of PhysFS handles left open, because they're pinned  
+///           by reads or writes in progress, or failed to flush              
+Count HandlePool::Suspend() {
+   std::scoped_lock lock {mMutex};
+   Count remaining = 0;
+   for (auto it = mOrder.begin(); it != mOrder.end(); ) {
+      const auto node = *it++;
+      if (node->IsNative())
+         continue;
+      if (node->mPins or not Close(*node)) {
+         ++remaining;
+         continue;
+      }
+
+      // Idle nodes have no lease that could reopen them                
+      if (node->mIdle) {
+         Unidle(*node);
+         delete node;
+      }
+   }
+   return remaining;
+}
+
+/// Change the maximum number of open handles, closing handles if necessary   
+///   @param maxOpen - the new limit, at least one                            
+void HandlePool::SetMaxOpen(Count maxOpen) {
+   std::scoped_lock lock {mMutex};
+   mMaxOpen = std::max<Count>(maxOpen, 1);
+   Evict(0);
+}
+
+/// Get the maximum number of open handles                                    
+///   @return the limit                                                       
+Count HandlePool::GetMaxOpen() {
+   std::scoped_lock lock {mMutex};
+   return mMaxOpen;
+}
+
+/// Get the number of handles currently open, including idle ones             
+///   @return the number of open handles                                      
+Count HandlePool::GetOpen() {
+   std::scoped_lock lock {mMutex};
+   return mOrder.size();
+}
+
+/// Open a node's native descriptor                                           
+///   @param node - the node to open, in one of the native modes              
+///   @return true on success                                                 
+bool HandlePool::OpenNative(Node& node) {
+   auto& descriptor = node.mDescriptor;
+   switch (node.mMode) {
+   case NativeRead:
+      return descriptor.Open(node.mPath);
+   case NativeWrite:
+      return descriptor.Open(node.mPath, true);
+   case DirectRead:
+      return descriptor.OpenDirect(node.mPath, false, false);
+   case DirectWrite:
+      return descriptor.OpenDirect(node.mPath, true, true);
+   case DirectUpdate:
+      return descriptor.OpenDirect(node.mPath, true, false);
+   default:
+      return false;
+   }
+}
+
+/// Get the mode a handle is reopened in, after it was closed                 
+///   @param mode - the mode the handle was opened in                         
+///   @return the same mode, but without truncating                           
+auto HandlePool::Reopened(Mode mode) noexcept -> Mode {
+   switch (mode) {
+   case Write:
+      return Append;
+   case DirectWrite:
+      return DirectUpdate;
+   default:
+      return mode;
+   }
+}
+
+/// Mark a node as the most recently used                                     
+///   @attention assumes mMutex is locked, and the node's handle is open      
+///   @param node - the node to touch                                         
+void HandlePool::Touch(Node& node) {
+   mOrder.splice(mOrder.begin(), mOrder, node.mOrder);
+}
+
+/// Close a node's handle, saving its position for reopening                  
+///   @attention assumes mMutex is locked, and the node's handle is open      
+///   @param node - the node to close                                         
+///   @return false if handle couldn't be closed, and is still open           
+bool HandlePool::Close(Node& node) {
+   if (node.IsNative())
+      node.mDescriptor.Close();
+   else {
+      const auto position = PHYSFS_tell(node.mHandle);
+      if (0 == PHYSFS_close(node.mHandle))
+         return false;
+
+      node.mHandle = nullptr;
+      node.mPosition = position > 0 ? static_cast<Offset>(position) : 0;
+   }
+
+   mOrder.erase(node.mOrder);
+   return true;
+}
+
+/// Close least recently used handles, that aren't pinned, until there's      
+/// room for more handles under the limit                                     
+///   @attention assumes mMutex is locked                                     
+///   @param room - number of handles to make room for                        
+void HandlePool::Evict(Count room) {
+   auto it = mOrder.end();
+   while (it != mOrder.begin() and mOrder.size() + room > mMaxOpen) {
+      const auto node = *--it;
+      if (node->mPins)
+         continue;
+
+      // Closing erases the node from the list, but not what follows it 
+      const auto after = std::next(it);
+      if (not Close(*node))
+         continue;
+
+      // Idle nodes have no lease that could reopen them                
+      if (node->mIdle) {
+         Unidle(*node);
+         delete node;
+      }
+      it = after;
+   }
+}
+
+/// Remove a node from the idle ones                                          
+///   @attention assumes mMutex is locked                                     
+///   @param node - the idle node                                             
+void HandlePool::Unidle(Node& node) {
+   const auto found = mIdle.find(node.mPath);
+   std::erase(found->second, &node);
+   if (found->second.empty())
+      mIdle.erase(found);
+   node.mIdle = false;
+}
+
+/// Release a lease - read handles are kept idle for reuse, while there's     
+/// room for them, the rest are closed                                        
+///   @param lease - the lease to release                                     
+///   @return false if handle failed to close, i.e. failed to flush           
+bool HandlePool::Release(Lease& lease) {
+   const auto node = lease.mNode;
+   lease.mNode = nullptr;
+
+   std::scoped_lock lock {mMutex};
+   if (node->mHandle and node->mMode == Read
+   and mOrder.size() <= mMaxOpen) {
+      node->mIdle = true;
+      mIdle[node->mPath].push_back(node);
+      return true;
+   }
+
+   bool closed = true;
+   if (node->IsOpen()) {
+      if (node->IsNative())
+         node->mDescriptor.Close();
+      else
+         closed = 0 != PHYSFS_close(node->mHandle);
+      mOrder.erase(node->mOrder);
+   }
+
+   delete node;
+   return closed;
+}
+
+
+
+///                                                                           
+///   Lease implementation                                                    
+///                                                                           
+
+/// Move-construct a lease                                                    
+///   @param other - the lease to move                                        
+HandlePool::Lease::Lease(Lease&& other) noexcept
+   : mPool {other.mPool}
+   , mNode {other.mNode} {
+   other.mNode = nullptr;
+}
+
+/// Release the lease on destruction                                          
+HandlePool::Lease::~Lease() {
+   if (mNode)
+      mPool->Release(*this);
+}
+
+/// Move-assign a lease                                                       
+///   @param other - the lease to move                                        
+///   @return a reference to this lease                                       
+auto HandlePool::Lease::operator = (Lease&& other) noexcept -> Lease& {
+   if (this != &other) {
+      if (mNode)
+         mPool->Release(*this);
+      mPool = other.mPool;
+      mNode = other.mNode;
+      other.mNode = nullptr;
+   }
+   return *this;
+}
+
+/// Release the lease explicitly, to check if handle was closed properly      
+///   @return false if handle failed to close, i.e. failed to flush           
+bool HandlePool::Lease::Close() {
+   return mNode ? mPool->Release(*this) : true;
+}
+
+/// Change the handle's buffer size, and remember it for reopening            
+///   @param size - the new buffer size in bytes, zero disables buffering     
+void HandlePool::Lease::SetBuffer(Offset size) {
+   const Pin pin {*this};
+   LANGULUS_ASSERT(PHYSFS_setBuffer(pin, PHYSFS_uint64(size)), FileSystem,
+      "Error in PHYSFS_setBuffer: ", GetLastError());
+   mNode->mBufferSize = size;
+}
+
+
+
+///                                                                           
+///   Pin implementation                                                      
+///                                                                           
+
+/// Pin a leased handle, reopening it if it was closed in the meantime        
+///   @param lease - the lease to pin                                         
+HandlePool::Pin::Pin(Lease& lease)
+   : mLease {lease} {
+   auto& pool = *lease.mPool;
+   auto& node = *lease.mNode;
+   std::unique_lock lock {pool.mMutex};
+   ++node.mPins;
+   if (node.IsOpen()) {
+      pool.Touch(node);
+      mHandle = node.mHandle;
+      mDescriptor = &node.mDescriptor;
+      return;
+   }
+
+   pool.Evict(1);
+   if (node.IsNative()) {
+      // Descriptors might be pinned by other threads at the same time, 
+      // so they're reopened without unlocking - it's cheap for them    
+      if (not OpenNative(node)) {
+         --node.mPins;
+         LANGULUS_OOPS(FileSystem, "Can't open `", node.mPath,
+            "` after its descriptor was pooled");
+      }
+
+      pool.mOrder.push_front(&node);
+      node.mOrder = pool.mOrder.begin();
+      mDescriptor = &node.mDescriptor;
+      return;
+   }
+
+   // Reopen outside the lock - pinned nodes are never touched by the   
+   // other threads                                                     
+   lock.unlock();
+
+   const auto handle = node.mMode == Read
+      ? PHYSFS_openRead(node.mPath.c_str())
+      : PHYSFS_openAppend(node.mPath.c_str());
+   const bool restored = handle
+      and (not node.mBufferSize
+         or PHYSFS_setBuffer(handle, PHYSFS_uint64(node.mBufferSize)))
+      and PHYSFS_seek(handle, PHYSFS_uint64(node.mPosition));
+
+   lock.lock();
+   if (not restored) {
+      --node.mPins;
+      const auto error = GetLastError();
+      if (handle)
+         PHYSFS_close(handle);
+      LANGULUS_OOPS(FileSystem, "Can't reopen `", node.mPath,
+         "` after its handle was pooled: ", error);
+   }
+
+   node.mHandle = handle;
+   pool.mOrder.push_front(&node);
+   node.mOrder = pool.mOrder.begin();
+   mHandle = handle;
+}
+
+/// Unpin the handle, so that it can be closed again                          
+HandlePool::Pin::~Pin() {
+   std::scoped_lock lock {mLease.mPool->mMutex};
+   --mLease.mNode->mPins;
+}
@@ -0,0 +1,151 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#pragma once
+#include "Common.hpp"
+#include "Native.hpp"
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+
+///                                                                           
+///   Pool of PhysFS handles                                                  
+///                                                                           
+///   Readers and writers lease their handles from here, so that the number   
+/// of handles opened at once never exceeds a limit, regardless of how many   
+/// readers and writers exist. When the limit is reached, the least recently  
+/// used handle is closed, and its position is saved - it is reopened at the  
+/// same position the next time its owner uses it. Handles are pinned while   
+/// in use, so they can't be closed from under their owner.                   
+///   Read handles of released leases are kept open while there's room, and   
+/// reused by the next reader of the same file, because opening files inside  
+/// archives is expensive.                                                    
+///   Native descriptors, used for positional and uncached I/O, are pooled    
+/// the same way, and count towards the same limit. They can be pinned by     
+/// multiple threads at once, so that a single descriptor can be shared       
+///                                                                           
+struct HandlePool {
+   enum Mode {
+      Read,          // Open for reading
+      Write,         // Truncate, and open for writing
+      Append,        // Open for writing at the end
+      NativeRead,    // Native descriptor, for positional reads
+      NativeWrite,   // Native descriptor, for positional writes
+      DirectRead,    // Native descriptor, bypassing the page cache
+      DirectWrite,   // Same, but truncated, and for writing
+      DirectUpdate   // Same, but for writing without truncating
+   };
+
+   static constexpr Count DefaultMaxOpen = 256;
+
+private:
+   struct Node {
+      // The handle, or nullptr while closed                            
+      PHYSFS_File* mHandle = nullptr;
+      // The descriptor, used instead of the handle in native modes     
+      Native::Descriptor mDescriptor;
+      // Null-terminated virtual path, for reopening - native path in   
+      // native modes                                                   
+      std::string mPath;
+      Mode mMode = Read;
+      // Buffer size to restore, when reopening                         
+      Offset mBufferSize = 0;
+      // Position to restore, when reopening                            
+      Offset mPosition = 0;
+      // Handle can't be closed while pinned                            
+      Count mPins = 0;
+      // Idle nodes have no lease, and wait to be reused                
+      bool mIdle = false;
+      // Place in mOrder, valid only while handle is open               
+      std::list<Node*>::iterator mOrder;
+
+      bool IsNative() const noexcept { return mMode >= NativeRead; }
+      bool IsOpen() const noexcept { return mHandle or mDescriptor; }
+   };
+
+public:
+   ///                                                                        
+   ///   A handle leased by a reader or writer                                
+   ///                                                                        
+   struct Lease {
+   private:
+      friend struct HandlePool;
+      HandlePool* mPool {};
+      Node* mNode {};
+
+   public:
+      Lease() = default;
+      Lease(const Lease&) = delete;
+      Lease(Lease&&) noexcept;
+     ~Lease();
+
+      Lease& operator = (const Lease&) = delete;
+      Lease& operator = (Lease&&) noexcept;
+
+      bool Close();
+      void SetBuffer(Offset);
+
+      explicit operator bool() const noexcept { return mNode != nullptr; }
+   };
+
+   ///                                                                        
+   ///   Keeps a leased handle open while in scope                            
+   ///   Native descriptors can be pinned by any number of threads at once    
+   ///                                                                        
+   struct Pin {
+   private:
+      Lease& mLease;
+      PHYSFS_File* mHandle {};
+      const Native::Descriptor* mDescriptor {};
+
+   public:
+      Pin(Lease&);
+      Pin(const Pin&) = delete;
+     ~Pin();
+
+      operator PHYSFS_File* () const noexcept { return mHandle; }
+      auto GetDescriptor() const noexcept -> const Native::Descriptor& {
+         return *mDescriptor;
+      }
+   };
+
+private:
+   // Open handles, most recently used in front                         
+   std::list<Node*> mOrder;
+   // Idle read handles, by path                                        
+   std::unordered_map<std::string, std::vector<Node*>> mIdle;
+   Count mMaxOpen = DefaultMaxOpen;
+   std::mutex mMutex;
+
+   static bool OpenNative(Node&);
+   static Mode Reopened(Mode) noexcept;
+
+   void Touch(Node&);
+   bool Close(Node&);
+   void Evict(Count room);
+   void Unidle(Node&);
+   bool Release(Lease&);
+
+public:
+   HandlePool() = default;
+   HandlePool(const HandlePool&) = delete;
+  ~HandlePool();
+
+   Lease Open(std::string_view path, Mode);
+   Lease Reserve(std::string_view path, Mode);
+   void Forget(std::string_view path);
+   void DropIdle();
+   Count Suspend();
+
+   void SetMaxOpen(Count);
+   Count GetMaxOpen();
+   Count GetOpen();
+};
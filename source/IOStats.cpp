@@ -0,0 +1,189 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#include "IOStats.hpp"
+#include <algorithm>
+#include <bit>
+#include <chrono>
+
+
+/// Each thread sticks to one shard, picked in round-robin order when the     
+/// thread first records something                                            
+///   @return the index of the current thread's shard                         
+static unsigned ShardOfThisThread() noexcept {
+   static std::atomic<unsigned> next = 0;
+   thread_local const unsigned shard =
+      next.fetch_add(1, std::memory_order_relaxed) % IOStats::ShardCount;
+   return shard;
+}
+
+/// Get the upper bound of the bucket, that contains a given percentile       
+///   @param percentile - the percentile, in the range [0; 1]                 
+///   @return the latency in nanoseconds, zero if histogram is empty          
+uint64_t IOStats::Histogram::Percentile(double percentile) const noexcept {
+   Count total = 0;
+   for (auto count : mBuckets)
+      total += count;
+   if (not total)
+      return 0;
+
+   const auto rank = std::max<Count>(1,
+      static_cast<Count>(percentile * static_cast<double>(total) + 0.5));
+   Count seen = 0;
+   for (unsigned bucket = 0; bucket < BucketCount; ++bucket) {
+      seen += mBuckets[bucket];
+      if (seen >= rank)
+         return uint64_t {1} << bucket;
+   }
+   return uint64_t {1} << (BucketCount - 1);
+}
+
+/// Count an operation                                                        
+///   @param operation - the operation                                        
+///   @param time - duration in nanoseconds                                   
+///   @param bytes - bytes read or written                                    
+void IOStats::Tally::Record(
+   Operation operation, uint64_t time, Offset bytes
+) noexcept {
+   auto& counters = mOperations[operation];
+   counters.mCount.fetch_add(1, std::memory_order_relaxed);
+   counters.mBytes.fetch_add(bytes, std::memory_order_relaxed);
+   counters.mTime.fetch_add(time, std::memory_order_relaxed);
+
+   auto max = counters.mMaxTime.load(std::memory_order_relaxed);
+   while (time > max and not counters.mMaxTime.compare_exchange_weak(
+      max, time, std::memory_order_relaxed));
+}
+
+/// Add the totals of all operations to a sum                                 
+///   @param sum - [in/out] the totals to add to, indexed by Operation        
+void IOStats::Tally::AddTo(
+   std::array<Totals, OperationCount>& sum
+) const noexcept {
+   for (unsigned i = 0; i < OperationCount; ++i) {
+      auto& counters = mOperations[i];
+      sum[i].mCount += counters.mCount.load(std::memory_order_relaxed);
+      sum[i].mBytes += counters.mBytes.load(std::memory_order_relaxed);
+      sum[i].mTime += counters.mTime.load(std::memory_order_relaxed);
+      sum[i].mMaxTime = std::max(sum[i].mMaxTime,
+         counters.mMaxTime.load(std::memory_order_relaxed));
+   }
+}
+
+/// Zero all counters                                                         
+void IOStats::Tally::Reset() noexcept {
+   for (auto& counters : mOperations) {
+      counters.mCount.store(0, std::memory_order_relaxed);
+      counters.mBytes.store(0, std::memory_order_relaxed);
+      counters.mTime.store(0, std::memory_order_relaxed);
+      counters.mMaxTime.store(0, std::memory_order_relaxed);
+   }
+}
+
+/// Count an operation made on the file                                       
+///   @param operation - the operation                                        
+///   @param time - duration in nanoseconds                                   
+///   @param bytes - bytes read or written                                    
+void IOStats::Counters::Record(
+   Operation operation, uint64_t time, Offset bytes
+) noexcept {
+   mTally.Record(operation, time, bytes);
+}
+
+/// Get the totals of all operations                                          
+/// Operations that happen meanwhile might be partially included              
+///   @return the totals, indexed by Operation                                
+auto IOStats::Counters::GetTotals() const noexcept
+-> std::array<Totals, OperationCount> {
+   std::array<Totals, OperationCount> result {};
+   mTally.AddTo(result);
+   return result;
+}
+
+/// Zero all counters                                                         
+void IOStats::Counters::Reset() noexcept {
+   mTally.Reset();
+}
+
+/// Start measuring an operation                                              
+///   @param stats - module-wide statistics                                   
+///   @param counters - counters of the file the operation is made on, if any 
+///   @param operation - the operation                                        
+IOStats::Timer::Timer(
+   IOStats& stats, Counters* counters, Operation operation
+) noexcept
+   : mStats {stats}
+   , mCounters {counters}
+   , mOperation {operation}
+   , mStart {Now()} {}
+
+/// Stop measuring, and record the operation                                  
+IOStats::Timer::~Timer() {
+   mStats.Record(mOperation, Now() - mStart, mBytes, mCounters);
+}
+
+/// Get a monotonic timestamp                                                 
+///   @return nanoseconds since an unspecified point in time                  
+uint64_t IOStats::Now() noexcept {
+   return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+         std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/// Get the histogram bucket of a duration                                    
+///   @param time - duration in nanoseconds                                   
+///   @return the bucket index                                                
+unsigned IOStats::BucketOf(uint64_t time) noexcept {
+   return std::min<unsigned>(
+      static_cast<unsigned>(std::bit_width(time)), BucketCount - 1);
+}
+
+/// Record an operation                                                       
+///   @param operation - the operation                                        
+///   @param time - duration in nanoseconds                                   
+///   @param bytes - bytes read or written                                    
+///   @param counters - counters of the file the operation is made on, if any 
+void IOStats::Record(
+   Operation operation, uint64_t time, Offset bytes, Counters* counters
+) noexcept {
+   auto& shard = mShards[ShardOfThisThread()];
+   shard.mTally.Record(operation, time, bytes);
+   shard.mBuckets[operation][BucketOf(time)]
+      .fetch_add(1, std::memory_order_relaxed);
+
+   if (counters)
+      counters->Record(operation, time, bytes);
+}
+
+/// Sum all shards                                                            
+/// Operations that happen meanwhile might be partially included              
+///   @return the module-wide statistics                                      
+auto IOStats::GetSnapshot() const noexcept -> Snapshot {
+   Snapshot result;
+   for (auto& shard : mShards) {
+      shard.mTally.AddTo(result.mTotals);
+      for (unsigned i = 0; i < OperationCount; ++i) {
+         for (unsigned b = 0; b < BucketCount; ++b) {
+            result.mLatency[i].mBuckets[b] +=
+               shard.mBuckets[i][b].load(std::memory_order_relaxed);
+         }
+      }
+   }
+   return result;
+}
+
+/// Zero all module-wide statistics                                           
+/// Counters of individual files are not affected                             
+void IOStats::Reset() noexcept {
+   for (auto& shard : mShards) {
+      shard.mTally.Reset();
+      for (auto& buckets : shard.mBuckets) {
+         for (auto& bucket : buckets)
+            bucket.store(0, std::memory_order_relaxed);
+      }
+   }
+}
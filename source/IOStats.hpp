@@ -0,0 +1,134 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#pragma once
+#include "Common.hpp"
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+
+///                                                                           
+///   I/O instrumentation                                                     
+///                                                                           
+///   Always-on counters and latency histograms for stat, open, read and      
+/// write operations, so that stalls can be tracked down to the files that    
+/// cause them, without rebuilding with verbose logging. Every operation is   
+/// counted twice - once in the counters of the file it was made on, and once 
+/// in the module-wide totals. Totals are split in shards, and each thread    
+/// picks its own shard, so that threads don't fight over the same cache      
+/// lines. Shards are only summed when totals are requested. Files are many,  
+/// so their counters aren't sharded - threads rarely hit the same file at    
+/// once, and when they do, the I/O costs far more than the shared counters   
+///   Latencies go into logarithmic buckets - bucket N counts operations      
+/// that took less than 2^N nanoseconds, but no less than 2^(N-1)             
+///                                                                           
+struct IOStats {
+   /// Instrumented operations                                                
+   enum Operation : unsigned {
+      Stat, Open, Read, Write
+   };
+
+   static constexpr unsigned OperationCount = 4;
+   static constexpr unsigned BucketCount = 40;
+   static constexpr unsigned ShardCount = 16;
+
+   /// Totals of a single operation                                           
+   struct Totals {
+      Count mCount = 0;
+      // Bytes read or written                                          
+      Offset mBytes = 0;
+      // Total and longest duration, in nanoseconds                     
+      uint64_t mTime = 0;
+      uint64_t mMaxTime = 0;
+   };
+
+   /// Latency histogram of a single operation                                
+   struct Histogram {
+      std::array<Count, BucketCount> mBuckets {};
+
+      uint64_t Percentile(double) const noexcept;
+   };
+
+   /// Summed statistics, safe to inspect while operations continue           
+   struct Snapshot {
+      std::array<Totals, OperationCount> mTotals {};
+      std::array<Histogram, OperationCount> mLatency {};
+   };
+
+private:
+   /// Totals of all operations, in a single shard                            
+   struct Tally {
+      struct Atomic {
+         std::atomic<Count> mCount = 0;
+         std::atomic<Offset> mBytes = 0;
+         std::atomic<uint64_t> mTime = 0;
+         std::atomic<uint64_t> mMaxTime = 0;
+      };
+
+      std::array<Atomic, OperationCount> mOperations;
+
+      void Record(Operation, uint64_t time, Offset bytes) noexcept;
+      void AddTo(std::array<Totals, OperationCount>&) const noexcept;
+      void Reset() noexcept;
+   };
+
+public:
+   /// Counters of a single file                                              
+   struct Counters {
+   private:
+      Tally mTally;
+
+   public:
+      void Record(Operation, uint64_t time, Offset bytes) noexcept;
+      auto GetTotals() const noexcept
+         -> std::array<Totals, OperationCount>;
+      void Reset() noexcept;
+   };
+
+   /// Measures an operation from construction to destruction, so that        
+   /// failed operations that throw are measured too                          
+   struct Timer {
+   private:
+      IOStats& mStats;
+      Counters* mCounters;
+      Operation mOperation;
+      uint64_t mStart;
+      Offset mBytes = 0;
+
+   public:
+      Timer(IOStats&, Counters*, Operation) noexcept;
+     ~Timer();
+
+      Timer(const Timer&) = delete;
+      Timer& operator = (const Timer&) = delete;
+
+      /// Set the number of bytes the operation read or wrote                 
+      void SetBytes(Offset bytes) noexcept { mBytes = bytes; }
+   };
+
+private:
+   // The module might be allocated without honoring alignas, so shards 
+   // are kept a cache line apart by padding instead                    
+   struct Shard {
+      Tally mTally;
+      std::array<std::array<std::atomic<Count>, BucketCount>, OperationCount>
+         mBuckets {};
+      char mPadding[64];
+   };
+
+   std::array<Shard, ShardCount> mShards;
+
+public:
+   static uint64_t Now() noexcept;
+   static unsigned BucketOf(uint64_t time) noexcept;
+
+   void Record(Operation, uint64_t time, Offset bytes,
+      Counters* = nullptr) noexcept;
+   Snapshot GetSnapshot() const noexcept;
+   void Reset() noexcept;
+};
@@ -0,0 +1,189 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#include "LineReader.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#if defined(__SSE2__) or defined(_M_X64) \
+ or (defined(_M_IX86_FP) and _M_IX86_FP >= 2)
+   #define LINE_READER_SSE2
+   #include <immintrin.h>
+   #if defined(__AVX2__)
+      // AVX2 is always available                                       
+      #define LINE_READER_AVX2
+   #elif defined(__GNUC__) or defined(__clang__)
+      // AVX2 is compiled separately, and used if the CPU supports it   
+      #define LINE_READER_AVX2
+      #define LINE_READER_AVX2_DISPATCH
+   #endif
+#elif defined(__ARM_NEON) or defined(__aarch64__) or defined(_M_ARM64)
+   #define LINE_READER_NEON
+   #include <arm_neon.h>
+#endif
+
+
+/// Find a character one byte at a time - the reference for the vectorized    
+/// versions, which fall back to it for the tail of the range                 
+///   @param begin - start of the range                                       
+///   @param end - end of the range                                           
+///   @param what - the character to find                                     
+///   @return the first occurence, or end if there's none                     
+const char* LineReader::FindScalar(
+   const char* begin, const char* end, char what
+) noexcept {
+   while (begin != end and *begin != what)
+      ++begin;
+   return begin;
+}
+
+#if defined(LINE_READER_SSE2)
+/// Find a character sixteen bytes at a time                                  
+static const char* FindSSE2(
+   const char* begin, const char* end, char what
+) noexcept {
+   const auto needle = _mm_set1_epi8(what);
+   for (; end - begin >= 16; begin += 16) {
+      const auto chunk = _mm_loadu_si128(
+         reinterpret_cast<const __m128i*>(begin));
+      const auto mask = static_cast<unsigned>(
+         _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)));
+      if (mask)
+         return begin + std::countr_zero(mask);
+   }
+   return LineReader::FindScalar(begin, end, what);
+}
+#endif
+
+#if defined(LINE_READER_AVX2)
+/// Find a character thirty-two bytes at a time                               
+#if defined(LINE_READER_AVX2_DISPATCH)
+__attribute__((target("avx2")))
+#endif
+static const char* FindAVX2(
+   const char* begin, const char* end, char what
+) noexcept {
+   const auto needle = _mm256_set1_epi8(what);
+   for (; end - begin >= 32; begin += 32) {
+      const auto chunk = _mm256_loadu_si256(
+         reinterpret_cast<const __m256i*>(begin));
+      const auto mask = static_cast<unsigned>(
+         _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle)));
+      if (mask)
+         return begin + std::countr_zero(mask);
+   }
+   return FindSSE2(begin, end, what);
+}
+#endif
+
+#if defined(LINE_READER_NEON)
+/// Find a character sixteen bytes at a time                                  
+static const char* FindNEON(
+   const char* begin, const char* end, char what
+) noexcept {
+   const auto needle = vdupq_n_u8(static_cast<uint8_t>(what));
+   for (; end - begin >= 16; begin += 16) {
+      const auto chunk = vld1q_u8(reinterpret_cast<const uint8_t*>(begin));
+      const auto equal = vceqq_u8(chunk, needle);
+
+      // Narrow each byte of the comparison to four bits, so that the   
+      // whole result fits in 64 bits, like a movemask                  
+      const auto mask = vget_lane_u64(vreinterpret_u64_u8(
+         vshrn_n_u16(vreinterpretq_u16_u8(equal), 4)), 0);
+      if (mask)
+         return begin + std::countr_zero(mask) / 4;
+   }
+   return LineReader::FindScalar(begin, end, what);
+}
+#endif
+
+/// Find a character, using the widest vector instructions available          
+///   @param begin - start of the range                                       
+///   @param end - end of the range                                           
+///   @param what - the character to find                                     
+///   @return the first occurence, or end if there's none                     
+const char* LineReader::Find(
+   const char* begin, const char* end, char what
+) noexcept {
+#if defined(LINE_READER_AVX2_DISPATCH)
+   static const bool avx2 = __builtin_cpu_supports("avx2");
+   return avx2 ? FindAVX2(begin, end, what) : FindSSE2(begin, end, what);
+#elif defined(LINE_READER_AVX2)
+   return FindAVX2(begin, end, what);
+#elif defined(LINE_READER_SSE2)
+   return FindSSE2(begin, end, what);
+#elif defined(LINE_READER_NEON)
+   return FindNEON(begin, end, what);
+#else
+   return FindScalar(begin, end, what);
+#endif
+}
+
+/// Line reader constructor                                                   
+///   @param file - the file to read                                          
+///   @param delimiter - the character that separates records                 
+///   @param bufferSize - initial size of the buffer, grows to fit records    
+LineReader::LineReader(const File& file, char delimiter, Offset bufferSize)
+   : mBuffer(std::max<Offset>(bufferSize, 1))
+   , mDelimiter {delimiter} {
+   // The buffer is big enough, so reads don't need another one         
+   File::Buffering buffering;
+   buffering.mSize = 0;
+   buffering.mAdaptive = false;
+   mReader = file.NewReader(buffering);
+}
+
+/// Produce the next record                                                   
+///   @attention the record is a view into the buffer, which remains valid    
+///              only until the next call                                     
+///   @param record - [out] the record, without its delimiter                 
+///   @return false if there are no more records                              
+bool LineReader::Next(Token& record) {
+   for (;;) {
+      const auto begin = mBuffer.data() + mBegin;
+      const auto end = mBuffer.data() + mEnd;
+      const auto found = Find(begin + mScanned, end, mDelimiter);
+      if (found != end or (mEndOfFile and begin != end)) {
+         // The last record might not have a delimiter after it         
+         auto count = static_cast<Offset>(found - begin);
+         mBegin += found != end ? count + 1 : count;
+         mScanned = 0;
+         if (mDelimiter == '\n' and count and begin[count - 1] == '\r')
+            --count;
+
+         record = Token {begin, count};
+         ++mRecords;
+         return true;
+      }
+
+      if (mEndOfFile)
+         return false;
+      mScanned = mEnd - mBegin;
+      mEndOfFile = not Refill();
+   }
+}
+
+/// Read more bytes after the unconsumed ones                                 
+/// Unconsumed bytes are moved to the start of the buffer, and the buffer     
+/// grows, if they fill all of it                                             
+///   @return false if nothing was read, because file has ended               
+bool LineReader::Refill() {
+   if (mBegin) {
+      std::memmove(mBuffer.data(), mBuffer.data() + mBegin, mEnd - mBegin);
+      mEnd -= mBegin;
+      mBegin = 0;
+   }
+
+   if (mEnd == mBuffer.size())
+      mBuffer.resize(mBuffer.size() * 2);
+
+   const auto read = mReader.template As<File::Reader>()->Read(
+      reinterpret_cast<Byte*>(mBuffer.data() + mEnd), mBuffer.size() - mEnd);
+   mEnd += read;
+   return read != 0;
+}
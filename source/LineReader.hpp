@@ -0,0 +1,55 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#pragma once
+#include "File.hpp"
+#include <vector>
+
+
+///                                                                           
+///   Line/record reader                                                      
+///                                                                           
+///   Splits a file into records, separated by a single delimiter character,  
+/// a new line by default. The file is streamed through a file reader into    
+/// one buffer, which is scanned for delimiters many bytes at a time, using   
+/// AVX2, SSE2 or NEON where available. Records are produced as views into    
+/// the buffer, so nothing is allocated per record, unless a record doesn't   
+/// fit in the buffer, which then grows to fit it.                            
+///   When splitting by new lines, a trailing carriage return is stripped, so 
+/// that files with Windows line endings produce the same records.            
+///   Quoting isn't handled - a delimiter inside a quoted CSV field still     
+/// ends the record                                                           
+///                                                                           
+struct LineReader {
+   /// Default size of the buffer - big enough to amortize reads              
+   static constexpr Offset DefaultBufferSize = 256 * 1024;
+
+private:
+   Ref<A::File::Reader> mReader;
+   std::vector<char> mBuffer;
+   // Unconsumed bytes in the buffer are in the range [mBegin; mEnd)    
+   Offset mBegin = 0;
+   Offset mEnd = 0;
+   // Bytes after mBegin, that are known not to contain a delimiter     
+   Offset mScanned = 0;
+   // Number of records produced so far                                 
+   Count mRecords = 0;
+   char mDelimiter;
+   bool mEndOfFile = false;
+
+   bool Refill();
+
+public:
+   LineReader(const File&, char delimiter = '\n',
+      Offset bufferSize = DefaultBufferSize);
+
+   bool Next(Token&);
+   Count GetRecordCount() const noexcept { return mRecords; }
+
+   static const char* Find(const char*, const char*, char) noexcept;
+   static const char* FindScalar(const char*, const char*, char) noexcept;
+};
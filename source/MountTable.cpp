@@ -0,0 +1,363 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#include "MountTable.hpp"
+#include "Native.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+
+
+/// Check if a source should be searched before another one                   
+///   @param lhs, rhs - the sources to compare                                
+///   @return true if lhs goes before rhs                                     
+bool MountTable::Precedes(const Source& lhs, const Source& rhs) noexcept {
+   if (lhs.mPriority != rhs.mPriority)
+      return lhs.mPriority > rhs.mPriority;
+   return lhs.mSequence > rhs.mSequence;
+}
+
+/// Mount a directory or an archive                                           
+/// Archives are scanned once, and all of their entries are indexed           
+///   @param native - the native path to the directory or archive             
+///   @param mountPoint - where to mount it in the virtual file system        
+///   @param priority - sources with higher priority are searched first       
+///   @return true on success, PhysFS error is set otherwise                  
+bool MountTable::Mount(
+   std::string_view native, std::string_view mountPoint, int priority
+) {
+   auto source = std::make_unique<Source>();
+   source->mNative = native;
+   source->mMountPoint = NormalizePath(mountPoint, false);
+   source->mKey = NormalizePath(mountPoint, true);
+   source->mPriority = priority;
+
+   std::error_code ec;
+   source->mIsArchive = not std::filesystem::is_directory(native, ec);
+
+   std::unique_lock lock {mMutex};
+
+   // Mounting the same source again only changes where it is mounted   
+   const auto existing = std::ranges::find_if(mSources, [&](auto& other) {
+      return other->mNative == source->mNative;
+   });
+   if (existing != mSources.end()
+   and not Remove(existing - mSources.begin()))
+      return false;
+
+   source->mSequence = ++mSequence;
+   Scanned entries;
+   if (source->mIsArchive and not Scan(*source, entries))
+      return false;
+
+   const auto at = std::ranges::find_if(mSources, [&](auto& other) {
+      return Precedes(*source, *other);
+   }) - mSources.begin();
+   if (not Attach(at, *source))
+      return false;
+
+   // Index all archive entries, keeping the search order for paths     
+   // that are contained in multiple archives                           
+   for (auto& [relative, info] : entries) {
+      auto path = source->mKey.empty()
+         ? std::move(relative) : source->mMountPoint + '/' + relative;
+      auto key = NormalizePath(path, true);
+      if (key == path)
+         path.clear();
+
+      auto& list = mIndex[key];
+      const auto place = std::ranges::find_if(list, [&](auto& other) {
+         return Precedes(*source, *other.mSource);
+      });
+      list.insert(place, {source.get(), info, std::move(path)});
+      source->mEntries.emplace_back(std::move(key));
+   }
+
+   // The mount point, and all directories above it, exist because of   
+   // this mount, regardless of what's inside the other sources         
+   std::string_view parent {source->mKey};
+   while (not parent.empty()) {
+      ++mMountParents[std::string {parent}];
+      const auto separator = parent.find_last_of('/');
+      parent = separator == std::string_view::npos
+         ? std::string_view {} : parent.substr(0, separator);
+   }
+
+   if (not source->mIsArchive) {
+      auto& list = mDirectories[source->mKey];
+      const auto place = std::ranges::find_if(list, [&](auto other) {
+         return Precedes(*source, *other);
+      });
+      list.insert(place, source.get());
+   }
+
+   mSources.insert(mSources.begin() + at, std::move(source));
+   ++mGeneration;
+   return true;
+}
+
+/// Unmount a directory or an archive                                         
+///   @param native - the native path, as it was mounted                      
+///   @return true on success, PhysFS error is set otherwise                  
+bool MountTable::Unmount(std::string_view native) {
+   std::unique_lock lock {mMutex};
+   const auto found = std::ranges::find_if(mSources, [&](auto& source) {
+      return source->mNative == native;
+   });
+   if (found == mSources.end()) {
+      PHYSFS_setErrorCode(PHYSFS_ERR_NOT_MOUNTED);
+      return false;
+   }
+
+   return Remove(found - mSources.begin());
+}
+
+/// Unmount a source and forget about it                                      
+///   @param at - index of the source to remove                               
+///   @return true on success                                                 
+bool MountTable::Remove(size_t at) {
+   if (not PHYSFS_unmount(mSources[at]->mNative.c_str()))
+      return false;
+
+   Forget(at);
+   return true;
+}
+
+/// Forget about a source, that is no longer mounted in PhysFS                
+///   @param at - index of the source to forget                               
+void MountTable::Forget(size_t at) {
+   const auto& source = *mSources[at];
+   for (auto& key : source.mEntries) {
+      const auto found = mIndex.find(key);
+      if (found == mIndex.end())
+         continue;
+
+      std::erase_if(found->second, [&](auto& indexed) {
+         return indexed.mSource == &source;
+      });
+      if (found->second.empty())
+         mIndex.erase(found);
+   }
+
+   std::string_view parent {source.mKey};
+   while (not parent.empty()) {
+      const auto found = mMountParents.find(std::string {parent});
+      if (found != mMountParents.end() and 0 == --found->second)
+         mMountParents.erase(found);
+
+      const auto separator = parent.find_last_of('/');
+      parent = separator == std::string_view::npos
+         ? std::string_view {} : parent.substr(0, separator);
+   }
+
+   if (not source.mIsArchive) {
+      const auto found = mDirectories.find(source.mKey);
+      std::erase(found->second, &source);
+      if (found->second.empty())
+         mDirectories.erase(found);
+   }
+
+   mSources.erase(mSources.begin() + at);
+   ++mGeneration;
+}
+
+/// Gather info about all entries inside an archive                           
+/// PhysFS can't enumerate a single archive, so it is temporarily mounted     
+/// at a unique mount point, where nothing else can interfere                 
+///   @param source - the archive to scan                                     
+///   @param entries - [out] paths relative to archive root, and their info   
+///   @return true on success                                                 
+bool MountTable::Scan(const Source& source, Scanned& entries) {
+   const auto scratch = "/.langulus-scan-" + std::to_string(source.mSequence);
+   if (not PHYSFS_mount(source.mNative.c_str(), scratch.c_str(), 1))
+      return false;
+
+   std::vector<std::string> pending {std::string {}};
+   while (not pending.empty()) {
+      const auto dir = std::move(pending.back());
+      pending.pop_back();
+
+      const auto full = dir.empty() ? scratch : scratch + '/' + dir;
+      const auto list = PHYSFS_enumerateFiles(full.c_str());
+      if (not list)
+         continue;
+
+      for (auto name = list; *name; ++name) {
+         auto relative = dir.empty() ? std::string {*name} : dir + '/' + *name;
+         PHYSFS_Stat info {};
+         const auto child = scratch + '/' + relative;
+         if (not PHYSFS_stat(child.c_str(), &info))
+            continue;
+
+         if (info.filetype == PHYSFS_FILETYPE_DIRECTORY)
+            pending.emplace_back(relative);
+         entries.emplace_back(std::move(relative), info);
+      }
+
+      PHYSFS_freeList(list);
+   }
+
+   PHYSFS_unmount(source.mNative.c_str());
+   return true;
+}
+
+/// Mount a source in PhysFS, at a specific place in the search order         
+/// PhysFS can only prepend or append mounts, so the shorter side of the      
+/// search path is temporarily unmounted, and mounted back afterwards.        
+/// Archives are reopened in the process, but not scanned again.              
+///   Unmounting fails while handles are open inside a source, in which case  
+/// nothing is attached. If a source can't be mounted back, the new source    
+/// is unmounted again, and the lost source is forgotten, so that the table   
+/// always matches the search path of PhysFS                                  
+///   @param at - the place in the search order                               
+///   @param source - the source to mount                                     
+///   @return true on success, PhysFS error is set otherwise                  
+bool MountTable::Attach(size_t at, const Source& source) {
+   const auto mount = [](const Source& what, bool append) {
+      const auto point = "/" + what.mMountPoint;
+      return 0 != PHYSFS_mount(what.mNative.c_str(), point.c_str(), append);
+   };
+   const auto unmount = [](const Source& what) {
+      return 0 != PHYSFS_unmount(what.mNative.c_str());
+   };
+
+   const auto count = mSources.size();
+   if (at == 0)
+      return mount(source, false);
+   if (at == count)
+      return mount(source, true);
+
+   // Sources that couldn't be mounted back                             
+   std::vector<size_t> lost;
+   bool attached;
+   if (at <= count - at) {
+      // Detach the front, starting from the very first source          
+      size_t detached = 0;
+      while (detached < at and unmount(*mSources[detached]))
+         ++detached;
+
+      attached = detached == at and mount(source, false);
+      while (detached > 0) {
+         --detached;
+         if (not mount(*mSources[detached], false))
+            lost.push_back(detached);
+      }
+   }
+   else {
+      // Detach the back, starting from the very last source            
+      size_t detached = count;
+      while (detached > at and unmount(*mSources[detached - 1]))
+         --detached;
+
+      attached = detached == at and mount(source, true);
+      for (; detached < count; ++detached) {
+         if (not mount(*mSources[detached], true))
+            lost.push_back(detached);
+      }
+   }
+
+   if (lost.empty())
+      return attached;
+
+   // Roll the new source back, because the order it was attached in    
+   // is no longer valid, and forget the lost ones, starting from the   
+   // back, so that indices remain valid                                
+   if (attached)
+      unmount(source);
+   std::ranges::sort(lost, std::greater {});
+   for (auto index : lost)
+      Forget(index);
+   return false;
+}
+
+/// Get info about a virtual path, without searching through PhysFS           
+///   @param path - the virtual path                                          
+///   @param info - [out] the path info, only set if path was found           
+///   @param native - [out] where the path is on disk, only set if it was     
+///                   found inside a directory mount                          
+///   @return whether path was found, or has to be checked through PhysFS     
+auto MountTable::Stat(
+   std::string_view path, PHYSFS_Stat& info, std::string* native
+) const -> Lookup {
+   const auto normalized = NormalizePath(path, false);
+   const auto key = NormalizePath(normalized, true);
+
+   std::shared_lock lock {mMutex};
+   if (key.empty() or mMountParents.contains(key))
+      return Unknown;
+
+   // Archives that contain the path only in another case don't count   
+   const Indexed* indexed = nullptr;
+   const auto found = mIndex.find(key);
+   if (found != mIndex.end()) {
+      for (auto& candidate : found->second) {
+         if ((candidate.mPath.empty() ? key : candidate.mPath) == normalized) {
+            indexed = &candidate;
+            break;
+         }
+      }
+   }
+
+   // Only directories mounted at one of the path's parents can contain 
+   // it, and only those searched before the archive that contains it   
+   // have to be asked. Their number doesn't depend on how many sources 
+   // are mounted elsewhere                                             
+   std::vector<const Source*> directories;
+   const auto gather = [&](std::string_view mountKey) {
+      const auto bucket = mDirectories.find(mountKey);
+      if (bucket == mDirectories.end())
+         return;
+
+      for (auto source : bucket->second) {
+         if (indexed and not Precedes(*source, *indexed->mSource))
+            break;
+         directories.push_back(source);
+      }
+   };
+
+   gather({});
+   auto separator = key.find('/');
+   while (separator != std::string::npos) {
+      gather(std::string_view {key}.substr(0, separator));
+      separator = key.find('/', separator + 1);
+   }
+
+   if (directories.size() > 1)
+      std::ranges::sort(directories, [](auto lhs, auto rhs) {
+         return Precedes(*lhs, *rhs);
+      });
+
+   const bool followLinks = PHYSFS_symbolicLinksPermitted();
+   for (auto source : directories) {
+      auto relative = std::string_view {normalized};
+      if (not source->mKey.empty())
+         relative.remove_prefix(source->mKey.size() + 1);
+
+      auto full = (std::filesystem::path {source->mNative} / relative)
+         .string();
+      if (Native::Stat(full, info, followLinks)) {
+         if (native)
+            *native = std::move(full);
+         return Found;
+      }
+   }
+
+   if (not indexed)
+      return Missing;
+
+   info = indexed->mInfo;
+   return Found;
+}
+
+/// Get a number that changes whenever sources are added or removed, to be    
+/// able to tell if a failed mount changed anything                           
+///   @return the generation                                                  
+uint64_t MountTable::GetGeneration() const {
+   std::shared_lock lock {mMutex};
+   return mGeneration;
+}
@@ -0,0 +1,111 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#pragma once
+#include "Common.hpp"
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+///                                                                           
+///   Mount table                                                             
+///                                                                           
+///   Keeps track of everything mounted in PhysFS, ordered by priority -      
+/// mounts with higher priority are searched first, and among mounts with     
+/// equal priority, the latest one wins, so patches override what they patch  
+///   PhysFS searches mounts one by one, asking each archive about a path.    
+/// To avoid that, the entries of each archive are indexed once, when it is   
+/// mounted, in a single hash map shared by all archives. Only directory      
+/// mounts - whose contents can change at any time - are still asked,         
+/// directly through the OS, and only those mounted at one of the path's      
+/// parents, which are found by their mount point, instead of walking all     
+/// mounts. Paths that aren't in the index, and in none of those directories, 
+/// don't exist, which is answered without ever calling PhysFS                
+///   Archives are indexed without case, but PhysFS opens archived files      
+/// case-sensitively, so an indexed entry answers only for the exact case it  
+/// was archived in                                                           
+///   Mounts must go through this table, or the index will be out of date     
+///                                                                           
+struct MountTable {
+   enum Lookup {
+      Missing,       // Path definitely doesn't exist
+      Found,         // Path exists, and its info was provided
+      Unknown        // Path has to be checked through PhysFS
+   };
+
+private:
+   struct Source {
+      // The native path, as given to PhysFS                            
+      std::string mNative;
+      // Where the source is mounted, as given to PhysFS                
+      std::string mMountPoint;
+      // Normalized lowercase mount point, without surrounding slashes  
+      std::string mKey;
+      int mPriority;
+      uint64_t mSequence;
+      bool mIsArchive;
+      // Index keys of all archive entries, to be able to unmount       
+      std::vector<std::string> mEntries;
+   };
+
+   struct Indexed {
+      const Source* mSource;
+      PHYSFS_Stat mInfo;
+      // The virtual path in the case it was archived in, empty if it's 
+      // the same as its lowercase index key                            
+      std::string mPath;
+   };
+
+   struct Hash {
+      using is_transparent = void;
+      size_t operator () (std::string_view key) const noexcept {
+         return std::hash<std::string_view> {}(key);
+      }
+   };
+
+   // Mounted sources, in search order                                  
+   std::vector<std::unique_ptr<Source>> mSources;
+   // Directory mounts by their mount key, each list in search order    
+   std::unordered_map<std::string, std::vector<const Source*>,
+      Hash, std::equal_to<>> mDirectories;
+   // Entries of all mounted archives, by normalized lowercase virtual  
+   // path. Each path lists the archives that contain it, in search order
+   std::unordered_map<std::string, std::vector<Indexed>> mIndex;
+   // Directories that exist only because something is mounted inside   
+   // them, along with the number of such mounts                        
+   std::unordered_map<std::string, Count> mMountParents;
+   // Incremented on each mount, so that equal priorities can be ordered
+   uint64_t mSequence = 0;
+   // Incremented whenever sources are added or removed                 
+   uint64_t mGeneration = 0;
+   // Lookups are frequent, mounts are rare                             
+   mutable std::shared_mutex mMutex;
+
+   static bool Precedes(const Source&, const Source&) noexcept;
+
+   using Scanned = std::vector<std::pair<std::string, PHYSFS_Stat>>;
+
+   static bool Scan(const Source&, Scanned&);
+   bool Attach(size_t, const Source&);
+   bool Remove(size_t);
+   void Forget(size_t);
+
+public:
+   bool Mount(std::string_view native, std::string_view mountPoint, int);
+   bool Unmount(std::string_view native);
+
+   Lookup Stat(std::string_view, PHYSFS_Stat&,
+      std::string* native = nullptr) const;
+
+   uint64_t GetGeneration() const;
+};
@@ -0,0 +1,839 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#include "Native.hpp"
+#include <src/physfs.h>
+#include <filesystem>
+#include <string_view>
+#include <algorithm>
+#include <new>
+#include <utility>
+
+#if defined(_WIN32)
+   #define WIN32_LEAN_AND_MEAN
+   #define NOMINMAX
+   #include <windows.h>
+#else
+   #include <sys/mman.h>
+   #include <sys/stat.h>
+   #include <sys/uio.h>
+   #include <climits>
+   #include <cerrno>
+   #include <fcntl.h>
+   #include <unistd.h>
+#endif
+
+
+namespace Native
+{
+
+#if defined(__linux__) or defined(__FreeBSD__)
+   static_assert(sizeof(Slice) == sizeof(iovec)
+      and offsetof(Slice, mData) == offsetof(iovec, iov_base)
+      and offsetof(Slice, mSize) == offsetof(iovec, iov_len),
+      "Slices are passed to preadv/pwritev as they are");
+#endif
+
+   /// Find the real location of a virtual file or directory on disk          
+   ///   @param path - the virtual path, as seen by PhysFS                    
+   ///   @return the native path, or an empty string if path doesn't reside   
+   ///           inside a native directory mount (i.e. it is inside an        
+   ///           archive, or doesn't exist at all)                            
+   auto ResolvePath(const char* path) -> std::string {
+      const auto realDir = PHYSFS_getRealDir(path);
+      if (not realDir)
+         return {};
+
+      std::error_code ec;
+      if (not std::filesystem::is_directory(realDir, ec))
+         return {};
+
+      // Strip the mount point from the virtual path, if any            
+      std::string relative {path};
+      const auto mountPoint = PHYSFS_getMountPoint(realDir);
+      if (mountPoint) {
+         const std::string mount {mountPoint};
+         if (mount != "/" and relative.starts_with(mount))
+            relative.erase(0, mount.size());
+      }
+
+      while (not relative.empty() and relative.front() == '/')
+         relative.erase(0, 1);
+
+      const auto native = std::filesystem::path {realDir} / relative;
+      if (not std::filesystem::exists(native, ec))
+         return {};
+      return native.string();
+   }
+
+   /// Find where a virtual file or directory would be written on disk        
+   /// Unlike ResolvePath, the path doesn't have to exist                     
+   ///   @param path - the virtual path, as seen by PhysFS                    
+   ///   @return the native path, or an empty string if there's no write dir  
+   auto ResolveWritePath(const char* path) -> std::string {
+      const auto writeDir = PHYSFS_getWriteDir();
+      if (not writeDir)
+         return {};
+
+      while (*path == '/')
+         ++path;
+      return (std::filesystem::path {writeDir} / path).string();
+   }
+
+   /// Find the real location of a virtual directory, but only if its whole   
+   /// contents come from that single native directory. PhysFS merges all     
+   /// mounts that contain a path, and mounts nested inside the directory     
+   /// add entries to it too - in both cases the native directory alone       
+   /// doesn't tell the whole story                                           
+   ///   @param path - the virtual directory path, as seen by PhysFS          
+   ///   @return the native path, or an empty string if directory has to      
+   ///           be enumerated through PhysFS                                 
+   auto ResolveSoleDirectory(const char* path) -> std::string {
+      std::string_view dir {path};
+      while (not dir.empty() and dir.front() == '/')
+         dir.remove_prefix(1);
+      while (not dir.empty() and dir.back() == '/')
+         dir.remove_suffix(1);
+
+      const auto searchPath = PHYSFS_getSearchPath();
+      if (not searchPath)
+         return {};
+
+      std::string result;
+      bool sole = true;
+      std::error_code ec;
+      for (auto source = searchPath; *source and sole; ++source) {
+         std::string_view mount {PHYSFS_getMountPoint(*source)};
+         while (not mount.empty() and mount.front() == '/')
+            mount.remove_prefix(1);
+         while (not mount.empty() and mount.back() == '/')
+            mount.remove_suffix(1);
+
+         const bool covers = mount.empty() or dir == mount
+            or (dir.starts_with(mount) and dir[mount.size()] == '/');
+         if (not covers) {
+            // A mount point inside the directory adds an entry to it   
+            if (dir.empty() or (mount.starts_with(dir)
+            and mount[dir.size()] == '/'))
+               sole = false;
+            continue;
+         }
+
+         // Archives could contain the directory, and we can't tell     
+         // without looking inside                                      
+         if (not std::filesystem::is_directory(*source, ec)) {
+            sole = false;
+            break;
+         }
+
+         auto relative = dir.substr(mount.size());
+         while (not relative.empty() and relative.front() == '/')
+            relative.remove_prefix(1);
+
+         const auto native = std::filesystem::path {*source} / relative;
+         if (not std::filesystem::is_directory(native, ec))
+            continue;
+
+         if (result.empty())
+            result = native.string();
+         else
+            sole = false;
+      }
+
+      PHYSFS_freeList(searchPath);
+      return sole ? result : std::string {};
+   }
+
+   /// Get info about a native file or directory, the same way PhysFS does    
+   /// for directory mounts, but without searching through all mounts         
+   ///   @param path - the native path                                        
+   ///   @param info - [out] the path info, only set if path exists           
+   ///   @param followLinks - whether symbolic links are permitted            
+   ///   @return true if path exists                                          
+   bool Stat(const std::string& path, PHYSFS_Stat& info, bool followLinks) {
+   #if defined(_WIN32)
+      (void) followLinks;
+      WIN32_FILE_ATTRIBUTE_DATA data;
+      if (not GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &data))
+         return false;
+
+      // File times are in 100ns intervals since 1601                   
+      const auto toUnix = [](const FILETIME& time) {
+         const auto ticks = (static_cast<int64_t>(time.dwHighDateTime) << 32)
+            | time.dwLowDateTime;
+         return (ticks - 116444736000000000LL) / 10000000LL;
+      };
+
+      const bool folder = data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY;
+      info.filetype = folder
+         ? PHYSFS_FILETYPE_DIRECTORY : PHYSFS_FILETYPE_REGULAR;
+      info.filesize = folder ? 0 : static_cast<PHYSFS_sint64>(
+         (static_cast<uint64_t>(data.nFileSizeHigh) << 32)
+         | data.nFileSizeLow);
+      info.modtime = toUnix(data.ftLastWriteTime);
+      info.createtime = toUnix(data.ftCreationTime);
+      info.accesstime = toUnix(data.ftLastAccessTime);
+      info.readonly = (data.dwFileAttributes & FILE_ATTRIBUTE_READONLY) != 0;
+   #else
+      struct stat native;
+      if (0 != ::lstat(path.c_str(), &native))
+         return false;
+
+      if (S_ISLNK(native.st_mode)) {
+         // PhysFS pretends forbidden links don't exist                 
+         if (not followLinks)
+            return false;
+         info.filetype = PHYSFS_FILETYPE_SYMLINK;
+         info.filesize = 0;
+      }
+      else if (S_ISREG(native.st_mode)) {
+         info.filetype = PHYSFS_FILETYPE_REGULAR;
+         info.filesize = native.st_size;
+      }
+      else if (S_ISDIR(native.st_mode)) {
+         info.filetype = PHYSFS_FILETYPE_DIRECTORY;
+         info.filesize = 0;
+      }
+      else {
+         info.filetype = PHYSFS_FILETYPE_OTHER;
+         info.filesize = native.st_size;
+      }
+
+      info.modtime = native.st_mtime;
+      info.createtime = native.st_ctime;
+      info.accesstime = native.st_atime;
+      info.readonly = 0 != ::access(path.c_str(), W_OK);
+   #endif
+      return true;
+   }
+
+   /// Make files and directories durable, each with its own sync             
+   /// Directories are synced, so that renames inside them are durable. Only  
+   /// the given paths are flushed, and their own writeback errors are        
+   /// reported, unlike when syncing the whole file system                    
+   ///   @param paths - native paths of the files and directories to sync     
+   ///   @return true if all of them were synced                              
+   bool SyncAll(std::span<const std::string> paths) {
+      bool success = true;
+   #if defined(_WIN32)
+      for (auto& path : paths) {
+         // Directory entries are journaled by NTFS, and can't be flushed
+         const auto attributes = GetFileAttributesA(path.c_str());
+         if (attributes == INVALID_FILE_ATTRIBUTES) {
+            success = false;
+            continue;
+         }
+         if (attributes & FILE_ATTRIBUTE_DIRECTORY)
+            continue;
+
+         Descriptor file;
+         if (not file.Open(path, true) or not file.Sync())
+            success = false;
+      }
+   #else
+      for (auto& path : paths) {
+         // Directories can only be opened for reading, which is enough 
+         Descriptor file;
+         if (not file.Open(path) or not file.Sync())
+            success = false;
+      }
+   #endif
+      return success;
+   }
+
+
+
+   ///                                                                        
+   ///   Native descriptor implementation                                     
+   ///                                                                        
+
+   /// Close descriptor on destruction                                        
+   Descriptor::~Descriptor() {
+      Close();
+   }
+
+   /// Open an existing native file for positional reading or writing         
+   ///   @param path - the native file path                                   
+   ///   @param writable - true to open for writing, instead of reading       
+   ///   @return true if file was opened                                      
+   bool Descriptor::Open(const std::string& path, bool writable) {
+      Close();
+
+   #if defined(_WIN32)
+      const auto handle = CreateFileA(
+         path.c_str(), writable ? GENERIC_WRITE : GENERIC_READ,
+         FILE_SHARE_READ | FILE_SHARE_WRITE,
+         nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr
+      );
+      if (handle == INVALID_HANDLE_VALUE)
+         return false;
+      mHandle = handle;
+   #else
+      mHandle = ::open(path.c_str(),
+         (writable ? O_WRONLY : O_RDONLY) | O_CLOEXEC);
+      if (mHandle < 0)
+         return false;
+   #endif
+      return true;
+   }
+
+   /// Create a native file for positional writing, or truncate it, if it     
+   /// already exists                                                         
+   ///   @param path - the native file path                                   
+   ///   @return true if file was created                                     
+   bool Descriptor::Create(const std::string& path) {
+      Close();
+
+   #if defined(_WIN32)
+      const auto handle = CreateFileA(
+         path.c_str(), GENERIC_WRITE, FILE_SHARE_READ,
+         nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr
+      );
+      if (handle == INVALID_HANDLE_VALUE)
+         return false;
+      mHandle = handle;
+   #else
+      mHandle = ::open(path.c_str(),
+         O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+      if (mHandle < 0)
+         return false;
+   #endif
+      return true;
+   }
+
+   /// Open a native file, bypassing the page cache where possible            
+   /// Where direct I/O isn't available at all, or isn't supported by the     
+   /// file system (i.e. tmpfs), the file is opened normally, and IsDirect()  
+   /// is false - use DontNeed to drop what was cached instead                
+   ///   @param path - the native file path                                   
+   ///   @param writable - true to open for reading and writing, creating the 
+   ///                     file if it doesn't exist, instead of only reading  
+   ///   @param truncate - true to discard contents, when writable            
+   ///   @return true if file was opened                                      
+   bool Descriptor::OpenDirect(
+      const std::string& path, bool writable, bool truncate
+   ) {
+      Close();
+
+   #if defined(_WIN32)
+      const DWORD disposition = not writable ? OPEN_EXISTING
+         : truncate ? CREATE_ALWAYS : OPEN_ALWAYS;
+      const DWORD access = writable
+         ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ;
+      auto handle = CreateFileA(
+         path.c_str(), access,
+         FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, disposition,
+         FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING, nullptr
+      );
+      mDirect = handle != INVALID_HANDLE_VALUE;
+      if (not mDirect) {
+         handle = CreateFileA(
+            path.c_str(), access,
+            FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, disposition,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr
+         );
+         if (handle == INVALID_HANDLE_VALUE)
+            return false;
+      }
+      mHandle = handle;
+   #else
+      int flags = O_CLOEXEC | (writable ? O_RDWR | O_CREAT : O_RDONLY);
+      if (writable and truncate)
+         flags |= O_TRUNC;
+
+      #if defined(O_DIRECT)
+         mHandle = ::open(path.c_str(), flags | O_DIRECT, 0666);
+         mDirect = mHandle >= 0;
+         if (not mDirect and errno != EINVAL)
+            return false;
+      #endif
+
+      if (not mDirect) {
+         mHandle = ::open(path.c_str(), flags, 0666);
+         if (mHandle < 0)
+            return false;
+
+         #if defined(F_NOCACHE)
+            // Unaligned, but uncached nonetheless                      
+            ::fcntl(mHandle, F_NOCACHE, 1);
+         #endif
+      }
+   #endif
+      return true;
+   }
+
+   /// Close the descriptor, if opened                                        
+   void Descriptor::Close() noexcept {
+      mDirect = false;
+   #if defined(_WIN32)
+      if (mHandle)
+         CloseHandle(mHandle);
+      mHandle = nullptr;
+   #else
+      if (mHandle >= 0)
+         ::close(mHandle);
+      mHandle = -1;
+   #endif
+   }
+
+   /// Read bytes at a specific offset, without moving any file cursor        
+   ///   @param output - [out] where to read bytes into                       
+   ///   @param size - number of bytes to read                                
+   ///   @param offset - byte offset inside the file                          
+   ///   @return number of read bytes, zero on end of file, -1 on error       
+   int64_t Descriptor::ReadAt(
+      void* output, size_t size, uint64_t offset
+   ) const noexcept {
+   #if defined(_WIN32)
+      OVERLAPPED position {};
+      position.Offset = static_cast<DWORD>(offset & 0xFFFFFFFF);
+      position.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+      DWORD read = 0;
+      const auto chunk = static_cast<DWORD>(
+         std::min<size_t>(size, 0x40000000));
+      if (ReadFile(mHandle, output, chunk, &read, &position))
+         return static_cast<int64_t>(read);
+
+      // Reading past the end fails, but it is not an error             
+      LARGE_INTEGER fileSize;
+      if (GetFileSizeEx(mHandle, &fileSize)
+      and static_cast<uint64_t>(fileSize.QuadPart) <= offset)
+         return 0;
+      return -1;
+   #else
+      ssize_t result;
+      do result = ::pread(mHandle, output, size, static_cast<off_t>(offset));
+      while (result < 0 and errno == EINTR);
+      return static_cast<int64_t>(result);
+   #endif
+   }
+
+   /// Read bytes at a specific offset into multiple regions, in order        
+   /// Uses a single system call per batch of regions where available, and    
+   /// a positional read per region otherwise. Regions are modified, so that  
+   /// they describe what is left, if the call fails midway                   
+   ///   @param slices - [in/out] the regions to read into                    
+   ///   @param count - number of regions                                     
+   ///   @param offset - byte offset inside the file                          
+   ///   @return number of read bytes, less than the total only at end of     
+   ///           file, -1 on error                                            
+   int64_t Descriptor::ReadAtV(
+      Slice* slices, size_t count, uint64_t offset
+   ) const noexcept {
+      int64_t done = 0;
+   #if defined(__linux__) or defined(__FreeBSD__)
+      while (count and not slices->mSize) {
+         ++slices;
+         --count;
+      }
+
+      while (count) {
+         const auto batch = static_cast<int>(std::min<size_t>(count, IOV_MAX));
+         ssize_t result;
+         do result = ::preadv(mHandle, reinterpret_cast<iovec*>(slices),
+            batch, static_cast<off_t>(offset + done));
+         while (result < 0 and errno == EINTR);
+         if (result < 0)
+            return -1;
+         if (result == 0)
+            break;
+
+         // Skip the regions that were filled, and trim the partial one 
+         done += result;
+         auto left = static_cast<size_t>(result);
+         while (count and left >= slices->mSize) {
+            left -= slices->mSize;
+            ++slices;
+            --count;
+         }
+         if (count) {
+            slices->mData = static_cast<char*>(slices->mData) + left;
+            slices->mSize -= left;
+         }
+      }
+   #else
+      for (; count; ++slices, --count) {
+         while (slices->mSize) {
+            const auto result = ReadAt(
+               slices->mData, slices->mSize, offset + done);
+            if (result < 0)
+               return -1;
+            if (result == 0)
+               return done;
+
+            done += result;
+            slices->mData = static_cast<char*>(slices->mData) + result;
+            slices->mSize -= static_cast<size_t>(result);
+         }
+      }
+   #endif
+      return done;
+   }
+
+   /// Write bytes at a specific offset from multiple regions, in order       
+   /// Uses a single system call per batch of regions where available, and    
+   /// a positional write per region otherwise. Regions are modified, so      
+   /// that they describe what is left, if the call fails midway              
+   ///   @param slices - [in/out] the regions to write                        
+   ///   @param count - number of regions                                     
+   ///   @param offset - byte offset inside the file                          
+   ///   @return number of written bytes, or -1 on error                      
+   int64_t Descriptor::WriteAtV(
+      Slice* slices, size_t count, uint64_t offset
+   ) const noexcept {
+      int64_t done = 0;
+   #if defined(__linux__) or defined(__FreeBSD__)
+      while (count and not slices->mSize) {
+         ++slices;
+         --count;
+      }
+
+      while (count) {
+         const auto batch = static_cast<int>(std::min<size_t>(count, IOV_MAX));
+         ssize_t result;
+         do result = ::pwritev(mHandle, reinterpret_cast<iovec*>(slices),
+            batch, static_cast<off_t>(offset + done));
+         while (result < 0 and errno == EINTR);
+         if (result <= 0)
+            return -1;
+
+         done += result;
+         auto left = static_cast<size_t>(result);
+         while (count and left >= slices->mSize) {
+            left -= slices->mSize;
+            ++slices;
+            --count;
+         }
+         if (count) {
+            slices->mData = static_cast<char*>(slices->mData) + left;
+            slices->mSize -= left;
+         }
+      }
+   #elif defined(_WIN32)
+      for (; count; ++slices, --count) {
+         while (slices->mSize) {
+            OVERLAPPED position {};
+            position.Offset = static_cast<DWORD>((offset + done) & 0xFFFFFFFF);
+            position.OffsetHigh = static_cast<DWORD>((offset + done) >> 32);
+
+            DWORD written = 0;
+            const auto chunk = static_cast<DWORD>(
+               std::min<size_t>(slices->mSize, 0x40000000));
+            if (not WriteFile(mHandle, slices->mData, chunk, &written,
+               &position) or not written)
+               return -1;
+
+            done += written;
+            slices->mData = static_cast<char*>(slices->mData) + written;
+            slices->mSize -= written;
+         }
+      }
+   #else
+      for (; count; ++slices, --count) {
+         while (slices->mSize) {
+            ssize_t result;
+            do result = ::pwrite(mHandle, slices->mData, slices->mSize,
+               static_cast<off_t>(offset + done));
+            while (result < 0 and errno == EINTR);
+            if (result <= 0)
+               return -1;
+
+            done += result;
+            slices->mData = static_cast<char*>(slices->mData) + result;
+            slices->mSize -= static_cast<size_t>(result);
+         }
+      }
+   #endif
+      return done;
+   }
+
+   /// Hint the OS that a range will be read soon, so that it starts reading  
+   /// it into the page cache in the background                               
+   ///   @param offset - byte offset inside the file                          
+   ///   @param size - number of bytes, zero for everything after offset      
+   ///   @return false if the OS doesn't support such hints                   
+   bool Descriptor::WillNeed(uint64_t offset, size_t size) const noexcept {
+   #if defined(_WIN32)
+      (void) offset;
+      (void) size;
+      return false;
+   #elif defined(__APPLE__)
+      radvisory advice {};
+      advice.ra_offset = static_cast<off_t>(offset);
+      advice.ra_count = static_cast<int>(
+         std::min<size_t>(size ? size : INT32_MAX, INT32_MAX));
+      return ::fcntl(mHandle, F_RDADVISE, &advice) != -1;
+   #else
+      return 0 == ::posix_fadvise(mHandle, static_cast<off_t>(offset),
+         static_cast<off_t>(size), POSIX_FADV_WILLNEED);
+   #endif
+   }
+
+   /// Hint the OS that a range won't be needed again, so that it drops it    
+   /// from the page cache. Dirty pages can't be dropped, so on Linux written 
+   /// ranges are flushed first                                               
+   ///   @param offset - byte offset inside the file                          
+   ///   @param size - number of bytes, zero for everything after offset      
+   ///   @return false if the OS doesn't support such hints                   
+   bool Descriptor::DontNeed(uint64_t offset, size_t size) const noexcept {
+   #if defined(_WIN32) or defined(__APPLE__)
+      // Files are opened uncached there, when it matters               
+      (void) offset;
+      (void) size;
+      return false;
+   #else
+      #if defined(__linux__)
+         ::sync_file_range(mHandle, static_cast<off_t>(offset),
+            static_cast<off_t>(size), SYNC_FILE_RANGE_WAIT_BEFORE
+            | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+      #endif
+
+      return 0 == ::posix_fadvise(mHandle, static_cast<off_t>(offset),
+         static_cast<off_t>(size), POSIX_FADV_DONTNEED);
+   #endif
+   }
+
+   /// Wait until everything written through the descriptor is on disk        
+   /// On macOS fsync only reaches the drive's cache, so a full sync is       
+   /// requested, falling back to fsync where it isn't supported              
+   ///   @return true on success                                              
+   bool Descriptor::Sync() const noexcept {
+   #if defined(_WIN32)
+      return FlushFileBuffers(mHandle);
+   #else
+      #if defined(F_FULLFSYNC)
+         if (::fcntl(mHandle, F_FULLFSYNC) != -1)
+            return true;
+      #endif
+
+      int result;
+      do result = ::fsync(mHandle);
+      while (result < 0 and errno == EINTR);
+      return result == 0;
+   #endif
+   }
+
+   /// Change the size of the file, discarding or zero-filling its end        
+   ///   @param size - the new size in bytes                                  
+   ///   @return true on success                                              
+   bool Descriptor::Truncate(uint64_t size) const noexcept {
+   #if defined(_WIN32)
+      FILE_END_OF_FILE_INFO info {};
+      info.EndOfFile.QuadPart = static_cast<LONGLONG>(size);
+      return SetFileInformationByHandle(
+         mHandle, FileEndOfFileInfo, &info, sizeof(info));
+   #else
+      int result;
+      do result = ::ftruncate(mHandle, static_cast<off_t>(size));
+      while (result < 0 and errno == EINTR);
+      return result == 0;
+   #endif
+   }
+
+   /// Get the current size of the file                                       
+   ///   @return the size in bytes, or -1 on error                            
+   int64_t Descriptor::GetSize() const noexcept {
+   #if defined(_WIN32)
+      LARGE_INTEGER size;
+      if (not GetFileSizeEx(mHandle, &size))
+         return -1;
+      return static_cast<int64_t>(size.QuadPart);
+   #else
+      struct stat info;
+      if (::fstat(mHandle, &info) != 0)
+         return -1;
+      return static_cast<int64_t>(info.st_size);
+   #endif
+   }
+
+   /// Check if descriptor is opened                                          
+   Descriptor::operator bool() const noexcept {
+   #if defined(_WIN32)
+      return mHandle != nullptr;
+   #else
+      return mHandle >= 0;
+   #endif
+   }
+
+
+
+   ///                                                                        
+   ///   Aligned buffer implementation                                        
+   ///                                                                        
+
+   /// Free the buffer on destruction                                         
+   AlignedBuffer::~AlignedBuffer() {
+      if (mData)
+         ::operator delete[](mData, std::align_val_t {DirectAlignment});
+   }
+
+   /// Allocate the buffer, discarding its previous contents                  
+   ///   @param size - the size in bytes, rounded up to DirectAlignment       
+   void AlignedBuffer::Allocate(size_t size) {
+      size = (size + DirectAlignment - 1) / DirectAlignment * DirectAlignment;
+      if (size == mSize)
+         return;
+
+      const auto data = static_cast<std::byte*>(::operator new[](
+         size, std::align_val_t {DirectAlignment}));
+      if (mData)
+         ::operator delete[](mData, std::align_val_t {DirectAlignment});
+      mData = data;
+      mSize = size;
+   }
+
+
+
+   ///                                                                        
+   ///   Memory mapping implementation                                        
+   ///                                                                        
+
+   /// Move-construct a mapping                                               
+   ///   @param other - the mapping to move                                   
+   Mapping::Mapping(Mapping&& other) noexcept {
+      *this = std::move(other);
+   }
+
+   /// Unmap on destruction                                                   
+   Mapping::~Mapping() {
+      Close();
+   }
+
+   /// Move-assign a mapping                                                  
+   ///   @param other - the mapping to move                                   
+   ///   @return a reference to this mapping                                  
+   Mapping& Mapping::operator = (Mapping&& other) noexcept {
+      if (this == &other)
+         return *this;
+
+      Close();
+      mBase = std::exchange(other.mBase, nullptr);
+      mMappedSize = std::exchange(other.mMappedSize, 0);
+      mView = std::exchange(other.mView, nullptr);
+      mViewSize = std::exchange(other.mViewSize, 0);
+   #if defined(_WIN32)
+      mMappingHandle = std::exchange(other.mMappingHandle, nullptr);
+   #endif
+      return *this;
+   }
+
+   /// Map a region of a native file in memory for reading                    
+   ///   @param path - the native file path                                   
+   ///   @param offset - byte offset of the region, doesn't have to be aligned
+   ///   @param size - size of the region in bytes, zero to map up to the end 
+   ///   @return true if region was mapped                                    
+   bool Mapping::Open(const std::string& path, size_t offset, size_t size) {
+      Close();
+
+   #if defined(_WIN32)
+      const auto file = CreateFileA(
+         path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+         nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr
+      );
+      if (file == INVALID_HANDLE_VALUE)
+         return false;
+
+      LARGE_INTEGER fileSize;
+      if (not GetFileSizeEx(file, &fileSize)
+      or static_cast<size_t>(fileSize.QuadPart) <= offset) {
+         CloseHandle(file);
+         return false;
+      }
+
+      const auto available = static_cast<size_t>(fileSize.QuadPart) - offset;
+      if (not size or size > available)
+         size = available;
+
+      // The mapping object keeps the file alive on its own             
+      mMappingHandle = CreateFileMappingA(
+         file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      CloseHandle(file);
+      if (not mMappingHandle)
+         return false;
+
+      SYSTEM_INFO info;
+      GetSystemInfo(&info);
+      const size_t granularity = info.dwAllocationGranularity;
+      const auto base = offset - offset % granularity;
+      mMappedSize = size + (offset - base);
+      mBase = MapViewOfFile(
+         mMappingHandle, FILE_MAP_READ,
+         static_cast<DWORD>(static_cast<uint64_t>(base) >> 32),
+         static_cast<DWORD>(base & 0xFFFFFFFF),
+         mMappedSize
+      );
+
+      if (not mBase) {
+         CloseHandle(mMappingHandle);
+         mMappingHandle = nullptr;
+         mMappedSize = 0;
+         return false;
+      }
+   #else
+      const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+      if (fd < 0)
+         return false;
+
+      struct stat info;
+      if (0 != ::fstat(fd, &info)
+      or static_cast<size_t>(info.st_size) <= offset) {
+         ::close(fd);
+         return false;
+      }
+
+      const auto available = static_cast<size_t>(info.st_size) - offset;
+      if (not size or size > available)
+         size = available;
+
+      static const auto granularity =
+         static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+      const auto base = offset - offset % granularity;
+      mMappedSize = size + (offset - base);
+
+      // The mapping keeps the file alive, so descriptor can be closed  
+      mBase = ::mmap(
+         nullptr, mMappedSize, PROT_READ, MAP_SHARED, fd,
+         static_cast<off_t>(base)
+      );
+      ::close(fd);
+
+      if (mBase == MAP_FAILED) {
+         mBase = nullptr;
+         mMappedSize = 0;
+         return false;
+      }
+
+      // Big assets are almost always consumed front to back            
+      ::madvise(mBase, mMappedSize, MADV_SEQUENTIAL);
+   #endif
+
+      mView = static_cast<const std::byte*>(mBase) + (offset - base);
+      mViewSize = size;
+      return true;
+   }
+
+   /// Unmap the region, if mapped                                            
+   void Mapping::Close() noexcept {
+      if (not mBase)
+         return;
+
+   #if defined(_WIN32)
+      UnmapViewOfFile(mBase);
+      CloseHandle(mMappingHandle);
+      mMappingHandle = nullptr;
+   #else
+      ::munmap(mBase, mMappedSize);
+   #endif
+
+      mBase = nullptr;
+      mMappedSize = 0;
+      mView = nullptr;
+      mViewSize = 0;
+   }
+
+} // namespace Native
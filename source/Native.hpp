@@ -0,0 +1,152 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+struct PHYSFS_Stat;
+
+///                                                                           
+///   Native file system helpers                                              
+///                                                                           
+///   PhysFS hides where a file actually lives, which is usually what we      
+/// want. Some fast paths (memory mapping, positional reads) however need     
+/// to talk to the operating system directly, and are only available for      
+/// files that reside inside a native directory mount                         
+///   These helpers intentionally don't depend on the rest of the module, so  
+/// that OS headers never meet Langulus/PhysFS declarations                   
+///                                                                           
+namespace Native
+{
+
+   auto ResolvePath(const char*) -> std::string;
+   auto ResolveWritePath(const char*) -> std::string;
+   auto ResolveSoleDirectory(const char*) -> std::string;
+
+   bool Stat(const std::string&, PHYSFS_Stat&, bool followLinks);
+   bool SyncAll(std::span<const std::string>);
+
+   /// Direct I/O requires offsets, sizes and buffers aligned to the device's 
+   /// logical block size, which is never bigger than a page                  
+   constexpr size_t DirectAlignment = 4096;
+
+
+   ///                                                                        
+   ///   A contiguous region of memory, for vectored reads and writes         
+   ///                                                                        
+   struct Slice {
+      void* mData;
+      size_t mSize;
+   };
+
+
+   ///                                                                        
+   ///   Native file descriptor for positional reads and writes               
+   ///   Positional reads don't move any shared cursor, so a single           
+   ///   descriptor can be used from multiple threads simultaneously          
+   ///                                                                        
+   struct Descriptor {
+   private:
+   #if defined(_WIN32)
+      void* mHandle {};
+   #else
+      int mHandle = -1;
+   #endif
+      // True if I/O bypasses the page cache, and has to be aligned     
+      bool mDirect = false;
+
+   public:
+      Descriptor() = default;
+      Descriptor(const Descriptor&) = delete;
+     ~Descriptor();
+
+      Descriptor& operator = (const Descriptor&) = delete;
+
+      bool Open(const std::string&, bool writable = false);
+      bool Create(const std::string&);
+      bool OpenDirect(const std::string&, bool writable, bool truncate);
+      void Close() noexcept;
+      bool Sync() const noexcept;
+      bool Truncate(uint64_t size) const noexcept;
+      int64_t GetSize() const noexcept;
+
+      int64_t ReadAt(void*, size_t size, uint64_t offset) const noexcept;
+      int64_t ReadAtV(Slice*, size_t count, uint64_t offset) const noexcept;
+      int64_t WriteAtV(Slice*, size_t count, uint64_t offset) const noexcept;
+      bool WillNeed(uint64_t offset, size_t size) const noexcept;
+      bool DontNeed(uint64_t offset, size_t size) const noexcept;
+
+      bool IsDirect() const noexcept { return mDirect; }
+      explicit operator bool() const noexcept;
+   };
+
+
+   ///                                                                        
+   ///   A memory block aligned for direct I/O                                
+   ///                                                                        
+   struct AlignedBuffer {
+   private:
+      std::byte* mData {};
+      size_t mSize {};
+
+   public:
+      AlignedBuffer() = default;
+      AlignedBuffer(const AlignedBuffer&) = delete;
+     ~AlignedBuffer();
+
+      AlignedBuffer& operator = (const AlignedBuffer&) = delete;
+
+      void Allocate(size_t);
+
+      auto GetRaw() const noexcept { return mData; }
+      auto GetSize() const noexcept { return mSize; }
+
+      explicit operator bool() const noexcept { return mData != nullptr; }
+   };
+
+
+   ///                                                                        
+   ///   Read-only memory mapping of a native file region                     
+   ///                                                                        
+   struct Mapping {
+   private:
+      // The page-aligned base address, as returned by the OS           
+      void* mBase {};
+      // Size of the page-aligned mapping                               
+      size_t mMappedSize {};
+      // The requested view inside the mapping                          
+      const std::byte* mView {};
+      // Size of the requested view in bytes                            
+      size_t mViewSize {};
+
+   #if defined(_WIN32)
+      // Handle of the file mapping object                              
+      void* mMappingHandle {};
+   #endif
+
+   public:
+      Mapping() = default;
+      Mapping(const Mapping&) = delete;
+      Mapping(Mapping&&) noexcept;
+     ~Mapping();
+
+      Mapping& operator = (const Mapping&) = delete;
+      Mapping& operator = (Mapping&&) noexcept;
+
+      bool Open(const std::string&, size_t offset = 0, size_t size = 0);
+      void Close() noexcept;
+
+      auto GetRaw() const noexcept { return mView; }
+      auto GetSize() const noexcept { return mViewSize; }
+
+      explicit operator bool() const noexcept { return mView != nullptr; }
+   };
+
+} // namespace Native
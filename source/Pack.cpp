@@ -0,0 +1,585 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#include "Pack.hpp"
+#include "PackFormat.hpp"
+#include "Native.hpp"
+#include <src/physfs.h>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#if LANGULUS_MOD_FILESYSTEM_LZ4
+   #include <lz4.h>
+#endif
+
+using namespace PackFormat;
+
+
+namespace Pack
+{
+   namespace
+   {
+
+      ///                                                                     
+      ///   An opened pack                                                    
+      ///                                                                     
+      struct Archive {
+         // The pack stream, owned once the pack is opened              
+         PHYSFS_Io* mIo {};
+         // The native path, as given to PhysFS                         
+         std::string mName;
+         // The mapped table of contents                                
+         Native::Mapping mMapping;
+         // A copy of the table of contents, if it couldn't be mapped   
+         std::unique_ptr<std::byte[]> mCopy;
+
+         const PackHeader* mHeader {};
+         const PackEntry* mEntries {};
+         const char* mNames {};
+
+         ~Archive() {
+            if (mIo)
+               mIo->destroy(mIo);
+         }
+
+         const PackEntry* Find(std::string_view name) const noexcept {
+            return PackFormat::Find(
+               mEntries, mHeader->mEntryCount, mNames, name);
+         }
+      };
+
+      ///                                                                     
+      ///   A stream over a single entry                                      
+      ///                                                                     
+      struct Reader {
+         const Archive* mArchive {};
+         const PackEntry* mEntry {};
+         // Own duplicate of the pack stream                            
+         PHYSFS_Io* mIo {};
+         // Position inside the entry                                   
+         uint64_t mPosition = 0;
+         // Position of mIo, to avoid redundant seeking                 
+         uint64_t mIoPosition = ~0ull;
+
+         // Chunk offsets, only for compressed entries                  
+         std::vector<uint64_t> mChunks;
+         // Last decompressed chunk, and its index                      
+         std::vector<char> mChunk;
+         uint64_t mLoaded = ~0ull;
+         // Compressed chunk scratch                                    
+         std::vector<char> mStored;
+
+         ~Reader() {
+            if (mIo)
+               mIo->destroy(mIo);
+         }
+      };
+
+      // Opened packs by native path, so that files inside them can be  
+      // located. Scanning, remounting, and reading packs happens from  
+      // different threads, hence the mutex                             
+      std::mutex Registry;
+      std::unordered_map<std::string, const Archive*> Opened;
+
+      /// Read exactly the requested number of bytes from a stream            
+      bool ReadExactly(PHYSFS_Io* io, void* output, uint64_t size) {
+         auto bytes = static_cast<char*>(output);
+         while (size) {
+            const auto read = io->read(io, bytes, size);
+            if (read <= 0)
+               return false;
+            bytes += read;
+            size -= static_cast<uint64_t>(read);
+         }
+         return true;
+      }
+
+      /// Read bytes at an offset in the pack, seeking only if necessary      
+      bool ReadAt(
+         Reader& reader, uint64_t offset, void* output, uint64_t size
+      ) {
+         if (reader.mIoPosition != offset) {
+            if (not reader.mIo->seek(reader.mIo, offset)) {
+               reader.mIoPosition = ~0ull;
+               return false;
+            }
+         }
+
+         reader.mIoPosition = ~0ull;
+         if (not ReadExactly(reader.mIo, output, size))
+            return false;
+         reader.mIoPosition = offset + size;
+         return true;
+      }
+
+      /// Check the table of contents, so that it can be used without any     
+      /// further bounds checking                                             
+      ///   @param archive - the archive to check                             
+      ///   @param length - size of the whole pack in bytes                   
+      ///   @return true if table of contents is valid                        
+      bool Validate(const Archive& archive, uint64_t length) {
+         const auto& header = *archive.mHeader;
+         std::string_view previous;
+         for (uint32_t i = 0; i < header.mEntryCount; ++i) {
+            const auto& entry = archive.mEntries[i];
+            if (uint64_t {entry.mNameOffset} + entry.mNameSize
+                > header.mNamesSize or not entry.mNameSize)
+               return false;
+
+            // Binary search relies on strictly ascending names         
+            const auto name = NameOf(archive.mNames, entry);
+            if (i and not (previous < name))
+               return false;
+            previous = name;
+
+            if (entry.mFlags & Directory)
+               continue;
+            if (entry.mOffset % header.mAlignment
+            or entry.mOffset > length
+            or entry.mStoredSize > length - entry.mOffset)
+               return false;
+
+            if (entry.mFlags & Compressed) {
+               if (not entry.mChunkSize)
+                  return false;
+               const auto chunks =
+                  (entry.mSize + entry.mChunkSize - 1) / entry.mChunkSize;
+               if ((chunks + 1) * sizeof(uint64_t) > entry.mStoredSize)
+                  return false;
+            }
+            else if (entry.mStoredSize != entry.mSize)
+               return false;
+         }
+         return true;
+      }
+
+      /// Load the table of contents of a pack                                
+      ///   @param archive - [out] the archive to load                        
+      ///   @param io - the pack stream                                       
+      ///   @param claimed - [out] set if stream is a pack at all             
+      ///   @return true on success                                           
+      bool Load(Archive& archive, PHYSFS_Io* io, int* claimed) {
+         PackHeader header;
+         if (not io->seek(io, 0)
+         or not ReadExactly(io, &header, sizeof(header))
+         or 0!= std::memcmp(header.mMagic, Magic, sizeof(Magic)))
+            return false;
+
+         *claimed = 1;
+         const auto length = io->length(io);
+         if (length < 0 or header.mVersion != Version
+         or not std::has_single_bit(header.mAlignment)
+         or header.mEntryCount > (uint64_t(length) / sizeof(PackEntry))
+         or header.mNamesSize > uint64_t(length)) {
+            PHYSFS_setErrorCode(PHYSFS_ERR_CORRUPT);
+            return false;
+         }
+
+         const auto entriesEnd = header.mEntriesOffset
+            + uint64_t {header.mEntryCount} * sizeof(PackEntry);
+         const auto namesEnd = header.mNamesOffset + header.mNamesSize;
+         const auto tocSize = std::max(entriesEnd, namesEnd);
+         if (entriesEnd < header.mEntriesOffset
+         or namesEnd < header.mNamesOffset
+         or tocSize > uint64_t(length)
+         or header.mEntriesOffset % alignof(PackEntry)) {
+            PHYSFS_setErrorCode(PHYSFS_ERR_CORRUPT);
+            return false;
+         }
+
+         // Map the table of contents if pack is a native file, otherwise
+         // (i.e. pack is inside another archive) keep a copy of it     
+         const std::byte* toc;
+         if (archive.mMapping.Open(archive.mName, 0, tocSize)
+         and archive.mMapping.GetSize() == tocSize)
+            toc = archive.mMapping.GetRaw();
+         else {
+            archive.mMapping.Close();
+            archive.mCopy.reset(new (std::nothrow) std::byte[tocSize]);
+            if (not archive.mCopy) {
+               PHYSFS_setErrorCode(PHYSFS_ERR_OUT_OF_MEMORY);
+               return false;
+            }
+            if (not io->seek(io, 0)
+            or not ReadExactly(io, archive.mCopy.get(), tocSize)) {
+               PHYSFS_setErrorCode(PHYSFS_ERR_IO);
+               return false;
+            }
+            toc = archive.mCopy.get();
+         }
+
+         archive.mHeader = reinterpret_cast<const PackHeader*>(toc);
+         archive.mEntries = reinterpret_cast<const PackEntry*>(
+            toc + header.mEntriesOffset);
+         archive.mNames = reinterpret_cast<const char*>(
+            toc + header.mNamesOffset);
+
+         if (not Validate(archive, uint64_t(length))) {
+            PHYSFS_setErrorCode(PHYSFS_ERR_CORRUPT);
+            return false;
+         }
+         return true;
+      }
+
+      /// Make sure a chunk of a compressed entry is decompressed             
+      ///   @param reader - the reader                                        
+      ///   @param index - the chunk index                                    
+      ///   @return true on success                                           
+      bool LoadChunk(Reader& reader, uint64_t index) {
+         if (reader.mLoaded == index)
+            return true;
+
+         const auto& entry = *reader.mEntry;
+         const auto from = reader.mChunks[index];
+         const auto stored = reader.mChunks[index + 1] - from;
+         const auto start = index * entry.mChunkSize;
+         const auto size = std::min<uint64_t>(
+            entry.mChunkSize, entry.mSize - start);
+         const auto at = entry.mOffset + from;
+
+         reader.mLoaded = ~0ull;
+         reader.mChunk.resize(size);
+         if (stored == size) {
+            // Chunk didn't compress, so it is stored as it is          
+            if (not ReadAt(reader, at, reader.mChunk.data(), size)) {
+               PHYSFS_setErrorCode(PHYSFS_ERR_IO);
+               return false;
+            }
+         }
+         else {
+         #if LANGULUS_MOD_FILESYSTEM_LZ4
+            reader.mStored.resize(stored);
+            if (not ReadAt(reader, at, reader.mStored.data(), stored)) {
+               PHYSFS_setErrorCode(PHYSFS_ERR_IO);
+               return false;
+            }
+
+            const auto result = LZ4_decompress_safe(
+               reader.mStored.data(), reader.mChunk.data(),
+               static_cast<int>(stored), static_cast<int>(size));
+            if (result < 0 or uint64_t(result) != size) {
+               PHYSFS_setErrorCode(PHYSFS_ERR_CORRUPT);
+               return false;
+            }
+         #else
+            PHYSFS_setErrorCode(PHYSFS_ERR_UNSUPPORTED);
+            return false;
+         #endif
+         }
+
+         reader.mLoaded = index;
+         return true;
+      }
+
+      PHYSFS_Io* MakeIo(const Archive&, const PackEntry&);
+
+      PHYSFS_sint64 IoRead(PHYSFS_Io* io, void* output, PHYSFS_uint64 size) {
+         auto& reader = *static_cast<Reader*>(io->opaque);
+         const auto& entry = *reader.mEntry;
+         if (reader.mPosition >= entry.mSize)
+            return 0;
+
+         size = std::min(size, entry.mSize - reader.mPosition);
+         if (not (entry.mFlags & Compressed)) {
+            const auto at = entry.mOffset + reader.mPosition;
+            if (not ReadAt(reader, at, output, size)) {
+               PHYSFS_setErrorCode(PHYSFS_ERR_IO);
+               return -1;
+            }
+            reader.mPosition += size;
+            return static_cast<PHYSFS_sint64>(size);
+         }
+
+         auto bytes = static_cast<char*>(output);
+         uint64_t done = 0;
+         while (done < size) {
+            const auto index = reader.mPosition / entry.mChunkSize;
+            if (not LoadChunk(reader, index))
+               return done ? static_cast<PHYSFS_sint64>(done) : -1;
+
+            const auto inside = reader.mPosition - index * entry.mChunkSize;
+            const auto count = std::min<uint64_t>(
+               size - done, reader.mChunk.size() - inside);
+            std::memcpy(bytes + done, reader.mChunk.data() + inside, count);
+            done += count;
+            reader.mPosition += count;
+         }
+         return static_cast<PHYSFS_sint64>(done);
+      }
+
+      PHYSFS_sint64 IoWrite(PHYSFS_Io*, const void*, PHYSFS_uint64) {
+         PHYSFS_setErrorCode(PHYSFS_ERR_OPEN_FOR_READING);
+         return -1;
+      }
+
+      int IoSeek(PHYSFS_Io* io, PHYSFS_uint64 offset) {
+         auto& reader = *static_cast<Reader*>(io->opaque);
+         if (offset > reader.mEntry->mSize) {
+            PHYSFS_setErrorCode(PHYSFS_ERR_PAST_EOF);
+            return 0;
+         }
+         reader.mPosition = offset;
+         return 1;
+      }
+
+      PHYSFS_sint64 IoTell(PHYSFS_Io* io) {
+         const auto& reader = *static_cast<Reader*>(io->opaque);
+         return static_cast<PHYSFS_sint64>(reader.mPosition);
+      }
+
+      PHYSFS_sint64 IoLength(PHYSFS_Io* io) {
+         const auto& reader = *static_cast<Reader*>(io->opaque);
+         return static_cast<PHYSFS_sint64>(reader.mEntry->mSize);
+      }
+
+      PHYSFS_Io* IoDuplicate(PHYSFS_Io* io) {
+         const auto& reader = *static_cast<Reader*>(io->opaque);
+         return MakeIo(*reader.mArchive, *reader.mEntry);
+      }
+
+      int IoFlush(PHYSFS_Io*) {
+         return 1;
+      }
+
+      void IoDestroy(PHYSFS_Io* io) {
+         delete static_cast<Reader*>(io->opaque);
+         delete io;
+      }
+
+      /// Create a stream over an entry                                       
+      ///   @param archive - the pack                                         
+      ///   @param entry - the entry inside the pack                          
+      ///   @return the new stream, or nullptr on error                       
+      PHYSFS_Io* MakeIo(const Archive& archive, const PackEntry& entry) {
+         std::unique_ptr<Reader> reader {new (std::nothrow) Reader};
+         if (not reader) {
+            PHYSFS_setErrorCode(PHYSFS_ERR_OUT_OF_MEMORY);
+            return nullptr;
+         }
+
+         reader->mArchive = &archive;
+         reader->mEntry = &entry;
+         reader->mIo = archive.mIo->duplicate(archive.mIo);
+         if (not reader->mIo)
+            return nullptr;
+
+         if (entry.mFlags & Compressed) {
+            const auto chunks =
+               (entry.mSize + entry.mChunkSize - 1) / entry.mChunkSize;
+            reader->mChunks.resize(chunks + 1);
+            if (not ReadAt(*reader, entry.mOffset, reader->mChunks.data(),
+                  reader->mChunks.size() * sizeof(uint64_t))) {
+               PHYSFS_setErrorCode(PHYSFS_ERR_IO);
+               return nullptr;
+            }
+
+            // Chunk offsets have to be ascending, and inside the entry 
+            const auto table = reader->mChunks.size() * sizeof(uint64_t);
+            if (reader->mChunks.front() < table
+            or reader->mChunks.back() > entry.mStoredSize
+            or not std::ranges::is_sorted(reader->mChunks)) {
+               PHYSFS_setErrorCode(PHYSFS_ERR_CORRUPT);
+               return nullptr;
+            }
+         }
+
+         const auto io = new (std::nothrow) PHYSFS_Io {
+            0, reader.get(),
+            IoRead, IoWrite, IoSeek, IoTell, IoLength,
+            IoDuplicate, IoFlush, IoDestroy
+         };
+         if (not io) {
+            PHYSFS_setErrorCode(PHYSFS_ERR_OUT_OF_MEMORY);
+            return nullptr;
+         }
+
+         reader.release();
+         return io;
+      }
+
+      void* OpenArchive(
+         PHYSFS_Io* io, const char* name, int forWrite, int* claimed
+      ) {
+         if (forWrite) {
+            PHYSFS_setErrorCode(PHYSFS_ERR_READ_ONLY);
+            return nullptr;
+         }
+
+         auto archive = std::make_unique<Archive>();
+         archive->mName = name;
+         if (not Load(*archive, io, claimed))
+            return nullptr;
+
+         // PhysFS hands the stream over only on success                
+         archive->mIo = io;
+         std::scoped_lock lock {Registry};
+         Opened[archive->mName] = archive.get();
+         return archive.release();
+      }
+
+      PHYSFS_EnumerateCallbackResult Enumerate(
+         void* opaque, const char* dirname,
+         PHYSFS_EnumerateCallback callback, const char* origdir, void* data
+      ) {
+         const auto& archive = *static_cast<const Archive*>(opaque);
+         std::string prefix {dirname};
+         if (not prefix.empty())
+            prefix += '/';
+
+         // All entries inside a directory are adjacent, and immediate  
+         // children are the ones without another separator             
+         const auto end = archive.mEntries + archive.mHeader->mEntryCount;
+         auto it = std::lower_bound(archive.mEntries, end, prefix,
+            [&](const PackEntry& entry, const std::string& value) {
+               return NameOf(archive.mNames, entry) < value;
+            });
+
+         std::string child;
+         for (; it != end; ++it) {
+            const auto name = NameOf(archive.mNames, *it);
+            if (not name.starts_with(prefix))
+               break;
+
+            const auto relative = name.substr(prefix.size());
+            if (relative.find('/') != std::string_view::npos)
+               continue;
+
+            child = relative;
+            const auto result = callback(data, origdir, child.c_str());
+            if (result == PHYSFS_ENUM_ERROR) {
+               PHYSFS_setErrorCode(PHYSFS_ERR_APP_CALLBACK);
+               return PHYSFS_ENUM_ERROR;
+            }
+            if (result == PHYSFS_ENUM_STOP)
+               return PHYSFS_ENUM_STOP;
+         }
+         return PHYSFS_ENUM_OK;
+      }
+
+      PHYSFS_Io* OpenRead(void* opaque, const char* filename) {
+         const auto& archive = *static_cast<const Archive*>(opaque);
+         const auto entry = archive.Find(filename);
+         if (not entry) {
+            PHYSFS_setErrorCode(PHYSFS_ERR_NOT_FOUND);
+            return nullptr;
+         }
+         if (entry->mFlags & Directory) {
+            PHYSFS_setErrorCode(PHYSFS_ERR_NOT_A_FILE);
+            return nullptr;
+         }
+         return MakeIo(archive, *entry);
+      }
+
+      PHYSFS_Io* OpenWrite(void*, const char*) {
+         PHYSFS_setErrorCode(PHYSFS_ERR_READ_ONLY);
+         return nullptr;
+      }
+
+      int Modify(void*, const char*) {
+         PHYSFS_setErrorCode(PHYSFS_ERR_READ_ONLY);
+         return 0;
+      }
+
+      int Stat(void* opaque, const char* filename, PHYSFS_Stat* info) {
+         const auto& archive = *static_cast<const Archive*>(opaque);
+         *info = {};
+         info->readonly = 1;
+         info->createtime = info->accesstime = info->modtime = -1;
+
+         if (not *filename) {
+            info->filetype = PHYSFS_FILETYPE_DIRECTORY;
+            return 1;
+         }
+
+         const auto entry = archive.Find(filename);
+         if (not entry) {
+            PHYSFS_setErrorCode(PHYSFS_ERR_NOT_FOUND);
+            return 0;
+         }
+
+         const bool folder = entry->mFlags & Directory;
+         info->filetype = folder
+            ? PHYSFS_FILETYPE_DIRECTORY : PHYSFS_FILETYPE_REGULAR;
+         info->filesize = folder
+            ? 0 : static_cast<PHYSFS_sint64>(entry->mSize);
+         info->modtime = entry->mModTime;
+         return 1;
+      }
+
+      void CloseArchive(void* opaque) {
+         const auto archive = static_cast<Archive*>(opaque);
+         {
+            std::scoped_lock lock {Registry};
+            const auto found = Opened.find(archive->mName);
+            if (found != Opened.end() and found->second == archive)
+               Opened.erase(found);
+         }
+         delete archive;
+      }
+
+   } // namespace
+
+
+   /// Register the pack archiver in PhysFS                                   
+   ///   @return true on success                                              
+   bool Register() {
+      static const PHYSFS_Archiver archiver {
+         0, {
+            Extension.data(),
+            "Langulus pack with a memory-mapped table of contents",
+            "Langulus <team@langulus.com>",
+            "https://langulus.com",
+            0
+         },
+         OpenArchive, Enumerate, OpenRead, OpenWrite, OpenWrite,
+         Modify, Modify, Stat, CloseArchive
+      };
+      return 0 != PHYSFS_registerArchiver(&archiver);
+   }
+
+   /// Find where a virtual file resides inside a pack, if it is stored       
+   /// without compression, so that it can be read or mapped directly         
+   ///   @param path - the virtual path, as seen by PhysFS                    
+   ///   @param native - [out] the native path of the pack                    
+   ///   @param offset - [out] the byte offset of the contents inside pack    
+   ///   @return true if file was found inside a pack, and is not compressed  
+   bool Locate(const char* path, std::string& native, uint64_t& offset) {
+      const auto realDir = PHYSFS_getRealDir(path);
+      if (not realDir)
+         return false;
+
+      // Strip the mount point from the virtual path, if any            
+      std::string_view relative {path};
+      while (relative.starts_with('/'))
+         relative.remove_prefix(1);
+      if (const auto mountPoint = PHYSFS_getMountPoint(realDir)) {
+         std::string_view mount {mountPoint};
+         while (mount.starts_with('/'))
+            mount.remove_prefix(1);
+         if (not mount.empty() and relative.starts_with(mount))
+            relative.remove_prefix(mount.size());
+         while (relative.starts_with('/'))
+            relative.remove_prefix(1);
+      }
+
+      std::scoped_lock lock {Registry};
+      const auto found = Opened.find(realDir);
+      if (found == Opened.end())
+         return false;
+
+      const auto entry = found->second->Find(relative);
+      if (not entry or (entry->mFlags & (Directory | Compressed)))
+         return false;
+
+      native = realDir;
+      offset = entry->mOffset;
+      return true;
+   }
+
+} // namespace Pack
@@ -0,0 +1,28 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#pragma once
+#include <cstdint>
+#include <string>
+
+
+///                                                                           
+///   Langulus pack archiver                                                  
+///                                                                           
+///   Makes .lpk packs (see PackFormat.hpp) mountable like any other PhysFS   
+/// archive. The table of contents is memory-mapped when the pack is opened,  
+/// and used as it is, so opening a pack costs the same regardless of the     
+/// number of entries inside. Entries, that are stored without compression,   
+/// can be located inside the pack, and read or mapped directly               
+///                                                                           
+namespace Pack
+{
+
+   bool Register();
+   bool Locate(const char*, std::string& native, uint64_t& offset);
+
+} // namespace Pack
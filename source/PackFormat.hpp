@@ -0,0 +1,134 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+
+///                                                                           
+///   Langulus pack format (.lpk)                                             
+///                                                                           
+///   Standalone description of the pack layout, shared between the module    
+/// and the packer tool, so it must not depend on anything else. All values   
+/// are little-endian, and the layout is fixed, so that the table of          
+/// contents can be memory-mapped and used directly:                          
+///                                                                           
+///      PackHeader                    at offset 0                            
+///      PackEntry[mEntryCount]        at mEntriesOffset, sorted by name      
+///      names                         at mNamesOffset, not null-terminated   
+///      entry data                    each at an mAlignment-aligned offset   
+///                                                                           
+///   Entry names are full lowercase paths, separated by '/', so that         
+/// lookups are a binary search, and all entries inside a directory are       
+/// adjacent. Directories have their own entries, without any data            
+///   Compressed entries are split in chunks of mChunkSize uncompressed       
+/// bytes, so that seeking never has to decompress more than one chunk.       
+/// Their data starts with a table of chunkCount + 1 offsets, relative to     
+/// the entry, followed by the chunks. A chunk, whose stored size equals      
+/// its uncompressed size, is stored as-is                                    
+///                                                                           
+namespace PackFormat
+{
+
+   static_assert(std::endian::native == std::endian::little,
+      "Pack format is little-endian, and used without conversions");
+
+   constexpr char     Magic[4] = {'L', 'P', 'K', '1'};
+   constexpr uint32_t Version = 1;
+   constexpr uint32_t DefaultAlignment = 4096;
+   constexpr uint32_t DefaultChunkSize = 64 * 1024;
+   constexpr std::string_view Extension = "lpk";
+
+   /// Entry flags                                                            
+   enum : uint32_t {
+      Directory  = 1 << 0,
+      Compressed = 1 << 1
+   };
+
+   /// Compression methods, stored in the header                              
+   enum : uint32_t {
+      None = 0,
+      LZ4 = 1
+   };
+
+   struct PackHeader {
+      char     mMagic[4];
+      uint32_t mVersion;
+      // Alignment of entry data, usually the page size                 
+      uint32_t mAlignment;
+      uint32_t mEntryCount;
+      uint64_t mEntriesOffset;
+      uint64_t mNamesOffset;
+      uint64_t mNamesSize;
+      // Compression method for all compressed entries                  
+      uint32_t mCompression;
+      uint8_t  mReserved[20];
+   };
+
+   struct PackEntry {
+      // Absolute offset of the data, aligned to header's mAlignment    
+      uint64_t mOffset;
+      // Uncompressed size in bytes                                     
+      uint64_t mSize;
+      // Size of the data in the pack, including the chunk table        
+      uint64_t mStoredSize;
+      // Modification time, in seconds since the epoch                  
+      int64_t  mModTime;
+      uint32_t mNameOffset;
+      uint32_t mNameSize;
+      uint32_t mFlags;
+      // Uncompressed bytes per chunk, only for compressed entries      
+      uint32_t mChunkSize;
+      uint8_t  mReserved[16];
+   };
+
+   static_assert(sizeof(PackHeader) == 64);
+   static_assert(sizeof(PackEntry) == 64);
+
+   /// Round an offset up to an alignment                                     
+   ///   @param offset - the offset to align                                  
+   ///   @param alignment - the alignment, must be a power of two             
+   ///   @return the aligned offset                                           
+   constexpr uint64_t Align(uint64_t offset, uint64_t alignment) noexcept {
+      return (offset + alignment - 1) & ~(alignment - 1);
+   }
+
+   /// Get the name of an entry                                               
+   ///   @param names - the names table                                       
+   ///   @param entry - the entry                                             
+   ///   @return the name                                                     
+   inline std::string_view NameOf(
+      const char* names, const PackEntry& entry
+   ) noexcept {
+      return {names + entry.mNameOffset, entry.mNameSize};
+   }
+
+   /// Find an entry by name, using binary search                             
+   ///   @param entries - the sorted entries                                  
+   ///   @param count - number of entries                                     
+   ///   @param names - the names table                                       
+   ///   @param name - the name to search for                                 
+   ///   @return the entry, or nullptr if not found                           
+   inline const PackEntry* Find(
+      const PackEntry* entries, uint32_t count,
+      const char* names, std::string_view name
+   ) noexcept {
+      const auto end = entries + count;
+      const auto found = std::lower_bound(entries, end, name,
+         [names](const PackEntry& entry, std::string_view value) {
+            return NameOf(names, entry) < value;
+         });
+      if (found == end or NameOf(names, *found) != name)
+         return nullptr;
+      return found;
+   }
+
+} // namespace PackFormat
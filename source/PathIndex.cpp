@@ -0,0 +1,207 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#include "PathIndex.hpp"
+
+
+/// Hash the normalized form of a path, using 64-bit FNV-1a                   
+///   @param parts - the path segments                                        
+///   @param length - [out] the normalized length                             
+///   @return the hash                                                        
+uint64_t PathIndex::Hash(Parts parts, Count& length) {
+   uint64_t hash = 14695981039346656037ull;
+   length = 0;
+   NormalizePath(parts, true, [&](char c) {
+      hash ^= static_cast<uint8_t>(c);
+      hash *= 1099511628211ull;
+      ++length;
+      return true;
+   });
+   return hash;
+}
+
+/// Check if an entry is the normalized form of the given segments            
+///   @param entry - the entry to compare against                             
+///   @param parts - the path segments                                        
+///   @return true if they match                                              
+bool PathIndex::Matches(const Entry& entry, Parts parts) {
+   Count at = 0;
+   bool match = true;
+   NormalizePath(parts, true, [&](char c) {
+      match = at < entry.mPath.size() and entry.mPath[at++] == c;
+      return match;
+   });
+   return match and at == entry.mPath.size();
+}
+
+/// Create a table of empty slots                                             
+///   @param size - the number of slots, must be a power of two               
+PathIndex::Table::Table(size_t size)
+   : mMask {size - 1}
+   , mSlots {new std::atomic<uint32_t>[size]} {
+   for (size_t i = 0; i < size; ++i)
+      mSlots[i].store(0, std::memory_order_relaxed);
+}
+
+/// Index constructor                                                         
+PathIndex::PathIndex()
+   : mChunks {new std::atomic<Entry*>[MaxChunks]} {
+   for (uint32_t i = 0; i < MaxChunks; ++i)
+      mChunks[i].store(nullptr, std::memory_order_relaxed);
+}
+
+/// Index destructor                                                          
+PathIndex::~PathIndex() {
+   Reset();
+}
+
+/// Access an entry by index                                                  
+///   @attention assumes index is smaller than the published count            
+///   @param index - the entry index                                          
+///   @return the entry                                                       
+auto PathIndex::At(uint32_t index) const noexcept -> Entry& {
+   const auto chunk = mChunks[index >> ChunkBits]
+      .load(std::memory_order_acquire);
+   return chunk[index & (ChunkSize - 1)];
+}
+
+/// Find the slot that contains the path, or the empty slot where it would    
+/// be inserted                                                               
+///   @param table - the table to probe                                       
+///   @param parts - the path segments                                        
+///   @param hash - the precomputed hash of the normalized path               
+///   @return the slot index                                                  
+auto PathIndex::Probe(
+   const Table& table, Parts parts, uint64_t hash
+) const -> size_t {
+   auto slot = static_cast<size_t>(hash) & table.mMask;
+   while (true) {
+      const auto index = table.mSlots[slot].load(std::memory_order_acquire);
+      if (not index)
+         return slot;
+
+      const auto& entry = At(index - 1);
+      if (entry.mHash == hash and Matches(entry, parts))
+         return slot;
+      slot = (slot + 1) & table.mMask;
+   }
+}
+
+/// Replace the current table with a bigger one                               
+/// The old table is retired, but kept alive for lookups still probing it     
+///   @attention assumes mMutex is locked                                     
+void PathIndex::Grow() {
+   const auto current = mTable.load(std::memory_order_relaxed);
+   const auto size = current ? (current->mMask + 1) * 2 : 64;
+   auto table = std::make_unique<Table>(size);
+
+   const auto count = mCount.load(std::memory_order_relaxed);
+   for (uint32_t index = 0; index < count; ++index) {
+      auto slot = static_cast<size_t>(At(index).mHash) & table->mMask;
+      while (table->mSlots[slot].load(std::memory_order_relaxed))
+         slot = (slot + 1) & table->mMask;
+      table->mSlots[slot].store(index + 1, std::memory_order_relaxed);
+   }
+
+   mTable.store(table.get(), std::memory_order_release);
+   mTables.emplace_back(std::move(table));
+}
+
+/// Find an already interned path                                             
+/// Doesn't allocate or lock - the path is normalized and hashed on the fly   
+///   @param parts - the path segments, i.e. {"base/directory", "file.txt"}   
+///   @return the handle, or an invalid handle if path isn't interned         
+auto PathIndex::Find(Parts parts) const -> Handle {
+   Count length;
+   const auto hash = Hash(parts, length);
+   const auto table = mTable.load(std::memory_order_acquire);
+   if (not length or not table)
+      return {};
+
+   const auto slot = Probe(*table, parts, hash);
+   const auto index = table->mSlots[slot].load(std::memory_order_acquire);
+   if (not index)
+      return {};
+   return {hash, index - 1};
+}
+
+/// Find a path, or intern it if not interned yet                             
+/// Locks and allocates only when interning a new path                        
+///   @param parts - the path segments, i.e. {"base/directory", "file.txt"}   
+///   @return the handle, or an invalid handle if normalized path is empty    
+auto PathIndex::Intern(Parts parts) -> Handle {
+   if (const auto found = Find(parts))
+      return found;
+
+   Count length;
+   const auto hash = Hash(parts, length);
+   if (not length)
+      return {};
+
+   std::scoped_lock lock {mMutex};
+
+   // Another thread might have interned the path in the meantime       
+   auto table = mTable.load(std::memory_order_relaxed);
+   if (table) {
+      const auto slot = Probe(*table, parts, hash);
+      const auto index = table->mSlots[slot].load(std::memory_order_relaxed);
+      if (index)
+         return {hash, index - 1};
+   }
+
+   const auto index = mCount.load(std::memory_order_relaxed);
+   LANGULUS_ASSERT(index < MaxChunks * ChunkSize, FileSystem,
+      "Too many interned paths");
+
+   // Make sure there's place for the entry, and fill it                
+   auto& chunk = mChunks[index >> ChunkBits];
+   if (not chunk.load(std::memory_order_relaxed))
+      chunk.store(new Entry[ChunkSize], std::memory_order_release);
+
+   auto& entry = At(index);
+   entry.mHash = hash;
+   entry.mPath.reserve(length);
+   NormalizePath(parts, true, [&](char c) {
+      entry.mPath += c;
+      return true;
+   });
+   mCount.store(index + 1, std::memory_order_release);
+
+   // Keep the load factor under one half                               
+   if (not table or (index + 1) * 2 > table->mMask + 1) {
+      // The new table already contains the new entry                   
+      Grow();
+      return {hash, index};
+   }
+
+   // Publishing the slot makes the entry visible to lookups            
+   const auto slot = Probe(*table, parts, hash);
+   table->mSlots[slot].store(index + 1, std::memory_order_release);
+   return {hash, index};
+}
+
+/// Get an interned entry                                                     
+///   @param handle - a valid handle, returned by this index                  
+///   @return the entry                                                       
+auto PathIndex::Get(Handle handle) const -> Entry& {
+   LANGULUS_ASSERT(handle.mIndex < mCount.load(std::memory_order_acquire)
+      and At(handle.mIndex).mHash == handle.mHash, FileSystem,
+      "Invalid path handle");
+   return At(handle.mIndex);
+}
+
+/// Forget all interned paths, invalidating all handles                       
+///   @attention not thread-safe, no other thread may use the index           
+void PathIndex::Reset() {
+   std::scoped_lock lock {mMutex};
+   mTable.store(nullptr, std::memory_order_relaxed);
+   mTables.clear();
+
+   for (uint32_t i = 0; i < MaxChunks; ++i)
+      delete[] mChunks[i].exchange(nullptr, std::memory_order_relaxed);
+   mCount.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,120 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#pragma once
+#include "Common.hpp"
+#include <atomic>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+///                                                                           
+///   Interned path index                                                     
+///                                                                           
+///   Every path is normalized (lowercased, duplicate and surrounding         
+/// separators removed) and hashed exactly once, when interned. Lookups       
+/// normalize and hash on the fly, directly from the path segments, so        
+/// finding an already interned path - even one that is the concatenation     
+/// of a base directory and a relative path - never allocates.                
+///   Entries are never removed before Reset, so handles remain valid, and    
+/// they're also where file/folder interfaces are cached.                     
+///   Lookups are lock-free and can run on any thread, concurrently with      
+/// interning. Interning new paths is serialized by a mutex. Tables that      
+/// are outgrown are retired, but kept alive until Reset, because lookups     
+/// might still be probing them                                               
+///                                                                           
+struct PathIndex {
+   using Parts = std::initializer_list<std::string_view>;
+
+   ///                                                                        
+   ///   Compact handle to an interned path                                   
+   ///                                                                        
+   struct Handle {
+      static constexpr uint32_t Invalid = ~uint32_t(0);
+
+      uint64_t mHash = 0;
+      uint32_t mIndex = Invalid;
+
+      explicit operator bool() const noexcept { return mIndex != Invalid; }
+   };
+
+   ///                                                                        
+   ///   An interned path                                                     
+   ///                                                                        
+   struct Entry {
+      // The normalized path, immutable after interning                 
+      std::string mPath;
+      // Hash of the normalized path                                    
+      uint64_t mHash = 0;
+
+      // File interface for the path, if any - readable from any thread 
+      std::atomic<A::File*> mFile {};
+      // Folder interface for the path, if any - readable from any thread
+      std::atomic<A::Folder*> mFolder {};
+      // References that keep the interfaces alive, set only once, while
+      // the producer is locked                                         
+      Ref<A::File> mFileRef;
+      Ref<A::Folder> mFolderRef;
+   };
+
+private:
+   static constexpr uint32_t ChunkBits = 12;
+   static constexpr uint32_t ChunkSize = 1 << ChunkBits;
+   static constexpr uint32_t MaxChunks = 4096;
+
+   ///                                                                        
+   ///   Open addressing table of entry indices + 1, zero marks empty         
+   ///                                                                        
+   struct Table {
+      size_t mMask;
+      std::unique_ptr<std::atomic<uint32_t>[]> mSlots;
+
+      Table(size_t size);
+   };
+
+   // Entries are allocated in fixed chunks, so they never move         
+   std::unique_ptr<std::atomic<Entry*>[]> mChunks;
+   // Number of interned entries                                        
+   std::atomic<uint32_t> mCount = 0;
+   // The current table                                                 
+   std::atomic<Table*> mTable {};
+   // The current table and all retired ones, guarded by mMutex         
+   std::vector<std::unique_ptr<Table>> mTables;
+   // Serializes interning                                              
+   std::mutex mMutex;
+
+   static uint64_t Hash(Parts, Count& length);
+   static bool Matches(const Entry&, Parts);
+
+   auto At(uint32_t) const noexcept -> Entry&;
+   auto Probe(const Table&, Parts, uint64_t hash) const -> size_t;
+   void Grow();
+
+public:
+   PathIndex();
+   PathIndex(const PathIndex&) = delete;
+  ~PathIndex();
+
+   auto Find(Parts) const -> Handle;
+   auto Intern(Parts) -> Handle;
+
+   auto Get(Handle) const -> Entry&;
+   auto GetCount() const noexcept -> Count { return mCount; }
+
+   template<class F>
+   void ForEach(F&& call) const {
+      const auto count = mCount.load(std::memory_order_acquire);
+      for (uint32_t index = 0; index < count; ++index)
+         call(At(index));
+   }
+
+   void Reset();
+};
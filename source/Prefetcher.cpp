@@ -0,0 +1,66 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#include "Prefetcher.hpp"
+#include "File.hpp"
+#include <algorithm>
+
+
+/// Stop prefetching on destruction                                           
+Prefetcher::~Prefetcher() {
+   Stop();
+}
+
+/// Start prefetching in the background                                       
+/// Anything still being prefetched from a previous start is cancelled        
+///   @param jobs - the ranges to prefetch, in the order they'll be needed    
+///   @param workers - number of threads, zero to pick automatically          
+void Prefetcher::Start(std::vector<Job>&& jobs, Count workers) {
+   Stop();
+   if (jobs.empty())
+      return;
+
+   if (not workers) {
+      const Count cores = std::thread::hardware_concurrency();
+      workers = std::clamp<Count>(cores, 1, 8);
+   }
+   workers = std::min<Count>(workers, jobs.size());
+
+   mJobs = std::move(jobs);
+   mNext = 0;
+   mActive = workers;
+   mWorkers.reserve(workers);
+   for (Count i = 0; i < workers; ++i)
+      mWorkers.emplace_back(&Prefetcher::Work, this);
+}
+
+/// Cancel the remaining jobs, and wait for the ones in progress              
+void Prefetcher::Stop() {
+   mNext = mJobs.size();
+   for (auto& worker : mWorkers)
+      worker.join();
+
+   mWorkers.clear();
+   mJobs.clear();
+   mNext = 0;
+   mActive = 0;
+}
+
+/// Worker thread routine - takes jobs until there are none left              
+void Prefetcher::Work() noexcept {
+   while (true) {
+      const auto index = mNext.fetch_add(1);
+      if (index >= mJobs.size())
+         break;
+
+      const auto& job = mJobs[index];
+      try { job.mFile->Prefetch(job.mOffset, job.mSize); }
+      catch (...) {}
+   }
+
+   --mActive;
+}
@@ -0,0 +1,53 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#pragma once
+#include "Common.hpp"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+
+///                                                                           
+///   Parallel prefetcher                                                     
+///                                                                           
+///   Replays a recorded access trace on a couple of background threads,      
+/// ahead of the actual reads. Native files are only hinted to the OS, so     
+/// that it reads them into the page cache, while archived files are          
+/// decompressed into the block cache. Prefetching is only a hint, so any     
+/// failures are ignored                                                      
+///   Jobs are taken roughly in recorded order, so that the files needed      
+/// first are also prefetched first                                           
+///                                                                           
+struct Prefetcher {
+   struct Job {
+      // Interfaces are owned by the file system, and must outlive jobs 
+      const File* mFile;
+      Offset mOffset;
+      Offset mSize;
+   };
+
+private:
+   std::vector<Job> mJobs;
+   std::vector<std::thread> mWorkers;
+   // Index of the next job to take                                     
+   std::atomic<size_t> mNext = 0;
+   // Number of workers that haven't run out of jobs yet                
+   std::atomic<Count> mActive = 0;
+
+   void Work() noexcept;
+
+public:
+   Prefetcher() = default;
+   Prefetcher(const Prefetcher&) = delete;
+  ~Prefetcher();
+
+   void Start(std::vector<Job>&&, Count workers = 0);
+   void Stop();
+
+   bool IsBusy() const noexcept { return mActive > 0; }
+};
@@ -0,0 +1,199 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#include "StatCache.hpp"
+#include "Native.hpp"
+#include <algorithm>
+#include <mutex>
+
+
+/// Lowercase an ASCII letter, like interfaced paths are                      
+///   @param c - the character                                                
+///   @return the lowercase character                                         
+static constexpr char Lower(char c) noexcept {
+   return c >= 'A' and c <= 'Z' ? static_cast<char>(c + ('a' - 'A')) : c;
+}
+
+/// Normalize a path into a buffer, that each thread reuses, so that lookups  
+/// don't allocate                                                            
+///   @param path - the path to normalize                                     
+///   @return the normalized path, valid until the next call on this thread   
+static std::string_view Normalized(std::string_view path) {
+   thread_local std::string buffer;
+   buffer.clear();
+   NormalizePath({path}, false, [](char c) {
+      buffer += c;
+      return true;
+   });
+   return buffer;
+}
+
+/// Hash a normalized path without case, using 64-bit FNV-1a                  
+///   @param path - the normalized path                                       
+///   @return the hash                                                        
+size_t StatCache::CaselessHash::operator () (
+   std::string_view path
+) const noexcept {
+   uint64_t hash = 14695981039346656037ull;
+   for (auto c : path) {
+      hash ^= static_cast<uint8_t>(Lower(c));
+      hash *= 1099511628211ull;
+   }
+   return static_cast<size_t>(hash);
+}
+
+/// Compare normalized paths without case                                     
+///   @param lhs, rhs - the normalized paths                                  
+///   @return true if paths are the same, in any case                         
+bool StatCache::CaselessEqual::operator () (
+   std::string_view lhs, std::string_view rhs
+) const noexcept {
+   return std::ranges::equal(lhs, rhs, [](char a, char b) {
+      return Lower(a) == Lower(b);
+   });
+}
+
+/// Get info about a virtual path, using the cache if possible                
+///   @param path - the virtual path                                          
+///   @param info - [out] the path info, only set if path exists              
+///   @param native - [out] where the path is on disk, only set if it exists  
+///                   inside a native directory                               
+///   @return true if path exists                                             
+bool StatCache::Stat(
+   std::string_view path, PHYSFS_Stat& info, std::string* native
+) {
+   const auto exact = Normalized(path);
+   uint64_t epoch;
+   {
+      std::shared_lock lock {mMutex};
+      const auto found = mEntries.find(exact);
+      if (found != mEntries.end() and found->first == exact) {
+         ++mHits;
+         if (found->second.mExists)
+            info = found->second.mInfo;
+         if (native)
+            *native = found->second.mNative;
+         return found->second.mExists;
+      }
+      epoch = mEpoch;
+   }
+
+   // Not cached, so ask the mount table, or PhysFS as a last resort,   
+   // outside of the lock                                               
+   ++mMisses;
+   std::string key {exact};
+   Entry entry {};
+   switch (mMounts.Stat(path, entry.mInfo, &entry.mNative)) {
+   case MountTable::Found:
+      entry.mExists = true;
+      break;
+   case MountTable::Missing:
+      entry.mExists = false;
+      break;
+   default: {
+      const std::string terminated {path};
+      entry.mExists = 0 != PHYSFS_stat(terminated.c_str(), &entry.mInfo);
+      if (entry.mExists)
+         entry.mNative = Native::ResolvePath(terminated.c_str());
+   }
+   }
+   if (entry.mExists)
+      info = entry.mInfo;
+   if (native)
+      *native = entry.mNative;
+
+   // Anything invalidated since the lookup might have been resolved    
+   // before the change, so the entry is cached only if nothing was.    
+   // An entry for the same path in another case is replaced            
+   const bool exists = entry.mExists;
+   std::unique_lock lock {mMutex};
+   if (epoch == mEpoch) {
+      const auto found = mEntries.find(key);
+      if (found != mEntries.end())
+         mEntries.erase(found);
+      else
+         Evict(mCapacity - 1);
+      mEntries.emplace(std::move(key), std::move(entry));
+   }
+   return exists;
+}
+
+/// Evict entries until there are no more than the given number               
+/// Buckets are visited in turn, so all entries get evicted eventually        
+///   @attention assumes mMutex is exclusively locked                         
+///   @param capacity - the number of entries to keep                         
+void StatCache::Evict(Count capacity) {
+   while (mEntries.size() > capacity) {
+      mEvictCursor = (mEvictCursor + 1) % mEntries.bucket_count();
+      if (mEntries.bucket_size(mEvictCursor)) {
+         mEntries.erase(mEntries.find(
+            std::string_view {mEntries.begin(mEvictCursor)->first}));
+      }
+   }
+}
+
+/// Forget about a path, and about its parent directory, whose info might     
+/// also change when entries are added or removed                             
+///   @param path - the virtual path to forget about                          
+void StatCache::Invalidate(std::string_view path) {
+   const auto key = Normalized(path);
+   const auto separator = key.find_last_of('/');
+   const auto parent = separator == std::string_view::npos
+      ? std::string_view {} : key.substr(0, separator);
+
+   std::unique_lock lock {mMutex};
+   ++mEpoch;
+   for (auto forgotten : {key, parent}) {
+      const auto found = mEntries.find(forgotten);
+      if (found != mEntries.end())
+         mEntries.erase(found);
+   }
+}
+
+/// Forget about many paths at once, along with all of their ancestors,       
+/// because a batch can create whole directory chains                         
+///   @param paths - the virtual paths to forget about                        
+void StatCache::InvalidateBatch(std::span<const std::string> paths) {
+   std::unique_lock lock {mMutex};
+   ++mEpoch;
+   for (auto& path : paths) {
+      auto ancestor = Normalized(path);
+      while (true) {
+         const auto found = mEntries.find(ancestor);
+         if (found != mEntries.end())
+            mEntries.erase(found);
+         if (ancestor.empty())
+            break;
+
+         const auto separator = ancestor.find_last_of('/');
+         ancestor = separator == std::string_view::npos
+            ? std::string_view {} : ancestor.substr(0, separator);
+      }
+   }
+}
+
+/// Forget about everything - used when mounts change                         
+void StatCache::Clear() {
+   std::unique_lock lock {mMutex};
+   ++mEpoch;
+   mEntries.clear();
+}
+
+/// Limit the number of cached entries, evicting any above the limit          
+///   @param capacity - the maximum number of entries, at least one           
+void StatCache::SetCapacity(Count capacity) {
+   std::unique_lock lock {mMutex};
+   mCapacity = std::max<Count>(capacity, 1);
+   Evict(mCapacity);
+}
+
+/// Get the number of cached entries                                          
+///   @return the number of entries                                           
+Count StatCache::GetCount() const {
+   std::shared_lock lock {mMutex};
+   return mEntries.size();
+}
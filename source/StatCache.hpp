@@ -0,0 +1,95 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#pragma once
+#include "MountTable.hpp"
+#include <atomic>
+#include <shared_mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+
+///                                                                           
+///   Metadata cache                                                          
+///                                                                           
+///   PHYSFS_stat searches every mounted archive in order, which gets very    
+/// expensive when thousands of files are interfaced at once. Results are     
+/// cached here by normalized path - including negative results for missing   
+/// paths - and are invalidated on writes, refreshes and mount changes.       
+/// Entries are keyed without case, so that invalidating a path invalidates   
+/// it in any case, but each entry answers only for the case it was resolved  
+/// in, because PhysFS opens archived files case-sensitively. Lookups         
+/// normalize the path into a buffer reused by the calling thread, and don't  
+/// allocate when they hit.                                                   
+///   The number of entries is bounded - once full, each new entry evicts an  
+/// old one, going through the table in order, so hits never have to record   
+/// anything                                                                  
+///   Cache misses are resolved through the mount table's index, and only     
+/// fall back to PHYSFS_stat if the index can't tell. They're resolved        
+/// without locking, so a miss is cached only if nothing was invalidated      
+/// meanwhile - otherwise it might cache what was true before a write         
+///                                                                           
+struct StatCache {
+   static constexpr Count DefaultCapacity = 64 * 1024;
+
+private:
+   struct Entry {
+      // False if path doesn't exist                                    
+      bool mExists;
+      // Path info, only valid if path exists                           
+      PHYSFS_Stat mInfo;
+      // Where the path is on disk, if it's inside a native directory   
+      std::string mNative;
+   };
+
+   // Hashes and compares normalized paths without case, so that they   
+   // can be looked up by any string view                               
+   struct CaselessHash {
+      using is_transparent = void;
+      size_t operator () (std::string_view) const noexcept;
+   };
+
+   struct CaselessEqual {
+      using is_transparent = void;
+      bool operator () (std::string_view, std::string_view) const noexcept;
+   };
+
+   // Resolves cache misses                                             
+   const MountTable& mMounts;
+   // Cached entries, by normalized path, in the case it was resolved in
+   std::unordered_map<std::string, Entry, CaselessHash, CaselessEqual>
+      mEntries;
+   // Maximum number of entries, and the bucket to evict from next      
+   Count mCapacity = DefaultCapacity;
+   size_t mEvictCursor = 0;
+   // Lookups are frequent, invalidations are rare                      
+   mutable std::shared_mutex mMutex;
+   // Incremented by each invalidation, while mMutex is exclusively     
+   // locked, so that misses can tell if they're stale                  
+   uint64_t mEpoch = 0;
+   // Statistics                                                        
+   std::atomic<Count> mHits = 0;
+   std::atomic<Count> mMisses = 0;
+
+   void Evict(Count capacity);
+
+public:
+   StatCache(const MountTable& mounts) noexcept
+      : mMounts {mounts} {}
+
+   bool Stat(std::string_view, PHYSFS_Stat&, std::string* native = nullptr);
+   void Invalidate(std::string_view);
+   void InvalidateBatch(std::span<const std::string>);
+   void Clear();
+
+   void SetCapacity(Count);
+   Count GetCount() const;
+   Count GetHits() const noexcept { return mHits; }
+   Count GetMisses() const noexcept { return mMisses; }
+};
@@ -0,0 +1,197 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#include "Watcher.hpp"
+#include <filesystem>
+#include <unordered_set>
+
+#if defined(__linux__)
+   #include <sys/inotify.h>
+   #include <unistd.h>
+   #include <cerrno>
+
+   /// Events that make a watched entry stale                                 
+   constexpr uint32_t WatchedEvents = IN_CLOSE_WRITE | IN_ATTRIB
+      | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+      | IN_DELETE_SELF | IN_MOVE_SELF;
+#endif
+
+
+/// Stop watching on destruction                                              
+Watcher::~Watcher() {
+   Stop();
+}
+
+/// Initialize the OS notification mechanism                                  
+///   @return true if watching is supported and running                       
+bool Watcher::Start() {
+#if defined(__linux__)
+   std::scoped_lock lock {mMutex};
+   if (mInstance < 0)
+      mInstance = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+   return mInstance >= 0;
+#else
+   return false;
+#endif
+}
+
+/// Stop watching everything                                                  
+void Watcher::Stop() {
+   std::scoped_lock lock {mMutex};
+#if defined(__linux__)
+   if (mInstance >= 0)
+      ::close(mInstance);
+#endif
+   mInstance = -1;
+   mDirectories.clear();
+   mDescriptors.clear();
+}
+
+/// Start watching a native directory, if not watched already                 
+///   @param path - the native directory path                                 
+///   @return the watch descriptor, or -1 on failure                          
+int Watcher::WatchDirectory(const std::string& path) {
+#if defined(__linux__)
+   const auto found = mDescriptors.find(path);
+   if (found != mDescriptors.end())
+      return found->second;
+
+   const int descriptor = inotify_add_watch(
+      mInstance, path.c_str(), WatchedEvents | IN_ONLYDIR);
+   if (descriptor < 0)
+      return -1;
+
+   // A directory can be reached through different paths (symlinks),    
+   // in which case inotify returns the same descriptor                 
+   mDescriptors.emplace(path, descriptor);
+   mDirectories[descriptor].mPath = path;
+   return descriptor;
+#else
+   (void) path;
+   return -1;
+#endif
+}
+
+/// Register a unit for refreshing, when a native path changes                
+/// Registering the same unit multiple times is harmless                      
+///   @param unit - the unit to refresh                                       
+///   @param path - the native path of the file/directory to watch, doesn't   
+///                 have to exist, as long as its parent directory does       
+///   @param contents - also watch for changes inside the path, if it is an   
+///                     existing directory                                    
+void Watcher::Watch(A::Unit* unit, const std::string& path, bool contents) {
+   std::scoped_lock lock {mMutex};
+   if (mInstance < 0 or path.empty())
+      return;
+
+   const auto add = [&](int descriptor, const std::string& name) {
+      if (descriptor < 0)
+         return;
+
+      auto& entries = mDirectories[descriptor].mEntries;
+      const auto range = entries.equal_range(name);
+      for (auto it = range.first; it != range.second; ++it) {
+         if (it->second == unit)
+            return;
+      }
+      entries.emplace(name, unit);
+   };
+
+   // Watch the parent directory for changes to the entry itself        
+   const std::filesystem::path native {path};
+   const auto parent = native.parent_path().string();
+   add(WatchDirectory(parent.empty() ? "." : parent),
+      native.filename().string());
+
+   // Watch the directory itself for changes to its contents            
+   std::error_code ec;
+   if (contents and std::filesystem::is_directory(native, ec))
+      add(WatchDirectory(path), {});
+}
+
+/// Stop refreshing a unit                                                    
+/// Directories stay watched, because they're usually shared among units      
+///   @param unit - the unit to forget                                        
+void Watcher::Unwatch(A::Unit* unit) {
+   std::scoped_lock lock {mMutex};
+   for (auto& directory : mDirectories) {
+      std::erase_if(directory.second.mEntries, [unit](const auto& entry) {
+         return entry.second == unit;
+      });
+   }
+}
+
+/// Collect all pending notifications, and refresh each affected unit once    
+/// Called from FileSystem::Update                                            
+///   @return the number of refreshed units                                   
+Count Watcher::Poll() {
+#if defined(__linux__)
+   std::unique_lock lock {mMutex};
+   if (mInstance < 0)
+      return 0;
+
+   std::unordered_set<A::Unit*> stale;
+   const auto markDirectory = [&](const Directory& directory) {
+      for (auto& entry : directory.mEntries)
+         stale.insert(entry.second);
+   };
+
+   alignas(inotify_event) char buffer[16 * 1024];
+   while (true) {
+      const auto length = ::read(mInstance, buffer, sizeof(buffer));
+      if (length <= 0)
+         break;
+
+      for (auto at = buffer; at < buffer + length; ) {
+         const auto event = reinterpret_cast<const inotify_event*>(at);
+         at += sizeof(inotify_event) + event->len;
+
+         if (event->mask & IN_Q_OVERFLOW) {
+            // Events were lost, so everything is potentially stale     
+            for (auto& directory : mDirectories)
+               markDirectory(directory.second);
+            continue;
+         }
+
+         const auto found = mDirectories.find(event->wd);
+         if (found == mDirectories.end())
+            continue;
+
+         if (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) {
+            // The directory itself is gone - refresh everything inside 
+            // and forget about it                                      
+            markDirectory(found->second);
+            if (event->mask & IN_IGNORED) {
+               mDescriptors.erase(found->second.mPath);
+               mDirectories.erase(found);
+            }
+            continue;
+         }
+
+         // Refresh units interested in the entry, and in any change    
+         const auto& entries = found->second.mEntries;
+         auto range = entries.equal_range(event->len ? event->name : "");
+         for (auto it = range.first; it != range.second; ++it)
+            stale.insert(it->second);
+
+         if (event->len) {
+            range = entries.equal_range({});
+            for (auto it = range.first; it != range.second; ++it)
+               stale.insert(it->second);
+         }
+      }
+   }
+
+   // Refreshing can register units again, so do it unlocked            
+   lock.unlock();
+   for (auto unit : stale)
+      unit->Refresh();
+   return stale.size();
+#else
+   return 0;
+#endif
+}
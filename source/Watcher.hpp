@@ -0,0 +1,61 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#pragma once
+#include "Common.hpp"
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+
+///                                                                           
+///   File change watcher                                                     
+///                                                                           
+///   Interfaced files and folders are registered here with their native      
+/// paths, and the OS notifies us when they change. Notifications are only    
+/// collected in Poll (called from FileSystem::Update), where each changed    
+/// unit is refreshed exactly once per batch. When nothing changes, polling   
+/// costs a single non-blocking read.                                         
+///   Only inotify (Linux) is currently supported - on other platforms,       
+/// watching silently does nothing, and units must be refreshed manually      
+///                                                                           
+struct Watcher {
+private:
+   ///                                                                        
+   ///   A watched native directory                                           
+   ///                                                                        
+   struct Directory {
+      // Native path of the directory                                   
+      std::string mPath;
+      // Units interested in entries inside the directory, by entry name
+      // Empty name means the unit is interested in any change inside   
+      std::unordered_multimap<std::string, A::Unit*> mEntries;
+   };
+
+   // The inotify instance, or -1 if not running                        
+   int mInstance = -1;
+   // Watched directories, by watch descriptor                          
+   std::unordered_map<int, Directory> mDirectories;
+   // Watch descriptors, by native directory path                       
+   std::unordered_map<std::string, int> mDescriptors;
+   // Units can be interfaced from any thread                           
+   std::mutex mMutex;
+
+   int WatchDirectory(const std::string&);
+
+public:
+   Watcher() = default;
+   Watcher(const Watcher&) = delete;
+  ~Watcher();
+
+   bool Start();
+   void Stop();
+
+   void Watch(A::Unit*, const std::string&, bool contents = false);
+   void Unwatch(A::Unit*);
+   Count Poll();
+};
@@ -7,6 +7,385 @@
 ///                                                                           
 #include <Langulus/IO.hpp>
 #include <Langulus/Testing.hpp>
+#include "FileSystem.hpp"
+#include "Enumerator.hpp"
+#include "LineReader.hpp"
+#include "PackFormat.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#if LANGULUS_MOD_FILESYSTEM_LZ4
+   #include <lz4.h>
+#endif
+
+namespace fs = std::filesystem;
+
+
+/// Get the file system module - the abstract interface doesn't expose most   
+/// of its features                                                           
+///   @param runtime - the runtime the module is loaded in                    
+///   @return the module                                                      
+static ::FileSystem* GetModule(auto runtime) {
+   auto anchor = runtime->GetFile("test.txt");
+   return static_cast<::File*>(anchor.Get())->GetProducer();
+}
+
+/// Get the module's file behind an abstract file reference                   
+///   @param file - the file reference, must outlive the result               
+///   @return the file                                                        
+static ::File* AsFile(const Ref<A::File>& file) {
+   return static_cast<::File*>(const_cast<A::File*>(file.Get()));
+}
+
+/// Prepare an empty native directory inside the write directory, for a       
+/// scenario to play with                                                     
+///   @param runtime - the runtime the module is loaded in                    
+///   @param name - the name of the directory, also its virtual path          
+///   @return the native path of the directory                                
+static fs::path Sandbox(auto runtime, std::string_view name) {
+   const auto path = fs::path {
+      std::string {AsToken(runtime->GetWorkingPath())}} / "data" / name;
+   std::error_code ec;
+   fs::remove_all(path, ec);
+   fs::create_directories(path);
+   return path;
+}
+
+/// Read a native file directly, bypassing the file system                    
+///   @param path - the native path                                           
+///   @return the contents, empty if file doesn't exist                       
+static std::string ReadNative(const fs::path& path) {
+   std::ifstream input {path, std::ios::binary};
+   return {std::istreambuf_iterator<char> {input}, {}};
+}
+
+/// Write a native file directly, bypassing the file system                   
+///   @param path - the native path                                           
+///   @param contents - the contents                                          
+static void WriteNative(const fs::path& path, std::string_view contents) {
+   fs::create_directories(path.parent_path());
+   std::ofstream output {path, std::ios::binary | std::ios::trunc};
+   output.write(contents.data(), contents.size());
+}
+
+/// Get the module's folder behind an abstract folder reference               
+///   @param folder - the folder reference, must outlive the result           
+///   @return the folder                                                      
+static ::Folder* AsFolder(const Ref<A::Folder>& folder) {
+   return static_cast<::Folder*>(const_cast<A::Folder*>(folder.Get()));
+}
+
+/// Mount a native directory or archive through the module                    
+///   @param module - the module                                              
+///   @param native - the native path                                         
+///   @param point - where to mount it                                        
+///   @param priority - the mount priority                                    
+///   @return true on success                                                 
+static bool MountNative(
+   ::FileSystem* module, const fs::path& native, Token point,
+   int priority = 0
+) {
+   const auto path = fs::absolute(native).string();
+   return module->Mount(Path {Token {path}}, Path {point}, priority);
+}
+
+/// Select paths inside a folder, sorted                                      
+///   @param folder - the folder                                              
+///   @param pattern - the glob pattern, empty for the immediate children     
+///   @return the full virtual paths of everything selected                   
+static std::vector<std::string> SelectPaths(
+   const Ref<A::Folder>& folder, Token pattern = {}
+) {
+   auto select = pattern.empty()
+      ? Verbs::Select {} : Verbs::Select {Text {pattern}};
+   AsFolder(folder)->Select(select);
+
+   std::vector<std::string> result;
+   select.GetOutput().ForEachDeep([&](const Path& path) {
+      result.emplace_back(AsToken(path));
+   });
+   std::ranges::sort(result);
+   return result;
+}
+
+/// Make a block of bytes out of a string                                     
+///   @param text - the string                                                
+///   @return the bytes                                                       
+static Many AsBytes(std::string_view text) {
+   auto bytes = Allocate(text.size());
+   if (not text.empty())
+      std::memcpy(bytes.GetRaw(), text.data(), text.size());
+   return bytes;
+}
+
+/// Make a string out of a block of bytes                                     
+///   @param bytes - the bytes                                                
+///   @return the string                                                      
+static std::string AsString(const Many& bytes) {
+   return {reinterpret_cast<const char*>(bytes.GetRaw()),
+      bytes.GetBytesize()};
+}
+
+/// Count the temporaries of atomic rewrites inside a directory               
+///   @param directory - the native directory                                 
+///   @return the number of temporaries                                       
+static size_t CountTemporaries(const fs::path& directory) {
+   size_t count = 0;
+   for (auto& entry : fs::directory_iterator {directory})
+      count += entry.path().filename().string().find(".tmp-")
+         != std::string::npos;
+   return count;
+}
+
+/// An entry of a test pack                                                   
+struct PackFile {
+   std::string mName;
+   std::string mContents;
+   bool mDirectory = false;
+   // Split contents in chunks of this size, compressed if possible     
+   uint32_t mChunkSize = 0;
+};
+
+/// Compress a chunk, the same way the packer tool does                       
+///   @param chunk - the uncompressed chunk                                   
+///   @return the stored chunk, as it is if it doesn't shrink                 
+static std::string CompressChunk(const std::string& chunk) {
+#if LANGULUS_MOD_FILESYSTEM_LZ4
+   std::string packed(LZ4_compressBound(static_cast<int>(chunk.size())), 0);
+   const auto size = LZ4_compress_default(chunk.data(), packed.data(),
+      static_cast<int>(chunk.size()), static_cast<int>(packed.size()));
+   if (size > 0 and static_cast<size_t>(size) < chunk.size()) {
+      packed.resize(size);
+      return packed;
+   }
+#endif
+   return chunk;
+}
+
+/// Make a pack in memory, so that it can be corrupted before it is written   
+///   @param files - the entries of the pack                                  
+///   @return the pack                                                        
+static std::string MakePack(std::vector<PackFile> files) {
+   using namespace PackFormat;
+   std::ranges::sort(files, {}, &PackFile::mName);
+
+   std::vector<PackEntry> entries(files.size());
+   std::vector<std::string> stored(files.size());
+   std::string names;
+   for (size_t i = 0; i < files.size(); ++i) {
+      auto& file = files[i];
+      auto& entry = entries[i];
+      entry = {};
+      entry.mNameOffset = static_cast<uint32_t>(names.size());
+      entry.mNameSize = static_cast<uint32_t>(file.mName.size());
+      names += file.mName;
+      if (file.mDirectory) {
+         entry.mFlags = Directory;
+         continue;
+      }
+
+      entry.mSize = file.mContents.size();
+      if (not file.mChunkSize)
+         stored[i] = file.mContents;
+      else {
+         // Chunk table of offsets, relative to the entry, then chunks  
+         entry.mFlags = Compressed;
+         entry.mChunkSize = file.mChunkSize;
+         const auto count = (entry.mSize + file.mChunkSize - 1)
+            / file.mChunkSize;
+         std::vector<uint64_t> table;
+         std::string chunks;
+         for (uint64_t c = 0; c < count; ++c) {
+            table.push_back((count + 1) * sizeof(uint64_t) + chunks.size());
+            chunks += CompressChunk(file.mContents.substr(
+               c * file.mChunkSize, file.mChunkSize));
+         }
+         table.push_back((count + 1) * sizeof(uint64_t) + chunks.size());
+         stored[i].assign(reinterpret_cast<const char*>(table.data()),
+            table.size() * sizeof(uint64_t));
+         stored[i] += chunks;
+      }
+      entry.mStoredSize = stored[i].size();
+   }
+
+   PackHeader header {};
+   std::memcpy(header.mMagic, Magic, sizeof(Magic));
+   header.mVersion = Version;
+   header.mAlignment = DefaultAlignment;
+   header.mEntryCount = static_cast<uint32_t>(entries.size());
+   header.mEntriesOffset = sizeof(PackHeader);
+   header.mNamesOffset = header.mEntriesOffset
+      + entries.size() * sizeof(PackEntry);
+   header.mNamesSize = names.size();
+#if LANGULUS_MOD_FILESYSTEM_LZ4
+   header.mCompression = LZ4;
+#else
+   header.mCompression = None;
+#endif
+
+   auto at = Align(header.mNamesOffset + names.size(), DefaultAlignment);
+   for (size_t i = 0; i < files.size(); ++i) {
+      if (files[i].mDirectory)
+         continue;
+      entries[i].mOffset = at;
+      at = Align(at + stored[i].size(), DefaultAlignment);
+   }
+
+   std::string pack {reinterpret_cast<const char*>(&header), sizeof(header)};
+   pack.append(reinterpret_cast<const char*>(entries.data()),
+      entries.size() * sizeof(PackEntry));
+   pack += names;
+   for (size_t i = 0; i < files.size(); ++i) {
+      if (files[i].mDirectory)
+         continue;
+      pack.resize(entries[i].mOffset, '\0');
+      pack += stored[i];
+   }
+   return pack;
+}
+
+/// Make contents that differ from byte to byte, but still compress well      
+///   @param size - the size in bytes                                         
+///   @return the contents                                                    
+static std::string MakePattern(size_t size) {
+   std::string result(size, '\0');
+   for (size_t i = 0; i < size; ++i)
+      result[i] = static_cast<char>('a' + (i / 7 + i % 3) % 26);
+   return result;
+}
+
+/// Unmount a native directory or archive, mounted with MountNative           
+///   @param module - the module                                              
+///   @param native - the native path                                         
+///   @return true on success                                                 
+static bool UnmountNative(::FileSystem* module, const fs::path& native) {
+   const auto path = fs::absolute(native).string();
+   return module->Unmount(Path {Token {path}});
+}
+
+/// Compute the checksum of zip entries                                       
+///   @param data - the entry contents                                        
+///   @return the CRC-32                                                      
+static uint32_t Crc32(std::string_view data) {
+   uint32_t crc = ~0u;
+   for (unsigned char c : data) {
+      crc ^= c;
+      for (int bit = 0; bit < 8; ++bit)
+         crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+   }
+   return ~crc;
+}
+
+/// Make a zip archive in memory, without compression                         
+///   @param files - names and contents of the entries                        
+///   @return the archive                                                     
+static std::string MakeZip(
+   const std::vector<std::pair<std::string, std::string>>& files
+) {
+   const auto put16 = [](std::string& out, size_t value) {
+      out += static_cast<char>(value & 0xFF);
+      out += static_cast<char>((value >> 8) & 0xFF);
+   };
+   const auto put32 = [&](std::string& out, size_t value) {
+      put16(out, value & 0xFFFF);
+      put16(out, (value >> 16) & 0xFFFF);
+   };
+
+   std::string zip, central;
+   for (auto& [name, contents] : files) {
+      const auto offset = zip.size();
+      const auto crc = Crc32(contents);
+
+      // Local header - version, flags, method, time, date, checksum,   
+      // sizes, name and extra field lengths                            
+      put32(zip, 0x04034B50);
+      for (size_t field : {20, 0, 0, 0, 0x21})
+         put16(zip, field);
+      for (size_t field : {size_t {crc}, contents.size(), contents.size()})
+         put32(zip, field);
+      put16(zip, name.size());
+      put16(zip, 0);
+      zip += name;
+      zip += contents;
+
+      // Central directory entry - same, with a few more fields         
+      put32(central, 0x02014B50);
+      for (size_t field : {20, 20, 0, 0, 0, 0x21})
+         put16(central, field);
+      for (size_t field : {size_t {crc}, contents.size(), contents.size()})
+         put32(central, field);
+      for (size_t field : {name.size(), size_t {0}, size_t {0}, size_t {0},
+                           size_t {0}})
+         put16(central, field);
+      put32(central, 0);
+      put32(central, offset);
+      central += name;
+   }
+
+   const auto at = zip.size();
+   zip += central;
+   put32(zip, 0x06054B50);
+   for (size_t field : {size_t {0}, size_t {0}, files.size(), files.size()})
+      put16(zip, field);
+   put32(zip, central.size());
+   put32(zip, at);
+   put16(zip, 0);
+   return zip;
+}
+
+/// Create or delete entries in a folder, as a single batch                   
+///   @param folder - the folder                                              
+///   @param paths - paths relative to the folder, folders end with a slash   
+///   @param remove - whether to delete entries, instead of creating them     
+///   @return sorted full paths of the created or deleted entries             
+static std::vector<std::string> Batch(
+   const Ref<A::Folder>& folder, std::initializer_list<const char*> paths,
+   bool remove = false
+) {
+   TMany<Text> arguments;
+   for (auto path : paths)
+      arguments << Text {path};
+
+   Verbs::Create create {arguments};
+   if (remove)
+      create.SetMass(-1);
+   AsFolder(folder)->Create(create);
+
+   std::vector<std::string> result;
+   create.GetOutput().ForEachDeep([&](const Path& path) {
+      result.emplace_back(AsToken(path));
+   });
+   std::ranges::sort(result);
+   return result;
+}
+
+/// Get the module's reader behind an abstract reader reference               
+///   @param reader - the reader reference, must outlive the result           
+///   @return the reader                                                      
+static ::File::Reader* AsReader(const Ref<A::File::Reader>& reader) {
+   return static_cast<::File::Reader*>(
+      const_cast<A::File::Reader*>(reader.Get()));
+}
+
+/// Read the next bytes from a reader                                         
+///   @param reader - the reader                                              
+///   @param size - number of bytes to read                                   
+///   @return the read bytes, fewer only at the end of the file               
+static std::string ReadNext(const Ref<A::File::Reader>& reader, size_t size) {
+   auto bytes = Allocate(size);
+   const auto read = AsReader(reader)->Read(bytes);
+   return AsString(bytes).substr(0, read);
+}
 
 
 SCENARIO("Non-existing file/folder interfacing", "[filesystem]") {
@@ -135,3 +514,2599 @@ SCENARIO("Existing file/folder interfacing", "[filesystem]") {
    }
 }
 
+SCENARIO("Reading file contents", "[filesystem]") {
+   static Allocator::State memoryState;
+
+   for (int repeat = 0; repeat != 10; ++repeat) {
+      GIVEN(std::string("Init and shutdown cycle #") + std::to_string(repeat)) {
+         // Create root entity                                          
+         auto root = Thing::Root<false>("FileSystem");
+
+         WHEN("An existing text file is read as text") {
+            auto producedFile = root.CreateUnit<A::File>("test.txt");
+            auto file = producedFile.template As<A::File*>();
+            const auto contents = file->ReadAs(MetaDataOf<Text>());
+
+            REQUIRE(file->Exists());
+            REQUIRE(contents.GetCount() == file->GetBytesize());
+            REQUIRE(contents.GetBytesize() == file->GetBytesize());
+         }
+
+         WHEN("An existing text file is read raw") {
+            auto producedFile = root.CreateUnit<A::File>("test.txt");
+            auto file = producedFile.template As<A::File*>();
+            const auto contents = file->ReadAs(nullptr);
+
+            REQUIRE(contents.GetBytesize() == file->GetBytesize());
+         }
+
+         WHEN("A non-existing file is read") {
+            auto producedFile = root.CreateUnit<A::File>("nonexistent.txt");
+            auto file = producedFile.template As<A::File*>();
+
+            REQUIRE_THROWS(file->ReadAs(MetaDataOf<Text>()));
+         }
+
+         // Check for memory leaks after each cycle                     
+         REQUIRE(memoryState.Assert());
+      }
+   }
+}
+
+SCENARIO("Memory-mapped views", "[filesystem]") {
+   static Allocator::State memoryState;
+
+   GIVEN("The same contents in a directory, a pack and an archive") {
+      auto root = Thing::Root<false>("FileSystem");
+      const auto runtime = root.GetRuntime();
+      const auto module = GetModule(runtime);
+      const auto dir = Sandbox(runtime, "mapped");
+      const auto contents = MakePattern(100000);
+      WriteNative(dir / "native.bin", contents);
+      WriteNative(dir / "empty.bin", "");
+      WriteNative(dir / "packed.lpk", MakePack({
+         {"first.bin", MakePattern(123)}, {"plain.bin", contents}}));
+      WriteNative(dir / "zipped.zip", MakeZip({{"plain.bin", contents}}));
+      REQUIRE(MountNative(module, dir / "packed.lpk", "packed"));
+      REQUIRE(MountNative(module, dir / "zipped.zip", "zipped"));
+
+      WHEN("Files are viewed") {
+         // Only archived files have to be copied                       
+         const std::pair<const char*, bool> cases[] {
+            {"mapped/native.bin", true}, {"packed/plain.bin", true},
+            {"zipped/plain.bin", false}
+         };
+
+         for (auto [path, mapped] : cases) {
+            auto file = runtime->GetFile(path);
+            const auto view = AsFile(file)->NewMappedView();
+            REQUIRE(view.IsMapped() == mapped);
+            REQUIRE(AsString(view.GetData()) == contents);
+            REQUIRE(AsString(view.GetData())
+               == AsString(file->ReadAs(nullptr)));
+
+            // Views share a single mapping                             
+            const auto another = AsFile(file)->NewMappedView();
+            REQUIRE((another.GetData().GetRaw() == view.GetData().GetRaw())
+               == mapped);
+         }
+
+         for (auto path : {"mapped/empty.bin", "mapped/missing.bin"}) {
+            const auto view = AsFile(runtime->GetFile(path))
+               ->NewMappedView();
+            REQUIRE_FALSE(view.IsMapped());
+            REQUIRE(view.GetData().IsEmpty());
+         }
+      }
+
+      WHEN("A viewed file is rewritten") {
+         auto file = runtime->GetFile("mapped/native.bin");
+         const auto view = AsFile(file)->NewMappedView();
+         REQUIRE(view.IsMapped());
+
+         {
+            auto writer = AsFile(file)->NewWriter(false);
+            writer->Write(AsBytes("rewritten"));
+         }
+
+         // The view keeps the old contents, new views see the new ones 
+         REQUIRE(AsString(view.GetData()) == contents);
+         REQUIRE(ReadNative(dir / "native.bin") == "rewritten");
+         AsFile(file)->Refresh();
+         const auto fresh = AsFile(file)->NewMappedView();
+         REQUIRE(AsString(fresh.GetData()) == "rewritten");
+         REQUIRE(AsString(view.GetData()) == contents);
+      }
+
+      // Check for memory leaks after each cycle                        
+      REQUIRE(memoryState.Assert());
+   }
+}
+
+SCENARIO("Asynchronous reads and writes", "[filesystem]") {
+   static Allocator::State memoryState;
+
+   GIVEN("A file system with asynchronous I/O workers") {
+      auto root = Thing::Root<false>("FileSystem");
+      const auto runtime = root.GetRuntime();
+      const auto module = GetModule(runtime);
+      const auto dir = Sandbox(runtime, "async");
+      const auto contents = MakePattern(100000);
+      WriteNative(dir / "source.bin", contents);
+      auto source = runtime->GetFile("async/source.bin");
+      auto target = runtime->GetFile("async/target.bin");
+      auto& async = module->GetAsyncIO();
+      const auto mainThread = std::this_thread::get_id();
+
+      // Completed requests, as seen by their callbacks                 
+      struct Completed {
+         Offset mOffset;
+         Offset mResult;
+         std::string mError;
+      };
+      std::vector<Completed> completed;
+      const auto onComplete = [&](AsyncIO::Request& request) {
+         REQUIRE(std::this_thread::get_id() == mainThread);
+         completed.push_back(
+            {request.mOffset, request.mResult, request.mError});
+      };
+
+      // Callbacks are invoked only from Update                         
+      const auto wait = [&](size_t count) {
+         const auto deadline = std::chrono::steady_clock::now()
+            + std::chrono::seconds(10);
+         while (completed.size() < count
+         and std::chrono::steady_clock::now() < deadline) {
+            root.Update({});
+            std::this_thread::yield();
+         }
+         REQUIRE(completed.size() == count);
+         REQUIRE(async.GetInFlight() == 0);
+      };
+
+      WHEN("Ranges are read in parallel") {
+         constexpr Offset Size = 1000;
+         const Offset offsets[] {0, 5000, 4095, 99000, 99500, 50000};
+         std::vector<Many> outputs;
+         for (auto offset : offsets) {
+            outputs.push_back(Allocate(Size));
+            AsFile(source)->ReadAsync(offset, outputs.back(), onComplete);
+         }
+
+         REQUIRE(completed.empty());
+         REQUIRE(async.GetInFlight() == std::size(offsets));
+         wait(std::size(offsets));
+
+         // Completion order is arbitrary, so match by offset           
+         for (size_t i = 0; i < std::size(offsets); ++i) {
+            const auto offset = offsets[i];
+            const auto done = std::ranges::find(
+               completed, offset, &Completed::mOffset);
+            REQUIRE(done != completed.end());
+            REQUIRE(done->mError.empty());
+
+            // The last read stops at the end of the file               
+            const auto expected = contents.substr(offset, Size);
+            REQUIRE(done->mResult == expected.size());
+            REQUIRE(AsString(outputs[i]).substr(0, done->mResult)
+               == expected);
+         }
+      }
+
+      WHEN("A file is written, and then appended to") {
+         AsFile(target)->WriteAsync(AsBytes(contents), false, onComplete);
+         REQUIRE(completed.empty());
+         wait(1);
+         REQUIRE(completed[0].mError.empty());
+         REQUIRE(completed[0].mResult == contents.size());
+         REQUIRE(ReadNative(dir / "target.bin") == contents);
+
+         // Appends are done one after another, so that they're ordered 
+         AsFile(target)->WriteAsync(AsBytes("first"), true, onComplete);
+         wait(2);
+         AsFile(target)->WriteAsync(AsBytes("second"), true, onComplete);
+         wait(3);
+         REQUIRE(completed[1].mResult == 5);
+         REQUIRE(completed[2].mResult == 6);
+         REQUIRE(ReadNative(dir / "target.bin")
+            == contents + "first" + "second");
+
+         // Rewriting replaces the file, instead of truncating it, so   
+         // views keep the old contents, and the file is seen anew      
+         const auto view = AsFile(target)->NewMappedView();
+         AsFile(target)->WriteAsync(AsBytes("short"), false, onComplete);
+         wait(4);
+         REQUIRE(ReadNative(dir / "target.bin") == "short");
+         REQUIRE(AsString(view.GetData()) == contents + "first" + "second");
+         REQUIRE(target->GetBytesize() == 5);
+         REQUIRE(AsString(AsFile(target)->NewMappedView().GetData())
+            == "short");
+         PHYSFS_Stat info {};
+         REQUIRE(module->GetStatCache().Stat("async/target.bin", info));
+         REQUIRE(info.filesize == 5);
+         REQUIRE(CountTemporaries(dir) == 0);
+      }
+
+      WHEN("A completion callback throws") {
+         auto output = Allocate(10);
+         bool thrown = false;
+         for (int i = 0; i < 3; ++i) {
+            AsFile(source)->ReadAsync(i * 10, output,
+               [&](AsyncIO::Request& request) {
+                  if (not thrown) {
+                     thrown = true;
+                     throw std::runtime_error {"callback failed"};
+                  }
+                  onComplete(request);
+               });
+         }
+
+         // The others are dispatched anyway, on the next call          
+         const auto deadline = std::chrono::steady_clock::now()
+            + std::chrono::seconds(10);
+         while (completed.size() < 2
+         and std::chrono::steady_clock::now() < deadline) {
+            try { async.Dispatch(); }
+            catch (const std::runtime_error&) {}
+            std::this_thread::yield();
+         }
+
+         REQUIRE(thrown);
+         REQUIRE(completed.size() == 2);
+         REQUIRE(async.GetInFlight() == 0);
+      }
+
+      WHEN("A file that doesn't exist is read") {
+         auto missing = runtime->GetFile("async/missing.bin");
+         auto output = Allocate(10);
+         AsFile(missing)->ReadAsync(0, output, onComplete);
+         wait(1);
+         REQUIRE_FALSE(completed[0].mError.empty());
+         REQUIRE(completed[0].mResult == 0);
+      }
+
+      // Check for memory leaks after each cycle                        
+      REQUIRE(memoryState.Assert());
+   }
+}
+
+/// Select a position inside a file                                           
+///   @param file - the file                                                  
+///   @param select - the select verb, with the position as argument          
+///   @return the reader, positioned at the selected offset                   
+static Ref<A::File::Reader> SelectReader(
+   const Ref<A::File>& file, Verbs::Select&& select
+) {
+   AsFile(file)->Select(select);
+   REQUIRE(select.GetOutput().GetCount() == 1);
+   return select.GetOutput().template As<A::File::Reader*>();
+}
+
+SCENARIO("Positional reads and independent readers", "[filesystem]") {
+   static Allocator::State memoryState;
+
+   GIVEN("The same contents in a directory and in an archive") {
+      auto root = Thing::Root<false>("FileSystem");
+      const auto runtime = root.GetRuntime();
+      const auto module = GetModule(runtime);
+      const auto dir = Sandbox(runtime, "ranges");
+      const auto contents = MakePattern(300000);
+      WriteNative(dir / "data.bin", contents);
+      WriteNative(dir / "data.zip", MakeZip({{"data.bin", contents}}));
+      REQUIRE(MountNative(module, dir / "data.zip", "zipped"));
+      const std::vector<Ref<A::File>> files {
+         runtime->GetFile("ranges/data.bin"),
+         runtime->GetFile("zipped/data.bin")
+      };
+
+      WHEN("Ranges are read") {
+         // Ranges don't depend on each other, nor on any cursor        
+         const std::pair<Offset, Offset> ranges[] {
+            {0, 100}, {250000, 4096}, {65530, 20}, {299990, 100},
+            {1000, 0}, {400000, 10}
+         };
+
+         for (auto& file : files) {
+            REQUIRE(file->GetBytesize() == contents.size());
+            for (auto [offset, size] : ranges) {
+               Many output;
+               const auto read = AsFile(file)->ReadRange(
+                  offset, size, output);
+               const auto expected = offset < contents.size()
+                  ? contents.substr(offset, size) : std::string {};
+               REQUIRE(read == expected.size());
+               REQUIRE(AsString(output).substr(0, read) == expected);
+            }
+
+            // Preallocated outputs are filled, and must be big enough  
+            auto output = Allocate(64);
+            REQUIRE(AsFile(file)->ReadRange(1234, 64, output) == 64);
+            REQUIRE(AsString(output) == contents.substr(1234, 64));
+            REQUIRE_THROWS(AsFile(file)->ReadRange(0, 65, output));
+         }
+      }
+
+      WHEN("Positions are selected") {
+         for (auto& file : files) {
+            auto front = SelectReader(file, Verbs::Select {});
+            REQUIRE(AsReader(front)->GetPosition() == 0);
+            REQUIRE(ReadNext(front, 10) == contents.substr(0, 10));
+
+            auto middle = SelectReader(file, Verbs::Select {Offset {1234}});
+            REQUIRE(AsReader(middle)->GetPosition() == 1234);
+            REQUIRE(ReadNext(middle, 10) == contents.substr(1234, 10));
+
+            // Back and last are both where the file currently ends     
+            for (auto index : {IndexBack, IndexLast}) {
+               auto back = SelectReader(file, Verbs::Select {index});
+               REQUIRE(AsReader(back)->GetPosition() == contents.size());
+               REQUIRE(ReadNext(back, 10).empty());
+            }
+
+            // Readers don't share their cursor with each other         
+            REQUIRE(ReadNext(front, 10) == contents.substr(10, 10));
+            REQUIRE(ReadNext(middle, 10) == contents.substr(1244, 10));
+         }
+      }
+
+      WHEN("Readers are interleaved") {
+         for (auto& file : files) {
+            auto first = AsFile(file)->NewReader();
+            auto second = AsFile(file)->NewReader();
+            AsReader(second)->Seek(150000);
+
+            // Each reader continues where it left off                  
+            for (size_t at = 0; at < 100000; at += 10000) {
+               REQUIRE(ReadNext(first, 10000)
+                  == contents.substr(at, 10000));
+               REQUIRE(ReadNext(second, 10000)
+                  == contents.substr(150000 + at, 10000));
+            }
+
+            REQUIRE(AsReader(first)->GetPosition() == 100000);
+            REQUIRE(AsReader(second)->GetPosition() == 250000);
+         }
+      }
+
+      WHEN("Readers and ranges are used from multiple threads") {
+         constexpr size_t Threads = 4;
+         constexpr size_t Part = 300000 / Threads;
+
+         for (auto& file : files) {
+            // Everything is allocated here, and each reader is used by 
+            // a single thread                                          
+            std::vector<Ref<A::File::Reader>> readers;
+            std::vector<Many> ranges;
+            for (size_t i = 0; i < Threads; ++i) {
+               readers.push_back(AsFile(file)->NewReader());
+               AsReader(readers.back())->Seek(i * Part);
+               ranges.push_back(Allocate(1000));
+            }
+
+            std::vector<std::string> parts(Threads);
+            std::vector<std::thread> threads;
+            for (size_t i = 0; i < Threads; ++i) {
+               threads.emplace_back([&, i] {
+                  std::vector<Byte> bytes(Part);
+                  for (size_t done = 0; done < Part; done += 1000)
+                     AsReader(readers[i])->Read(bytes.data() + done, 1000);
+                  parts[i].assign(
+                     reinterpret_cast<const char*>(bytes.data()), Part);
+                  AsFile(file)->ReadRange(Part - i * 1000, 1000, ranges[i]);
+               });
+            }
+            for (auto& thread : threads)
+               thread.join();
+
+            for (size_t i = 0; i < Threads; ++i) {
+               REQUIRE(parts[i] == contents.substr(i * Part, Part));
+               REQUIRE(AsString(ranges[i])
+                  == contents.substr(Part - i * 1000, 1000));
+            }
+         }
+      }
+
+      // Check for memory leaks after each cycle                        
+      REQUIRE(memoryState.Assert());
+   }
+}
+
+SCENARIO("Parallel reads", "[filesystem]") {
+   static Allocator::State memoryState;
+
+   GIVEN("Files spanning several read chunks and parallel ranges") {
+      auto root = Thing::Root<false>("FileSystem");
+      const auto runtime = root.GetRuntime();
+      const auto module = GetModule(runtime);
+      const auto dir = Sandbox(runtime, "parallel");
+
+      // Files are read in 1 MiB chunks, and split in ranges of at      
+      // least 32 MiB - see File.cpp. Each 8 bytes hold their offset,   
+      // so a range read into the wrong place can't go unnoticed        
+      constexpr size_t MiB = 1024 * 1024;
+      const auto makeContents = [](size_t size) {
+         std::string result(size, '\0');
+         for (size_t at = 0; at < size; at += sizeof(uint64_t)) {
+            const uint64_t word = at;
+            std::memcpy(result.data() + at, &word,
+               std::min(sizeof(word), size - at));
+         }
+         return result;
+      };
+
+      const std::pair<const char*, size_t> sizes[] {
+         {"parallel/small.bin",  12345},
+         {"parallel/chunks.bin", 3 * MiB},
+         {"parallel/ranges.bin", 96 * MiB},
+         {"parallel/uneven.bin", 70 * MiB + 12345}
+      };
+      for (auto [path, size] : sizes)
+         WriteNative(dir / fs::path {path}.filename(), makeContents(size));
+      WriteNative(dir / "data.zip", MakeZip({
+         {"uneven.bin", makeContents(3 * MiB + 12345)}}));
+      REQUIRE(MountNative(module, dir / "data.zip", "zipped"));
+
+      WHEN("Files are read with any number of threads") {
+         const Count threads[] {0, 1, 3, 16};
+         for (auto [path, size] : sizes) {
+            const auto interfaced = runtime->GetFile(path);
+            const auto file = AsFile(interfaced);
+            REQUIRE(file->GetBytesize() == size);
+            const auto expected = file->ReadAs(nullptr);
+            REQUIRE(expected.GetBytesize() == size);
+
+            for (auto count : threads) {
+               Many output;
+               REQUIRE(file->ReadParallel(output, count) == size);
+               REQUIRE(output.GetBytesize() == size);
+               REQUIRE(0 == std::memcmp(
+                  output.GetRaw(), expected.GetRaw(), size));
+            }
+         }
+      }
+
+      WHEN("An archived file is read, one range after another") {
+         const auto interfaced = runtime->GetFile("zipped/uneven.bin");
+         const auto file = AsFile(interfaced);
+         const auto expected = file->ReadAs(nullptr);
+         for (Count count : {0, 4}) {
+            Many output;
+            REQUIRE(file->ReadParallel(output, count) == 3 * MiB + 12345);
+            REQUIRE(0 == std::memcmp(output.GetRaw(), expected.GetRaw(),
+               expected.GetBytesize()));
+         }
+      }
+
+      WHEN("Files are read into preallocated blocks") {
+         const auto interfaced = runtime->GetFile("parallel/uneven.bin");
+         const auto file = AsFile(interfaced);
+         const auto expected = file->ReadAs(nullptr);
+
+         // Bigger blocks are filled only as much as the file goes      
+         auto output = Allocate(expected.GetBytesize() + 100);
+         REQUIRE(file->ReadParallel(output, 4) == expected.GetBytesize());
+         REQUIRE(0 == std::memcmp(output.GetRaw(), expected.GetRaw(),
+            expected.GetBytesize()));
+
+         auto small = Allocate(expected.GetBytesize() - 1);
+         REQUIRE_THROWS(file->ReadParallel(small, 4));
+      }
+
+      WHEN("Empty and missing files are read") {
+         WriteNative(dir / "empty.bin", "");
+         Many output;
+         REQUIRE(AsFile(runtime->GetFile("parallel/empty.bin"))
+            ->ReadParallel(output) == 0);
+         REQUIRE_THROWS(AsFile(runtime->GetFile("parallel/missing.bin"))
+            ->ReadParallel(output));
+      }
+
+      // Check for memory leaks after each cycle                        
+      REQUIRE(memoryState.Assert());
+   }
+}
+
+SCENARIO("Adaptive read-ahead", "[filesystem]") {
+   static Allocator::State memoryState;
+
+   GIVEN("A file, read with various buffering options") {
+      auto root = Thing::Root<false>("FileSystem");
+      const auto runtime = root.GetRuntime();
+      const auto dir = Sandbox(runtime, "buffering");
+      const auto contents = MakePattern(1024 * 1024);
+      WriteNative(dir / "data.bin", contents);
+      WriteNative(dir / "data.zip", MakeZip({{"data.bin", contents}}));
+      REQUIRE(MountNative(GetModule(runtime), dir / "data.zip", "zipped"));
+      auto file = runtime->GetFile("buffering/data.bin");
+
+      ::File::Buffering buffering;
+      buffering.mSize = 4096;
+      buffering.mMaxSize = 64 * 1024;
+
+      // Read sequentially, checking the contents along the way         
+      const auto readAll = [&](const Ref<A::File::Reader>& reader,
+         Offset from, Offset size, Offset chunk) {
+         for (Offset at = from; at < from + size; at += chunk)
+            REQUIRE(ReadNext(reader, chunk) == contents.substr(at, chunk));
+      };
+
+      WHEN("The file is read sequentially") {
+         auto reader = AsFile(file)->NewReader(buffering);
+         REQUIRE(AsReader(reader)->GetBufferSize() == 4096);
+
+         // The buffer doubles each time twice its size is read         
+         readAll(reader, 0, 8192, 1024);
+         REQUIRE(AsReader(reader)->GetBufferSize() == 8192);
+         readAll(reader, 8192, 16384, 1024);
+         REQUIRE(AsReader(reader)->GetBufferSize() == 16384);
+
+         // ...but never beyond the maximum                             
+         readAll(reader, 24576, 512 * 1024, 4096);
+         REQUIRE(AsReader(reader)->GetBufferSize() == 64 * 1024);
+
+         // Seeking to where the reader already is isn't random access  
+         const auto position = AsReader(reader)->GetPosition();
+         REQUIRE(position == 24576 + 512 * 1024);
+         AsReader(reader)->Seek(position);
+         readAll(reader, position, 4096, 4096);
+         REQUIRE(AsReader(reader)->GetBufferSize() == 64 * 1024);
+
+         // Reading anywhere else shrinks the buffer back               
+         AsReader(reader)->Seek(1000);
+         REQUIRE(AsReader(reader)->GetBufferSize() == 64 * 1024);
+         readAll(reader, 1000, 100, 100);
+         REQUIRE(AsReader(reader)->GetBufferSize() == 4096);
+
+         // ...and it grows again from there                            
+         readAll(reader, 1100, 8192, 1024);
+         REQUIRE(AsReader(reader)->GetBufferSize() == 8192);
+      }
+
+      WHEN("The file is read with a fixed buffer") {
+         buffering.mAdaptive = false;
+         auto reader = AsFile(file)->NewReader(buffering);
+         readAll(reader, 0, 512 * 1024, 4096);
+         REQUIRE(AsReader(reader)->GetBufferSize() == 4096);
+      }
+
+      WHEN("The file is read without a buffer") {
+         buffering.mSize = 0;
+         auto reader = AsFile(file)->NewReader(buffering);
+         readAll(reader, 0, 512 * 1024, 4096);
+         REQUIRE(AsReader(reader)->GetBufferSize() == 0);
+      }
+
+      WHEN("An archived file is read through the block cache") {
+         // There's no handle to buffer, the blocks are the read-ahead  
+         auto reader = AsFile(runtime->GetFile("zipped/data.bin"))
+            ->NewReader(buffering);
+         readAll(reader, 0, 512 * 1024, 4096);
+         REQUIRE(AsReader(reader)->GetBufferSize() == 0);
+      }
+
+      // Check for memory leaks after each cycle                        
+      REQUIRE(memoryState.Assert());
+   }
+}
+
+SCENARIO("Watching for changes on disk", "[filesystem]") {
+   static Allocator::State memoryState;
+
+   GIVEN("Interfaced files and folders, that change natively") {
+      auto root = Thing::Root<false>("FileSystem");
+      const auto runtime = root.GetRuntime();
+      const auto dir = Sandbox(runtime, "watched");
+      WriteNative(dir / "data.bin", "old");
+      auto file = runtime->GetFile("watched/data.bin");
+      auto folder = runtime->GetFolder("watched/sub");
+      auto parent = runtime->GetFolder("watched");
+
+      // Files are watched once their contents are used, folders once   
+      // they're enumerated                                             
+      REQUIRE(AsString(AsFile(file)->ReadAs(nullptr)) == "old");
+      REQUIRE_FALSE(folder->Exists());
+      REQUIRE(SelectPaths(folder).empty());
+      REQUIRE(SelectPaths(parent) == std::vector<std::string> {
+         "watched/data.bin"});
+
+      // Changes are seen only in Update, as soon as the OS reports them
+      const auto update = [&](auto&& condition) {
+         const auto deadline = std::chrono::steady_clock::now()
+            + std::chrono::seconds(10);
+         while (not condition()
+         and std::chrono::steady_clock::now() < deadline) {
+            root.Update({});
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+         }
+         return condition();
+      };
+
+   #if defined(__linux__)
+      WHEN("A file is modified") {
+         WriteNative(dir / "data.bin", "new contents");
+         REQUIRE(update([&] { return file->GetBytesize() == 12; }));
+         REQUIRE(file->Exists());
+         REQUIRE(AsString(AsFile(file)->ReadAs(nullptr)) == "new contents");
+         REQUIRE(AsString(AsFile(file)->NewMappedView().GetData())
+            == "new contents");
+      }
+
+      WHEN("A file is deleted, and then created again") {
+         fs::remove(dir / "data.bin");
+         REQUIRE(update([&] { return not file->Exists(); }));
+         REQUIRE(file->GetBytesize() == 0);
+         REQUIRE_THROWS(AsFile(file)->ReadAs(nullptr));
+
+         // The directory remains watched, so the file is seen again    
+         WriteNative(dir / "data.bin", "again");
+         REQUIRE(update([&] { return file->Exists(); }));
+         REQUIRE(file->GetBytesize() == 5);
+         REQUIRE(AsString(AsFile(file)->ReadAs(nullptr)) == "again");
+      }
+
+      WHEN("A folder is created, filled and deleted") {
+         fs::create_directory(dir / "sub");
+         REQUIRE(update([&] { return folder->Exists(); }));
+         REQUIRE(SelectPaths(parent) == std::vector<std::string> {
+            "watched/data.bin", "watched/sub"});
+
+         // The new file is seen by the folder, and by its interface    
+         WriteNative(dir / "sub" / "created.bin", "created");
+         root.Update({});
+         REQUIRE(SelectPaths(folder) == std::vector<std::string> {
+            "watched/sub/created.bin"});
+         auto created = runtime->GetFile("watched/sub/created.bin");
+         REQUIRE(created->Exists());
+         REQUIRE(AsString(AsFile(created)->ReadAs(nullptr)) == "created");
+
+         fs::remove_all(dir / "sub");
+         REQUIRE(update([&] { return not folder->Exists(); }));
+         REQUIRE(SelectPaths(folder).empty());
+         REQUIRE(update([&] { return not created->Exists(); }));
+      }
+   #endif
+
+      WHEN("Nothing changes") {
+         // Polling without changes refreshes nothing                   
+         root.Update({});
+         REQUIRE(file->Exists());
+         REQUIRE(file->GetBytesize() == 3);
+         REQUIRE_FALSE(folder->Exists());
+      }
+
+      // Check for memory leaks after each cycle                        
+      REQUIRE(memoryState.Assert());
+   }
+}
+
+SCENARIO("Metadata cache", "[filesystem]") {
+   static Allocator::State memoryState;
+
+   GIVEN("A directory, whose contents are looked up through the cache") {
+      auto root = Thing::Root<false>("FileSystem");
+      const auto runtime = root.GetRuntime();
+      const auto module = GetModule(runtime);
+      const auto dir = Sandbox(runtime, "meta");
+      WriteNative(dir / "data.bin", "data");
+      auto& cache = module->GetStatCache();
+
+      // Stat a path, checking whether it was cached                    
+      const auto stat = [&](const char* path, bool cached) {
+         const auto hits = cache.GetHits();
+         const auto misses = cache.GetMisses();
+         PHYSFS_Stat info {};
+         const bool found = cache.Stat(path, info);
+         REQUIRE(cache.GetHits() - hits == (cached ? 1 : 0));
+         REQUIRE(cache.GetMisses() - misses == (cached ? 0 : 1));
+         return found ? std::optional<PHYSFS_sint64> {info.filesize}
+                      : std::nullopt;
+      };
+
+      WHEN("Paths are looked up repeatedly") {
+         REQUIRE(stat("meta/data.bin", false) == 4);
+         REQUIRE(stat("meta/data.bin", true) == 4);
+         REQUIRE(stat("meta//data.bin", true) == 4);
+         REQUIRE(stat("meta\\data.bin", true) == 4);
+
+         // Missing paths are cached too                                
+         REQUIRE_FALSE(stat("meta/missing.bin", false));
+         REQUIRE_FALSE(stat("meta/missing.bin", true));
+
+         // Each case is resolved on its own, and replaces the other,   
+         // because native directories can be case-sensitive            
+         const auto upper = stat("meta/DATA.bin", false);
+         REQUIRE(stat("meta/DATA.bin", true) == upper);
+         REQUIRE(stat("meta/data.bin", false) == 4);
+      }
+
+      WHEN("Missing files are written") {
+         auto file = AsFile(runtime->GetFile("meta/written.bin"));
+         REQUIRE_FALSE(stat("meta/written.bin", true));
+
+         {
+            auto writer = file->NewWriter(false);
+            writer->Write(AsBytes("written"));
+         }
+         REQUIRE(stat("meta/written.bin", false) == 7);
+
+         file->WriteAtomic(AsBytes("rewritten"));
+         REQUIRE(stat("meta/written.bin", true) == 9);
+         REQUIRE(file->GetBytesize() == 9);
+      }
+
+      WHEN("Missing files are created in a batch") {
+         REQUIRE_FALSE(stat("meta/new/file.bin", false));
+         REQUIRE_FALSE(stat("meta/new", false));
+         Batch(runtime->GetFolder("meta"), {"new/file.bin"});
+         REQUIRE(stat("meta/new/file.bin", false) == 0);
+         REQUIRE(stat("meta/new", false));
+
+         Batch(runtime->GetFolder("meta"), {"new/"}, true);
+         REQUIRE_FALSE(stat("meta/new/file.bin", false));
+         REQUIRE_FALSE(stat("meta/new", false));
+      }
+
+      WHEN("Missing files are mounted") {
+         REQUIRE_FALSE(stat("mounted/inside.bin", false));
+         WriteNative(dir / "data.zip", MakeZip({{"inside.bin", "inside"}}));
+         REQUIRE(MountNative(module, dir / "data.zip", "mounted"));
+         REQUIRE(stat("mounted/inside.bin", false) == 6);
+
+         REQUIRE(UnmountNative(module, dir / "data.zip"));
+         REQUIRE_FALSE(stat("mounted/inside.bin", false));
+      }
+
+      WHEN("More paths are looked up than the cache can hold") {
+         cache.SetCapacity(16);
+         REQUIRE(cache.GetCount() <= 16);
+
+         std::vector<std::string> paths;
+         for (int i = 0; i < 100; ++i)
+            paths.push_back("meta/missing" + std::to_string(i) + ".bin");
+         for (auto& path : paths)
+            REQUIRE_FALSE(stat(path.c_str(), false));
+         REQUIRE(cache.GetCount() == 16);
+
+         // Evicted paths are resolved again, and still correctly       
+         Count hits = cache.GetHits();
+         for (auto& path : paths) {
+            PHYSFS_Stat info {};
+            REQUIRE_FALSE(cache.Stat(path, info));
+         }
+         REQUIRE(cache.GetHits() - hits <= 16);
+         REQUIRE(stat("meta/data.bin", false) == 4);
+         REQUIRE(cache.GetCount() == 16);
+
+         cache.SetCapacity(StatCache::DefaultCapacity);
+      }
+
+      // Check for memory leaks after each cycle                        
+      REQUIRE(memoryState.Assert());
+   }
+}
+
+SCENARIO("Interning paths", "[filesystem]") {
+   static Allocator::State memoryState;
+
+   GIVEN("A path index") {
+      PathIndex index;
+
+      WHEN("Equivalent paths are interned") {
+         REQUIRE_FALSE(index.Find({"data/textures/a.png"}));
+         const auto handle = index.Intern({"data/textures/a.png"});
+         REQUIRE(handle);
+         REQUIRE(index.Get(handle).mPath == "data/textures/a.png");
+
+         const PathIndex::Parts equivalent[] {
+            {"Data/Textures/A.PNG"}, {"data\\textures\\a.png"},
+            {"/data//textures/a.png/"}, {"data/textures", "a.png"},
+            {"data/textures/", "/a.png"}, {"data", "textures", "a.png"},
+            {"", "data/textures/a.png", ""}
+         };
+         for (auto parts : equivalent) {
+            REQUIRE(index.Find(parts).mIndex == handle.mIndex);
+            REQUIRE(index.Intern(parts).mIndex == handle.mIndex);
+            REQUIRE(index.Intern(parts).mHash == handle.mHash);
+         }
+         REQUIRE(index.GetCount() == 1);
+
+         // Paths that only look alike are different                    
+         const PathIndex::Parts different[] {
+            {"data/textures/a.pn"}, {"data/texturesa.png"},
+            {"data/textures/a.png/b"}, {"data", "textures/a", ".png"}
+         };
+         for (auto parts : different) {
+            REQUIRE_FALSE(index.Find(parts));
+            REQUIRE(index.Intern(parts).mIndex != handle.mIndex);
+         }
+         REQUIRE(index.GetCount() == 5);
+
+         // Empty paths are never interned                              
+         REQUIRE_FALSE(index.Intern({""}));
+         REQUIRE_FALSE(index.Intern({"/", "\\", ""}));
+      }
+
+      WHEN("Many paths are interned, outgrowing tables and chunks") {
+         const auto first = index.Intern({"first/path"});
+         const auto entry = &index.Get(first);
+
+         std::vector<PathIndex::Handle> handles;
+         for (int i = 0; i < 10000; ++i) {
+            const auto path = "many/" + std::to_string(i) + ".bin";
+            handles.push_back(index.Intern({path}));
+         }
+         REQUIRE(index.GetCount() == 10001);
+
+         // Entries never move, and handles remain valid                
+         REQUIRE(&index.Get(first) == entry);
+         REQUIRE(entry->mPath == "first/path");
+         REQUIRE(index.Find({"FIRST", "PATH"}).mIndex == first.mIndex);
+         for (int i = 0; i < 10000; ++i) {
+            const auto path = "many/" + std::to_string(i) + ".bin";
+            REQUIRE(index.Find({"MANY", std::to_string(i) + ".BIN"}).mIndex
+               == handles[i].mIndex);
+            REQUIRE(index.Get(handles[i]).mPath == path);
+         }
+      }
+
+      WHEN("The same paths are interned from many threads") {
+         constexpr int Threads = 8;
+         constexpr int Paths = 2000;
+         std::vector<std::vector<uint32_t>> found(Threads);
+         std::vector<std::thread> threads;
+         for (int t = 0; t < Threads; ++t) {
+            threads.emplace_back([&, t] {
+               // Each thread goes through the paths in its own order,  
+               // and in its own case                                   
+               for (int i = 0; i < Paths; ++i) {
+                  const auto n = (i * 7 + t * 13) % Paths;
+                  auto path = "shared/" + std::to_string(n);
+                  if (t % 2)
+                     path = "SHARED\\" + std::to_string(n) + '/';
+                  found[t].push_back(index.Intern({path}).mIndex);
+               }
+            });
+         }
+         for (auto& thread : threads)
+            thread.join();
+
+         REQUIRE(index.GetCount() == Paths);
+         for (int t = 0; t < Threads; ++t) {
+            for (int i = 0; i < Paths; ++i) {
+               const auto n = (i * 7 + t * 13) % Paths;
+               const auto path = "shared/" + std::to_string(n);
+               REQUIRE(found[t][i] == index.Find({path}).mIndex);
+            }
+         }
+      }
+   }
+
+   GIVEN("The file system module") {
+      auto root = Thing::Root<false>("FileSystem");
+      const auto runtime = root.GetRuntime();
+      const auto module = GetModule(runtime);
+
+      WHEN("Equivalent paths are interfaced") {
+         const auto handle = module->Intern("Interned/Dir", "File.TXT");
+         REQUIRE(handle.mIndex == module->Intern("interned/dir/file.txt")
+            .mIndex);
+
+         // Equivalent paths produce the very same interface            
+         auto file = runtime->GetFile("interned/dir/file.txt");
+         REQUIRE(runtime->GetFile("INTERNED\\Dir//file.txt").Get()
+            == file.Get());
+         REQUIRE(runtime->GetFile("/interned/dir/file.txt/").Get()
+            == file.Get());
+         REQUIRE(module->InterfaceFile(handle) == file.Get());
+
+         auto folder = runtime->GetFolder("interned/dir");
+         REQUIRE(runtime->GetFolder("Interned/Dir/").Get() == folder.Get());
+         REQUIRE(folder->RelativeFile("FILE.txt").Get() == file.Get());
+      }
+
+      // Check for memory leaks after each cycle                        
+      REQUIRE(memoryState.Assert());
+   }
+}
+
+SCENARIO("Interfacing from many threads", "[filesystem]") {
+   static Allocator::State memoryState;
+
+   GIVEN("Many paths, some of which exist") {
+      auto root = Thing::Root<false>("FileSystem");
+      const auto runtime = root.GetRuntime();
+      const auto module = GetModule(runtime);
+      const auto dir = Sandbox(runtime, "stress");
+
+      constexpr int PathCount = 300;
+      constexpr int Threads = 8;
+      std::vector<Path> files, folders;
+      std::vector<std::string> upper;
+      for (int i = 0; i < PathCount; ++i) {
+         const auto name = std::to_string(i);
+         if (i % 2) {
+            WriteNative(dir / ("file-" + name + ".txt"), name);
+            fs::create_directories(dir / ("dir-" + name));
+         }
+
+         // Paths are made in advance, so that workers don't allocate   
+         // anything but the interfaces                                 
+         files.emplace_back(Path {Token {"stress/file-" + name + ".txt"}});
+         folders.emplace_back(Path {Token {"stress/dir-" + name}});
+         upper.emplace_back("STRESS\\FILE-" + name + ".TXT");
+      }
+
+      WHEN("All threads interface all paths at once") {
+         std::vector<std::vector<const A::File*>> foundFiles(Threads);
+         std::vector<std::vector<const A::Folder*>> foundFolders(Threads);
+         std::atomic_bool go = false;
+         std::vector<std::thread> threads;
+         for (int t = 0; t < Threads; ++t) {
+            foundFiles[t].resize(PathCount);
+            foundFolders[t].resize(PathCount);
+            threads.emplace_back([&, t] {
+               while (not go)
+                  std::this_thread::yield();
+
+               // Each thread goes through the paths in its own order,  
+               // half of them through the interned path handles        
+               for (int i = 0; i < PathCount; ++i) {
+                  const auto n = (i * 7 + t * 37) % PathCount;
+                  foundFiles[t][n] = t % 2
+                     ? module->InterfaceFile(files[n])
+                     : module->InterfaceFile(module->Intern(Token {upper[n]}));
+                  foundFolders[t][n] = module->InterfaceFolder(folders[n]);
+               }
+            });
+         }
+
+         go = true;
+         for (auto& thread : threads)
+            thread.join();
+
+         // Every path got exactly one interface                        
+         std::vector<const A::File*> unique;
+         for (int i = 0; i < PathCount; ++i) {
+            const auto file = foundFiles[0][i];
+            const auto folder = foundFolders[0][i];
+            REQUIRE(file);
+            REQUIRE(folder);
+            for (int t = 1; t < Threads; ++t) {
+               REQUIRE(foundFiles[t][i] == file);
+               REQUIRE(foundFolders[t][i] == folder);
+            }
+
+            REQUIRE(runtime->GetFile(files[i]).Get() == file);
+            REQUIRE(runtime->GetFolder(folders[i]).Get() == folder);
+            REQUIRE(file->Exists() == (i % 2 == 1));
+            REQUIRE(folder->Exists() == (i % 2 == 1));
+            unique.push_back(file);
+         }
+
+         std::ranges::sort(unique);
+         REQUIRE(std::ranges::adjacent_find(unique) == unique.end());
+      }
+
+      WHEN("All threads get and read interfaces at once") {
+         std::vector<const A::File*> expected(PathCount);
+         for (int i = 0; i < PathCount; ++i)
+            expected[i] = module->InterfaceFile(files[i]);
+
+         std::atomic_int mismatches = 0;
+         std::atomic_int readers = 0;
+         std::atomic_bool go = false;
+         std::vector<std::thread> threads;
+         for (int t = 0; t < Threads; ++t) {
+            threads.emplace_back([&, t] {
+               while (not go)
+                  std::this_thread::yield();
+
+               // Hits through the public interface, and readers made   
+               // and released on all threads, referencing same files   
+               for (int i = 0; i < PathCount; ++i) {
+                  const auto n = (i * 7 + t * 37) % PathCount;
+                  const auto file = module->GetFile(files[n]);
+                  if (file.Get() != expected[n]
+                  or not module->GetFolder(folders[n]))
+                     ++mismatches;
+                  else if (n % 2 and AsFile(file)->NewReader())
+                     ++readers;
+               }
+            });
+         }
+
+         go = true;
+         for (auto& thread : threads)
+            thread.join();
+
+         REQUIRE(mismatches == 0);
+         REQUIRE(readers == Threads * PathCount / 2);
+      }
+
+      // Check for memory leaks after each cycle                        
+      REQUIRE(memoryState.Assert());
+   }
+}
+
+/// Walk a virtual directory, and gather everything that matches              
+///   @param path - the virtual directory                                     
+///   @param patterns - the glob patterns                                     
+///   @param workers - number of threads for native walks                     
+///   @return sorted relative paths, folders with a trailing slash            
+static std::vector<std::string> Glob(
+   std::string_view path, const std::vector<std::string>& patterns,
+   Count workers = 0
+) {
+   std::vector<std::string> result;
+   const Enumerator enumerator {patterns, workers};
+   const auto count = enumerator.Walk(path,
+      [&](std::string_view relative, bool folder) {
+         result.emplace_back(relative);
+         if (folder)
+            result.back() += '/';
+      });
+   REQUIRE(count == result.size());
+   std::ranges::sort(result);
+   return result;
+}
+
+SCENARIO("Enumerating with glob patterns", "[filesystem]") {
+   static Allocator::State memoryState;
+
+   GIVEN("A directory tree") {
+      auto root = Thing::Root<false>("FileSystem");
+      const auto runtime = root.GetRuntime();
+      const auto module = GetModule(runtime);
+      const auto dir = Sandbox(runtime, "glob");
+      for (auto name : {"a.png", "b.txt", "textures/x.png", "textures/y.jpg",
+                        "textures/sub/z.png", "models/m.obj",
+                        "models/deep/er/w.png"})
+         WriteNative(dir / name, name);
+      fs::create_directories(dir / "empty");
+
+      using Paths = std::vector<std::string>;
+      const std::pair<Paths, Paths> cases[] {
+         // Immediate children, without patterns                        
+         {{}, {"a.png", "b.txt", "empty/", "models/", "textures/"}},
+         {{"*.png"}, {"a.png"}},
+         {{"?.txt"}, {"b.txt"}},
+         {{"./*.txt"}, {"b.txt"}},
+         {{"textures/*.png"}, {"textures/x.png"}},
+         {{"textures\\*.png"}, {"textures/x.png"}},
+         {{"**/*.png"}, {"a.png", "models/deep/er/w.png",
+            "textures/sub/z.png", "textures/x.png"}},
+         {{"textures/**/*.png"}, {"textures/sub/z.png", "textures/x.png"}},
+         {{"*/"}, {"empty/", "models/", "textures/"}},
+         {{"**/"}, {"empty/", "models/", "models/deep/", "models/deep/er/",
+            "textures/", "textures/sub/"}},
+         {{"*.txt", "models/**"}, {"b.txt", "models/", "models/deep/",
+            "models/deep/er/", "models/deep/er/w.png", "models/m.obj"}},
+         {{"*.bmp", "nothing/**"}, {}}
+      };
+
+      WHEN("The directory is walked natively, on one and many threads") {
+         for (auto& [patterns, expected] : cases) {
+            REQUIRE(Glob("glob", patterns, 1) == expected);
+            REQUIRE(Glob("glob", patterns, 4) == expected);
+         }
+      }
+
+      WHEN("The directory is walked through the folder interface") {
+         auto folder = runtime->GetFolder("glob");
+         REQUIRE(SelectPaths(folder, "**/*.png") == Paths {"glob/a.png",
+            "glob/models/deep/er/w.png", "glob/textures/sub/z.png",
+            "glob/textures/x.png"});
+         REQUIRE(SelectPaths(folder) == Paths {"glob/a.png", "glob/b.txt",
+            "glob/empty", "glob/models", "glob/textures"});
+      }
+
+      WHEN("The same tree is mounted twice, with differences") {
+         const auto other = Sandbox(runtime, "glob-other");
+         for (auto name : {"a.png", "textures/x.png", "extra/e.png"})
+            WriteNative(other / name, name);
+         REQUIRE(MountNative(module, dir, "merged"));
+         REQUIRE(MountNative(module, other, "merged"));
+
+         // Mounts are merged, and walked through PhysFS, so entries    
+         // found in both are reported only once                        
+         for (auto& [patterns, expected] : cases) {
+            auto merged = Glob("merged", patterns);
+            std::erase_if(merged, [](const std::string& path) {
+               return path.starts_with("extra");
+            });
+            REQUIRE(merged == expected);
+         }
+
+         REQUIRE(Glob("merged", {"**/e.png"}) == Paths {"extra/e.png"});
+         REQUIRE(Glob("merged", {"*/"}) == Paths {
+            "empty/", "extra/", "models/", "textures/"});
+      }
+
+      // Check for memory leaks after each cycle                        
+      REQUIRE(memoryState.Assert());
+   }
+}
+
+SCENARIO("Creating and deleting in batches", "[filesystem]") {
+   static Allocator::State memoryState;
+
+   GIVEN("A folder in the write directory") {
+      auto root = Thing::Root<false>("FileSystem");
+      const auto runtime = root.GetRuntime();
+      const auto module = GetModule(runtime);
+      const auto dir = Sandbox(runtime, "batch");
+      auto folder = runtime->GetFolder("batch");
+      WriteNative(dir / "kept.txt", "kept");
+      using Paths = std::vector<std::string>;
+
+      WHEN("Files and nested folders are created") {
+         const auto created = Batch(folder, {
+            "kept.txt", "a.txt", "nested/deep/chain/file.txt",
+            "nested/deep/chain/", "nested/deep/other/", "dir/", "dir//",
+            "win\\style.txt", "/leading.txt"
+         });
+
+         REQUIRE(created == Paths {
+            "batch/a.txt", "batch/dir", "batch/kept.txt",
+            "batch/leading.txt", "batch/nested/deep/chain",
+            "batch/nested/deep/chain/file.txt", "batch/nested/deep/other",
+            "batch/win/style.txt"
+         });
+
+         for (auto file : {"a.txt", "nested/deep/chain/file.txt",
+                           "win/style.txt", "leading.txt"}) {
+            REQUIRE(fs::is_regular_file(dir / file));
+            REQUIRE(fs::file_size(dir / file) == 0);
+         }
+         for (auto name : {"dir", "nested/deep/chain", "nested/deep/other"})
+            REQUIRE(fs::is_directory(dir / name));
+
+         // Existing files are left intact                              
+         REQUIRE(ReadNative(dir / "kept.txt") == "kept");
+
+         // Created entries are visible right away                      
+         REQUIRE(runtime->GetFile("batch/nested/deep/chain/file.txt")
+            ->Exists());
+      }
+
+      WHEN("Some entries of a batch fail") {
+         WriteNative(dir / "blocker", "file");
+         const auto created = Batch(folder, {
+            "fine.txt", "blocker/child.txt", "blocker/sub/"});
+         REQUIRE(created == Paths {"batch/fine.txt"});
+         REQUIRE(fs::is_regular_file(dir / "fine.txt"));
+         REQUIRE(ReadNative(dir / "blocker") == "file");
+
+         // Only a batch that fails entirely throws                     
+         REQUIRE_THROWS(Batch(folder, {"blocker/child.txt"}));
+      }
+
+      WHEN("Files and nested folders are deleted") {
+         Batch(folder, {"a.txt", "nested/deep/chain/file.txt",
+            "nested/deep/other/", "nested/top.txt", "other/b.txt"});
+
+         const auto deleted = Batch(folder, {
+            "nested/", "a.txt", "missing.txt", "missing/"}, true);
+         REQUIRE(deleted == Paths {"batch/a.txt", "batch/missing",
+            "batch/missing.txt", "batch/nested"});
+
+         REQUIRE_FALSE(fs::exists(dir / "nested"));
+         REQUIRE_FALSE(fs::exists(dir / "a.txt"));
+         REQUIRE(fs::exists(dir / "other" / "b.txt"));
+         REQUIRE(ReadNative(dir / "kept.txt") == "kept");
+         REQUIRE_FALSE(runtime->GetFile("batch/nested/top.txt")->Exists());
+      }
+
+      WHEN("Entries outside the write directory are deleted") {
+         const auto outside = Sandbox(runtime, "batch-outside");
+         WriteNative(outside / "mounted.txt", "mounted");
+         WriteNative(outside / "sub" / "inner.txt", "inner");
+         REQUIRE(MountNative(module, outside, "batch/mounted"));
+         auto mounted = runtime->GetFolder("batch/mounted");
+
+         // Nothing mounted from elsewhere is ever deleted              
+         REQUIRE_THROWS(Batch(mounted, {"mounted.txt", "sub/"}, true));
+         REQUIRE(Batch(mounted, {"mounted.txt", "gone.txt"}, true)
+            == Paths {"batch/mounted/gone.txt"});
+         REQUIRE(ReadNative(outside / "mounted.txt") == "mounted");
+         REQUIRE(ReadNative(outside / "sub" / "inner.txt") == "inner");
+
+         // Deleting the mount point leaves it alone too                
+         REQUIRE(Batch(folder, {"mounted/", "kept.txt"}, true)
+            == Paths {"batch/kept.txt"});
+         REQUIRE_FALSE(fs::exists(dir / "kept.txt"));
+         REQUIRE(ReadNative(outside / "mounted.txt") == "mounted");
+      }
+
+      // Check for memory leaks after each cycle                        
+      REQUIRE(memoryState.Assert());
+   }
+}
+
+SCENARIO("Mounting with priorities", "[filesystem]") {
+   static Allocator::State memoryState;
+
+   GIVEN("Directories that contain the same file") {
+      auto root = Thing::Root<false>("FileSystem");
+      const auto runtime = root.GetRuntime();
+      const auto module = GetModule(runtime);
+      const auto dir = Sandbox(runtime, "mounts");
+      for (auto name : {"low", "high", "late"})
+         WriteNative(dir / name / "same.txt", name);
+      WriteNative(dir / "low" / "only-low.txt", "only");
+
+      // Interfaced before anything is mounted                          
+      auto same = runtime->GetFile("merged/same.txt");
+      auto onlyLow = runtime->GetFile("merged/only-low.txt");
+      REQUIRE_FALSE(same->Exists());
+
+      const auto contents = [](const Ref<A::File>& file) {
+         return AsString(file->ReadAs(nullptr));
+      };
+
+      WHEN("Sources are mounted and unmounted") {
+         // Interfaces refresh themselves the next time they're used    
+         REQUIRE(MountNative(module, dir / "low", "merged", 0));
+         REQUIRE(runtime->GetFile("merged/same.txt").Get() == same.Get());
+         REQUIRE(same->Exists());
+         REQUIRE(contents(same) == "low");
+
+         REQUIRE(MountNative(module, dir / "high", "merged", 5));
+         REQUIRE(contents(same) == "high");
+         REQUIRE(contents(onlyLow) == "only");
+
+         // Among equal priorities, the latest mount wins               
+         REQUIRE(MountNative(module, dir / "late", "merged", 5));
+         REQUIRE(contents(same) == "late");
+
+         REQUIRE(UnmountNative(module, dir / "late"));
+         REQUIRE(contents(same) == "high");
+         REQUIRE(UnmountNative(module, dir / "high"));
+         REQUIRE(contents(same) == "low");
+         REQUIRE(UnmountNative(module, dir / "low"));
+         REQUIRE_FALSE(runtime->GetFile("merged/same.txt")->Exists());
+         REQUIRE_FALSE(runtime->GetFile("merged/only-low.txt")->Exists());
+      }
+
+      WHEN("Lower priorities are mounted later") {
+         REQUIRE(MountNative(module, dir / "high", "merged", 5));
+         REQUIRE(MountNative(module, dir / "low", "merged", 0));
+         REQUIRE(contents(same) == "high");
+         REQUIRE(contents(onlyLow) == "only");
+
+         // Mounting in the middle of the search order                  
+         REQUIRE(MountNative(module, dir / "late", "merged", 3));
+         REQUIRE(contents(same) == "high");
+         REQUIRE(UnmountNative(module, dir / "high"));
+         REQUIRE(contents(same) == "late");
+      }
+
+      WHEN("Directories are mounted above and below an archive") {
+         WriteNative(dir / "inner.zip", MakeZip({{"deep/same.txt", "zip"}}));
+         WriteNative(dir / "outer" / "inner" / "deep" / "same.txt", "outer");
+         WriteNative(dir / "low" / "deep" / "same.txt", "low");
+
+         // Directories mounted at a parent of the archive's mount      
+         // point, and at the same place, are ordered with the archive  
+         REQUIRE(MountNative(module, dir / "low", "merged/inner", 0));
+         REQUIRE(MountNative(module, dir / "inner.zip", "merged/inner", 1));
+         REQUIRE(MountNative(module, dir / "outer", "merged", 2));
+         const auto deep = runtime->GetFile("merged/inner/deep/same.txt");
+         REQUIRE(contents(deep) == "outer");
+
+         REQUIRE(UnmountNative(module, dir / "outer"));
+         REQUIRE(contents(deep) == "zip");
+         REQUIRE(UnmountNative(module, dir / "inner.zip"));
+         REQUIRE(contents(deep) == "low");
+
+         PHYSFS_Stat info {};
+         REQUIRE_FALSE(module->GetStatCache().Stat(
+            "merged/inner/deep/missing.txt", info));
+      }
+
+      WHEN("Archived paths are looked up in another case") {
+         WriteNative(dir / "cased.zip", MakeZip({
+            {"Docs/ReadMe.TXT", "mixed"}, {"lower.txt", "lower"}}));
+         REQUIRE(MountNative(module, dir / "cased.zip", "cased"));
+
+         // Stat and open must agree, no matter in which order paths    
+         // are cached                                                  
+         const char* paths[] {
+            "cased/Docs/ReadMe.TXT", "cased/docs/readme.txt",
+            "cased/DOCS/README.TXT", "cased/Docs/ReadMe.TXT",
+            "cased/lower.txt", "cased/LOWER.TXT", "cased/lower.txt"
+         };
+
+         for (auto path : paths) {
+            PHYSFS_Stat info {};
+            const bool found = module->GetStatCache().Stat(path, info);
+            const auto handle = PHYSFS_openRead(path);
+            REQUIRE(found == (handle != nullptr));
+            if (handle)
+               PHYSFS_close(handle);
+         }
+
+         PHYSFS_Stat info {};
+         REQUIRE(module->GetStatCache().Stat("cased/Docs/ReadMe.TXT", info));
+         REQUIRE(info.filesize == 5);
+      }
+
+      // Check for memory leaks after each cycle                        
+      REQUIRE(memoryState.Assert());
+   }
+}
+
+/// Overwrite a field of an entry inside a pack made by MakePack              
+///   @param pack - [in/out] the pack                                         
+///   @param index - the entry index, in name order                           
+///   @param field - the member to overwrite                                  
+///   @param value - the new value                                            
+template<class T>
+static void Corrupt(
+   std::string& pack, size_t index, T PackFormat::PackEntry::*field,
+   T value
+) {
+   PackFormat::PackEntry entry;
+   const auto at = sizeof(PackFormat::PackHeader)
+      + index * sizeof(PackFormat::PackEntry);
+   std::memcpy(&entry, pack.data() + at, sizeof(entry));
+   entry.*field = value;
+   std::memcpy(pack.data() + at, &entry, sizeof(entry));
+}
+
+SCENARIO("Langulus packs", "[filesystem]") {
+   static Allocator::State memoryState;
+
+   GIVEN("A pack with plain and chunked entries") {
+      auto root = Thing::Root<false>("FileSystem");
+      const auto runtime = root.GetRuntime();
+      const auto module = GetModule(runtime);
+      const auto dir = Sandbox(runtime, "packs");
+
+      constexpr uint32_t ChunkSize = 4096;
+      const auto chunked = MakePattern(3 * ChunkSize + 123);
+      const std::vector<PackFile> files {
+         {"chunked.bin", chunked, false, ChunkSize},
+         {"docs", {}, true},
+         {"docs/readme.txt", "Read me, I'm packed"},
+         {"docs/sub", {}, true},
+         {"docs/sub/deep.bin", MakePattern(10000)},
+         {"empty.bin", {}}
+      };
+      const auto pack = MakePack(files);
+
+      WHEN("The pack is mounted and read back") {
+         WriteNative(dir / "good.lpk", pack);
+         REQUIRE(MountNative(module, dir / "good.lpk", "packed"));
+
+         for (auto& file : files) {
+            const Path path {Token {"packed/" + file.mName}};
+            if (file.mDirectory) {
+               REQUIRE(runtime->GetFolder(path)->Exists());
+               continue;
+            }
+
+            auto interfaced = runtime->GetFile(path);
+            REQUIRE(interfaced->Exists());
+            REQUIRE(interfaced->GetBytesize() == file.mContents.size());
+            if (not file.mContents.empty()) {
+               REQUIRE(AsString(interfaced->ReadAs(nullptr))
+                  == file.mContents);
+            }
+         }
+      }
+
+      WHEN("Chunked entries are read at arbitrary offsets") {
+         WriteNative(dir / "good.lpk", pack);
+         REQUIRE(MountNative(module, dir / "good.lpk", "packed"));
+         auto file = runtime->GetFile("packed/chunked.bin");
+
+         // Within a chunk, across chunk boundaries, backwards, at the  
+         // very end, and past it                                       
+         const std::pair<Offset, Offset> ranges[] {
+            {0, 10}, {ChunkSize - 5, 10}, {2 * ChunkSize + 100, 2000},
+            {100, 3 * ChunkSize}, {chunked.size() - 3, 3},
+            {chunked.size() - 3, 100}, {5, 1}
+         };
+
+         for (auto [offset, size] : ranges) {
+            Many output;
+            const auto read = AsFile(file)->ReadRange(offset, size, output);
+            const auto expected = chunked.substr(offset, size);
+            REQUIRE(read == expected.size());
+            REQUIRE(AsString(output).substr(0, read) == expected);
+         }
+      }
+
+      WHEN("Folders inside the pack are enumerated") {
+         WriteNative(dir / "good.lpk", pack);
+         REQUIRE(MountNative(module, dir / "good.lpk", "packed"));
+         auto docs = runtime->GetFolder("packed/docs");
+
+         REQUIRE(SelectPaths(docs) == std::vector<std::string> {
+            "packed/docs/readme.txt", "packed/docs/sub"});
+         REQUIRE(SelectPaths(docs, "**") == std::vector<std::string> {
+            "packed/docs/readme.txt", "packed/docs/sub",
+            "packed/docs/sub/deep.bin"});
+         REQUIRE(SelectPaths(docs, "**/*.bin") == std::vector<std::string> {
+            "packed/docs/sub/deep.bin"});
+      }
+
+      WHEN("The header is corrupted") {
+         auto badMagic = pack;
+         badMagic[0] = 'X';
+         WriteNative(dir / "magic.lpk", badMagic);
+         REQUIRE_FALSE(MountNative(module, dir / "magic.lpk", "packed"));
+
+         auto badVersion = pack;
+         badVersion[4] = 99;
+         WriteNative(dir / "version.lpk", badVersion);
+         REQUIRE_FALSE(MountNative(module, dir / "version.lpk", "packed"));
+
+         auto truncated = pack.substr(0, sizeof(PackFormat::PackHeader) + 10);
+         WriteNative(dir / "truncated.lpk", truncated);
+         REQUIRE_FALSE(MountNative(module, dir / "truncated.lpk", "packed"));
+
+         REQUIRE_FALSE(runtime->GetFile("packed/docs/readme.txt")->Exists());
+      }
+
+      WHEN("The table of contents is corrupted") {
+         using PackFormat::PackEntry;
+
+         // Data past the end of the pack                               
+         auto outside = pack;
+         Corrupt<uint64_t>(outside, 2, &PackEntry::mStoredSize, pack.size());
+         WriteNative(dir / "outside.lpk", outside);
+         REQUIRE_FALSE(MountNative(module, dir / "outside.lpk", "packed"));
+
+         // Names out of order break the binary search                  
+         auto unsorted = pack;
+         Corrupt<uint32_t>(unsorted, 0, &PackEntry::mNameOffset,
+            static_cast<uint32_t>(std::string_view {"chunked.bin"}.size()));
+         WriteNative(dir / "unsorted.lpk", unsorted);
+         REQUIRE_FALSE(MountNative(module, dir / "unsorted.lpk", "packed"));
+
+         // Chunk table that doesn't fit in the stored data             
+         auto chunks = pack;
+         Corrupt<uint64_t>(chunks, 0, &PackEntry::mStoredSize, 8);
+         WriteNative(dir / "chunks.lpk", chunks);
+         REQUIRE_FALSE(MountNative(module, dir / "chunks.lpk", "packed"));
+
+         // Misaligned data                                             
+         auto misaligned = pack;
+         Corrupt<uint64_t>(misaligned, 2, &PackEntry::mOffset,
+            PackFormat::DefaultAlignment + 1);
+         WriteNative(dir / "misaligned.lpk", misaligned);
+         REQUIRE_FALSE(MountNative(module, dir / "misaligned.lpk", "packed"));
+
+         REQUIRE_FALSE(runtime->GetFile("packed/docs/readme.txt")->Exists());
+      }
+
+      // Check for memory leaks after each cycle                        
+      REQUIRE(memoryState.Assert());
+   }
+}
+
+SCENARIO("Decompressed block cache", "[filesystem]") {
+   static Allocator::State memoryState;
+
+   GIVEN("An archive with files spanning multiple blocks") {
+      auto root = Thing::Root<false>("FileSystem");
+      const auto runtime = root.GetRuntime();
+      const auto module = GetModule(runtime);
+      const auto dir = Sandbox(runtime, "blocks");
+      constexpr auto Block = BlockCache::BlockSize;
+      const auto first = MakePattern(3 * Block + 1000);
+      const auto second = MakePattern(Block + 10);
+      WriteNative(dir / "blocks.zip", MakeZip({
+         {"first.bin", first}, {"second.bin", second}}));
+      REQUIRE(MountNative(module, dir / "blocks.zip", "zipped"));
+
+      auto& cache = module->GetBlockCache();
+      auto file = runtime->GetFile("zipped/first.bin");
+      auto other = runtime->GetFile("zipped/second.bin");
+      REQUIRE(file->Exists());
+
+      // Counters are never reset, so only their changes are checked    
+      Count hits = cache.GetHits();
+      Count misses = cache.GetMisses();
+      const auto expect = [&](Count newHits, Count newMisses) {
+         REQUIRE(cache.GetHits() - hits == newHits);
+         REQUIRE(cache.GetMisses() - misses == newMisses);
+         hits = cache.GetHits();
+         misses = cache.GetMisses();
+      };
+
+      const auto read = [](const Ref<A::File>& from, Offset at, Offset size) {
+         Many output;
+         const auto done = AsFile(from)->ReadRange(at, size, output);
+         return AsString(output).substr(0, done);
+      };
+
+      WHEN("Blocks are read more than once") {
+         REQUIRE(read(file, 0, 10) == first.substr(0, 10));
+         expect(0, 1);
+         REQUIRE(read(file, 100, 10) == first.substr(100, 10));
+         expect(1, 0);
+
+         // Across the boundary of the first and second block           
+         REQUIRE(read(file, Block - 5, 10) == first.substr(Block - 5, 10));
+         expect(1, 1);
+         REQUIRE(cache.GetUsage() == 2 * Block);
+
+         // The whole file, through the cache - the last block is short 
+         REQUIRE(AsString(file->ReadAs(nullptr)) == first);
+         expect(2, 2);
+         REQUIRE(cache.GetUsage() == first.size());
+      }
+
+      WHEN("The budget is exceeded") {
+         cache.SetBudget(2 * Block);
+         for (Offset index = 0; index < 4; ++index) {
+            const auto at = index * Block;
+            REQUIRE(read(file, at, 10) == first.substr(at, 10));
+            REQUIRE(cache.GetUsage() <= 2 * Block);
+         }
+         expect(0, 4);
+
+         // Only the two most recently used blocks remain               
+         REQUIRE(read(file, 2 * Block, 10) == first.substr(2 * Block, 10));
+         expect(1, 0);
+         REQUIRE(read(file, 0, 10) == first.substr(0, 10));
+         expect(0, 1);
+
+         // The last block was evicted by the first one, the third one  
+         // was used more recently                                      
+         REQUIRE(read(file, 3 * Block, 10) == first.substr(3 * Block, 10));
+         expect(0, 1);
+         REQUIRE(read(file, 0, 10) == first.substr(0, 10));
+         expect(1, 0);
+
+         // Nothing is cached without a budget, but reads still work    
+         cache.SetBudget(0);
+         REQUIRE(cache.GetUsage() == 0);
+         REQUIRE(read(file, 0, 10) == first.substr(0, 10));
+         REQUIRE(read(file, 0, 10) == first.substr(0, 10));
+         expect(0, 2);
+         REQUIRE(cache.GetUsage() == 0);
+      }
+
+      WHEN("Files are refreshed") {
+         read(file, 0, 10);
+         read(other, Block, 10);
+         REQUIRE(cache.GetUsage() == Block + 10);
+
+         // Only the blocks of the refreshed file are dropped           
+         AsFile(file)->Refresh();
+         REQUIRE(cache.GetUsage() == 10);
+         hits = cache.GetHits();
+         misses = cache.GetMisses();
+         REQUIRE(read(file, 0, 10) == first.substr(0, 10));
+         REQUIRE(read(other, Block, 10) == second.substr(Block, 10));
+         expect(1, 1);
+
+         // Mounting anything drops all blocks                          
+         WriteNative(dir / "unrelated" / "file.txt", "unrelated");
+         REQUIRE(MountNative(module, dir / "unrelated", "unrelated"));
+         REQUIRE(cache.GetUsage() == 0);
+         REQUIRE(read(other, Block, 10) == second.substr(Block, 10));
+         expect(0, 1);
+      }
+
+      // Check for memory leaks after each cycle                        
+      REQUIRE(memoryState.Assert());
+   }
+}
+
+SCENARIO("Access traces and replays", "[filesystem]") {
+   static Allocator::State memoryState;
+
+   GIVEN("An access trace") {
+      AccessTrace trace;
+      using Accesses = std::vector<AccessTrace::Access>;
+      const auto same = [](const Accesses& lhs, const Accesses& rhs) {
+         return std::ranges::equal(lhs, rhs, [](auto& a, auto& b) {
+            return a.mPath == b.mPath and a.mOffset == b.mOffset
+               and a.mSize == b.mSize;
+         });
+      };
+
+      WHEN("Accesses are recorded") {
+         trace.Record("ignored", 0, 10);
+         trace.Start();
+         trace.Record("a", 0, 0);
+         trace.Record("a", 0, 100);
+         trace.Record("a", 100, 50);
+         trace.Record("b", 0, 10);
+         // Continues the last read of 'a', despite 'b' in between      
+         trace.Record("a", 150, 10);
+         // Starts over, and can't be merged                            
+         trace.Record("a", 0, 10);
+         // Opening again adds nothing                                  
+         trace.Record("a", 0, 0);
+         // Reading after opening takes the place of the opening        
+         trace.Record("c", 0, 0);
+         trace.Record("c", 50, 10);
+         trace.Record("d", 0, 0);
+         trace.Stop();
+         trace.Record("ignored", 0, 10);
+
+         const Accesses expected {
+            {"a", 0, 160}, {"b", 0, 10}, {"a", 0, 10}, {"c", 50, 10},
+            {"d", 0, 0}
+         };
+         REQUIRE(same(trace.GetAccesses(), expected));
+
+         // Starting again forgets everything                           
+         trace.Start();
+         trace.Record("a", 160, 10);
+         REQUIRE(same(trace.GetAccesses(), {{"a", 160, 10}}));
+      }
+
+      WHEN("Manifests are serialized and parsed") {
+         const Accesses accesses {
+            {"plain.txt", 0, 0}, {"dir/with spaces.bin", 123, 4567},
+            {"huge.bin", 1ull << 40, 1ull << 33}
+         };
+         const auto manifest = AccessTrace::Serialize(accesses);
+         Accesses parsed;
+         REQUIRE(AccessTrace::Parse(manifest, parsed));
+         REQUIRE(same(parsed, accesses));
+
+         // Parsed accesses are appended, and Windows line endings,     
+         // comments and blank lines are tolerated                      
+         std::string edited;
+         for (auto c : manifest) {
+            if (c == '\n')
+               edited += "\r\n\r\n# comment\r\n";
+            else
+               edited += c;
+         }
+         REQUIRE(AccessTrace::Parse(edited, parsed));
+         REQUIRE(parsed.size() == 2 * accesses.size());
+         const Accesses appended {
+            parsed.begin() + accesses.size(), parsed.end()};
+         REQUIRE(same(appended, accesses));
+      }
+
+      WHEN("Malformed manifests are parsed") {
+         const auto header = AccessTrace::Serialize({});
+         const std::string malformed[] {
+            "", "0 10 a\n", "# another header\n0 10 a\n",
+            header + "0 10\n", header + "0 10 \n", header + "0\n",
+            header + "x 10 a\n", header + "0 y a\n", header + "-1 10 a\n",
+            header + "0  10 a\n", header + "0 10 a\n10 0\n",
+            header + "99999999999999999999999 0 a\n"
+         };
+
+         for (auto& manifest : malformed) {
+            Accesses parsed;
+            REQUIRE_FALSE(AccessTrace::Parse(manifest, parsed));
+         }
+
+         Accesses parsed;
+         REQUIRE(AccessTrace::Parse(header, parsed));
+         REQUIRE(parsed.empty());
+      }
+   }
+
+   GIVEN("Files inside an archive") {
+      auto root = Thing::Root<false>("FileSystem");
+      const auto runtime = root.GetRuntime();
+      const auto module = GetModule(runtime);
+      const auto dir = Sandbox(runtime, "trace");
+      constexpr auto Block = BlockCache::BlockSize;
+      const auto contents = MakePattern(3 * Block);
+      WriteNative(dir / "traced.zip", MakeZip({
+         {"a.bin", contents}, {"b.bin", contents.substr(0, 100)},
+         {"c.bin", "opened"}}));
+      REQUIRE(MountNative(module, dir / "traced.zip", "traced"));
+
+      auto a = runtime->GetFile("traced/a.bin");
+      auto b = runtime->GetFile("traced/b.bin");
+      auto& cache = module->GetBlockCache();
+
+      // Read the same ranges that were traced                          
+      const auto readTraced = [&] {
+         const auto read = [](auto& file, Offset at, Offset size) {
+            Many output;
+            return AsFile(file)->ReadRange(at, size, output);
+         };
+         REQUIRE(read(a, 0, 100) == 100);
+         REQUIRE(read(a, 100, Block) == Block);
+         REQUIRE(read(b, 10, 10) == 10);
+      };
+
+      WHEN("A trace is recorded, and replayed") {
+         module->StartTrace();
+         readTraced();
+         REQUIRE(runtime->GetFile("traced/c.bin")->Exists());
+         REQUIRE(module->SaveTrace(Path {"trace/manifest.txt"}));
+
+         std::vector<AccessTrace::Access> saved;
+         REQUIRE(AccessTrace::Parse(
+            ReadNative(dir / "manifest.txt"), saved));
+         REQUIRE(saved.size() == 3);
+         REQUIRE(saved[0].mPath == "traced/a.bin");
+         REQUIRE(saved[0].mOffset == 0);
+         REQUIRE(saved[0].mSize == Block + 100);
+         REQUIRE(saved[1].mPath == "traced/b.bin");
+         REQUIRE(saved[1].mOffset == 10);
+         REQUIRE(saved[1].mSize == 10);
+         REQUIRE(saved[2].mPath == "traced/c.bin");
+         REQUIRE(saved[2].mSize == 0);
+
+         // Replaying decompresses the first two blocks of 'a', and the 
+         // only block of 'b', in the background                        
+         cache.Clear();
+         REQUIRE(module->Replay(Path {"trace/manifest.txt"}, 2));
+         const auto expected = 2 * Block + 100;
+         const auto deadline = std::chrono::steady_clock::now()
+            + std::chrono::seconds(10);
+         while (cache.GetUsage() < expected
+         and std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+         REQUIRE(cache.GetUsage() == expected);
+
+         // The traced reads are now served only from the cache         
+         const auto misses = cache.GetMisses();
+         const auto hits = cache.GetHits();
+         readTraced();
+         REQUIRE(cache.GetMisses() == misses);
+         REQUIRE(cache.GetHits() - hits == 3);
+      }
+
+      WHEN("Malformed or missing manifests are replayed") {
+         WriteNative(dir / "bad.txt", "0 10 traced/a.bin\n");
+         REQUIRE_FALSE(module->Replay(Path {"trace/bad.txt"}));
+         REQUIRE_FALSE(module->Replay(Path {"trace/missing.txt"}));
+      }
+
+      // Check for memory leaks after each cycle                        
+      REQUIRE(memoryState.Assert());
+   }
+}
+
+SCENARIO("Vectored reads and writes", "[filesystem]") {
+   static Allocator::State memoryState;
+
+   GIVEN("A file in a native directory, and the same file in an archive") {
+      auto root = Thing::Root<false>("FileSystem");
+      const auto runtime = root.GetRuntime();
+      const auto module = GetModule(runtime);
+      const auto dir = Sandbox(runtime, "vectored");
+      const auto contents = MakePattern(200000);
+      WriteNative(dir / "source.bin", contents);
+      WriteNative(dir / "source.zip", MakeZip({{"source.bin", contents}}));
+      REQUIRE(MountNative(module, dir / "source.zip", "zipped"));
+      auto file = runtime->GetFile("vectored/target.bin");
+
+      // Sizes of the blocks of a batch - a header, followed by arrays  
+      const auto batch = [](std::initializer_list<size_t> sizes) {
+         std::vector<Many> blocks;
+         for (auto size : sizes)
+            blocks.push_back(Allocate(size));
+         return blocks;
+      };
+
+      WHEN("Batches are written with and without buffering") {
+         ::File::Buffering unbuffered;
+         unbuffered.mSize = 0;
+
+         for (auto buffering : {::File::Buffering {}, unbuffered}) {
+            std::string written;
+            {
+               auto writer = AsFile(file)->NewWriter(false, buffering);
+               const auto concrete = static_cast<::File::Writer*>(
+                  const_cast<A::File::Writer*>(writer.Get()));
+
+               // Small batches are coalesced in the buffer, big ones   
+               // are written with a single vectored write, after what  
+               // is already buffered                                   
+               const std::vector<std::string> pieces[] {
+                  {"header"},
+                  {"a", MakePattern(100), MakePattern(1000)},
+                  {MakePattern(40000), "b", MakePattern(30000)},
+                  {"tail"},
+                  {MakePattern(70000)}
+               };
+
+               for (auto& piece : pieces) {
+                  std::vector<Many> blocks;
+                  std::string joined;
+                  for (auto& part : piece) {
+                     blocks.push_back(AsBytes(part));
+                     joined += part;
+                  }
+
+                  REQUIRE(concrete->WriteV(blocks) == joined.size());
+                  written += joined;
+               }
+
+               // Plain writes continue after the vectored ones         
+               REQUIRE(writer->Write(AsBytes("end")) == 3);
+               written += "end";
+            }
+
+            REQUIRE(ReadNative(dir / "target.bin") == written);
+         }
+      }
+
+      WHEN("Batches are read with and without buffering") {
+         ::File::Buffering unbuffered;
+         unbuffered.mSize = 0;
+
+         for (auto name : {"vectored/source.bin", "zipped/source.bin"}) {
+            for (auto buffering : {::File::Buffering {}, unbuffered}) {
+               auto reader = AsFile(runtime->GetFile(name))
+                  ->NewReader(buffering);
+               const auto concrete = static_cast<::File::Reader*>(
+                  const_cast<A::File::Reader*>(reader.Get()));
+
+               // A plain read first, so that there's a read-ahead to   
+               // bypass, or to continue from                           
+               auto head = Allocate(10);
+               REQUIRE(concrete->Read(head) == 10);
+
+               auto blocks = batch({5, 1000, 70000});
+               REQUIRE(concrete->ReadV(blocks) == 71005);
+               Offset at = 10;
+               for (auto& block : blocks) {
+                  const auto size = block.GetBytesize();
+                  REQUIRE(AsString(block) == contents.substr(at, size));
+                  at += size;
+               }
+               REQUIRE(concrete->GetPosition() == at);
+
+               // Plain reads continue after the vectored ones          
+               auto next = Allocate(10);
+               REQUIRE(concrete->Read(next) == 10);
+               REQUIRE(AsString(next) == contents.substr(at, 10));
+               at += 10;
+
+               // Batches that don't fit stop at the end of the file    
+               auto tail = batch({100, contents.size(), 50});
+               const auto left = contents.size() - at;
+               REQUIRE(concrete->ReadV(tail) == left);
+               REQUIRE(AsString(tail[0]) == contents.substr(at, 100));
+               REQUIRE(AsString(tail[1]).substr(0, left - 100)
+                  == contents.substr(at + 100));
+               REQUIRE(concrete->GetPosition() == contents.size());
+            }
+         }
+      }
+
+      // Check for memory leaks after each cycle                        
+      REQUIRE(memoryState.Assert());
+   }
+}
+
+SCENARIO("Limiting the number of open handles", "[filesystem]") {
+   static Allocator::State memoryState;
+
+   GIVEN("A handle pool that keeps a single handle open") {
+      auto root = Thing::Root<false>("FileSystem");
+      const auto runtime = root.GetRuntime();
+      auto& pool = GetModule(runtime)->GetHandlePool();
+      const auto dir = Sandbox(runtime, "handles");
+
+      const std::string names[] {"a.bin", "b.bin", "c.bin"};
+      std::vector<std::string> contents;
+      std::vector<Ref<A::File>> files;
+      for (auto& name : names) {
+         contents.push_back(name + MakePattern(300));
+         WriteNative(dir / name, contents.back());
+         files.push_back(runtime->GetFile(Path {Token {"handles/" + name}}));
+      }
+
+      pool.SetMaxOpen(1);
+      REQUIRE(pool.GetMaxOpen() == 1);
+
+      // Buffers would hide reopening, so there are none                
+      ::File::Buffering unbuffered;
+      unbuffered.mSize = 0;
+
+      WHEN("Readers take turns") {
+         std::vector<Ref<A::File::Reader>> readers;
+         for (auto& file : files)
+            readers.push_back(AsFile(file)->NewReader(unbuffered));
+
+         // Each read evicts the previous reader's handle, and each     
+         // reader resumes where it was                                 
+         for (Offset at = 0; at < 300; at += 10) {
+            for (size_t i = 0; i < readers.size(); ++i) {
+               std::string chunk(10, '\0');
+               const auto reader = static_cast<::File::Reader*>(
+                  const_cast<A::File::Reader*>(readers[i].Get()));
+               REQUIRE(reader->Read(
+                  reinterpret_cast<Byte*>(chunk.data()), 10) == 10);
+               REQUIRE(chunk == contents[i].substr(at, 10));
+               REQUIRE(reader->GetPosition() == at + 10);
+               REQUIRE(pool.GetOpen() <= 1);
+            }
+         }
+      }
+
+      WHEN("Positional reads and readers take turns") {
+         auto reader = AsFile(files[1])->NewReader(unbuffered);
+         const auto concrete = static_cast<::File::Reader*>(
+            const_cast<A::File::Reader*>(reader.Get()));
+
+         for (Offset at = 0; at < 300; at += 50) {
+            Many range;
+            REQUIRE(AsFile(files[0])->ReadRange(at, 50, range) == 50);
+            REQUIRE(AsString(range) == contents[0].substr(at, 50));
+            REQUIRE(pool.GetOpen() <= 1);
+
+            std::string chunk(50, '\0');
+            REQUIRE(concrete->Read(
+               reinterpret_cast<Byte*>(chunk.data()), 50) == 50);
+            REQUIRE(chunk == contents[1].substr(at, 50));
+            REQUIRE(pool.GetOpen() <= 1);
+         }
+      }
+
+      WHEN("Writers take turns") {
+         {
+            auto first = AsFile(files[0])->NewWriter(false);
+            auto second = AsFile(files[1])->NewWriter(true);
+
+            // Reopening an evicted writer must not truncate what it    
+            // already wrote                                            
+            for (int i = 0; i < 10; ++i) {
+               REQUIRE(first->Write(AsBytes("first" + std::to_string(i)))
+                  == 6);
+               REQUIRE(pool.GetOpen() <= 1);
+               REQUIRE(second->Write(AsBytes("second" + std::to_string(i)))
+                  == 7);
+               REQUIRE(pool.GetOpen() <= 1);
+            }
+
+            // A reader evicts the writer too                           
+            Many range;
+            AsFile(files[2])->ReadRange(0, 10, range);
+            REQUIRE(first->Write(AsBytes("last")) == 4);
+            REQUIRE(pool.GetOpen() <= 1);
+         }
+
+         std::string expectedFirst, expectedSecond = contents[1];
+         for (int i = 0; i < 10; ++i) {
+            expectedFirst += "first" + std::to_string(i);
+            expectedSecond += "second" + std::to_string(i);
+         }
+         expectedFirst += "last";
+
+         REQUIRE(ReadNative(dir / "a.bin") == expectedFirst);
+         REQUIRE(ReadNative(dir / "b.bin") == expectedSecond);
+      }
+
+      // Check for memory leaks after each cycle                        
+      REQUIRE(memoryState.Assert());
+   }
+}
+
+SCENARIO("I/O statistics", "[filesystem]") {
+   static Allocator::State memoryState;
+
+   GIVEN("Standalone statistics") {
+      IOStats stats;
+      IOStats::Counters counters;
+
+      WHEN("Latencies are put in buckets") {
+         REQUIRE(IOStats::BucketOf(0) == 0);
+         REQUIRE(IOStats::BucketOf(1) == 1);
+         REQUIRE(IOStats::BucketOf(100) == 7);
+         REQUIRE(IOStats::BucketOf(128) == 8);
+         REQUIRE(IOStats::BucketOf(~uint64_t {0}) == IOStats::BucketCount - 1);
+      }
+
+      WHEN("Operations are recorded") {
+         for (int i = 0; i < 99; ++i)
+            stats.Record(IOStats::Read, 100, 10, &counters);
+         stats.Record(IOStats::Read, 1000000, 1000, &counters);
+         stats.Record(IOStats::Stat, 50, 0);
+
+         const auto snapshot = stats.GetSnapshot();
+         const auto& read = snapshot.mTotals[IOStats::Read];
+         REQUIRE(read.mCount == 100);
+         REQUIRE(read.mBytes == 99 * 10 + 1000);
+         REQUIRE(read.mTime == 99 * 100 + 1000000);
+         REQUIRE(read.mMaxTime == 1000000);
+         REQUIRE(snapshot.mTotals[IOStats::Stat].mCount == 1);
+         REQUIRE(snapshot.mTotals[IOStats::Write].mCount == 0);
+
+         // Percentiles are upper bounds of their buckets               
+         const auto& latency = snapshot.mLatency[IOStats::Read];
+         REQUIRE(latency.mBuckets[7] == 99);
+         REQUIRE(latency.mBuckets[20] == 1);
+         REQUIRE(latency.Percentile(0.5) == 128);
+         REQUIRE(latency.Percentile(0.99) == 128);
+         REQUIRE(latency.Percentile(1.0) == 1 << 20);
+         REQUIRE(snapshot.mLatency[IOStats::Write].Percentile(0.5) == 0);
+
+         // Only the operations made on the file count in its counters  
+         const auto totals = counters.GetTotals();
+         REQUIRE(totals[IOStats::Read].mCount == 100);
+         REQUIRE(totals[IOStats::Read].mMaxTime == 1000000);
+         REQUIRE(totals[IOStats::Stat].mCount == 0);
+
+         // Resetting the module-wide totals doesn't touch the file's   
+         stats.Reset();
+         REQUIRE(stats.GetSnapshot().mTotals[IOStats::Read].mCount == 0);
+         REQUIRE(counters.GetTotals()[IOStats::Read].mCount == 100);
+         counters.Reset();
+         REQUIRE(counters.GetTotals()[IOStats::Read].mCount == 0);
+      }
+
+      WHEN("Operations are recorded from many threads at once") {
+         constexpr int Threads = 8;
+         constexpr int Operations = 10000;
+         std::vector<std::thread> threads;
+         for (int t = 0; t < Threads; ++t) {
+            threads.emplace_back([&, t] {
+               for (int i = 0; i < Operations; ++i) {
+                  stats.Record(IOStats::Write,
+                     static_cast<uint64_t>(t + 1), 1, &counters);
+               }
+            });
+         }
+         for (auto& thread : threads)
+            thread.join();
+
+         const auto snapshot = stats.GetSnapshot();
+         const auto& write = snapshot.mTotals[IOStats::Write];
+         REQUIRE(write.mCount == Threads * Operations);
+         REQUIRE(write.mBytes == Threads * Operations);
+         REQUIRE(write.mMaxTime == Threads);
+         REQUIRE(counters.GetTotals()[IOStats::Write].mCount
+            == Threads * Operations);
+         REQUIRE(counters.GetTotals()[IOStats::Write].mTime
+            == Operations * Threads * (Threads + 1) / 2);
+      }
+   }
+
+   GIVEN("Files that are read and written") {
+      auto root = Thing::Root<false>("FileSystem");
+      const auto runtime = root.GetRuntime();
+      const auto module = GetModule(runtime);
+      const auto dir = Sandbox(runtime, "iostats");
+      const auto contents = MakePattern(256 * 1024);
+      WriteNative(dir / "busy.bin", contents);
+      WriteNative(dir / "idle.bin", "idle");
+      auto busy = runtime->GetFile("iostats/busy.bin");
+      auto idle = runtime->GetFile("iostats/idle.bin");
+
+      WHEN("Files are ranked by the time they spent in I/O") {
+         for (int i = 0; i < 8; ++i)
+            REQUIRE(AsString(busy->ReadAs(nullptr)) == contents);
+         REQUIRE(AsString(idle->ReadAs(nullptr)) == "idle");
+
+         const auto busyTotals = AsFile(busy)->GetIOStats();
+         REQUIRE(busyTotals[IOStats::Read].mCount > 0);
+         REQUIRE(busyTotals[IOStats::Read].mBytes >= 8 * contents.size());
+         REQUIRE(busyTotals[IOStats::Write].mCount == 0);
+
+         // Module-wide totals include the operations of all files      
+         const auto snapshot = module->GetIOStats().GetSnapshot();
+         const auto& read = snapshot.mTotals[IOStats::Read];
+         REQUIRE(read.mCount >= busyTotals[IOStats::Read].mCount);
+         REQUIRE(read.mBytes >= busyTotals[IOStats::Read].mBytes);
+         Count histogram = 0;
+         for (auto count : snapshot.mLatency[IOStats::Read].mBuckets)
+            histogram += count;
+         REQUIRE(histogram == read.mCount);
+
+         // Files are sorted by the time they spent in I/O, including   
+         // the stat made when they were interfaced                     
+         const auto time = [](const ::File* file) {
+            uint64_t sum = 0;
+            for (auto& totals : file->GetIOStats())
+               sum += totals.mTime;
+            return sum;
+         };
+
+         const auto slowest = module->GetSlowestFiles(10);
+         std::vector<const ::File*> ranked {slowest.begin(), slowest.end()};
+         REQUIRE(std::ranges::find(ranked, AsFile(busy)) != ranked.end());
+         REQUIRE(std::ranges::find(ranked, AsFile(idle)) != ranked.end());
+         for (size_t i = 1; i < ranked.size(); ++i)
+            REQUIRE(time(ranked[i - 1]) >= time(ranked[i]));
+
+         REQUIRE(module->GetSlowestFiles(1).GetCount() == 1);
+         REQUIRE(module->GetSlowestFiles(0).GetCount() == 0);
+         REQUIRE_NOTHROW(module->LogIOStats(2));
+         REQUIRE_NOTHROW(module->LogIOStats(0));
+      }
+
+      WHEN("Writes are counted") {
+         AsFile(idle)->WriteAtomic(AsBytes("rewritten"));
+         const auto totals = AsFile(idle)->GetIOStats();
+         REQUIRE(totals[IOStats::Write].mCount > 0);
+         REQUIRE(totals[IOStats::Write].mBytes >= 9);
+      }
+
+      // Check for memory leaks after each cycle                        
+      REQUIRE(memoryState.Assert());
+   }
+}
+
+SCENARIO("Atomic rewrites", "[filesystem]") {
+   static Allocator::State memoryState;
+
+   GIVEN("A file in the write directory") {
+      auto root = Thing::Root<false>("FileSystem");
+      const auto runtime = root.GetRuntime();
+      const auto module = GetModule(runtime);
+      const auto dir = Sandbox(runtime, "atomic");
+      WriteNative(dir / "target.bin", "old contents");
+
+      auto file = runtime->GetFile("atomic/target.bin");
+      REQUIRE(file->Exists());
+
+      WHEN("The file is rewritten") {
+         AsFile(file)->WriteAtomic(AsBytes("new contents"));
+
+         REQUIRE(ReadNative(dir / "target.bin") == "new contents");
+         REQUIRE(AsString(file->ReadAs(nullptr)) == "new contents");
+         REQUIRE(CountTemporaries(dir) == 0);
+      }
+
+      WHEN("Temporaries were left behind by a crash") {
+         // The first one has the name the next temporary gets          
+         WriteNative(dir / "target.bin.tmp-0", "leftover");
+         WriteNative(dir / "target.bin.tmp-999", "leftover");
+         AsFile(file)->WriteAtomic(AsBytes("new contents"));
+
+         // Leftovers are reused or ignored, but never end up as the    
+         // contents of the target                                      
+         REQUIRE(ReadNative(dir / "target.bin") == "new contents");
+         REQUIRE(AsString(file->ReadAs(nullptr)) == "new contents");
+         REQUIRE_FALSE(fs::exists(dir / "target.bin.tmp-0"));
+         REQUIRE(ReadNative(dir / "target.bin.tmp-999") == "leftover");
+      }
+
+      WHEN("Rewrites are grouped") {
+         module->GetCommitQueue().SetGroupCommit(true);
+         AsFile(file)->WriteAtomic(AsBytes("new contents"));
+
+         // Nothing is visible until the next update                    
+         REQUIRE(ReadNative(dir / "target.bin") == "old contents");
+         REQUIRE(CountTemporaries(dir) == 1);
+
+         root.Update({});
+         REQUIRE(ReadNative(dir / "target.bin") == "new contents");
+         REQUIRE(AsString(file->ReadAs(nullptr)) == "new contents");
+         REQUIRE(CountTemporaries(dir) == 0);
+         module->GetCommitQueue().SetGroupCommit(false);
+      }
+
+      WHEN("A grouped rewrite is superseded before it is committed") {
+         module->GetCommitQueue().SetGroupCommit(true);
+         AsFile(file)->WriteAtomic(AsBytes("first"));
+         AsFile(file)->WriteAtomic(AsBytes("second"));
+         REQUIRE(CountTemporaries(dir) == 1);
+
+         root.Update({});
+         REQUIRE(ReadNative(dir / "target.bin") == "second");
+         REQUIRE(CountTemporaries(dir) == 0);
+
+         // An ungrouped rewrite supersedes a grouped one too           
+         AsFile(file)->WriteAtomic(AsBytes("grouped"));
+         module->GetCommitQueue().SetGroupCommit(false);
+         AsFile(file)->WriteAtomic(AsBytes("direct"));
+         REQUIRE(CountTemporaries(dir) == 0);
+
+         root.Update({});
+         REQUIRE(ReadNative(dir / "target.bin") == "direct");
+      }
+
+      // Check for memory leaks after each cycle                        
+      REQUIRE(memoryState.Assert());
+   }
+}
+
+/// Make a record of fixed size, that tells where it came from                
+///   @param producer - index of the producing thread                         
+///   @param index - index of the record inside the producer                  
+///   @return the record, always 16 characters                                
+static std::string MakeRecord(int producer, int index) {
+   auto record = "p" + std::to_string(producer) + "-" + std::to_string(index);
+   record.resize(15, '.');
+   return record + '\n';
+}
+
+SCENARIO("Multi-producer append logs", "[filesystem]") {
+   static Allocator::State memoryState;
+
+   GIVEN("An empty log file") {
+      auto root = Thing::Root<false>("FileSystem");
+      const auto runtime = root.GetRuntime();
+      const auto module = GetModule(runtime);
+      const auto dir = Sandbox(runtime, "append");
+      WriteNative(dir / "log.txt", "");
+
+      auto file = runtime->GetFile("append/log.txt");
+      const auto log = AsFile(file);
+
+      WHEN("Many threads append at once") {
+         constexpr int Producers = 8;
+         constexpr int Records = 256;
+         std::vector<std::vector<Offset>> offsets(Producers);
+         std::vector<std::thread> producers;
+         for (int p = 0; p < Producers; ++p) {
+            producers.emplace_back([&, p] {
+               for (int i = 0; i < Records; ++i)
+                  offsets[p].push_back(log->Append(AsBytes(MakeRecord(p, i))));
+            });
+         }
+         for (auto& producer : producers)
+            producer.join();
+
+         REQUIRE(log->GetAppendLog().Flush());
+
+         // Each record is found exactly where its offset says, and     
+         // offsets cover the file without gaps or overlaps             
+         const auto contents = ReadNative(dir / "log.txt");
+         REQUIRE(contents.size() == size_t {Producers * Records * 16});
+
+         std::vector<Offset> all;
+         for (int p = 0; p < Producers; ++p) {
+            for (int i = 0; i < Records; ++i) {
+               const auto offset = offsets[p][i];
+               REQUIRE(contents.substr(offset, 16) == MakeRecord(p, i));
+               all.push_back(offset);
+            }
+         }
+
+         std::ranges::sort(all);
+         for (size_t i = 0; i < all.size(); ++i)
+            REQUIRE(all[i] == i * 16);
+      }
+
+      WHEN("Records are flushed") {
+         REQUIRE(log->Append(AsBytes(MakeRecord(0, 0))) == 0);
+         REQUIRE(log->Append(AsBytes(MakeRecord(0, 1))) == 16);
+         REQUIRE(log->GetAppendLog().Flush());
+         REQUIRE(ReadNative(dir / "log.txt")
+            == MakeRecord(0, 0) + MakeRecord(0, 1));
+
+         // Offsets continue after what the file already contained      
+         REQUIRE(log->Append(AsBytes(MakeRecord(0, 2))) == 32);
+         REQUIRE(log->GetAppendLog().Flush());
+         REQUIRE(ReadNative(dir / "log.txt").size() == 48);
+         REQUIRE_FALSE(log->GetAppendLog().HasFailed());
+
+         // Cached info is invalidated before the flush returns         
+         PHYSFS_Stat info {};
+         REQUIRE(module->GetStatCache().Stat("append/log.txt", info));
+         REQUIRE(info.filesize == 48);
+      }
+
+      WHEN("Records are appended before the log is started") {
+         AppendLog idle {"append/idle.txt",
+            module->GetHandlePool(), module->GetIOStats(), nullptr};
+         const auto record = MakeRecord(0, 0);
+         REQUIRE_THROWS(idle.Append(
+            reinterpret_cast<const Byte*>(record.data()), record.size()));
+
+         // Nothing was reserved, so there is nothing to wait for       
+         REQUIRE(idle.Flush());
+         REQUIRE_FALSE(idle.IsRunning());
+      }
+
+      WHEN("The log is rotated") {
+         // Three records fit in a segment, and two segments are kept   
+         log->GetAppendLog().SetRotation(48, 2);
+         for (int i = 0; i < 9; ++i)
+            REQUIRE(log->Append(AsBytes(MakeRecord(0, i))) == Offset(i) * 16);
+         REQUIRE(log->GetAppendLog().Flush());
+
+         REQUIRE(ReadNative(dir / "log.txt").empty());
+         REQUIRE(ReadNative(dir / "log.txt.1")
+            == MakeRecord(0, 6) + MakeRecord(0, 7) + MakeRecord(0, 8));
+         REQUIRE(ReadNative(dir / "log.txt.2")
+            == MakeRecord(0, 3) + MakeRecord(0, 4) + MakeRecord(0, 5));
+         REQUIRE_FALSE(fs::exists(dir / "log.txt.3"));
+
+         // Offsets keep growing, and the current file starts where the 
+         // last rotated one ended                                      
+         auto& appendLog = log->GetAppendLog();
+         REQUIRE(appendLog.GetSegmentStart() == 9 * 16);
+         const auto offset = log->Append(AsBytes(MakeRecord(0, 9)));
+         REQUIRE(offset == 9 * 16);
+         REQUIRE(appendLog.Flush());
+         REQUIRE(ReadNative(dir / "log.txt").substr(
+            offset - appendLog.GetSegmentStart()) == MakeRecord(0, 9));
+      }
+
+      // Check for memory leaks after each cycle                        
+      REQUIRE(memoryState.Assert());
+   }
+}
+
+SCENARIO("Reading and writing without the page cache", "[filesystem]") {
+   static Allocator::State memoryState;
+
+   GIVEN("Streams that bypass the page cache") {
+      auto root = Thing::Root<false>("FileSystem");
+      const auto runtime = root.GetRuntime();
+      const auto dir = Sandbox(runtime, "direct");
+      WriteNative(dir / "target.bin", "");
+      auto file = runtime->GetFile("direct/target.bin");
+
+      // Two blocks, so that some writes span the whole buffer          
+      ::File::Buffering direct;
+      direct.mDirect = true;
+      direct.mSize = 2 * Native::DirectAlignment;
+
+      // Sizes that are never a multiple of the alignment, and writes   
+      // that end inside, at, and past the buffer                       
+      const size_t sizes[] {1, 4095, 4097, 10000, 3, 8192, 17};
+      std::string written;
+      const auto write = [&](bool append) {
+         auto writer = AsFile(file)->NewWriter(append, direct);
+         const auto concrete = static_cast<::File::Writer*>(
+            const_cast<A::File::Writer*>(writer.Get()));
+
+         for (auto size : sizes) {
+            const auto chunk = MakePattern(written.size() + size)
+               .substr(written.size());
+            REQUIRE(writer->Write(AsBytes(chunk)) == size);
+            written += chunk;
+
+            // Flushing midway pads the last block, but the file must   
+            // still end exactly where the written bytes do             
+            concrete->Flush();
+            REQUIRE(fs::file_size(dir / "target.bin") == written.size());
+         }
+      };
+
+      WHEN("A file is written, and then appended to") {
+         write(false);
+         REQUIRE(ReadNative(dir / "target.bin") == written);
+
+         write(true);
+         REQUIRE(ReadNative(dir / "target.bin") == written);
+         REQUIRE(fs::file_size(dir / "target.bin") == written.size());
+      }
+
+      WHEN("A file is rewritten with fewer bytes") {
+         WriteNative(dir / "target.bin", MakePattern(100000));
+         write(false);
+         REQUIRE(ReadNative(dir / "target.bin") == written);
+      }
+
+      WHEN("A file is read in pieces of odd sizes, and at odd offsets") {
+         const auto contents = MakePattern(50000);
+         WriteNative(dir / "target.bin", contents);
+         auto reader = AsFile(file)->NewReader(direct);
+         const auto concrete = static_cast<::File::Reader*>(
+            const_cast<A::File::Reader*>(reader.Get()));
+
+         std::string read;
+         for (auto size : sizes) {
+            std::string chunk(size, '\0');
+            const auto done = concrete->Read(
+               reinterpret_cast<Byte*>(chunk.data()), size);
+            read += chunk.substr(0, done);
+         }
+         REQUIRE(read == contents.substr(0, read.size()));
+
+         const Offset offsets[] {4095, 1, 40000, 8193, 49990};
+         for (auto offset : offsets) {
+            concrete->Seek(offset);
+            std::string chunk(100, '\0');
+            const auto done = concrete->Read(
+               reinterpret_cast<Byte*>(chunk.data()), 100);
+            REQUIRE(done == std::min<Offset>(100, contents.size() - offset));
+            REQUIRE(chunk.substr(0, done) == contents.substr(offset, done));
+         }
+      }
+
+      // Check for memory leaks after each cycle                        
+      REQUIRE(memoryState.Assert());
+   }
+}
+
+SCENARIO("Typed views", "[filesystem]") {
+   static Allocator::State memoryState;
+
+   GIVEN("An array of floats in a directory and in an archive") {
+      auto root = Thing::Root<false>("FileSystem");
+      const auto runtime = root.GetRuntime();
+      const auto module = GetModule(runtime);
+      const auto dir = Sandbox(runtime, "typed");
+
+      std::vector<float> floats(10000);
+      for (size_t i = 0; i < floats.size(); ++i)
+         floats[i] = static_cast<float>(i) * 0.5f;
+      const std::string bytes {
+         reinterpret_cast<const char*>(floats.data()),
+         floats.size() * sizeof(float)};
+      WriteNative(dir / "floats.bin", bytes);
+      WriteNative(dir / "odd.bin", bytes.substr(0, 10));
+      WriteNative(dir / "empty.bin", "");
+      WriteNative(dir / "floats.zip", MakeZip({
+         {"floats.bin", bytes}, {"odd.bin", bytes.substr(0, 10)}}));
+      REQUIRE(MountNative(module, dir / "floats.zip", "zipped"));
+
+      // The view has to hold the very same floats, in a block that is  
+      // aligned for them                                               
+      const auto check = [&](const ::File::View& view) {
+         const auto& data = view.GetData();
+         REQUIRE(data.IsExact<float>());
+         REQUIRE(data.GetCount() == floats.size());
+         REQUIRE(reinterpret_cast<uintptr_t>(data.GetRaw())
+            % alignof(float) == 0);
+         REQUIRE(0 == std::memcmp(data.GetRaw(), bytes.data(), bytes.size()));
+      };
+
+      WHEN("A native file is viewed") {
+         auto file = runtime->GetFile("typed/floats.bin");
+         const auto view = AsFile(file)->ViewAs(MetaDataOf<float>());
+         check(view);
+
+         // Elements are viewed right inside the mapping                
+         REQUIRE(view.IsMapped());
+         const auto mapped = AsFile(file)->NewMappedView();
+         REQUIRE(view.GetData().GetRaw() == mapped.GetData().GetRaw());
+
+         // Viewing as a bigger type only changes the count             
+         const auto wide = AsFile(file)->ViewAs(MetaDataOf<double>());
+         REQUIRE(wide.IsMapped());
+         REQUIRE(wide.GetData().GetCount() == floats.size() / 2);
+      }
+
+      WHEN("An archived file is viewed") {
+         const auto view = AsFile(runtime->GetFile("zipped/floats.bin"))
+            ->ViewAs(MetaDataOf<float>());
+         check(view);
+
+         // Elements are copied into a container of their own           
+         REQUIRE_FALSE(view.IsMapped());
+      }
+
+      WHEN("A native file is interpreted as a POD type") {
+         auto file = runtime->GetFile("typed/floats.bin");
+         Verbs::Interpret interpret {MetaDataOf<float>()};
+         AsFile(file)->Interpret(interpret);
+         REQUIRE(interpret.GetOutput().GetCount() == 1);
+
+         // The output is a view right inside the mapping, and keeps it 
+         // alive after the file drops it                               
+         const auto& view = interpret.GetOutput()
+            .template As<::File::View>();
+         REQUIRE(view.IsMapped());
+         check(view);
+
+         const auto mapped = AsFile(file)->NewMappedView();
+         REQUIRE(view.GetData().GetRaw() == mapped.GetData().GetRaw());
+         AsFile(file)->Refresh();
+         check(view);
+      }
+
+      WHEN("Files are viewed as types they can't hold") {
+         // Size isn't a multiple of the type size                      
+         auto odd = AsFile(runtime->GetFile("typed/odd.bin"));
+         REQUIRE_THROWS(odd->ViewAs(MetaDataOf<float>()));
+         REQUIRE_THROWS(AsFile(runtime->GetFile("zipped/odd.bin"))
+            ->ViewAs(MetaDataOf<float>()));
+
+         // Types that aren't POD can't be viewed at all                
+         auto file = AsFile(runtime->GetFile("typed/floats.bin"));
+         REQUIRE_THROWS(file->ViewAs(MetaDataOf<Text>()));
+         REQUIRE_THROWS(file->ViewAs(nullptr));
+
+         // Empty and missing files have no elements, but are typed     
+         for (auto path : {"typed/empty.bin", "typed/missing.bin"}) {
+            const auto view = AsFile(runtime->GetFile(path))
+               ->ViewAs(MetaDataOf<float>());
+            REQUIRE(view.GetData().IsExact<float>());
+            REQUIRE(view.GetData().IsEmpty());
+         }
+      }
+
+      // Check for memory leaks after each cycle                        
+      REQUIRE(memoryState.Assert());
+   }
+}
+
+/// Read all records of a file                                                
+///   @param file - the file                                                  
+///   @param delimiter - the record delimiter                                 
+///   @param bufferSize - initial buffer size of the line reader              
+///   @return the records                                                     
+static std::vector<std::string> ReadRecords(
+   const Ref<A::File>& file, char delimiter = '\n',
+   Offset bufferSize = LineReader::DefaultBufferSize
+) {
+   LineReader reader {*AsFile(file), delimiter, bufferSize};
+   std::vector<std::string> records;
+   Token record;
+   while (reader.Next(record))
+      records.emplace_back(record);
+   REQUIRE(reader.GetRecordCount() == records.size());
+   return records;
+}
+
+SCENARIO("Reading records", "[filesystem]") {
+   static Allocator::State memoryState;
+
+   GIVEN("A file system") {
+      auto root = Thing::Root<false>("FileSystem");
+      const auto runtime = root.GetRuntime();
+      const auto dir = Sandbox(runtime, "records");
+      using Records = std::vector<std::string>;
+
+      WHEN("Lines end with carriage returns") {
+         WriteNative(dir / "crlf.txt", "a\r\nbb\r\n\r\nccc\r\n");
+         REQUIRE(ReadRecords(runtime->GetFile("records/crlf.txt"))
+            == Records {"a", "bb", "", "ccc"});
+
+         // Only new lines strip them                                   
+         WriteNative(dir / "semicolons.txt", "a\r;b\r");
+         REQUIRE(ReadRecords(runtime->GetFile("records/semicolons.txt"), ';')
+            == Records {"a\r", "b\r"});
+      }
+
+      WHEN("The last record has no delimiter") {
+         WriteNative(dir / "open.txt", "first\nsecond");
+         REQUIRE(ReadRecords(runtime->GetFile("records/open.txt"))
+            == Records {"first", "second"});
+
+         WriteNative(dir / "closed.txt", "first\nsecond\n");
+         REQUIRE(ReadRecords(runtime->GetFile("records/closed.txt"))
+            == Records {"first", "second"});
+      }
+
+      WHEN("There are empty lines, or nothing at all") {
+         WriteNative(dir / "blank.txt", "\n\n\n");
+         REQUIRE(ReadRecords(runtime->GetFile("records/blank.txt"))
+            == Records {"", "", ""});
+
+         WriteNative(dir / "empty.txt", "");
+         REQUIRE(ReadRecords(runtime->GetFile("records/empty.txt")).empty());
+      }
+
+      WHEN("Records are bigger than the buffer") {
+         const auto big = MakePattern(1000);
+         const auto huge = MakePattern(5000);
+         WriteNative(dir / "big.txt", "x\n" + big + '\n' + huge + "\ny");
+         REQUIRE(ReadRecords(runtime->GetFile("records/big.txt"), '\n', 16)
+            == Records {"x", big, huge, "y"});
+      }
+
+      // Check for memory leaks after each cycle                        
+      REQUIRE(memoryState.Assert());
+   }
+
+   GIVEN("Ranges that end at every possible distance from a vector") {
+      // Ranges start at any alignment, and end anywhere within, and    
+      // just past, the 16 and 32 byte steps, with the needle anywhere  
+      // or nowhere                                                     
+      std::string text(160, '.');
+      for (size_t begin = 0; begin < 32; ++begin) {
+         for (size_t end = begin; end <= begin + 100; ++end) {
+            for (size_t at = begin; at <= end; ++at) {
+               if (at < end)
+                  text[at] = '\n';
+
+               const auto from = text.data() + begin;
+               const auto to = text.data() + end;
+               REQUIRE(LineReader::Find(from, to, '\n')
+                  == LineReader::FindScalar(from, to, '\n'));
+
+               if (at < end)
+                  text[at] = '.';
+            }
+         }
+      }
+
+      // A needle right after the range must not be found               
+      text[48] = '\n';
+      REQUIRE(LineReader::Find(text.data() + 16, text.data() + 48, '\n')
+         == text.data() + 48);
+      REQUIRE(LineReader::Find(text.data(), text.data() + 32, '\n')
+         == text.data() + 32);
+   }
+}
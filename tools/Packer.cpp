@@ -0,0 +1,275 @@
+///                                                                           
+/// Langulus::Module::FileSystem                                              
+/// Copyright (c) 2016 Dimo Markov <team@langulus.com>                        
+/// Part of the Langulus framework, see https://langulus.com                  
+///                                                                           
+/// SPDX-License-Identifier: GPL-3.0-or-later                                 
+///                                                                           
+#include "PackFormat.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#if LANGULUS_MOD_FILESYSTEM_LZ4
+   #include <lz4.h>
+#endif
+
+using namespace PackFormat;
+namespace fs = std::filesystem;
+
+
+/// An entry to be packed                                                     
+struct Input {
+   std::string mName;
+   fs::path mPath;
+   bool mFolder;
+   int64_t mModTime;
+};
+
+/// Lowercase a name, the same way the module does                            
+static std::string Lowercase(std::string name) {
+   for (auto& c : name) {
+      if (c >= 'A' and c <= 'Z')
+         c += 'a' - 'A';
+   }
+   return name;
+}
+
+/// Get a modification time in seconds since the epoch                        
+static int64_t ModTime(const fs::path& path) {
+   std::error_code ec;
+   const auto time = fs::last_write_time(path, ec);
+   if (ec)
+      return -1;
+
+   const auto system = std::chrono::file_clock::to_sys(time);
+   return std::chrono::duration_cast<std::chrono::seconds>(
+      system.time_since_epoch()).count();
+}
+
+/// Compress contents in independent chunks                                   
+///   @param data - the contents to compress                                  
+///   @param chunkSize - uncompressed bytes per chunk                         
+///   @param stored - [out] the chunk table, followed by the chunks           
+///   @return true if compression saved any space                             
+static bool Compress(
+   const std::vector<char>& data, uint32_t chunkSize, std::vector<char>& stored
+) {
+#if LANGULUS_MOD_FILESYSTEM_LZ4
+   const uint64_t chunks = (data.size() + chunkSize - 1) / chunkSize;
+   std::vector<uint64_t> table(chunks + 1);
+   stored.assign(table.size() * sizeof(uint64_t), 0);
+
+   std::vector<char> scratch(LZ4_compressBound(static_cast<int>(chunkSize)));
+   for (uint64_t i = 0; i < chunks; ++i) {
+      const auto from = data.data() + i * chunkSize;
+      const auto size = static_cast<int>(
+         std::min<uint64_t>(chunkSize, data.size() - i * chunkSize));
+
+      table[i] = stored.size();
+      const auto packed = LZ4_compress_default(
+         from, scratch.data(), size, static_cast<int>(scratch.size()));
+
+      // Chunks that don't shrink are stored as they are                
+      if (packed > 0 and packed < size)
+         stored.insert(stored.end(), scratch.data(), scratch.data() + packed);
+      else
+         stored.insert(stored.end(), from, from + size);
+   }
+
+   table[chunks] = stored.size();
+   std::memcpy(stored.data(), table.data(), table.size() * sizeof(uint64_t));
+   return stored.size() < data.size();
+#else
+   (void) data;
+   (void) chunkSize;
+   (void) stored;
+   return false;
+#endif
+}
+
+/// Write zeroes up to an alignment                                           
+static void Pad(std::ofstream& output, uint64_t alignment) {
+   const auto at = static_cast<uint64_t>(output.tellp());
+   const std::vector<char> zeroes(Align(at, alignment) - at);
+   output.write(zeroes.data(), zeroes.size());
+}
+
+
+///                                                                           
+///   Pack builder                                                            
+///                                                                           
+///   Packs a directory into a single .lpk file:                              
+///      LangulusModFileSystemPacker <directory> <output.lpk> [options]       
+///   Options:                                                                
+///      --lz4             compress entries in chunks, if it saves space      
+///      --chunk <bytes>   uncompressed chunk size, 64KiB by default          
+///      --align <bytes>   entry data alignment, 4KiB by default              
+///   Names are lowercased, because the module interfaces lowercase paths.    
+/// Symbolic links are skipped, because PhysFS hides them by default          
+///                                                                           
+int main(int argc, char** argv) {
+   if (argc < 3) {
+      std::cerr << "Usage: " << argv[0] << " <directory> <output.lpk>"
+         " [--lz4] [--chunk <bytes>] [--align <bytes>]\n";
+      return EXIT_FAILURE;
+   }
+
+   const fs::path root {argv[1]};
+   const fs::path target {argv[2]};
+   bool compress = false;
+   uint32_t chunkSize = DefaultChunkSize;
+   uint32_t alignment = DefaultAlignment;
+
+   for (int i = 3; i < argc; ++i) {
+      const std::string option {argv[i]};
+      if (option == "--lz4")
+         compress = true;
+      else if (option == "--chunk" and i + 1 < argc)
+         chunkSize = std::strtoul(argv[++i], nullptr, 0);
+      else if (option == "--align" and i + 1 < argc)
+         alignment = std::strtoul(argv[++i], nullptr, 0);
+      else {
+         std::cerr << "Unknown option: " << option << '\n';
+         return EXIT_FAILURE;
+      }
+   }
+
+#if not LANGULUS_MOD_FILESYSTEM_LZ4
+   if (compress) {
+      std::cerr << "Packer was built without LZ4 support\n";
+      return EXIT_FAILURE;
+   }
+#endif
+
+   if (not chunkSize or not std::has_single_bit(alignment)) {
+      std::cerr << "Chunk size must be positive, "
+         "and alignment must be a power of two\n";
+      return EXIT_FAILURE;
+   }
+
+   // Gather all entries, sorted by name, as the format requires        
+   std::vector<Input> inputs;
+   std::error_code ec;
+   fs::recursive_directory_iterator it {
+      root, fs::directory_options::skip_permission_denied, ec};
+   for (; not ec and it != fs::recursive_directory_iterator {};
+          it.increment(ec)) {
+      std::error_code entryError;
+      if (it->is_symlink(entryError))
+         continue;
+
+      const bool folder = it->is_directory(entryError);
+      if (not folder and not it->is_regular_file(entryError))
+         continue;
+
+      const auto relative = it->path().lexically_relative(root);
+      inputs.push_back({
+         Lowercase(relative.generic_string()), it->path(), folder,
+         ModTime(it->path())
+      });
+   }
+
+   if (ec) {
+      std::cerr << "Can't walk " << root << ": " << ec.message() << '\n';
+      return EXIT_FAILURE;
+   }
+
+   std::ranges::sort(inputs, {}, &Input::mName);
+   for (size_t i = 1; i < inputs.size(); ++i) {
+      if (inputs[i].mName == inputs[i - 1].mName) {
+         std::cerr << "Names differ only by case: "
+            << inputs[i].mPath << '\n';
+         return EXIT_FAILURE;
+      }
+   }
+
+   // Lay out the table of contents                                     
+   std::vector<PackEntry> entries(inputs.size());
+   std::string names;
+   for (size_t i = 0; i < inputs.size(); ++i) {
+      auto& entry = entries[i];
+      entry = {};
+      entry.mNameOffset = static_cast<uint32_t>(names.size());
+      entry.mNameSize = static_cast<uint32_t>(inputs[i].mName.size());
+      entry.mFlags = inputs[i].mFolder ? uint32_t {Directory} : 0u;
+      entry.mModTime = inputs[i].mModTime;
+      names += inputs[i].mName;
+   }
+
+   PackHeader header {};
+   std::memcpy(header.mMagic, Magic, sizeof(Magic));
+   header.mVersion = Version;
+   header.mAlignment = alignment;
+   header.mEntryCount = static_cast<uint32_t>(entries.size());
+   header.mEntriesOffset = sizeof(PackHeader);
+   header.mNamesOffset = header.mEntriesOffset
+      + entries.size() * sizeof(PackEntry);
+   header.mNamesSize = names.size();
+   header.mCompression = compress ? LZ4 : None;
+
+   std::ofstream output {target, std::ios::binary | std::ios::trunc};
+   if (not output) {
+      std::cerr << "Can't create " << target << '\n';
+      return EXIT_FAILURE;
+   }
+
+   // Table of contents is written once more at the end, when the data  
+   // offsets and sizes are known                                       
+   output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+   output.write(reinterpret_cast<const char*>(entries.data()),
+      entries.size() * sizeof(PackEntry));
+   output.write(names.data(), names.size());
+
+   uint64_t totalSize = 0, totalStored = 0;
+   std::vector<char> data, stored;
+   for (size_t i = 0; i < inputs.size(); ++i) {
+      if (inputs[i].mFolder)
+         continue;
+
+      std::ifstream input {inputs[i].mPath, std::ios::binary};
+      data.assign(std::istreambuf_iterator<char> {input}, {});
+      if (not input and not input.eof()) {
+         std::cerr << "Can't read " << inputs[i].mPath << '\n';
+         return EXIT_FAILURE;
+      }
+
+      Pad(output, alignment);
+      auto& entry = entries[i];
+      entry.mOffset = static_cast<uint64_t>(output.tellp());
+      entry.mSize = data.size();
+
+      if (compress and Compress(data, chunkSize, stored)) {
+         entry.mFlags |= Compressed;
+         entry.mChunkSize = chunkSize;
+         entry.mStoredSize = stored.size();
+         output.write(stored.data(), stored.size());
+      }
+      else {
+         entry.mStoredSize = data.size();
+         output.write(data.data(), data.size());
+      }
+
+      totalSize += entry.mSize;
+      totalStored += entry.mStoredSize;
+   }
+
+   output.seekp(sizeof(PackHeader));
+   output.write(reinterpret_cast<const char*>(entries.data()),
+      entries.size() * sizeof(PackEntry));
+   output.close();
+   if (not output) {
+      std::cerr << "Can't write " << target << '\n';
+      return EXIT_FAILURE;
+   }
+
+   std::cout << "Packed " << entries.size() << " entries, "
+      << totalSize << " bytes stored in " << totalStored << " bytes, into "
+      << target << '\n';
+   return EXIT_SUCCESS;
+}